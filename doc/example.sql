@@ -26,3 +26,102 @@ SELECT to_str(spatiotemporal_make('ST_TRAJECTORY(2015-05-18 10:00:00;2015-05-19
                            POINT(12 4), 2015-05-18 10:00:00;
                            POINT(13 5), 2015-05-18 20:00:00; 
                            POINT(15 10), 2015-05-19 11:00:00;)'));
+
+
+SELECT get_end_time(st_append_instant(spatiotemporal_make('ST_TRAJECTORY(2015-05-18 10:00:00;2015-05-19 11:00:00;
+                           POINT(12 4), 2015-05-18 10:00:00;
+                           POINT(13 5), 2015-05-18 20:00:00; 
+                           POINT(15 10), 2015-05-19 11:00:00;)'),
+                           ST_GeomFromText('POINT(16 11)'), '2015-05-19 12:00:00'));
+
+
+CREATE TABLE drifter_track (id INTEGER PRIMARY KEY, track spatiotemporal(4326, XY, 6));
+
+INSERT INTO drifter_track VALUES (1, 'SRID=4326;ST_TRAJECTORY(2015-05-18 10:00:00;2015-05-19 11:00:00;
+                           POINT(12 4), 2015-05-18 10:00:00;
+                           POINT(13 5), 2015-05-18 20:00:00; 
+                           POINT(15 10), 2015-05-19 11:00:00;)');
+
+SELECT st_srid(track) FROM drifter_track;
+
+SELECT st_as_binary(track, 6), st_as_mfjson(track) FROM drifter_track;
+
+ANALYZE drifter_track;
+
+SELECT id FROM drifter_track WHERE track && tsrange('2015-05-18', '2015-05-19');
+
+SELECT id, (st_instants(track)).* FROM drifter_track;
+
+SELECT ST_Length(track::geometry), ST_AsText(track::geometry) FROM drifter_track;
+
+SELECT DISTINCT st_normalize(track) FROM drifter_track;
+
+SELECT a.id, b.id, st_frechet(a.track, b.track, threshold => 0.5)
+  FROM drifter_track a, drifter_track b
+ WHERE a.id < b.id;
+
+SELECT * FROM st_proximity_pairs((SELECT array_agg(track ORDER BY id) FROM drifter_track), 0.1, '1 day');
+
+ALTER TABLE drifter_track ALTER COLUMN track SET STORAGE EXTERNAL;
+
+UPDATE drifter_track SET track = st_chunk(track, '30 days');
+
+SELECT ST_AsText(st_value_at(track, '2015-05-18 15:00:00')) FROM drifter_track;
+
+SELECT to_str(st_transform(track, 3857)) FROM drifter_track;
+
+SELECT tw_avg(temp), tw_min(temp), tw_max(temp), st_value_at(temp, '2015-05-18 15:00:00')
+  FROM (SELECT 'TEMPORAL_FLOAT(21.5, 2015-05-18 10:00:00; 22.25, 2015-05-18 20:00:00; 20, 2015-05-19 11:00:00;)'::temporal_float AS temp) t;
+
+SELECT temporal_float_agg(v, t ORDER BY t)
+  FROM (VALUES (21.5, '2015-05-18 10:00:00'::timestamp), (22.25, '2015-05-18 20:00:00')) AS s(v, t);
+
+SELECT st_density_grid(track, ST_MakeEnvelope(10, 0, 20, 10, 4326), tsrange('2015-05-18', '2015-05-20'), 10, 10, '1 day')
+  FROM drifter_track;
+
+SELECT st_as_trajectory_mvt(st_transform(track, 3857), 4, 8, 7, 'drifters') FROM drifter_track;
+
+CREATE INDEX drifter_track_track_idx ON drifter_track USING GIST (track);
+
+SELECT id FROM drifter_track WHERE st_intersects(track, ST_MakeEnvelope(12, 4, 14, 6, 4326));
+
+SELECT id FROM drifter_track WHERE st_during(track, tsrange('2015-05-01', '2015-06-01'));
+
+-- with postgist in shared_preload_libraries, and a timestamp column holding the time of each fix
+CREATE TABLE buoy_track (buoy_id INTEGER PRIMARY KEY, track spatiotemporal);
+
+SELECT postgist_build_trajectories('traj_buoy_trajectory', 'traj_buoy_id', 'traj_location',
+                                   'traj_timestamp', 'buoy_track', 8);
+
+SELECT * FROM postgist_build_status;
+
+INSERT INTO buoy_track
+SELECT traj_buoy_id, st_trajectory_agg(traj_location, traj_timestamp ORDER BY traj_timestamp)
+  FROM traj_buoy_trajectory GROUP BY traj_buoy_id;
+
+SELECT spatiotemporal_make(to_str(track)::cstring) = track FROM drifter_track;
+
+CREATE TABLE spill (id INTEGER PRIMARY KEY, extent moving_region);
+
+INSERT INTO spill VALUES (1, 'SRID=4326;ST_MOVINGREGION(POLYGON((-40 -20,-39 -20,-39 -19,-40 -20)), 2015-05-18 10:00:00;
+                                                  POLYGON((-40 -20,-38.5 -20,-38.5 -18.5,-40 -20)), 2015-05-18 11:00:00;)');
+
+SELECT ST_AsText(st_value_at(extent, '2015-05-18 10:30:00')) FROM spill;
+
+SELECT * FROM st_snapshots((SELECT extent FROM spill WHERE id = 1));
+
+SELECT s.id, d.id FROM spill s, drifter_track d
+ WHERE st_intersects(s.extent, st_value_at(d.track, '2015-05-18 10:30:00'));
+
+-- with postgist in shared_preload_libraries
+INSERT INTO postgist_geofence VALUES (1, 'harbour', ST_GeomFromText('POLYGON((-40 -20,-39 -20,-39 -19,-40 -19,-40 -20))', 4326));
+
+CREATE TRIGGER drifter_track_geofence AFTER INSERT OR UPDATE OF track ON drifter_track
+  FOR EACH ROW EXECUTE PROCEDURE postgist_geofence_trigger('id', 'track');
+
+UPDATE drifter_track SET track = st_append_instant(track, ST_SetSRID(ST_MakePoint(-39.5, -19.5), 4326), '2015-05-20 10:00:00')
+ WHERE id = 1;
+
+SELECT * FROM postgist_geofence_event;
+
+SELECT id, e.* FROM drifter_track, st_geofence_events(track, '2015-05-19 00:00:00') e;
@@ -0,0 +1,364 @@
+/*
+  Copyright (C) 2017 National Institute For Space Research (INPE) - Brazil.
+
+  postgis-t is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License version 3 as
+  published by the Free Software Foundation.
+
+  postgis-t is distributed  "AS-IS" in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY OF ANY KIND; without even the implied warranty
+  of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with postgis-t. See LICENSE. If not, write to
+  Gilberto Ribeiro de Queiroz at <gribeiro@dpi.inpe.br>.
+
+ */
+
+
+/*!
+ *
+ * \file loader/copy.c
+ *
+ * \brief Binary COPY encoding of drifter tracks.
+ *
+ * \note Tracks are sent in the binary format read by spatiotemporal_recv,
+ *       so the server does no text parsing.
+ *
+ * \author Gilberto Ribeiro de Queiroz
+ * \author Fabiana Zioti
+ *
+ * \date 2017
+ *
+ * \copyright GNU Lesser Public License version 3
+ *
+ */
+
+/* PostGIS-T loader */
+#include "loader.h"
+
+/* C Standard Library */
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* signature, flags and header extension length of a binary COPY stream */
+static const char copy_signature[11] = "PGCOPY\n\377\r\n\0";
+
+/* header of the spatiotemporal binary format */
+#define ST_BINARY_HEADER_SIZE 32
+
+
+struct copy_buffer
+{
+  char *data;
+
+  size_t size;
+
+  size_t capacity;
+};
+
+
+void loader_fatal(const char *fmt, ...)
+{
+  va_list args;
+
+  va_start(args, fmt);
+  vfprintf(stderr, fmt, args);
+  va_end(args);
+
+  fputc('\n', stderr);
+
+  exit(EXIT_FAILURE);
+}
+
+
+static inline char *buffer_reserve(struct copy_buffer *buf, size_t n)
+{
+  if(buf->size + n > buf->capacity)
+  {
+    size_t capacity = buf->capacity ? buf->capacity : LOADER_FLUSH_SIZE;
+
+    while(capacity < buf->size + n)
+      capacity *= 2;
+
+    buf->data = realloc(buf->data, capacity);
+
+    if(buf->data == NULL)
+      loader_fatal("out of memory");
+
+    buf->capacity = capacity;
+  }
+
+  return buf->data + buf->size;
+}
+
+
+static inline void put_int16(struct copy_buffer *buf, int16_t v)
+{
+  unsigned char *p = (unsigned char*) buffer_reserve(buf, 2);
+
+  p[0] = (unsigned char) ((uint16_t) v >> 8);
+  p[1] = (unsigned char) v;
+
+  buf->size += 2;
+}
+
+
+static inline void put_int32(struct copy_buffer *buf, int32_t v)
+{
+  unsigned char *p = (unsigned char*) buffer_reserve(buf, 4);
+
+  uint32_t u = (uint32_t) v;
+
+  p[0] = (unsigned char) (u >> 24);
+  p[1] = (unsigned char) (u >> 16);
+  p[2] = (unsigned char) (u >> 8);
+  p[3] = (unsigned char) u;
+
+  buf->size += 4;
+}
+
+
+static inline void put_int64(struct copy_buffer *buf, int64_t v)
+{
+  put_int32(buf, (int32_t) ((uint64_t) v >> 32));
+  put_int32(buf, (int32_t) (uint64_t) v);
+}
+
+
+static inline void put_float8(struct copy_buffer *buf, double d)
+{
+  int64_t v;
+
+  memcpy(&v, &d, sizeof(v));
+
+  put_int64(buf, v);
+}
+
+
+static void sink_write(struct copy_sink *sink, const char *data, size_t size)
+{
+  if(size == 0)
+    return;
+
+  if(sink->conn != NULL)
+  {
+    if(PQputCopyData(sink->conn, data, (int) size) != 1)
+      loader_fatal("COPY failed: %s", PQerrorMessage(sink->conn));
+
+    return;
+  }
+
+  pthread_mutex_lock(sink->file_mutex);
+
+  if(fwrite(data, 1, size, sink->file) != size)
+    loader_fatal("could not write COPY data");
+
+  pthread_mutex_unlock(sink->file_mutex);
+}
+
+
+/* quote each part of a possibly schema-qualified name */
+static char *quote_name(PGconn *conn, const char *name)
+{
+  struct copy_buffer buf = { NULL, 0, 0 };
+
+  const char *p = name;
+
+  for(;;)
+  {
+    const char *dot = strchr(p, '.');
+
+    size_t n = dot ? (size_t) (dot - p) : strlen(p);
+
+    char *part = PQescapeIdentifier(conn, p, n);
+
+    size_t len;
+
+    if(part == NULL)
+      loader_fatal("invalid name \"%s\": %s", name, PQerrorMessage(conn));
+
+    len = strlen(part);
+
+    memcpy(buffer_reserve(&buf, len + 2), part, len);
+    buf.size += len;
+
+    PQfreemem(part);
+
+    if(dot == NULL)
+      break;
+
+    buf.data[buf.size++] = '.';
+    p = dot + 1;
+  }
+
+  buf.data[buf.size] = '\0';
+
+  return buf.data;
+}
+
+
+void copy_file_header(FILE *file)
+{
+  static const char extension[8] = { 0 };
+
+  if(fwrite(copy_signature, 1, sizeof(copy_signature), file) != sizeof(copy_signature) ||
+     fwrite(extension, 1, sizeof(extension), file) != sizeof(extension))
+    loader_fatal("could not write COPY header");
+}
+
+
+void copy_file_trailer(FILE *file)
+{
+  static const char trailer[2] = { '\377', '\377' };
+
+  if(fwrite(trailer, 1, sizeof(trailer), file) != sizeof(trailer))
+    loader_fatal("could not write COPY trailer");
+}
+
+
+void copy_begin(struct copy_sink *sink, const char *table, const char *id_column,
+                const char *track_column)
+{
+  struct copy_buffer header = { NULL, 0, 0 };
+
+  char *qtable;
+
+  char *qid;
+
+  char *qtrack;
+
+  char *sql;
+
+  PGresult *res;
+
+  if(sink->conn == NULL)
+    return;
+
+  qtable = quote_name(sink->conn, table);
+  qid = quote_name(sink->conn, id_column);
+  qtrack = quote_name(sink->conn, track_column);
+
+  sql = malloc(strlen(qtable) + strlen(qid) + strlen(qtrack) + 64);
+
+  if(sql == NULL)
+    loader_fatal("out of memory");
+
+  sprintf(sql, "COPY %s (%s, %s) FROM STDIN (FORMAT binary)", qtable, qid, qtrack);
+
+  res = PQexec(sink->conn, sql);
+
+  if(PQresultStatus(res) != PGRES_COPY_IN)
+    loader_fatal("%s failed: %s", sql, PQerrorMessage(sink->conn));
+
+  PQclear(res);
+
+  free(sql);
+  free(qtrack);
+  free(qid);
+  free(qtable);
+
+  memcpy(buffer_reserve(&header, sizeof(copy_signature)), copy_signature, sizeof(copy_signature));
+  header.size += sizeof(copy_signature);
+
+  put_int32(&header, 0);
+  put_int32(&header, 0);
+
+  sink_write(sink, header.data, header.size);
+
+  free(header.data);
+}
+
+
+size_t copy_tracks(struct copy_sink *sink, const struct fix *fixes, size_t n)
+{
+  struct copy_buffer buf = { NULL, 0, 0 };
+
+  size_t ntracks = 0;
+
+  size_t i = 0;
+
+  while(i < n)
+  {
+    size_t j = i + 1;
+
+    int32_t npoints;
+
+    while(j < n && fixes[j].id == fixes[i].id)
+      ++j;
+
+    if(j - i > INT32_MAX / 16)
+      loader_fatal("buoy %d has too many fixes", fixes[i].id);
+
+    npoints = (int32_t) (j - i);
+
+    /* tuple: field count, id and track */
+    put_int16(&buf, 2);
+
+    put_int32(&buf, 4);
+    put_int32(&buf, fixes[i].id);
+
+    put_int32(&buf, ST_BINARY_HEADER_SIZE + npoints * 24);
+
+    put_int32(&buf, 0);
+    put_int32(&buf, LOADER_SRID);
+    put_int32(&buf, npoints);
+    put_int32(&buf, 0);
+    put_int64(&buf, fixes[i].time);
+    put_int64(&buf, fixes[j - 1].time);
+
+    buffer_reserve(&buf, (size_t) npoints * 24);
+
+    for(size_t k = i; k < j; ++k)
+    {
+      put_float8(&buf, fixes[k].x);
+      put_float8(&buf, fixes[k].y);
+    }
+
+    for(size_t k = i; k < j; ++k)
+      put_int64(&buf, fixes[k].time);
+
+    ++ntracks;
+
+    if(buf.size >= LOADER_FLUSH_SIZE)
+    {
+      sink_write(sink, buf.data, buf.size);
+
+      buf.size = 0;
+    }
+
+    i = j;
+  }
+
+  sink_write(sink, buf.data, buf.size);
+
+  free(buf.data);
+
+  return ntracks;
+}
+
+
+void copy_end(struct copy_sink *sink)
+{
+  static const char trailer[2] = { '\377', '\377' };
+
+  PGresult *res;
+
+  if(sink->conn == NULL)
+    return;
+
+  sink_write(sink, trailer, sizeof(trailer));
+
+  if(PQputCopyEnd(sink->conn, NULL) != 1)
+    loader_fatal("COPY failed: %s", PQerrorMessage(sink->conn));
+
+  while((res = PQgetResult(sink->conn)) != NULL)
+  {
+    if(PQresultStatus(res) != PGRES_COMMAND_OK)
+      loader_fatal("COPY failed: %s", PQerrorMessage(sink->conn));
+
+    PQclear(res);
+  }
+}
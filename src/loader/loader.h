@@ -0,0 +1,214 @@
+/*
+  Copyright (C) 2017 National Institute For Space Research (INPE) - Brazil.
+
+  postgis-t is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License version 3 as
+  published by the Free Software Foundation.
+
+  postgis-t is distributed  "AS-IS" in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY OF ANY KIND; without even the implied warranty
+  of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with postgis-t. See LICENSE. If not, write to
+  Gilberto Ribeiro de Queiroz at <gribeiro@dpi.inpe.br>.
+
+ */
+
+
+/*!
+ *
+ * \file loader/loader.h
+ *
+ * \brief Bulk loader of NOAA drifter files into spatiotemporal tables.
+ *
+ * \note Files are split in blocks of whole lines that a pool of threads
+ *       parses into fixes, bucketed by buoy. Each bucket is then sorted,
+ *       grouped by buoy and streamed as binary COPY over its own
+ *       connection.
+ *
+ * \note Each writer commits its own COPY, so when one of them fails the
+ *       tracks of the writers that finished stay in the table.
+ *
+ * \author Gilberto Ribeiro de Queiroz
+ * \author Fabiana Zioti
+ *
+ * \date 2017
+ *
+ * \copyright GNU Lesser Public License version 3
+ *
+ */
+
+#ifndef __POSTGIST_LOADER_H__
+#define __POSTGIST_LOADER_H__
+
+/* libpq */
+#include <libpq-fe.h>
+
+/* C Standard Library */
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/* size of the blocks handed to the parser threads */
+#define LOADER_BLOCK_SIZE (8 * 1024 * 1024)
+
+/* blocks waiting to be parsed before the reader blocks */
+#define LOADER_QUEUE_SIZE 16
+
+/* buffered COPY data per writer before it is sent */
+#define LOADER_FLUSH_SIZE (1024 * 1024)
+
+#define LOADER_MAX_THREADS 64
+
+/* SRID of the drifter positions */
+#define LOADER_SRID 4326
+
+
+/*
+ * \brief A position of a buoy; 'time' is in microseconds since 2000-01-01,
+ *        the PostgreSQL epoch.
+ *
+ */
+struct fix
+{
+  int32_t id;
+
+  int64_t time;
+
+  double x;
+
+  double y;
+};
+
+
+struct fix_vector
+{
+  struct fix *data;
+
+  size_t size;
+
+  size_t capacity;
+};
+
+
+/*
+ * \brief A run of whole lines; 'buffer' is freed after parsing unless the
+ *        block points into a memory map.
+ *
+ */
+struct block
+{
+  const char *data;
+
+  size_t size;
+
+  char *buffer;
+};
+
+
+/*
+ * \brief Bounded queue of blocks between the reader and the parsers.
+ *
+ */
+struct block_queue
+{
+  pthread_mutex_t mutex;
+
+  pthread_cond_t not_empty;
+
+  pthread_cond_t not_full;
+
+  struct block blocks[LOADER_QUEUE_SIZE];
+
+  int head;
+
+  int count;
+
+  bool closed;
+};
+
+
+/*
+ * \brief State of one parser thread: its fixes split in 'npartitions'
+ *        buckets by buoy id.
+ *
+ */
+struct parser
+{
+  pthread_t thread;
+
+  struct block_queue *queue;
+
+  int npartitions;
+
+  struct fix_vector *partitions;
+
+  size_t nlines;
+
+  size_t nskipped;
+};
+
+
+/*
+ * \brief Where binary COPY data goes: a server connection or a file shared
+ *        by all writers.
+ *
+ */
+struct copy_sink
+{
+  PGconn *conn;
+
+  FILE *file;
+
+  pthread_mutex_t *file_mutex;
+};
+
+
+/* reader.c */
+void block_queue_init(struct block_queue *q);
+
+void block_queue_destroy(struct block_queue *q);
+
+void block_queue_push(struct block_queue *q, struct block b);
+
+bool block_queue_pop(struct block_queue *q, struct block *b);
+
+void block_queue_close(struct block_queue *q);
+
+/* read 'path' (plain or gzip) into blocks of whole lines; false on error */
+bool read_file(const char *path, struct block_queue *q);
+
+void release_block(struct block *b);
+
+
+/* parse.c */
+void fix_vector_push(struct fix_vector *v, const struct fix *f);
+
+void *parser_main(void *arg);
+
+/* sort by buoy and time and drop repeated instants; returns the new size */
+size_t fixes_sort(struct fix *fixes, size_t n);
+
+
+/* copy.c */
+void copy_file_header(FILE *file);
+
+void copy_file_trailer(FILE *file);
+
+/* start a COPY on a connection sink; file sinks get copy_file_header() */
+void copy_begin(struct copy_sink *sink, const char *table, const char *id_column,
+                const char *track_column);
+
+/* append one (id, track) tuple per buoy in the sorted 'fixes' */
+size_t copy_tracks(struct copy_sink *sink, const struct fix *fixes, size_t n);
+
+void copy_end(struct copy_sink *sink);
+
+/* print the message and exit */
+void loader_fatal(const char *fmt, ...);
+
+#endif  /* __POSTGIST_LOADER_H__ */
@@ -0,0 +1,342 @@
+/*
+  Copyright (C) 2017 National Institute For Space Research (INPE) - Brazil.
+
+  postgis-t is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License version 3 as
+  published by the Free Software Foundation.
+
+  postgis-t is distributed  "AS-IS" in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY OF ANY KIND; without even the implied warranty
+  of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with postgis-t. See LICENSE. If not, write to
+  Gilberto Ribeiro de Queiroz at <gribeiro@dpi.inpe.br>.
+
+ */
+
+
+/*!
+ *
+ * \file loader/main.c
+ *
+ * \brief Command line of the drifter loader.
+ *
+ * \author Gilberto Ribeiro de Queiroz
+ * \author Fabiana Zioti
+ *
+ * \date 2017
+ *
+ * \copyright GNU Lesser Public License version 3
+ *
+ */
+
+/* PostGIS-T loader */
+#include "loader.h"
+
+/* C Standard Library */
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* POSIX */
+#include <getopt.h>
+#include <unistd.h>
+
+
+/*
+ * \brief State of one writer thread: the partition it sorts and the sink
+ *        its tracks go to.
+ *
+ */
+struct writer
+{
+  pthread_t thread;
+
+  int partition;
+
+  struct parser *parsers;
+
+  int nparsers;
+
+  struct copy_sink sink;
+
+  const char *table;
+
+  const char *id_column;
+
+  const char *track_column;
+
+  size_t nfixes;
+
+  size_t ntracks;
+};
+
+
+static void usage(const char *program)
+{
+  fprintf(stderr,
+          "Usage: %s [options] buoydata_*.dat[.gz] ...\n"
+          "\n"
+          "Load NOAA drifter files as one spatiotemporal track per buoy.\n"
+          "\n"
+          "  -d CONNINFO  connection string (default: PG* environment variables)\n"
+          "  -t TABLE     target table (default: drifter_track)\n"
+          "  -i COLUMN    buoy id column, integer (default: id)\n"
+          "  -c COLUMN    track column, spatiotemporal (default: track)\n"
+          "  -j THREADS   parser and writer threads (default: number of CPUs)\n"
+          "  -o FILE      write a binary COPY file instead of loading\n",
+          program);
+
+  exit(EXIT_FAILURE);
+}
+
+
+static double elapsed(const struct timespec *start)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return (double) (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+
+static void *writer_main(void *arg)
+{
+  struct writer *writer = arg;
+
+  struct fix_vector *base = NULL;
+
+  struct fix *fixes;
+
+  size_t n = 0;
+
+  for(int i = 0; i < writer->nparsers; ++i)
+  {
+    struct fix_vector *v = &writer->parsers[i].partitions[writer->partition];
+
+    n += v->size;
+
+    if(base == NULL || v->size > base->size)
+      base = v;
+  }
+
+  /*
+   * The largest bucket is grown into the merged array and every other one
+   * is freed as soon as it is appended, so the fixes are not held twice.
+   */
+  fixes = realloc(base->data, (n ? n : 1) * sizeof(struct fix));
+
+  if(fixes == NULL)
+    loader_fatal("out of memory");
+
+  n = base->size;
+
+  base->data = NULL;
+
+  for(int i = 0; i < writer->nparsers; ++i)
+  {
+    struct fix_vector *v = &writer->parsers[i].partitions[writer->partition];
+
+    if(v == base)
+      continue;
+
+    if(v->size > 0)
+      memcpy(fixes + n, v->data, v->size * sizeof(struct fix));
+
+    n += v->size;
+
+    free(v->data);
+
+    v->data = NULL;
+  }
+
+  n = fixes_sort(fixes, n);
+
+  copy_begin(&writer->sink, writer->table, writer->id_column, writer->track_column);
+
+  writer->ntracks = copy_tracks(&writer->sink, fixes, n);
+
+  copy_end(&writer->sink);
+
+  writer->nfixes = n;
+
+  free(fixes);
+
+  return NULL;
+}
+
+
+int main(int argc, char *argv[])
+{
+  const char *conninfo = "";
+
+  const char *table = "drifter_track";
+
+  const char *id_column = "id";
+
+  const char *track_column = "track";
+
+  const char *output = NULL;
+
+  int nthreads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+
+  FILE *file = NULL;
+
+  pthread_mutex_t file_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+  struct block_queue queue;
+
+  struct parser *parsers;
+
+  struct writer *writers;
+
+  struct timespec start;
+
+  size_t nlines = 0;
+
+  size_t nskipped = 0;
+
+  size_t nfixes = 0;
+
+  size_t ntracks = 0;
+
+  bool ok = true;
+
+  int opt;
+
+  while((opt = getopt(argc, argv, "d:t:i:c:j:o:h")) != -1)
+  {
+    switch(opt)
+    {
+      case 'd': conninfo = optarg; break;
+      case 't': table = optarg; break;
+      case 'i': id_column = optarg; break;
+      case 'c': track_column = optarg; break;
+      case 'j': nthreads = atoi(optarg); break;
+      case 'o': output = optarg; break;
+      default: usage(argv[0]);
+    }
+  }
+
+  if(optind == argc)
+    usage(argv[0]);
+
+  if(nthreads < 1)
+    nthreads = 1;
+
+  if(nthreads > LOADER_MAX_THREADS)
+    nthreads = LOADER_MAX_THREADS;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  parsers = calloc((size_t) nthreads, sizeof(struct parser));
+
+  writers = calloc((size_t) nthreads, sizeof(struct writer));
+
+  if(parsers == NULL || writers == NULL)
+    loader_fatal("out of memory");
+
+  /* open the sinks first so a bad connection fails before the parsing */
+  if(output != NULL)
+  {
+    file = fopen(output, "wb");
+
+    if(file == NULL)
+      loader_fatal("could not open \"%s\" for writing", output);
+
+    copy_file_header(file);
+  }
+
+  for(int i = 0; i < nthreads; ++i)
+  {
+    struct writer *w = &writers[i];
+
+    w->partition = i;
+    w->parsers = parsers;
+    w->nparsers = nthreads;
+    w->table = table;
+    w->id_column = id_column;
+    w->track_column = track_column;
+
+    if(file != NULL)
+    {
+      w->sink.file = file;
+      w->sink.file_mutex = &file_mutex;
+      continue;
+    }
+
+    w->sink.conn = PQconnectdb(conninfo);
+
+    if(PQstatus(w->sink.conn) != CONNECTION_OK)
+      loader_fatal("could not connect: %s", PQerrorMessage(w->sink.conn));
+  }
+
+  block_queue_init(&queue);
+
+  for(int i = 0; i < nthreads; ++i)
+  {
+    parsers[i].queue = &queue;
+    parsers[i].npartitions = nthreads;
+    parsers[i].partitions = calloc((size_t) nthreads, sizeof(struct fix_vector));
+
+    if(parsers[i].partitions == NULL)
+      loader_fatal("out of memory");
+
+    if(pthread_create(&parsers[i].thread, NULL, parser_main, &parsers[i]) != 0)
+      loader_fatal("could not start parser thread");
+  }
+
+  for(int i = optind; i < argc; ++i)
+    ok = read_file(argv[i], &queue) && ok;
+
+  block_queue_close(&queue);
+
+  for(int i = 0; i < nthreads; ++i)
+  {
+    pthread_join(parsers[i].thread, NULL);
+
+    nlines += parsers[i].nlines;
+    nskipped += parsers[i].nskipped;
+  }
+
+  block_queue_destroy(&queue);
+
+  fprintf(stderr, "parsed %zu lines (%zu skipped) in %.1f s\n", nlines, nskipped, elapsed(&start));
+
+  for(int i = 0; i < nthreads; ++i)
+  {
+    if(pthread_create(&writers[i].thread, NULL, writer_main, &writers[i]) != 0)
+      loader_fatal("could not start writer thread");
+  }
+
+  for(int i = 0; i < nthreads; ++i)
+  {
+    pthread_join(writers[i].thread, NULL);
+
+    nfixes += writers[i].nfixes;
+    ntracks += writers[i].ntracks;
+
+    if(writers[i].sink.conn != NULL)
+      PQfinish(writers[i].sink.conn);
+
+    free(parsers[i].partitions);
+  }
+
+  if(file != NULL)
+  {
+    copy_file_trailer(file);
+
+    if(fclose(file) != 0)
+      loader_fatal("could not write \"%s\"", output);
+  }
+
+  fprintf(stderr, "loaded %zu tracks with %zu fixes in %.1f s\n", ntracks, nfixes, elapsed(&start));
+
+  free(writers);
+  free(parsers);
+
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,316 @@
+/*
+  Copyright (C) 2017 National Institute For Space Research (INPE) - Brazil.
+
+  postgis-t is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License version 3 as
+  published by the Free Software Foundation.
+
+  postgis-t is distributed  "AS-IS" in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY OF ANY KIND; without even the implied warranty
+  of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with postgis-t. See LICENSE. If not, write to
+  Gilberto Ribeiro de Queiroz at <gribeiro@dpi.inpe.br>.
+
+ */
+
+
+/*!
+ *
+ * \file loader/parse.c
+ *
+ * \brief Parsing of NOAA drifter lines into fixes.
+ *
+ * \note A line is "ID MM DD.DDD YYYY LAT LON TEMP VE VN SPD VAR_LAT
+ *       VAR_LON VAR_TEMP", with the time of day as a fraction of DD and
+ *       LON in degrees east from 0 to 360. Only the first six fields are
+ *       read.
+ *
+ * \author Gilberto Ribeiro de Queiroz
+ * \author Fabiana Zioti
+ *
+ * \date 2017
+ *
+ * \copyright GNU Lesser Public License version 3
+ *
+ */
+
+/* PostGIS-T loader */
+#include "loader.h"
+
+/* C Standard Library */
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define USECS_PER_SEC INT64_C(1000000)
+#define SECS_PER_DAY 86400
+
+/* days between 1970-01-01 and 2000-01-01 */
+#define UNIX_TO_PG_EPOCH_DAYS 10957
+
+
+static const double powers_of_ten[] =
+{
+  1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15
+};
+
+
+static inline const char *skip_blanks(const char *p, const char *end)
+{
+  while(p < end && (*p == ' ' || *p == '\t'))
+    ++p;
+
+  return p;
+}
+
+
+static inline bool parse_int(const char **cp, const char *end, int64_t *value)
+{
+  const char *p = skip_blanks(*cp, end);
+
+  const char *digits;
+
+  bool negative = false;
+
+  int64_t v = 0;
+
+  if(p < end && (*p == '-' || *p == '+'))
+    negative = (*p++ == '-');
+
+  digits = p;
+
+  while(p < end && *p >= '0' && *p <= '9' && p - digits < 18)
+    v = v * 10 + (*p++ - '0');
+
+  if(p == digits)
+    return false;
+
+  *value = negative ? -v : v;
+  *cp = p;
+
+  return true;
+}
+
+
+/*
+ * \brief Read a plain decimal number; the result is exact when it has at
+ *        most 15 significant digits, which covers the drifter files.
+ *
+ */
+static inline bool parse_double(const char **cp, const char *end, double *value)
+{
+  const char *p = skip_blanks(*cp, end);
+
+  bool negative = false;
+
+  int64_t mantissa = 0;
+
+  int ndigits = 0;
+
+  int nfraction = 0;
+
+  if(p < end && (*p == '-' || *p == '+'))
+    negative = (*p++ == '-');
+
+  while(p < end && *p >= '0' && *p <= '9')
+  {
+    if(ndigits < 15)
+      mantissa = mantissa * 10 + (*p - '0');
+    else
+      return false;
+
+    ++ndigits;
+    ++p;
+  }
+
+  if(p < end && *p == '.')
+  {
+    ++p;
+
+    while(p < end && *p >= '0' && *p <= '9')
+    {
+      if(ndigits < 15)
+      {
+        mantissa = mantissa * 10 + (*p - '0');
+        ++ndigits;
+        ++nfraction;
+      }
+
+      ++p;
+    }
+  }
+
+  if(ndigits == 0)
+    return false;
+
+  *value = (double) mantissa / powers_of_ten[nfraction];
+
+  if(negative)
+    *value = -*value;
+
+  *cp = p;
+
+  return true;
+}
+
+
+/* days since 1970-01-01 of a proleptic Gregorian date */
+static inline int64_t days_from_civil(int64_t y, int64_t m, int64_t d)
+{
+  int64_t era;
+
+  int64_t yoe;
+
+  int64_t doy;
+
+  int64_t doe;
+
+  y -= m <= 2;
+
+  era = (y >= 0 ? y : y - 399) / 400;
+  yoe = y - era * 400;
+  doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+  doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+
+  return era * 146097 + doe - 719468;
+}
+
+
+static bool parse_line(const char *p, const char *end, struct fix *f)
+{
+  int64_t id;
+
+  int64_t month;
+
+  int64_t year;
+
+  double day;
+
+  double lat;
+
+  double lon;
+
+  double mday;
+
+  int64_t seconds;
+
+  if(!parse_int(&p, end, &id) || !parse_int(&p, end, &month) ||
+     !parse_double(&p, end, &day) || !parse_int(&p, end, &year) ||
+     !parse_double(&p, end, &lat) || !parse_double(&p, end, &lon))
+    return false;
+
+  /* missing positions are written as 999.999 */
+  if(id < 0 || id > INT32_MAX || month < 1 || month > 12 || day < 1.0 || day >= 32.0 ||
+     year < 1 || year > 9999 || fabs(lat) > 90.0 || lon < -180.0 || lon > 360.0)
+    return false;
+
+  mday = floor(day);
+
+  seconds = llround((day - mday) * SECS_PER_DAY);
+
+  f->id = (int32_t) id;
+  f->time = ((days_from_civil(year, month, (int64_t) mday) - UNIX_TO_PG_EPOCH_DAYS) * SECS_PER_DAY + seconds) * USECS_PER_SEC;
+  f->x = lon > 180.0 ? lon - 360.0 : lon;
+  f->y = lat;
+
+  return true;
+}
+
+
+void fix_vector_push(struct fix_vector *v, const struct fix *f)
+{
+  if(v->size == v->capacity)
+  {
+    size_t capacity = v->capacity ? 2 * v->capacity : 4096;
+
+    struct fix *data = realloc(v->data, capacity * sizeof(struct fix));
+
+    if(data == NULL)
+      loader_fatal("out of memory");
+
+    v->data = data;
+    v->capacity = capacity;
+  }
+
+  v->data[v->size++] = *f;
+}
+
+
+void *parser_main(void *arg)
+{
+  struct parser *parser = arg;
+
+  struct block b;
+
+  while(block_queue_pop(parser->queue, &b))
+  {
+    const char *p = b.data;
+
+    const char *end = b.data + b.size;
+
+    while(p < end)
+    {
+      const char *eol = memchr(p, '\n', (size_t) (end - p));
+
+      struct fix f;
+
+      if(eol == NULL)
+        eol = end;
+
+      if(eol > p)
+      {
+        ++parser->nlines;
+
+        if(parse_line(p, eol, &f))
+          fix_vector_push(&parser->partitions[(uint32_t) f.id % (uint32_t) parser->npartitions], &f);
+        else
+          ++parser->nskipped;
+      }
+
+      p = eol + 1;
+    }
+
+    release_block(&b);
+  }
+
+  return NULL;
+}
+
+
+static int fix_cmp(const void *a, const void *b)
+{
+  const struct fix *fa = a;
+
+  const struct fix *fb = b;
+
+  if(fa->id != fb->id)
+    return fa->id < fb->id ? -1 : 1;
+
+  if(fa->time != fb->time)
+    return fa->time < fb->time ? -1 : 1;
+
+  return 0;
+}
+
+
+size_t fixes_sort(struct fix *fixes, size_t n)
+{
+  size_t m = 0;
+
+  if(n == 0)
+    return 0;
+
+  qsort(fixes, n, sizeof(struct fix), fix_cmp);
+
+  /* the same fix shows up in overlapping archive releases */
+  for(size_t i = 1; i < n; ++i)
+  {
+    if(fixes[i].id != fixes[m].id || fixes[i].time != fixes[m].time)
+      fixes[++m] = fixes[i];
+  }
+
+  return m + 1;
+}
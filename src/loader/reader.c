@@ -0,0 +1,318 @@
+/*
+  Copyright (C) 2017 National Institute For Space Research (INPE) - Brazil.
+
+  postgis-t is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License version 3 as
+  published by the Free Software Foundation.
+
+  postgis-t is distributed  "AS-IS" in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY OF ANY KIND; without even the implied warranty
+  of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with postgis-t. See LICENSE. If not, write to
+  Gilberto Ribeiro de Queiroz at <gribeiro@dpi.inpe.br>.
+
+ */
+
+
+/*!
+ *
+ * \file loader/reader.c
+ *
+ * \brief Splitting of drifter files in blocks of whole lines.
+ *
+ * \author Gilberto Ribeiro de Queiroz
+ * \author Fabiana Zioti
+ *
+ * \date 2017
+ *
+ * \copyright GNU Lesser Public License version 3
+ *
+ */
+
+/* PostGIS-T loader */
+#include "loader.h"
+
+/* zlib */
+#include <zlib.h>
+
+/* C Standard Library */
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* POSIX */
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+void block_queue_init(struct block_queue *q)
+{
+  memset(q, 0, sizeof(*q));
+
+  pthread_mutex_init(&q->mutex, NULL);
+  pthread_cond_init(&q->not_empty, NULL);
+  pthread_cond_init(&q->not_full, NULL);
+}
+
+
+void block_queue_destroy(struct block_queue *q)
+{
+  pthread_cond_destroy(&q->not_full);
+  pthread_cond_destroy(&q->not_empty);
+  pthread_mutex_destroy(&q->mutex);
+}
+
+
+void block_queue_push(struct block_queue *q, struct block b)
+{
+  pthread_mutex_lock(&q->mutex);
+
+  while(q->count == LOADER_QUEUE_SIZE)
+    pthread_cond_wait(&q->not_full, &q->mutex);
+
+  q->blocks[(q->head + q->count) % LOADER_QUEUE_SIZE] = b;
+  ++q->count;
+
+  pthread_cond_signal(&q->not_empty);
+  pthread_mutex_unlock(&q->mutex);
+}
+
+
+bool block_queue_pop(struct block_queue *q, struct block *b)
+{
+  bool found = false;
+
+  pthread_mutex_lock(&q->mutex);
+
+  while(q->count == 0 && !q->closed)
+    pthread_cond_wait(&q->not_empty, &q->mutex);
+
+  if(q->count > 0)
+  {
+    *b = q->blocks[q->head];
+
+    q->head = (q->head + 1) % LOADER_QUEUE_SIZE;
+    --q->count;
+
+    found = true;
+
+    pthread_cond_signal(&q->not_full);
+  }
+
+  pthread_mutex_unlock(&q->mutex);
+
+  return found;
+}
+
+
+void block_queue_close(struct block_queue *q)
+{
+  pthread_mutex_lock(&q->mutex);
+
+  q->closed = true;
+
+  pthread_cond_broadcast(&q->not_empty);
+  pthread_mutex_unlock(&q->mutex);
+}
+
+
+void release_block(struct block *b)
+{
+  free(b->buffer);
+
+  b->buffer = NULL;
+}
+
+
+/*
+ * \brief Hand out a mapped file in blocks without copying; the blocks
+ *        point into the map, which stays alive until the process exits.
+ *
+ */
+static bool read_mapped(int fd, size_t size, struct block_queue *q)
+{
+  const char *data;
+
+  size_t offset = 0;
+
+  if(size == 0)
+    return true;
+
+  data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+  if(data == MAP_FAILED)
+    return false;
+
+  madvise((void*) data, size, MADV_SEQUENTIAL);
+
+  while(offset < size)
+  {
+    struct block b = { data + offset, size - offset, NULL };
+
+    if(b.size > LOADER_BLOCK_SIZE)
+    {
+      const char *eol = memchr(data + offset + LOADER_BLOCK_SIZE, '\n',
+                               size - offset - LOADER_BLOCK_SIZE);
+
+      if(eol != NULL)
+        b.size = (size_t) (eol - b.data) + 1;
+    }
+
+    block_queue_push(q, b);
+
+    offset += b.size;
+  }
+
+  return true;
+}
+
+
+/*
+ * \brief Inflate a gzip file in blocks; the partial line at the end of a
+ *        block is carried over to the next one.
+ *
+ */
+static bool read_gzip(int fd, struct block_queue *q)
+{
+  gzFile gz = gzdopen(fd, "rb");
+
+  size_t carry = 0;
+
+  char *buffer;
+
+  if(gz == NULL)
+  {
+    close(fd);
+    return false;
+  }
+
+  gzbuffer(gz, 256 * 1024);
+
+  buffer = malloc(LOADER_BLOCK_SIZE);
+
+  if(buffer == NULL)
+    loader_fatal("out of memory");
+
+  for(;;)
+  {
+    int n = gzread(gz, buffer + carry, (unsigned) (LOADER_BLOCK_SIZE - carry));
+
+    size_t size;
+
+    char *next;
+
+    const char *eol;
+
+    if(n < 0)
+    {
+      int errnum;
+
+      fprintf(stderr, "gzip error: %s\n", gzerror(gz, &errnum));
+
+      free(buffer);
+      gzclose(gz);
+
+      return false;
+    }
+
+    size = carry + (size_t) n;
+
+    if(size == 0)
+      break;
+
+    /* last block of the file */
+    if(n == 0)
+    {
+      struct block b = { buffer, size, buffer };
+
+      block_queue_push(q, b);
+
+      buffer = NULL;
+
+      break;
+    }
+
+    eol = NULL;
+
+    for(size_t i = size; i > 0; --i)
+    {
+      if(buffer[i - 1] == '\n')
+      {
+        eol = buffer + i - 1;
+        break;
+      }
+    }
+
+    /* a line longer than a block is not drifter data, drop it */
+    if(eol == NULL)
+    {
+      carry = 0;
+      continue;
+    }
+
+    next = malloc(LOADER_BLOCK_SIZE);
+
+    if(next == NULL)
+      loader_fatal("out of memory");
+
+    carry = size - (size_t) (eol + 1 - buffer);
+
+    memcpy(next, eol + 1, carry);
+
+    {
+      struct block b = { buffer, (size_t) (eol + 1 - buffer), buffer };
+
+      block_queue_push(q, b);
+    }
+
+    buffer = next;
+  }
+
+  free(buffer);
+  gzclose(gz);
+
+  return true;
+}
+
+
+bool read_file(const char *path, struct block_queue *q)
+{
+  unsigned char magic[2];
+
+  struct stat st;
+
+  bool ok;
+
+  int fd = open(path, O_RDONLY);
+
+  if(fd < 0)
+  {
+    fprintf(stderr, "could not open \"%s\": %s\n", path, strerror(errno));
+    return false;
+  }
+
+  if(fstat(fd, &st) != 0)
+  {
+    fprintf(stderr, "could not stat \"%s\": %s\n", path, strerror(errno));
+    close(fd);
+    return false;
+  }
+
+  /* look at the content, not the name: archives are often renamed */
+  if(pread(fd, magic, 2, 0) == 2 && magic[0] == 0x1f && magic[1] == 0x8b)
+    return read_gzip(fd, q);
+
+  ok = read_mapped(fd, (size_t) st.st_size, q);
+
+  if(!ok)
+    fprintf(stderr, "could not map \"%s\": %s\n", path, strerror(errno));
+
+  close(fd);
+
+  return ok;
+}
@@ -0,0 +1,1027 @@
+/*
+  Copyright (C) 2017 National Institute For Space Research (INPE) - Brazil.
+
+  postgis-t is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License version 3 as
+  published by the Free Software Foundation.
+
+  postgis-t is distributed  "AS-IS" in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY OF ANY KIND; without even the implied warranty
+  of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with postgis-t. See LICENSE. If not, write to
+  Gilberto Ribeiro de Queiroz at <gribeiro@dpi.inpe.br>.
+
+ */
+/*!
+ *
+ * \file postgist/build.c
+ *
+ * \brief Parallel bulk conversion of point tables into spatiotemporal
+ *        values with dynamic background workers.
+ *
+ * postgist_build_trajectories() splits the sorted ids of the source table
+ * into one range per worker. Each worker streams its fixes ordered by id and time
+ * through a cursor, packs the fixes of every id into one value and writes
+ * the values to the target table in batches, with one INSERT ... unnest()
+ * per batch. Workers commit on their own; the caller waits for all of them
+ * and fails if any of them did.
+ *
+ * \author Gilberto Ribeiro de Queiroz
+ * \author Fabiana Zioti
+ *
+ * \date 2017
+ *
+ * \copyright GNU Lesser Public License version 3
+ *
+ */
+
+/* PostGIS-T extension */
+#include "build.h"
+#include "spatiotemporal.h"
+#include "dims.h"
+
+/* PostgreSQL */
+#include <access/htup_details.h>
+#include <access/xact.h>
+#include <catalog/namespace.h>
+#include <catalog/pg_type.h>
+#include <executor/spi.h>
+#include <funcapi.h>
+#include <miscadmin.h>
+#include <pgstat.h>
+#include <postmaster/bgworker.h>
+#include <storage/ipc.h>
+#include <storage/shmem.h>
+#include <storage/spin.h>
+#include <tcop/utility.h>
+#include <utils/array.h>
+#include <utils/builtins.h>
+#include <utils/datum.h>
+#include <utils/lsyscache.h>
+#include <utils/memutils.h>
+#include <utils/snapmgr.h>
+
+/* C Standard Library */
+#include <string.h>
+
+
+/* rows fetched from the cursor at a time */
+#define ST_BUILD_FETCH_SIZE 10000
+
+/* values written by each INSERT */
+#define ST_BUILD_BATCH_SIZE 1000
+
+#define ST_BUILD_ERROR_LEN 256
+
+/* longest text form of an id bounding the range of a worker */
+#define ST_BUILD_BOUND_LEN 256
+
+
+enum st_build_state
+{
+  ST_BUILD_FREE = 0,
+  ST_BUILD_STARTING,
+  ST_BUILD_RUNNING,
+  ST_BUILD_DONE,
+  ST_BUILD_FAILED
+};
+
+static const char *st_build_state_names[] = { "free", "starting", "running", "done", "failed" };
+
+
+/* one worker of a build */
+struct st_build_slot
+{
+  enum st_build_state state;
+  int64 build_id;
+  int32 worker;         /* Partition of the ids handled by this worker */
+  int32 nworkers;
+  bool hashed;          /* Ids split by hash instead of by range */
+  bool empty;           /* Fewer distinct ids than workers: nothing to do */
+  bool has_lower;
+  bool has_upper;
+  char lower[ST_BUILD_BOUND_LEN];   /* Ids >= lower, as text */
+  char upper[ST_BUILD_BOUND_LEN];   /* Ids < upper, as text */
+  int32 pid;
+  Oid dboid;
+  Oid useroid;
+  Oid source;
+  Oid target;
+  Oid st_typid;
+  NameData id_col;
+  NameData geom_col;
+  NameData time_col;
+  int64 rows_read;
+  int64 rows_skipped;   /* Fixes dropped for not increasing the time */
+  int64 trajectories;
+  TimestampTz started;
+  TimestampTz finished;
+  char error[ST_BUILD_ERROR_LEN];
+};
+
+/* offset of the fields that are set after the slot is claimed */
+#define ST_BUILD_SLOT_BODY offsetof(struct st_build_slot, worker)
+
+
+struct st_build_shared
+{
+  slock_t mutex;
+  int64 next_build_id;
+  struct st_build_slot slots[ST_BUILD_MAX_WORKERS];
+};
+
+
+static struct st_build_shared *build_shared = NULL;
+
+static shmem_startup_hook_type prev_shmem_startup_hook = NULL;
+
+#if PG_VERSION_NUM >= 150000
+static shmem_request_hook_type prev_shmem_request_hook = NULL;
+#endif
+
+
+static void st_build_shmem_request(void)
+{
+#if PG_VERSION_NUM >= 150000
+  if(prev_shmem_request_hook)
+    prev_shmem_request_hook();
+#endif
+
+  RequestAddinShmemSpace(MAXALIGN(sizeof(struct st_build_shared)));
+}
+
+
+static void st_build_shmem_startup(void)
+{
+  bool found;
+
+  if(prev_shmem_startup_hook)
+    prev_shmem_startup_hook();
+
+  LWLockAcquire(AddinShmemInitLock, LW_EXCLUSIVE);
+
+  build_shared = (struct st_build_shared*) ShmemInitStruct("postgist build status",
+                                                           sizeof(struct st_build_shared), &found);
+
+  if(!found)
+  {
+    memset(build_shared, 0, sizeof(struct st_build_shared));
+
+    SpinLockInit(&build_shared->mutex);
+
+    build_shared->next_build_id = 1;
+  }
+
+  LWLockRelease(AddinShmemInitLock);
+}
+
+
+void st_build_init(void)
+{
+  if(!process_shared_preload_libraries_in_progress)
+    return;
+
+#if PG_VERSION_NUM >= 150000
+  prev_shmem_request_hook = shmem_request_hook;
+  shmem_request_hook = st_build_shmem_request;
+#else
+  st_build_shmem_request();
+#endif
+
+  prev_shmem_startup_hook = shmem_startup_hook;
+  shmem_startup_hook = st_build_shmem_startup;
+}
+
+
+/* fixes of the id being packed */
+struct build_track
+{
+  Datum id;
+  int32 flags;
+  int32 srid;
+  int32 npoints;
+  int32 capacity;
+  double *coords;
+  Timestamp *times;
+};
+
+
+/* values waiting to be inserted */
+struct build_batch
+{
+  int32 n;
+  Datum ids[ST_BUILD_BATCH_SIZE];
+  Datum values[ST_BUILD_BATCH_SIZE];
+};
+
+
+static void slot_add_progress(volatile struct st_build_slot *slot, int64 rows, int64 skipped, int64 trajectories)
+{
+  SpinLockAcquire(&build_shared->mutex);
+
+  slot->rows_read += rows;
+  slot->rows_skipped += skipped;
+  slot->trajectories += trajectories;
+
+  SpinLockRelease(&build_shared->mutex);
+}
+
+
+static void batch_flush(struct build_batch *batch, SPIPlanPtr insert_plan, Oid id_typid, Oid st_typid)
+{
+  int16 typlen;
+
+  bool typbyval;
+
+  char typalign;
+
+  Datum args[2];
+
+  if(batch->n == 0)
+    return;
+
+  get_typlenbyvalalign(id_typid, &typlen, &typbyval, &typalign);
+
+  args[0] = PointerGetDatum(construct_array(batch->ids, batch->n, id_typid, typlen, typbyval, typalign));
+
+  args[1] = PointerGetDatum(construct_array(batch->values, batch->n, st_typid, -1, false, 'd'));
+
+  if(SPI_execute_plan(insert_plan, args, NULL, false, 0) != SPI_OK_INSERT)
+    elog(ERROR, "could not insert trajectories into the target table");
+
+  batch->n = 0;
+}
+
+
+/*
+ * \brief Pack the fixes of the current id into a value of the batch.
+ *
+ */
+static void track_finish(struct build_track *track, struct build_batch *batch)
+{
+  int ndims = ST_FLAGS_NDIMS(track->flags);
+
+  struct spatiotemporal *st;
+
+  if(track->npoints == 0)
+    return;
+
+  st = spatiotemporal_alloc(track->npoints, track->flags);
+
+  st->srid = track->srid;
+  st->npoints = track->npoints;
+  st->start_time = track->times[0];
+  st->end_time = track->times[track->npoints - 1];
+
+  memcpy(ST_COORDS(st), track->coords, track->npoints * ndims * sizeof(double));
+  memcpy(ST_TIMES(st), track->times, track->npoints * sizeof(Timestamp));
+
+  st_dims_ops_get(track->flags)->extent(ST_COORDS(st), st->npoints, &st->extent);
+
+  batch->ids[batch->n] = track->id;
+  batch->values[batch->n] = PointerGetDatum(st);
+
+  ++batch->n;
+
+  track->npoints = 0;
+}
+
+
+/*
+ * \brief Append a fix to the current track; returns false if it was
+ *        skipped.
+ *
+ */
+static bool track_append(struct build_track *track, GSERIALIZED *gser, Timestamp t)
+{
+  LWGEOM *lwgeom;
+
+  POINT4D p;
+
+  int32 flags;
+
+  int ndims;
+
+  if(gserialized_get_type(gser) != POINTTYPE || gserialized_is_empty(gser) || TIMESTAMP_NOT_FINITE(t))
+    return false;
+
+  if(track->npoints > 0 && t <= track->times[track->npoints - 1])
+    return false;
+
+  lwgeom = lwgeom_from_gserialized(gser);
+
+  getPoint4d_p(lwgeom_as_lwpoint(lwgeom)->point, 0, &p);
+
+  flags = st_flags_from_lwflags(lwgeom->flags);
+
+  lwgeom_free(lwgeom);
+
+  if(track->npoints == 0)
+  {
+    track->flags = flags;
+    track->srid = gserialized_get_srid(gser);
+  }
+  else if(flags != track->flags)
+    return false;
+
+  ndims = ST_FLAGS_NDIMS(flags);
+
+  /* geometric growth: amortizes the cost of moving the arrays */
+  if(track->npoints == track->capacity)
+  {
+    track->capacity = Max(track->capacity * 2, ST_MIN_CAPACITY);
+
+    track->coords = (double*) repalloc(track->coords, track->capacity * 4 * sizeof(double));
+    track->times = (Timestamp*) repalloc(track->times, track->capacity * sizeof(Timestamp));
+  }
+
+  st_dims_ops_get(flags)->encode(track->coords + track->npoints * ndims, &p);
+
+  track->times[track->npoints] = t;
+
+  ++track->npoints;
+
+  return true;
+}
+
+
+/*
+ * \brief Move the finished track into the batch, writing the batch when it
+ *        is full.
+ *
+ * \note Values and arrays are built in 'batch_context', which is reset
+ *       after each write. SPI calls return to the SPI procedure context.
+ *
+ */
+static void build_track_done(struct build_track *track, struct build_batch *batch,
+                             MemoryContext batch_context, SPIPlanPtr insert_plan,
+                             Oid id_typid, Oid st_typid)
+{
+  MemoryContext old_context = MemoryContextSwitchTo(batch_context);
+
+  track_finish(track, batch);
+
+  if(batch->n == ST_BUILD_BATCH_SIZE)
+  {
+    batch_flush(batch, insert_plan, id_typid, st_typid);
+
+    MemoryContextReset(batch_context);
+  }
+
+  MemoryContextSwitchTo(old_context);
+}
+
+
+/* a copy of the slot, read under the lock */
+static struct st_build_slot build_slot_copy(volatile struct st_build_slot *slot)
+{
+  struct st_build_slot copy;
+
+  SpinLockAcquire(&build_shared->mutex);
+
+  memcpy(&copy, (const void*) slot, sizeof(struct st_build_slot));
+
+  SpinLockRelease(&build_shared->mutex);
+
+  return copy;
+}
+
+
+static void build_worker_run(volatile struct st_build_slot *slot)
+{
+  struct st_build_slot params = build_slot_copy(slot);
+
+  char *source;
+
+  char *target;
+
+  const char *id_col = quote_identifier(NameStr(params.id_col));
+
+  const char *geom_col = quote_identifier(NameStr(params.geom_col));
+
+  const char *time_col = quote_identifier(NameStr(params.time_col));
+
+  StringInfoData query;
+
+  StringInfoData filter;
+
+  Portal portal;
+
+  SPIPlanPtr insert_plan = NULL;
+
+  Oid id_typid = InvalidOid;
+
+  int16 id_typlen = 0;
+
+  bool id_typbyval = false;
+
+  struct build_track track;
+
+  struct build_batch *batch = (struct build_batch*) palloc0(sizeof(struct build_batch));
+
+  MemoryContext worker_context = CurrentMemoryContext;
+
+  MemoryContext batch_context = AllocSetContextCreate(worker_context, "postgist build batch",
+                                                      ALLOCSET_DEFAULT_SIZES);
+
+  if(get_rel_name(params.source) == NULL || get_rel_name(params.target) == NULL)
+    elog(ERROR, "source or target table of the trajectory build no longer exists");
+
+  source = quote_qualified_identifier(get_namespace_name(get_rel_namespace(params.source)),
+                                      get_rel_name(params.source));
+
+  target = quote_qualified_identifier(get_namespace_name(get_rel_namespace(params.target)),
+                                      get_rel_name(params.target));
+
+  memset(&track, 0, sizeof(track));
+
+  track.capacity = ST_MIN_CAPACITY;
+  track.coords = (double*) palloc(track.capacity * 4 * sizeof(double));
+  track.times = (Timestamp*) palloc(track.capacity * sizeof(Timestamp));
+
+  if(params.empty)
+    return;
+
+  /* the ids of this worker: a range of the sorted ids, or a hash partition */
+  initStringInfo(&filter);
+
+  if(params.hashed)
+    appendStringInfo(&filter, " AND (hashtext(%s::text) & 2147483647) %% %d = %d",
+                     id_col, params.nworkers, params.worker);
+
+  if(params.has_lower || params.has_upper)
+  {
+    Oid typid = get_atttype(params.source, get_attnum(params.source, NameStr(params.id_col)));
+
+    const char *id_type = format_type_be(typid);
+
+    if(params.has_lower)
+      appendStringInfo(&filter, " AND %s >= %s::%s", id_col, quote_literal_cstr(params.lower), id_type);
+
+    if(params.has_upper)
+      appendStringInfo(&filter, " AND %s < %s::%s", id_col, quote_literal_cstr(params.upper), id_type);
+  }
+
+  /* sorted so that the fixes of each id are contiguous */
+  initStringInfo(&query);
+
+  appendStringInfo(&query,
+                   "SELECT %s, %s, %s FROM %s"
+                   " WHERE %s IS NOT NULL AND %s IS NOT NULL AND %s IS NOT NULL%s"
+                   " ORDER BY %s, %s",
+                   id_col, geom_col, time_col, source,
+                   id_col, geom_col, time_col, filter.data,
+                   id_col, time_col);
+
+  portal = SPI_cursor_open_with_args(NULL, query.data, 0, NULL, NULL, NULL, true, CURSOR_OPT_NO_SCROLL);
+
+  for(;;)
+  {
+    int64 skipped = 0;
+
+    int64 finished = 0;
+
+    uint64 nrows;
+
+    SPITupleTable *rows;
+
+    TupleDesc tupdesc;
+
+    SPI_cursor_fetch(portal, true, ST_BUILD_FETCH_SIZE);
+
+    /* the INSERTs of full batches replace SPI_tuptable and SPI_processed */
+    rows = SPI_tuptable;
+
+    nrows = SPI_processed;
+
+    if(nrows == 0)
+    {
+      SPI_freetuptable(rows);
+      break;
+    }
+
+    tupdesc = rows->tupdesc;
+
+    if(insert_plan == NULL)
+    {
+      Oid argtypes[2];
+
+      if(SPI_gettypeid(tupdesc, 3) != TIMESTAMPOID)
+        ereport(ERROR, (errcode(ERRCODE_DATATYPE_MISMATCH),
+                        errmsg("time column \"%s\" must be of type timestamp", NameStr(params.time_col))));
+
+      if(strcmp(SPI_gettype(tupdesc, 2), "geometry") != 0)
+        ereport(ERROR, (errcode(ERRCODE_DATATYPE_MISMATCH),
+                        errmsg("position column \"%s\" must be of type geometry", NameStr(params.geom_col))));
+
+      id_typid = SPI_gettypeid(tupdesc, 1);
+
+      get_typlenbyval(id_typid, &id_typlen, &id_typbyval);
+
+      argtypes[0] = get_array_type(id_typid);
+      argtypes[1] = get_array_type(params.st_typid);
+
+      if(!OidIsValid(argtypes[0]) || !OidIsValid(argtypes[1]))
+        elog(ERROR, "could not find the array types of the id column and of spatiotemporal");
+
+      resetStringInfo(&query);
+
+      appendStringInfo(&query, "INSERT INTO %s SELECT * FROM unnest($1, $2)", target);
+
+      insert_plan = SPI_prepare(query.data, 2, argtypes);
+
+      if(insert_plan == NULL)
+        elog(ERROR, "could not prepare the insert into %s: %s", target, SPI_result_code_string(SPI_result));
+
+      SPI_keepplan(insert_plan);
+    }
+
+    for(uint64 i = 0; i < nrows; ++i)
+    {
+      HeapTuple tuple = rows->vals[i];
+
+      bool isnull;
+
+      Datum id = SPI_getbinval(tuple, tupdesc, 1, &isnull);
+
+      Datum raw = SPI_getbinval(tuple, tupdesc, 2, &isnull);
+
+      GSERIALIZED *gser = (GSERIALIZED*) PG_DETOAST_DATUM(raw);
+
+      Timestamp t = DatumGetTimestamp(SPI_getbinval(tuple, tupdesc, 3, &isnull));
+
+      if(track.npoints > 0 && !datumIsEqual(track.id, id, id_typbyval, id_typlen))
+      {
+        build_track_done(&track, batch, batch_context, insert_plan, id_typid, params.st_typid);
+
+        ++finished;
+      }
+
+      if(track.npoints == 0)
+        track.id = datumCopy(id, id_typbyval, id_typlen);
+
+      if(!track_append(&track, gser, t))
+        ++skipped;
+
+      if((Pointer) gser != DatumGetPointer(raw))
+        pfree(gser);
+    }
+
+    SPI_freetuptable(rows);
+
+    slot_add_progress(slot, (int64) nrows, skipped, finished);
+
+    CHECK_FOR_INTERRUPTS();
+  }
+
+  if(track.npoints > 0)
+  {
+    build_track_done(&track, batch, batch_context, insert_plan, id_typid, params.st_typid);
+
+    slot_add_progress(slot, 0, 0, 1);
+  }
+
+  if(insert_plan)
+  {
+    MemoryContextSwitchTo(batch_context);
+
+    batch_flush(batch, insert_plan, id_typid, params.st_typid);
+  }
+
+  SPI_cursor_close(portal);
+}
+
+
+void postgist_build_worker_main(Datum main_arg)
+{
+  volatile struct st_build_slot *slot;
+
+  if(build_shared == NULL)
+    elog(FATAL, "postgist build worker started without the shared status area");
+
+  slot = &build_shared->slots[DatumGetInt32(main_arg)];
+
+  pqsignal(SIGTERM, die);
+
+  BackgroundWorkerUnblockSignals();
+
+#if PG_VERSION_NUM >= 110000
+  BackgroundWorkerInitializeConnectionByOid(slot->dboid, slot->useroid, 0);
+#else
+  BackgroundWorkerInitializeConnectionByOid(slot->dboid, slot->useroid);
+#endif
+
+  SpinLockAcquire(&build_shared->mutex);
+
+  slot->pid = MyProcPid;
+  slot->state = ST_BUILD_RUNNING;
+  slot->started = GetCurrentTimestamp();
+
+  SpinLockRelease(&build_shared->mutex);
+
+  pgstat_report_appname("postgist build worker");
+
+  PG_TRY();
+  {
+    SetCurrentStatementStartTimestamp();
+
+    StartTransactionCommand();
+
+    if(SPI_connect() != SPI_OK_CONNECT)
+      elog(ERROR, "could not connect to SPI manager");
+
+    PushActiveSnapshot(GetTransactionSnapshot());
+
+    pgstat_report_activity(STATE_RUNNING, "postgist_build_trajectories");
+
+    build_worker_run(slot);
+
+    SPI_finish();
+
+    PopActiveSnapshot();
+
+    CommitTransactionCommand();
+
+    pgstat_report_activity(STATE_IDLE, NULL);
+  }
+  PG_CATCH();
+  {
+    ErrorData *edata;
+
+    MemoryContextSwitchTo(TopMemoryContext);
+
+    edata = CopyErrorData();
+
+    SpinLockAcquire(&build_shared->mutex);
+
+    slot->state = ST_BUILD_FAILED;
+    slot->finished = GetCurrentTimestamp();
+    strlcpy((char*) slot->error, edata->message, ST_BUILD_ERROR_LEN);
+
+    SpinLockRelease(&build_shared->mutex);
+
+    PG_RE_THROW();
+  }
+  PG_END_TRY();
+
+  SpinLockAcquire(&build_shared->mutex);
+
+  slot->state = ST_BUILD_DONE;
+  slot->finished = GetCurrentTimestamp();
+
+  SpinLockRelease(&build_shared->mutex);
+
+  proc_exit(0);
+}
+
+
+/*
+ * \brief Split the distinct ids of 'source' into up to 'nworkers' ranges of
+ *        about the same size and return the first id of each, as text.
+ *
+ * \note One pass over the ids replaces a full scan and sort of the source
+ *       by each worker. Returns -1 if an id is too long for the slots; the
+ *       workers then split the ids by hash.
+ *
+ */
+static int32 build_id_bounds(Oid source, const char *id_col, int32 nworkers, char **bounds)
+{
+  const char *rel = quote_qualified_identifier(get_namespace_name(get_rel_namespace(source)),
+                                               get_rel_name(source));
+
+  const char *col = quote_identifier(id_col);
+
+  StringInfoData query;
+
+  int32 nbounds;
+
+  if(SPI_connect() != SPI_OK_CONNECT)
+    elog(ERROR, "could not connect to SPI manager");
+
+  initStringInfo(&query);
+
+  appendStringInfo(&query,
+                   "SELECT DISTINCT ON (tile) %s::text FROM"
+                   " (SELECT %s, ntile(%d) OVER (ORDER BY %s) AS tile FROM"
+                   " (SELECT DISTINCT %s FROM %s WHERE %s IS NOT NULL) ids) tiles"
+                   " ORDER BY tile, %s",
+                   col, col, nworkers, col, col, rel, col, col);
+
+  if(SPI_execute(query.data, true, 0) != SPI_OK_SELECT)
+    elog(ERROR, "could not split the ids of %s", rel);
+
+  nbounds = (int32) SPI_processed;
+
+  for(int32 i = 0; i < nbounds; ++i)
+  {
+    char *bound = SPI_getvalue(SPI_tuptable->vals[i], SPI_tuptable->tupdesc, 1);
+
+    if(strlen(bound) >= ST_BUILD_BOUND_LEN)
+    {
+      nbounds = -1;
+      break;
+    }
+
+    /* in the caller's context, which outlives SPI_finish */
+    bounds[i] = (char*) SPI_palloc(strlen(bound) + 1);
+
+    strcpy(bounds[i], bound);
+  }
+
+  SPI_finish();
+
+  return nbounds;
+}
+
+
+PG_FUNCTION_INFO_V1(postgist_build_trajectories);
+
+Datum
+postgist_build_trajectories(PG_FUNCTION_ARGS)
+{
+  Oid source = PG_GETARG_OID(0);
+
+  char *id_col = text_to_cstring(PG_GETARG_TEXT_PP(1));
+
+  char *geom_col = text_to_cstring(PG_GETARG_TEXT_PP(2));
+
+  char *time_col = text_to_cstring(PG_GETARG_TEXT_PP(3));
+
+  Oid target = PG_GETARG_OID(4);
+
+  int32 nworkers = PG_GETARG_INT32(5);
+
+  Oid st_typid = TypenameGetTypid("spatiotemporal");
+
+  int slots[ST_BUILD_MAX_WORKERS];
+
+  char *bounds[ST_BUILD_MAX_WORKERS];
+
+  int32 nbounds;
+
+  BackgroundWorkerHandle *handles[ST_BUILD_MAX_WORKERS];
+
+  int64 build_id;
+
+  int64 total = 0;
+
+  int nclaimed = 0;
+
+  int failed = -1;
+
+  if(build_shared == NULL)
+    ereport(ERROR, (errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+                    errmsg("postgist must be loaded via shared_preload_libraries to build trajectories in parallel")));
+
+  if(nworkers < 1 || nworkers > ST_BUILD_MAX_WORKERS)
+    ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                    errmsg("number of workers must be between 1 and %d", ST_BUILD_MAX_WORKERS)));
+
+  if(!OidIsValid(st_typid))
+    ereport(ERROR, (errcode(ERRCODE_UNDEFINED_OBJECT),
+                    errmsg("type spatiotemporal is not in the search path")));
+
+  if(strlen(id_col) >= NAMEDATALEN || strlen(geom_col) >= NAMEDATALEN || strlen(time_col) >= NAMEDATALEN)
+    ereport(ERROR, (errcode(ERRCODE_NAME_TOO_LONG),
+                    errmsg("column names must be shorter than %d characters", NAMEDATALEN)));
+
+  if(get_attnum(source, id_col) == InvalidAttrNumber)
+    ereport(ERROR, (errcode(ERRCODE_UNDEFINED_COLUMN),
+                    errmsg("column \"%s\" of %s does not exist", id_col, get_rel_name(source))));
+
+  nbounds = build_id_bounds(source, id_col, nworkers, bounds);
+
+  /*
+   * claim the slots of the build; other backends skip a slot once it is
+   * ST_BUILD_STARTING, so it is filled after the lock is released
+   */
+  SpinLockAcquire(&build_shared->mutex);
+
+  build_id = build_shared->next_build_id++;
+
+  for(int i = 0; i < ST_BUILD_MAX_WORKERS && nclaimed < nworkers; ++i)
+  {
+    struct st_build_slot *slot = &build_shared->slots[i];
+
+    if(slot->state == ST_BUILD_STARTING || slot->state == ST_BUILD_RUNNING)
+      continue;
+
+    slot->state = ST_BUILD_STARTING;
+    slot->build_id = build_id;
+
+    slots[nclaimed++] = i;
+  }
+
+  /* not enough free slots: give them back */
+  if(nclaimed < nworkers)
+  {
+    for(int i = 0; i < nclaimed; ++i)
+      build_shared->slots[slots[i]].state = ST_BUILD_FREE;
+  }
+
+  SpinLockRelease(&build_shared->mutex);
+
+  if(nclaimed < nworkers)
+    ereport(ERROR, (errcode(ERRCODE_INSUFFICIENT_RESOURCES),
+                    errmsg("too many trajectory build workers are running")));
+
+  for(int k = 0; k < nworkers; ++k)
+  {
+    struct st_build_slot *slot = &build_shared->slots[slots[k]];
+
+    /* everything after the state and the build id */
+    memset((char*) slot + ST_BUILD_SLOT_BODY, 0, sizeof(struct st_build_slot) - ST_BUILD_SLOT_BODY);
+
+    slot->worker = k;
+    slot->nworkers = nworkers;
+
+    /* worker k reads the ids from bound k up to bound k + 1 */
+    if(nbounds < 0)
+      slot->hashed = true;
+    else if(k >= nbounds)
+      slot->empty = true;
+    else
+    {
+      slot->has_lower = (k > 0);
+      slot->has_upper = (k + 1 < nbounds);
+
+      if(slot->has_lower)
+        strlcpy(slot->lower, bounds[k], ST_BUILD_BOUND_LEN);
+
+      if(slot->has_upper)
+        strlcpy(slot->upper, bounds[k + 1], ST_BUILD_BOUND_LEN);
+    }
+
+    slot->dboid = MyDatabaseId;
+    slot->useroid = GetUserId();
+    slot->source = source;
+    slot->target = target;
+    slot->st_typid = st_typid;
+    namestrcpy(&slot->id_col, id_col);
+    namestrcpy(&slot->geom_col, geom_col);
+    namestrcpy(&slot->time_col, time_col);
+  }
+
+  for(int i = 0; i < nworkers; ++i)
+  {
+    BackgroundWorker worker;
+
+    memset(&worker, 0, sizeof(worker));
+
+    worker.bgw_flags = BGWORKER_SHMEM_ACCESS | BGWORKER_BACKEND_DATABASE_CONNECTION;
+    worker.bgw_start_time = BgWorkerStart_RecoveryFinished;
+    worker.bgw_restart_time = BGW_NEVER_RESTART;
+    worker.bgw_main_arg = Int32GetDatum(slots[i]);
+    worker.bgw_notify_pid = MyProcPid;
+
+    snprintf(worker.bgw_library_name, BGW_MAXLEN, "postgist");
+    snprintf(worker.bgw_function_name, BGW_MAXLEN, "postgist_build_worker_main");
+    snprintf(worker.bgw_name, BGW_MAXLEN, "postgist build worker %d/%d", i + 1, nworkers);
+
+    if(!RegisterDynamicBackgroundWorker(&worker, &handles[i]))
+    {
+      /* workers already started run to completion; the rest never will */
+      SpinLockAcquire(&build_shared->mutex);
+
+      for(int j = i; j < nworkers; ++j)
+        build_shared->slots[slots[j]].state = ST_BUILD_FREE;
+
+      SpinLockRelease(&build_shared->mutex);
+
+      ereport(ERROR, (errcode(ERRCODE_INSUFFICIENT_RESOURCES),
+                      errmsg("could not register trajectory build worker %d of %d", i + 1, nworkers),
+                      errhint("You may need to increase max_worker_processes.")));
+    }
+  }
+
+  for(int i = 0; i < nworkers; ++i)
+  {
+    struct st_build_slot *slot = &build_shared->slots[slots[i]];
+
+    WaitForBackgroundWorkerShutdown(handles[i]);
+
+    SpinLockAcquire(&build_shared->mutex);
+
+    /* a worker that died before reporting has failed too */
+    if(slot->state != ST_BUILD_DONE)
+    {
+      if(slot->state != ST_BUILD_FAILED)
+        slot->state = ST_BUILD_FAILED;
+
+      if(failed < 0)
+        failed = i;
+    }
+
+    total += slot->trajectories;
+
+    SpinLockRelease(&build_shared->mutex);
+  }
+
+  if(failed >= 0)
+    ereport(ERROR, (errcode(ERRCODE_INTERNAL_ERROR),
+                    errmsg("trajectory build worker %d of %d failed: %s", failed + 1, nworkers,
+                           build_shared->slots[slots[failed]].error[0] ? build_shared->slots[slots[failed]].error
+                                                                      : "terminated"),
+                    errdetail("Workers that finished have committed their trajectories.")));
+
+  PG_RETURN_INT64(total);
+}
+
+
+struct build_status_cursor
+{
+  int next;
+  struct st_build_slot slots[ST_BUILD_MAX_WORKERS];
+};
+
+
+PG_FUNCTION_INFO_V1(postgist_build_status);
+
+Datum
+postgist_build_status(PG_FUNCTION_ARGS)
+{
+  FuncCallContext *funcctx;
+
+  struct build_status_cursor *cursor;
+
+  if(SRF_IS_FIRSTCALL())
+  {
+    MemoryContext oldcontext;
+
+    TupleDesc tupdesc;
+
+    funcctx = SRF_FIRSTCALL_INIT();
+
+    oldcontext = MemoryContextSwitchTo(funcctx->multi_call_memory_ctx);
+
+    if(get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+      ereport(ERROR, (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+                      errmsg("function returning record called in context that cannot accept type record")));
+
+    funcctx->tuple_desc = BlessTupleDesc(tupdesc);
+
+    cursor = (struct build_status_cursor*) palloc0(sizeof(struct build_status_cursor));
+
+    /* a consistent snapshot of the slots */
+    if(build_shared)
+    {
+      SpinLockAcquire(&build_shared->mutex);
+
+      memcpy(cursor->slots, build_shared->slots, sizeof(cursor->slots));
+
+      SpinLockRelease(&build_shared->mutex);
+    }
+
+    funcctx->user_fctx = cursor;
+
+    MemoryContextSwitchTo(oldcontext);
+  }
+
+  funcctx = SRF_PERCALL_SETUP();
+
+  cursor = (struct build_status_cursor*) funcctx->user_fctx;
+
+  while(cursor->next < ST_BUILD_MAX_WORKERS)
+  {
+    struct st_build_slot *slot = &cursor->slots[cursor->next++];
+
+    Datum values[13];
+
+    bool nulls[13];
+
+    HeapTuple tuple;
+
+    if(slot->state == ST_BUILD_FREE)
+      continue;
+
+    memset(nulls, 0, sizeof(nulls));
+
+    values[0] = Int64GetDatum(slot->build_id);
+    values[1] = Int32GetDatum(slot->worker + 1);
+    values[2] = Int32GetDatum(slot->nworkers);
+    values[3] = Int32GetDatum(slot->pid);
+    values[4] = CStringGetTextDatum(st_build_state_names[slot->state]);
+    values[5] = ObjectIdGetDatum(slot->source);
+    values[6] = ObjectIdGetDatum(slot->target);
+    values[7] = Int64GetDatum(slot->rows_read);
+    values[8] = Int64GetDatum(slot->rows_skipped);
+    values[9] = Int64GetDatum(slot->trajectories);
+    values[10] = TimestampTzGetDatum(slot->started);
+    values[11] = TimestampTzGetDatum(slot->finished);
+    values[12] = CStringGetTextDatum(slot->error);
+
+    nulls[3] = (slot->pid == 0);
+    nulls[10] = (slot->started == 0);
+    nulls[11] = (slot->finished == 0);
+    nulls[12] = (slot->error[0] == '\0');
+
+    tuple = heap_form_tuple(funcctx->tuple_desc, values, nulls);
+
+    SRF_RETURN_NEXT(funcctx, HeapTupleGetDatum(tuple));
+  }
+
+  SRF_RETURN_DONE(funcctx);
+}
@@ -0,0 +1,62 @@
+/*
+  Copyright (C) 2017 National Institute For Space Research (INPE) - Brazil.
+
+  postgis-t is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License version 3 as
+  published by the Free Software Foundation.
+
+  postgis-t is distributed  "AS-IS" in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY OF ANY KIND; without even the implied warranty
+  of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with postgis-t. See LICENSE. If not, write to
+  Gilberto Ribeiro de Queiroz at <gribeiro@dpi.inpe.br>.
+
+ */
+/*!
+ *
+ * \file postgist/build.h
+ *
+ * \brief Parallel bulk conversion of point tables into spatiotemporal
+ *        values with dynamic background workers.
+ *
+ * The status of each worker lives in a shared memory area reserved when
+ * the library is in shared_preload_libraries; without it the build
+ * function raises an error.
+ *
+ * \author Gilberto Ribeiro de Queiroz
+ * \author Fabiana Zioti
+ *
+ * \date 2017
+ *
+ * \copyright GNU Lesser Public License version 3
+ *
+ */
+
+#ifndef __POSTGIST_BUILD_H__
+#define __POSTGIST_BUILD_H__
+
+/* PostgreSQL */
+#include <postgres.h>
+#include <fmgr.h>
+
+/* maximum number of build workers running at the same time */
+#define ST_BUILD_MAX_WORKERS 32
+
+
+/*
+ * \brief Reserve and attach the shared status area; called from _PG_init.
+ *
+ */
+void st_build_init(void);
+
+
+/* entry point of the background workers */
+PGDLLEXPORT void postgist_build_worker_main(Datum main_arg);
+
+extern Datum postgist_build_trajectories(PG_FUNCTION_ARGS);
+extern Datum postgist_build_status(PG_FUNCTION_ARGS);
+
+#endif  /* __POSTGIST_BUILD_H__ */
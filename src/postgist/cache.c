@@ -0,0 +1,269 @@
+/*
+  Copyright (C) 2017 National Institute For Space Research (INPE) - Brazil.
+
+  postgis-t is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License version 3 as
+  published by the Free Software Foundation.
+
+  postgis-t is distributed  "AS-IS" in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY OF ANY KIND; without even the implied warranty
+  of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with postgis-t. See LICENSE. If not, write to
+  Gilberto Ribeiro de Queiroz at <gribeiro@dpi.inpe.br>.
+
+ */
+/*!
+ *
+ * \file postgist/cache.c
+ *
+ * \brief Call-site cache of detoasted spatiotemporal arguments and of
+ *        prepared GEOS geometries.
+ *
+ * \author Gilberto Ribeiro de Queiroz
+ * \author Fabiana Zioti
+ *
+ * \date 2017
+ *
+ * \copyright GNU Lesser Public License version 3
+ *
+ */
+
+/* PostGIS-T extension */
+#include "cache.h"
+
+/* PostgreSQL */
+#include <utils/memutils.h>
+
+/* C Standard Library */
+#include <string.h>
+
+
+struct st_cache_entry
+{
+  /* copy of the raw argument: a toast pointer or the compressed bytes */
+  struct varlena *key;
+
+  /* detoasted and flattened value, NULL until the key is seen twice */
+  struct spatiotemporal *value;
+};
+
+
+struct st_geos_entry
+{
+  /* copy of the raw geometry argument */
+  struct varlena *key;
+
+  /* GEOS objects live in malloc'd memory, freed with the cache */
+  GEOSGeometry *geom;
+  const GEOSPreparedGeometry *prepared;
+};
+
+
+struct st_cache
+{
+  struct st_cache_entry args[ST_CACHE_MAX_ARGS];
+  struct st_geos_entry geoms[ST_CACHE_MAX_ARGS];
+  MemoryContextCallback callback;
+};
+
+
+static void geos_entry_reset(struct st_geos_entry *entry)
+{
+  if(entry->prepared)
+    GEOSPreparedGeom_destroy(entry->prepared);
+
+  if(entry->geom)
+    GEOSGeom_destroy(entry->geom);
+
+  entry->prepared = NULL;
+  entry->geom = NULL;
+}
+
+
+/* fn_mcxt is going away: release what GEOS allocated */
+static void cache_release(void *arg)
+{
+  struct st_cache *cache = (struct st_cache*) arg;
+
+  for(int i = 0; i < ST_CACHE_MAX_ARGS; ++i)
+    geos_entry_reset(&cache->geoms[i]);
+}
+
+
+static struct st_cache *cache_fetch(FunctionCallInfo fcinfo)
+{
+  struct st_cache *cache = (struct st_cache*) fcinfo->flinfo->fn_extra;
+
+  if(cache == NULL)
+  {
+    cache = (struct st_cache*) MemoryContextAllocZero(fcinfo->flinfo->fn_mcxt, sizeof(struct st_cache));
+
+    cache->callback.func = cache_release;
+    cache->callback.arg = cache;
+
+    MemoryContextRegisterResetCallback(fcinfo->flinfo->fn_mcxt, &cache->callback);
+
+    fcinfo->flinfo->fn_extra = cache;
+  }
+
+  return cache;
+}
+
+
+/*
+ * \brief Tell if the raw argument is worth caching.
+ *
+ * \note Only on-disk toast pointers and compressed values are stable and
+ *       costly to expand. Indirect and expanded pointers refer to memory
+ *       that may change between calls.
+ *
+ */
+static bool cacheable(const struct varlena *raw)
+{
+  return VARATT_IS_EXTERNAL_ONDISK(raw) || VARATT_IS_COMPRESSED(raw);
+}
+
+
+static struct st_cache_entry *cache_probe(FunctionCallInfo fcinfo, int argno)
+{
+  struct varlena *raw = (struct varlena*) PG_GETARG_POINTER(argno);
+
+  struct st_cache *cache;
+
+  struct st_cache_entry *entry;
+
+  MemoryContext old_context;
+
+  Size size;
+
+  Assert(argno < ST_CACHE_MAX_ARGS);
+
+  if(!cacheable(raw))
+    return NULL;
+
+  cache = cache_fetch(fcinfo);
+
+  entry = &cache->args[argno];
+
+  size = VARSIZE_ANY(raw);
+
+  if(entry->key && VARSIZE_ANY(entry->key) == size && memcmp(entry->key, raw, size) == 0)
+  {
+    if(entry->value == NULL)
+    {
+      struct spatiotemporal *st;
+
+      old_context = MemoryContextSwitchTo(fcinfo->flinfo->fn_mcxt);
+
+      st = (struct spatiotemporal*) PG_DETOAST_DATUM_COPY(PointerGetDatum(raw));
+
+      entry->value = spatiotemporal_flatten(st);
+
+      if(entry->value != st)
+        pfree(st);
+
+      MemoryContextSwitchTo(old_context);
+    }
+
+    return entry;
+  }
+
+  /* a new argument: remember it and drop the previous one */
+  if(entry->key)
+    pfree(entry->key);
+
+  if(entry->value)
+    pfree(entry->value);
+
+  entry->value = NULL;
+
+  entry->key = (struct varlena*) MemoryContextAlloc(fcinfo->flinfo->fn_mcxt, size);
+
+  memcpy(entry->key, raw, size);
+
+  return NULL;
+}
+
+
+struct spatiotemporal *spatiotemporal_cache_get(FunctionCallInfo fcinfo, int argno)
+{
+  struct st_cache_entry *entry = cache_probe(fcinfo, argno);
+
+  if(entry)
+    return entry->value;
+
+  return PG_GETARG_SPATIOTEMPORAL_P(argno);
+}
+
+
+struct spatiotemporal *spatiotemporal_cache_lookup(FunctionCallInfo fcinfo, int argno)
+{
+  struct st_cache_entry *entry = cache_probe(fcinfo, argno);
+
+  return entry ? entry->value : NULL;
+}
+
+
+const GEOSPreparedGeometry *geometry_cache_prepared(FunctionCallInfo fcinfo, int argno)
+{
+  struct varlena *raw = (struct varlena*) PG_GETARG_POINTER(argno);
+
+  struct st_geos_entry *entry;
+
+  Size size;
+
+  Assert(argno < ST_CACHE_MAX_ARGS);
+
+  /* indirect and expanded values may change between calls */
+  if(VARATT_IS_EXTERNAL(raw) && !VARATT_IS_EXTERNAL_ONDISK(raw))
+    return NULL;
+
+  entry = &cache_fetch(fcinfo)->geoms[argno];
+
+  size = VARSIZE_ANY(raw);
+
+  if(entry->key && VARSIZE_ANY(entry->key) == size && memcmp(entry->key, raw, size) == 0)
+  {
+    if(entry->prepared == NULL)
+    {
+      LWGEOM *lwgeom = lwgeom_from_gserialized(PG_GETARG_GSERIALIZED_P(argno));
+
+      initGEOS(lwpgnotice, lwgeom_geos_error);
+
+      entry->geom = LWGEOM2GEOS(lwgeom, 0);
+
+      lwgeom_free(lwgeom);
+
+      if(entry->geom == NULL)
+        ereport(ERROR, (errcode(ERRCODE_INTERNAL_ERROR),
+                        errmsg("could not convert geometry to GEOS: %s", lwgeom_geos_errmsg)));
+
+      entry->prepared = GEOSPrepare(entry->geom);
+
+      if(entry->prepared == NULL)
+      {
+        geos_entry_reset(entry);
+
+        ereport(ERROR, (errcode(ERRCODE_INTERNAL_ERROR),
+                        errmsg("could not prepare geometry: %s", lwgeom_geos_errmsg)));
+      }
+    }
+
+    return entry->prepared;
+  }
+
+  /* a new argument: remember it and drop the previous one */
+  geos_entry_reset(entry);
+
+  if(entry->key)
+    pfree(entry->key);
+
+  entry->key = (struct varlena*) MemoryContextAlloc(fcinfo->flinfo->fn_mcxt, size);
+
+  memcpy(entry->key, raw, size);
+
+  return NULL;
+}
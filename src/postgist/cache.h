@@ -0,0 +1,85 @@
+/*
+  Copyright (C) 2017 National Institute For Space Research (INPE) - Brazil.
+
+  postgis-t is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License version 3 as
+  published by the Free Software Foundation.
+
+  postgis-t is distributed  "AS-IS" in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY OF ANY KIND; without even the implied warranty
+  of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with postgis-t. See LICENSE. If not, write to
+  Gilberto Ribeiro de Queiroz at <gribeiro@dpi.inpe.br>.
+
+ */
+/*!
+ *
+ * \file postgist/cache.h
+ *
+ * \brief Call-site cache of detoasted spatiotemporal arguments and of
+ *        prepared GEOS geometries.
+ *
+ * Functions called many times with the same toasted argument, like a join
+ * against a fixed trajectory, keep the detoasted and flattened value in
+ * fn_extra instead of fetching and decompressing it for every row. In the
+ * same way, a geometry argument that repeats, like the polygon of a
+ * spatial filter, is converted and prepared for GEOS once. An argument is
+ * only cached the second time it is seen, so one-off values do not pay for
+ * the copy into the function memory context.
+ *
+ * \note Cached values live in fn_mcxt and must not be freed by the caller.
+ *       Functions that already use fn_extra (set-returning functions) must
+ *       not use this cache.
+ *
+ * \author Gilberto Ribeiro de Queiroz
+ * \author Fabiana Zioti
+ *
+ * \date 2017
+ *
+ * \copyright GNU Lesser Public License version 3
+ *
+ */
+
+#ifndef __POSTGIST_CACHE_H__
+#define __POSTGIST_CACHE_H__
+
+/* PostGIS-T extension */
+#include "spatiotemporal.h"
+
+/* number of leading arguments that can be cached per call site */
+#define ST_CACHE_MAX_ARGS 2
+
+
+/*
+ * \brief Return argument 'argno' detoasted and flattened, from the cache
+ *        when it was seen before.
+ *
+ */
+struct spatiotemporal *spatiotemporal_cache_get(FunctionCallInfo fcinfo, int argno);
+
+
+/*
+ * \brief Return argument 'argno' detoasted and flattened if it was seen
+ *        before, NULL otherwise.
+ *
+ * \note Lets functions that read slices of chunked values avoid a full
+ *       fetch for arguments that are not repeated.
+ *
+ */
+struct spatiotemporal *spatiotemporal_cache_lookup(FunctionCallInfo fcinfo, int argno);
+
+
+/*
+ * \brief Return the prepared GEOS geometry of the geometry argument
+ *        'argno' if it was seen before, NULL otherwise.
+ *
+ * \note The prepared geometry is freed with the call site; the caller must
+ *       not destroy it.
+ *
+ */
+const GEOSPreparedGeometry *geometry_cache_prepared(FunctionCallInfo fcinfo, int argno);
+
+#endif  /* __POSTGIST_CACHE_H__ */
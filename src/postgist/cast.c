@@ -0,0 +1,213 @@
+/*
+  Copyright (C) 2017 National Institute For Space Research (INPE) - Brazil.
+
+  postgis-t is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License version 3 as
+  published by the Free Software Foundation.
+
+  postgis-t is distributed  "AS-IS" in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY OF ANY KIND; without even the implied warranty
+  of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with postgis-t. See LICENSE. If not, write to
+  Gilberto Ribeiro de Queiroz at <gribeiro@dpi.inpe.br>.
+
+ */
+
+/*!
+ *
+ * \file postgist/cast.c
+ *
+ * \brief Casts between spatiotemporal and PostGIS LINESTRING M geometries,
+ *        with the time of each instant as M in seconds since the Unix epoch.
+ *
+ * \author Gilberto Ribeiro de Queiroz
+ * \author Fabiana Zioti
+ *
+ * \date 2017
+ *
+ * \copyright GNU Lesser Public License version 3
+ *
+ */
+
+/* PostGIS-T extension */
+#include "cache.h"
+#include "spatiotemporal.h"
+#include "dims.h"
+
+/* PostgreSQL */
+#include <utils/datetime.h>
+
+/* C Standard Library */
+#include <math.h>
+#include <string.h>
+
+
+/* seconds between the Unix epoch and the PostgreSQL epoch (2000-01-01) */
+#define ST_UNIX_EPOCH_OFFSET ((double) (POSTGRES_EPOCH_JDATE - UNIX_EPOCH_JDATE) * SECS_PER_DAY)
+
+
+static inline double timestamp_to_epoch(Timestamp t)
+{
+  return (double) t / USECS_PER_SEC + ST_UNIX_EPOCH_OFFSET;
+}
+
+
+static inline Timestamp epoch_to_timestamp(double m)
+{
+  double usecs = rint((m - ST_UNIX_EPOCH_OFFSET) * USECS_PER_SEC);
+
+  /* the range is checked before the cast, which is undefined outside int64 */
+  if(!isfinite(usecs) || usecs < (double) MIN_TIMESTAMP || usecs >= (double) END_TIMESTAMP)
+    ereport(ERROR, (errcode(ERRCODE_DATETIME_VALUE_OUT_OF_RANGE),
+                    errmsg("LINESTRING M measure %g is not a valid time in seconds since 1970-01-01", m)));
+
+  return (Timestamp) usecs;
+}
+
+
+PG_FUNCTION_INFO_V1(spatiotemporal_to_geometry);
+
+Datum
+spatiotemporal_to_geometry(PG_FUNCTION_ARGS)
+{
+  struct spatiotemporal *st = spatiotemporal_cache_get(fcinfo, 0);
+
+  int ndims = ST_NDIMS(st);
+
+  const double *coords = ST_COORDS(st);
+
+  const Timestamp *times = ST_TIMES(st);
+
+  POINTARRAY *pa;
+
+  double *out;
+
+  LWLINE *lwline;
+
+  GSERIALIZED *result;
+
+  if(ST_HAS_M(st))
+    ereport(ERROR, (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+                    errmsg("spatiotemporal with M ordinates can not be cast to geometry"),
+                    errdetail("The M ordinate of the geometry holds the time of each instant.")));
+
+  /*
+   * Times live in their own array, so the XY(Z)M point list has to be
+   * interleaved here; it is written once, straight into the array that is
+   * serialized.
+   */
+  pa = ptarray_construct(ST_HAS_Z(st), 1, st->npoints);
+
+  out = (double*) getPoint_internal(pa, 0);
+
+  if(ndims == 2)
+  {
+    for(int32 i = 0; i < st->npoints; ++i)
+    {
+      out[3 * i] = coords[2 * i];
+      out[3 * i + 1] = coords[2 * i + 1];
+      out[3 * i + 2] = timestamp_to_epoch(times[i]);
+    }
+  }
+  else
+  {
+    for(int32 i = 0; i < st->npoints; ++i)
+    {
+      memcpy(out + 4 * i, coords + 3 * i, 3 * sizeof(double));
+      out[4 * i + 3] = timestamp_to_epoch(times[i]);
+    }
+  }
+
+  lwline = lwline_construct(st->srid, NULL, pa);
+
+  result = geometry_serialize((LWGEOM*) lwline);
+
+  lwline_free(lwline);
+
+  PG_RETURN_POINTER(result);
+}
+
+
+PG_FUNCTION_INFO_V1(spatiotemporal_from_geometry);
+
+Datum
+spatiotemporal_from_geometry(PG_FUNCTION_ARGS)
+{
+  GSERIALIZED *gser = PG_GETARG_GSERIALIZED_P(0);
+
+  LWGEOM *lwgeom;
+
+  POINTARRAY *pa;
+
+  struct spatiotemporal *st;
+
+  int32 flags;
+
+  int ndims;
+
+  int in_ndims;
+
+  const double *in;
+
+  double *coords;
+
+  Timestamp *times;
+
+  if(gserialized_get_type(gser) != LINETYPE || !gserialized_has_m(gser))
+    ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                    errmsg("only LINESTRING M geometries can be cast to spatiotemporal"),
+                    errdetail("The M ordinate must hold the time of each vertex in seconds since the Unix epoch.")));
+
+  /* the point array of the line references the serialized geometry */
+  lwgeom = lwgeom_from_gserialized(gser);
+
+  pa = lwgeom_as_lwline(lwgeom)->points;
+
+  flags = gserialized_has_z(gser) ? ST_FLAG_Z : 0;
+
+  ndims = ST_FLAGS_NDIMS(flags);
+
+  in_ndims = ndims + 1;
+
+  st = spatiotemporal_alloc(pa->npoints, flags);
+
+  st->srid = gserialized_get_srid(gser);
+
+  coords = ST_COORDS(st);
+
+  times = ST_TIMES(st);
+
+  in = pa->npoints > 0 ? (const double*) getPoint_internal(pa, 0) : NULL;
+
+  for(uint32_t i = 0; i < pa->npoints; ++i)
+  {
+    const double *p = in + i * in_ndims;
+
+    Timestamp t = epoch_to_timestamp(p[in_ndims - 1]);
+
+    if(i > 0 && t <= times[i - 1])
+      ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                      errmsg("LINESTRING M measures must be increasing to be cast to spatiotemporal")));
+
+    memcpy(coords + i * ndims, p, ndims * sizeof(double));
+
+    times[i] = t;
+  }
+
+  st->npoints = pa->npoints;
+
+  if(st->npoints > 0)
+  {
+    st->start_time = times[0];
+    st->end_time = times[st->npoints - 1];
+
+    st_dims_ops_get(flags)->extent(coords, st->npoints, &st->extent);
+  }
+
+  lwgeom_free(lwgeom);
+
+  PG_RETURN_SPATIOTEMPORAL_P(st);
+}
@@ -0,0 +1,631 @@
+/*
+  Copyright (C) 2017 National Institute For Space Research (INPE) - Brazil.
+
+  postgis-t is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License version 3 as
+  published by the Free Software Foundation.
+
+  postgis-t is distributed  "AS-IS" in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY OF ANY KIND; without even the implied warranty
+  of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with postgis-t. See LICENSE. If not, write to
+  Gilberto Ribeiro de Queiroz at <gribeiro@dpi.inpe.br>.
+
+ */
+
+/*!
+ *
+ * \file postgist/chunk.c
+ *
+ * \brief Chunked layout for long trajectories and the time restrictions
+ *        that read only the chunks they need.
+ *
+ * Slices are only cheap when the value is stored uncompressed, so columns
+ * holding chunked values should use SET STORAGE EXTERNAL.
+ *
+ * \author Gilberto Ribeiro de Queiroz
+ * \author Fabiana Zioti
+ *
+ * \date 2017
+ *
+ * \copyright GNU Lesser Public License version 3
+ *
+ */
+
+/* PostGIS-T extension */
+#include "spatiotemporal.h"
+#include "cache.h"
+#include "dims.h"
+
+/* PostgreSQL */
+#include <utils/datetime.h>
+
+/* C Standard Library */
+#include <float.h>
+#include <string.h>
+
+
+/* instants of one chunk, or of a whole contiguous value */
+struct chunk_view
+{
+  const double *coords;
+  const Timestamp *times;
+  int32 npoints;
+};
+
+
+struct spatiotemporal *spatiotemporal_flatten(struct spatiotemporal *st)
+{
+  struct spatiotemporal *result;
+
+  const struct st_chunk *chunks;
+
+  int ndims;
+
+  int32 n = 0;
+
+  if(!ST_IS_CHUNKED(st))
+    return st;
+
+  ndims = ST_NDIMS(st);
+
+  result = spatiotemporal_alloc(st->npoints, st->flags & ~ST_FLAG_CHUNKED);
+
+  result->start_time = st->start_time;
+  result->end_time = st->end_time;
+  result->srid = st->srid;
+  result->extent = st->extent;
+
+  chunks = ST_CHUNKS(st);
+
+  for(int32 k = 0; k < st->nchunks; ++k)
+  {
+    const char *base = (const char*) st + chunks[k].offset;
+
+    int32 cn = chunks[k].npoints;
+
+    memcpy(ST_COORDS(result) + n * ndims, base, cn * ndims * sizeof(double));
+
+    memcpy(ST_TIMES(result) + n, base + cn * ndims * sizeof(double), cn * sizeof(Timestamp));
+
+    n += cn;
+  }
+
+  result->npoints = n;
+
+  return result;
+}
+
+
+/*
+ * \brief Fetch 'length' bytes starting at byte 'offset' of the value.
+ *
+ * \note Offsets count from the start of the value, varlena header included.
+ *       The slice starts four bytes early so that the returned pointer,
+ *       which follows the 4-byte header of the palloc'd slice, ends up
+ *       8-byte aligned like the data it holds. Offsets are multiples of 8.
+ *
+ */
+static const char *fetch_slice(Datum d, int32 offset, int32 length)
+{
+  struct varlena *slice = PG_DETOAST_DATUM_SLICE(d, offset - VARHDRSZ - 4, length + 4);
+
+  return VARDATA(slice) + 4;
+}
+
+
+static void chunk_load(Datum d, const struct st_chunk *c, int ndims, struct chunk_view *view)
+{
+  size_t coords_size = (size_t) c->npoints * ndims * sizeof(double);
+
+  const char *data = fetch_slice(d, c->offset, coords_size + c->npoints * sizeof(Timestamp));
+
+  view->coords = (const double*) data;
+  view->times = (const Timestamp*) (data + coords_size);
+  view->npoints = c->npoints;
+}
+
+
+/*
+ * \brief Index of the last instant at or before 't', -1 if none.
+ *
+ */
+static int32 times_search(const Timestamp *times, int32 n, Timestamp t)
+{
+  int32 lo = 0;
+
+  int32 hi = n - 1;
+
+  int32 found = -1;
+
+  while(lo <= hi)
+  {
+    int32 mid = lo + (hi - lo) / 2;
+
+    if(times[mid] <= t)
+    {
+      found = mid;
+      lo = mid + 1;
+    }
+    else
+      hi = mid - 1;
+  }
+
+  return found;
+}
+
+
+/*
+ * \brief Index of the last chunk starting at or before 't', -1 if none.
+ *
+ */
+static int32 chunks_search(const struct st_chunk *chunks, int32 n, Timestamp t)
+{
+  int32 lo = 0;
+
+  int32 hi = n - 1;
+
+  int32 found = -1;
+
+  while(lo <= hi)
+  {
+    int32 mid = lo + (hi - lo) / 2;
+
+    if(chunks[mid].start_time <= t)
+    {
+      found = mid;
+      lo = mid + 1;
+    }
+    else
+      hi = mid - 1;
+  }
+
+  return found;
+}
+
+
+static void interpolate(const double *c0, const double *c1, Timestamp t0, Timestamp t1,
+                        Timestamp t, int ndims, double *out)
+{
+  double f = (t1 > t0) ? (double) (t - t0) / (double) (t1 - t0) : 0.0;
+
+  for(int d = 0; d < ndims; ++d)
+    out[d] = c0[d] + (c1[d] - c0[d]) * f;
+}
+
+
+static Datum make_point(const struct spatiotemporal *hdr, const double *c)
+{
+  POINT4D p;
+
+  LWPOINT *lwpoint;
+
+  GSERIALIZED *result;
+
+  st_dims_ops_get(hdr->flags)->decode(c, &p);
+
+  lwpoint = lwpoint_make(hdr->srid, ST_HAS_Z(hdr), ST_HAS_M(hdr), &p);
+
+  result = geometry_serialize((LWGEOM*) lwpoint);
+
+  lwpoint_free(lwpoint);
+
+  return PointerGetDatum(result);
+}
+
+
+struct spatiotemporal *spatiotemporal_tail(Datum d, const struct spatiotemporal *hdr, Timestamp t)
+{
+  int ndims = ST_NDIMS(hdr);
+
+  int32 flags = hdr->flags & ~ST_FLAG_CHUNKED;
+
+  struct chunk_view *views;
+
+  int32 nviews = 0;
+
+  int32 total = 0;
+
+  struct spatiotemporal *result;
+
+  if(hdr->npoints == 0 || hdr->end_time <= t)
+    return spatiotemporal_alloc(0, flags);
+
+  if(ST_IS_CHUNKED(hdr))
+  {
+    const struct st_chunk *chunks = (const struct st_chunk*)
+      fetch_slice(d, ST_HEADER_SIZE, hdr->nchunks * sizeof(struct st_chunk));
+
+    int32 first = Max(chunks_search(chunks, hdr->nchunks, t), 0);
+
+    views = (struct chunk_view*) palloc((hdr->nchunks - first) * sizeof(struct chunk_view));
+
+    for(int32 k = first; k < hdr->nchunks; ++k)
+      chunk_load(d, &chunks[k], ndims, &views[nviews++]);
+  }
+  else
+  {
+    /* the times at the end of the value, doubling the slice until it reaches 't' */
+    size_t times_offset = ST_HEADER_SIZE + (size_t) hdr->capacity * ndims * sizeof(double);
+
+    const Timestamp *times;
+
+    int32 n = Min(hdr->npoints, ST_MIN_CAPACITY);
+
+    for(;;)
+    {
+      times = (const Timestamp*) fetch_slice(d, times_offset + (hdr->npoints - n) * sizeof(Timestamp),
+                                             n * sizeof(Timestamp));
+
+      if(n == hdr->npoints || times[0] <= t)
+        break;
+
+      n = Min(n * 2, hdr->npoints);
+    }
+
+    views = (struct chunk_view*) palloc(sizeof(struct chunk_view));
+
+    views[0].times = times;
+    views[0].npoints = n;
+    views[0].coords = (const double*)
+      fetch_slice(d, ST_HEADER_SIZE + (size_t) (hdr->npoints - n) * ndims * sizeof(double),
+                  n * ndims * sizeof(double));
+
+    nviews = 1;
+  }
+
+  /* drop what precedes the last instant at or before 't' */
+  for(int32 k = 0; k < nviews; ++k)
+  {
+    struct chunk_view *v = &views[k];
+
+    int32 first = (k == 0) ? Max(times_search(v->times, v->npoints, t), 0) : 0;
+
+    v->coords += first * ndims;
+    v->times += first;
+    v->npoints -= first;
+
+    total += v->npoints;
+  }
+
+  result = spatiotemporal_alloc(total, flags);
+
+  result->srid = hdr->srid;
+
+  for(int32 k = 0; k < nviews; ++k)
+  {
+    memcpy(ST_COORDS(result) + result->npoints * ndims, views[k].coords,
+           views[k].npoints * ndims * sizeof(double));
+
+    memcpy(ST_TIMES(result) + result->npoints, views[k].times,
+           views[k].npoints * sizeof(Timestamp));
+
+    result->npoints += views[k].npoints;
+  }
+
+  result->start_time = ST_TIMES(result)[0];
+  result->end_time = ST_TIMES(result)[total - 1];
+
+  st_dims_ops_get(flags)->extent(ST_COORDS(result), total, &result->extent);
+
+  return result;
+}
+
+
+PG_FUNCTION_INFO_V1(spatiotemporal_chunk);
+
+Datum
+spatiotemporal_chunk(PG_FUNCTION_ARGS)
+{
+  struct spatiotemporal *st = PG_GETARG_SPATIOTEMPORAL_P(0);
+
+  Interval *span = PG_GETARG_INTERVAL_P(1);
+
+  int64 width = span->time + (int64) span->day * USECS_PER_DAY +
+                (int64) span->month * DAYS_PER_MONTH * USECS_PER_DAY;
+
+  int ndims = ST_NDIMS(st);
+
+  const double *coords = ST_COORDS(st);
+
+  const Timestamp *times = ST_TIMES(st);
+
+  const struct st_dims_ops *ops = st_dims_ops_get(st->flags);
+
+  struct spatiotemporal *result;
+
+  struct st_chunk *chunks;
+
+  int32 nchunks = 0;
+
+  int64 last_bucket = -1;
+
+  size_t size;
+
+  int32 offset;
+
+  int32 first = 0;
+
+  if(width <= 0)
+    ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                    errmsg("chunk interval must be positive")));
+
+  if(st->npoints == 0)
+    PG_RETURN_SPATIOTEMPORAL_P(st);
+
+  /* count the non-empty time buckets */
+  for(int32 i = 0; i < st->npoints; ++i)
+  {
+    int64 bucket = (times[i] - times[0]) / width;
+
+    if(bucket != last_bucket)
+    {
+      ++nchunks;
+      last_bucket = bucket;
+    }
+  }
+
+  offset = ST_HEADER_SIZE + nchunks * sizeof(struct st_chunk);
+
+  size = offset + (size_t) st->npoints * (ndims * sizeof(double) + sizeof(Timestamp));
+
+  result = (struct spatiotemporal*) palloc0(size);
+
+  memcpy(result, st, ST_HEADER_SIZE);
+
+  SET_VARSIZE(result, size);
+
+  result->flags |= ST_FLAG_CHUNKED;
+  result->capacity = st->npoints;
+  result->nchunks = nchunks;
+
+  chunks = ST_CHUNKS(result);
+
+  for(int32 k = 0; k < nchunks; ++k)
+  {
+    int64 bucket = (times[first] - times[0]) / width;
+
+    int32 last = first;
+
+    char *base = (char*) result + offset;
+
+    struct st_chunk *c = &chunks[k];
+
+    while(last + 1 < st->npoints && (times[last + 1] - times[0]) / width == bucket)
+      ++last;
+
+    c->npoints = last - first + 1;
+    c->offset = offset;
+    c->start_time = times[first];
+    c->end_time = times[last];
+
+    c->extent.xmin = c->extent.ymin = DBL_MAX;
+    c->extent.xmax = c->extent.ymax = -DBL_MAX;
+
+    ops->extent(coords + first * ndims, c->npoints, &c->extent);
+
+    memcpy(base, coords + first * ndims, c->npoints * ndims * sizeof(double));
+
+    memcpy(base + c->npoints * ndims * sizeof(double), times + first, c->npoints * sizeof(Timestamp));
+
+    offset += c->npoints * (ndims * sizeof(double) + sizeof(Timestamp));
+
+    first = last + 1;
+  }
+
+  PG_RETURN_SPATIOTEMPORAL_P(result);
+}
+
+
+PG_FUNCTION_INFO_V1(spatiotemporal_value_at);
+
+Datum
+spatiotemporal_value_at(PG_FUNCTION_ARGS)
+{
+  Datum d = PG_GETARG_DATUM(0);
+
+  Timestamp t = PG_GETARG_TIMESTAMP(1);
+
+  /* a repeated argument is read whole from the cache, so it is never chunked */
+  struct spatiotemporal *cached = spatiotemporal_cache_lookup(fcinfo, 0);
+
+  struct spatiotemporal *hdr = cached ? cached : DatumGetSpatioTemporalHeader(d);
+
+  int ndims = ST_NDIMS(hdr);
+
+  double out[4];
+
+  struct chunk_view view;
+
+  int32 i;
+
+  if(hdr->npoints == 0)
+    PG_RETURN_NULL();
+
+  if(ST_IS_CHUNKED(hdr))
+  {
+    const struct st_chunk *chunks = (const struct st_chunk*)
+      fetch_slice(d, ST_HEADER_SIZE, hdr->nchunks * sizeof(struct st_chunk));
+
+    int32 k = chunks_search(chunks, hdr->nchunks, t);
+
+    if(k < 0 || t > chunks[hdr->nchunks - 1].end_time)
+      PG_RETURN_NULL();
+
+    if(t > chunks[k].end_time)
+    {
+      /* between two chunks: interpolate from the end of one to the start of the next */
+      struct chunk_view next;
+
+      chunk_load(d, &chunks[k], ndims, &view);
+      chunk_load(d, &chunks[k + 1], ndims, &next);
+
+      interpolate(view.coords + (view.npoints - 1) * ndims, next.coords,
+                  view.times[view.npoints - 1], next.times[0], t, ndims, out);
+
+      PG_RETURN_DATUM(make_point(hdr, out));
+    }
+
+    chunk_load(d, &chunks[k], ndims, &view);
+  }
+  else
+  {
+    struct spatiotemporal *st = cached ? cached : DatumGetSpatioTemporal(d);
+
+    view.coords = ST_COORDS(st);
+    view.times = ST_TIMES(st);
+    view.npoints = st->npoints;
+  }
+
+  i = times_search(view.times, view.npoints, t);
+
+  if(i < 0 || (i == view.npoints - 1 && t > view.times[i]))
+    PG_RETURN_NULL();
+
+  if(view.times[i] == t)
+    PG_RETURN_DATUM(make_point(hdr, view.coords + i * ndims));
+
+  interpolate(view.coords + i * ndims, view.coords + (i + 1) * ndims,
+              view.times[i], view.times[i + 1], t, ndims, out);
+
+  PG_RETURN_DATUM(make_point(hdr, out));
+}
+
+
+PG_FUNCTION_INFO_V1(spatiotemporal_at_period);
+
+Datum
+spatiotemporal_at_period(PG_FUNCTION_ARGS)
+{
+  Datum d = PG_GETARG_DATUM(0);
+
+  struct spatiotemporal *cached = spatiotemporal_cache_lookup(fcinfo, 0);
+
+  struct spatiotemporal *hdr = cached ? cached : DatumGetSpatioTemporalHeader(d);
+
+  int ndims = ST_NDIMS(hdr);
+
+  int32 flags = hdr->flags & ~ST_FLAG_CHUNKED;
+
+  const struct st_dims_ops *ops = st_dims_ops_get(flags);
+
+  struct chunk_view view;
+
+  Timestamp lower, upper;
+
+  int32 i0, i1, first;
+
+  struct spatiotemporal *result;
+
+  double *coords;
+
+  Timestamp *times;
+
+  if(!st_period_from_range(PG_GETARG_DATUM(1), &lower, &upper))
+    PG_RETURN_NULL();
+
+  if(ST_IS_CHUNKED(hdr))
+  {
+    const struct st_chunk *chunks = (const struct st_chunk*)
+      fetch_slice(d, ST_HEADER_SIZE, hdr->nchunks * sizeof(struct st_chunk));
+
+    /* the chunks that overlap the period and the instants just outside it */
+    int32 k0 = Max(chunks_search(chunks, hdr->nchunks, lower), 0);
+
+    int32 k1 = Min(chunks_search(chunks, hdr->nchunks, upper) + 1, hdr->nchunks - 1);
+
+    int32 n = 0;
+
+    double *c;
+
+    Timestamp *t;
+
+    for(int32 k = k0; k <= k1; ++k)
+      n += chunks[k].npoints;
+
+    c = (double*) palloc(Max(n, 1) * ndims * sizeof(double));
+
+    t = (Timestamp*) palloc(Max(n, 1) * sizeof(Timestamp));
+
+    n = 0;
+
+    for(int32 k = k0; k <= k1; ++k)
+    {
+      struct chunk_view cv;
+
+      chunk_load(d, &chunks[k], ndims, &cv);
+
+      memcpy(c + n * ndims, cv.coords, cv.npoints * ndims * sizeof(double));
+      memcpy(t + n, cv.times, cv.npoints * sizeof(Timestamp));
+
+      n += cv.npoints;
+    }
+
+    view.coords = c;
+    view.times = t;
+    view.npoints = n;
+  }
+  else
+  {
+    struct spatiotemporal *st = cached ? cached : DatumGetSpatioTemporal(d);
+
+    view.coords = ST_COORDS(st);
+    view.times = ST_TIMES(st);
+    view.npoints = st->npoints;
+  }
+
+  /* instants inside the period, plus positions interpolated at its bounds */
+  i0 = times_search(view.times, view.npoints, lower);
+
+  i1 = times_search(view.times, view.npoints, upper);
+
+  first = (i0 >= 0 && view.times[i0] == lower) ? i0 : i0 + 1;
+
+  result = spatiotemporal_alloc(Max(i1 - first + 1, 0) + 2, flags);
+
+  result->srid = hdr->srid;
+
+  coords = ST_COORDS(result);
+
+  times = ST_TIMES(result);
+
+  if(i0 >= 0 && view.times[i0] < lower && i0 + 1 < view.npoints)
+  {
+    interpolate(view.coords + i0 * ndims, view.coords + (i0 + 1) * ndims,
+                view.times[i0], view.times[i0 + 1], lower, ndims, coords);
+
+    times[result->npoints++] = lower;
+  }
+
+  if(i1 >= first)
+  {
+    memcpy(coords + result->npoints * ndims, view.coords + first * ndims,
+           (i1 - first + 1) * ndims * sizeof(double));
+
+    memcpy(times + result->npoints, view.times + first, (i1 - first + 1) * sizeof(Timestamp));
+
+    result->npoints += i1 - first + 1;
+  }
+
+  if(i1 >= 0 && view.times[i1] < upper && i1 + 1 < view.npoints &&
+     (result->npoints == 0 || times[result->npoints - 1] < upper))
+  {
+    interpolate(view.coords + i1 * ndims, view.coords + (i1 + 1) * ndims,
+                view.times[i1], view.times[i1 + 1], upper, ndims, coords + result->npoints * ndims);
+
+    times[result->npoints++] = upper;
+  }
+
+  if(result->npoints > 0)
+  {
+    result->start_time = times[0];
+    result->end_time = times[result->npoints - 1];
+
+    ops->extent(coords, result->npoints, &result->extent);
+  }
+
+  PG_RETURN_SPATIOTEMPORAL_P(result);
+}
@@ -0,0 +1,490 @@
+/*
+  Copyright (C) 2017 National Institute For Space Research (INPE) - Brazil.
+
+  postgis-t is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License version 3 as
+  published by the Free Software Foundation.
+
+  postgis-t is distributed  "AS-IS" in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY OF ANY KIND; without even the implied warranty
+  of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with postgis-t. See LICENSE. If not, write to
+  Gilberto Ribeiro de Queiroz at <gribeiro@dpi.inpe.br>.
+
+ */
+
+/*!
+ *
+ * \file postgist/compare.c
+ *
+ * \brief B-tree and hash support for spatiotemporal.
+ *
+ * Values are ordered by start time, end time and finally by their payload
+ * (SRID, flags, number of instants, coordinates and times). The start time
+ * is the abbreviated key of sorts, CLUSTER and index builds, read from the
+ * header alone.
+ *
+ * Only the instants in use take part in the comparison, so the spare
+ * capacity left by st_append_instant does not make equal values differ.
+ * Coordinates are compared as numbers, with -0.0 equal to 0.0 and every NaN
+ * equal to every other NaN and greater than any number; the hash functions
+ * see the same canonical bits, so equal values always hash alike.
+ *
+ * \author Gilberto Ribeiro de Queiroz
+ * \author Fabiana Zioti
+ *
+ * \date 2017
+ *
+ * \copyright GNU Lesser Public License version 3
+ *
+ */
+
+/* PostGIS-T extension */
+#include "spatiotemporal.h"
+
+/* PostgreSQL */
+#if PG_VERSION_NUM >= 130000
+#include <common/hashfn.h>
+#else
+#include <access/hash.h>
+#endif
+#include <lib/hyperloglog.h>
+#include <utils/sortsupport.h>
+
+/* C Standard Library */
+#include <math.h>
+#include <string.h>
+
+
+/* 64-bit primes from xxHash */
+#define XXH_PRIME64_1 UINT64CONST(0x9E3779B185EBCA87)
+#define XXH_PRIME64_2 UINT64CONST(0xC2B2AE3D27D4EB4F)
+#define XXH_PRIME64_3 UINT64CONST(0x165667B19E3779F9)
+#define XXH_PRIME64_4 UINT64CONST(0x85EBCA77C2B2AE63)
+#define XXH_PRIME64_5 UINT64CONST(0x27D4EB2F165667C5)
+
+
+static inline uint64 rotl64(uint64 x, int r)
+{
+  return (x << r) | (x >> (64 - r));
+}
+
+
+static inline uint64 xxh_round(uint64 acc, uint64 w)
+{
+  acc += w * XXH_PRIME64_2;
+  acc = rotl64(acc, 31);
+  return acc * XXH_PRIME64_1;
+}
+
+
+/*
+ * \brief Mix 'nwords' 8-byte words into 'h'.
+ *
+ * \note The payload is made of doubles and timestamps, so it is always a
+ *       whole number of 8-byte words.
+ *
+ */
+static inline uint64 xxh_words(uint64 h, const uint64 *words, size_t nwords)
+{
+  for(size_t i = 0; i < nwords; ++i)
+  {
+    h ^= xxh_round(0, words[i]);
+    h = rotl64(h, 27) * XXH_PRIME64_1 + XXH_PRIME64_4;
+  }
+
+  return h;
+}
+
+
+static inline uint64 xxh_avalanche(uint64 h)
+{
+  h ^= h >> 33;
+  h *= XXH_PRIME64_2;
+  h ^= h >> 29;
+  h *= XXH_PRIME64_3;
+  h ^= h >> 32;
+
+  return h;
+}
+
+
+/*
+ * \brief Bits of 'd' with a single form for zero and for NaN, so that
+ *        values equal for the comparison hash the same.
+ *
+ */
+static inline uint64 double_canonical_bits(double d)
+{
+  uint64 u;
+
+  if(d == 0.0)
+    d = 0.0;
+  else if(isnan(d))
+    d = NAN;
+
+  memcpy(&u, &d, sizeof(uint64));
+
+  return u;
+}
+
+
+/* order of two coordinates: -0.0 equals 0.0 and NaNs are equal and last */
+static inline int double_cmp(double a, double b)
+{
+  if(isnan(a) || isnan(b))
+  {
+    if(isnan(a) && isnan(b))
+      return 0;
+
+    return isnan(a) ? 1 : -1;
+  }
+
+  if(a != b)
+    return a < b ? -1 : 1;
+
+  return 0;
+}
+
+
+static uint64 spatiotemporal_hash64(const struct spatiotemporal *st, uint64 seed)
+{
+  uint64 head[4];
+
+  uint64 h = seed + XXH_PRIME64_5;
+
+  head[0] = (uint64) st->start_time;
+  head[1] = (uint64) st->end_time;
+  head[2] = ((uint64) (uint32) st->srid << 32) | (uint32) st->flags;
+  head[3] = (uint64) st->npoints;
+
+  h = xxh_words(h, head, 4);
+
+  for(int32 i = 0; i < st->npoints * ST_NDIMS(st); ++i)
+  {
+    uint64 w = double_canonical_bits(ST_COORDS(st)[i]);
+
+    h = xxh_words(h, &w, 1);
+  }
+
+  h = xxh_words(h, (const uint64*) ST_TIMES(st), (size_t) st->npoints);
+
+  return xxh_avalanche(h);
+}
+
+
+int spatiotemporal_cmp_internal(const struct spatiotemporal *a, const struct spatiotemporal *b)
+{
+  int r;
+
+  if(a->start_time != b->start_time)
+    return a->start_time < b->start_time ? -1 : 1;
+
+  if(a->end_time != b->end_time)
+    return a->end_time < b->end_time ? -1 : 1;
+
+  if(a->srid != b->srid)
+    return a->srid < b->srid ? -1 : 1;
+
+  if(a->flags != b->flags)
+    return a->flags < b->flags ? -1 : 1;
+
+  if(a->npoints != b->npoints)
+    return a->npoints < b->npoints ? -1 : 1;
+
+  for(int32 i = 0; i < a->npoints * ST_NDIMS(a); ++i)
+  {
+    r = double_cmp(ST_COORDS(a)[i], ST_COORDS(b)[i]);
+
+    if(r != 0)
+      return r;
+  }
+
+  return memcmp(ST_TIMES(a), ST_TIMES(b), (size_t) a->npoints * sizeof(Timestamp));
+}
+
+
+static int spatiotemporal_cmp_args(FunctionCallInfo fcinfo)
+{
+  struct spatiotemporal *a = PG_GETARG_SPATIOTEMPORAL_P(0);
+
+  struct spatiotemporal *b = PG_GETARG_SPATIOTEMPORAL_P(1);
+
+  int r = spatiotemporal_cmp_internal(a, b);
+
+  PG_FREE_IF_COPY(a, 0);
+  PG_FREE_IF_COPY(b, 1);
+
+  return r;
+}
+
+
+PG_FUNCTION_INFO_V1(spatiotemporal_cmp);
+
+Datum
+spatiotemporal_cmp(PG_FUNCTION_ARGS)
+{
+  PG_RETURN_INT32(spatiotemporal_cmp_args(fcinfo));
+}
+
+
+PG_FUNCTION_INFO_V1(spatiotemporal_eq);
+
+Datum
+spatiotemporal_eq(PG_FUNCTION_ARGS)
+{
+  PG_RETURN_BOOL(spatiotemporal_cmp_args(fcinfo) == 0);
+}
+
+
+PG_FUNCTION_INFO_V1(spatiotemporal_ne);
+
+Datum
+spatiotemporal_ne(PG_FUNCTION_ARGS)
+{
+  PG_RETURN_BOOL(spatiotemporal_cmp_args(fcinfo) != 0);
+}
+
+
+PG_FUNCTION_INFO_V1(spatiotemporal_lt);
+
+Datum
+spatiotemporal_lt(PG_FUNCTION_ARGS)
+{
+  PG_RETURN_BOOL(spatiotemporal_cmp_args(fcinfo) < 0);
+}
+
+
+PG_FUNCTION_INFO_V1(spatiotemporal_le);
+
+Datum
+spatiotemporal_le(PG_FUNCTION_ARGS)
+{
+  PG_RETURN_BOOL(spatiotemporal_cmp_args(fcinfo) <= 0);
+}
+
+
+PG_FUNCTION_INFO_V1(spatiotemporal_gt);
+
+Datum
+spatiotemporal_gt(PG_FUNCTION_ARGS)
+{
+  PG_RETURN_BOOL(spatiotemporal_cmp_args(fcinfo) > 0);
+}
+
+
+PG_FUNCTION_INFO_V1(spatiotemporal_ge);
+
+Datum
+spatiotemporal_ge(PG_FUNCTION_ARGS)
+{
+  PG_RETURN_BOOL(spatiotemporal_cmp_args(fcinfo) >= 0);
+}
+
+
+PG_FUNCTION_INFO_V1(spatiotemporal_hash);
+
+Datum
+spatiotemporal_hash(PG_FUNCTION_ARGS)
+{
+  struct spatiotemporal *st = PG_GETARG_SPATIOTEMPORAL_P(0);
+
+  uint64 h = spatiotemporal_hash64(st, 0);
+
+  PG_FREE_IF_COPY(st, 0);
+
+  PG_RETURN_INT32((int32) (h ^ (h >> 32)));
+}
+
+
+PG_FUNCTION_INFO_V1(spatiotemporal_hash_extended);
+
+Datum
+spatiotemporal_hash_extended(PG_FUNCTION_ARGS)
+{
+  struct spatiotemporal *st = PG_GETARG_SPATIOTEMPORAL_P(0);
+
+  uint64 h = spatiotemporal_hash64(st, (uint64) PG_GETARG_INT64(1));
+
+  PG_FREE_IF_COPY(st, 0);
+
+  PG_RETURN_INT64((int64) h);
+}
+
+
+PG_FUNCTION_INFO_V1(spatiotemporal_normalize);
+
+Datum
+spatiotemporal_normalize(PG_FUNCTION_ARGS)
+{
+  struct spatiotemporal *st = PG_GETARG_SPATIOTEMPORAL_P(0);
+
+  int ndims = ST_NDIMS(st);
+
+  int32 n = st->npoints * ndims;
+
+  struct spatiotemporal *result = spatiotemporal_alloc(st->npoints, st->flags);
+
+  double *coords = ST_COORDS(result);
+
+  /* copy the header, then fix the fields that depend on the capacity */
+  memcpy(result, st, ST_HEADER_SIZE);
+
+  SET_VARSIZE(result, ST_SIZE(st->npoints, ndims));
+
+  result->capacity = st->npoints;
+
+  result->nchunks = 0;
+
+  memcpy(coords, ST_COORDS(st), n * sizeof(double));
+
+  memcpy(ST_TIMES(result), ST_TIMES(st), st->npoints * sizeof(Timestamp));
+
+  /* a single binary form for zero and for NaN, as the comparison sees them */
+  for(int32 i = 0; i < n; ++i)
+  {
+    if(coords[i] == 0.0)
+      coords[i] = 0.0;
+    else if(isnan(coords[i]))
+      coords[i] = NAN;
+  }
+
+  PG_RETURN_SPATIOTEMPORAL_P(result);
+}
+
+
+/*
+ * Sort support
+ */
+
+struct spatiotemporal_sortsupport_state
+{
+  hyperLogLogState abbr_card;   /* cardinality of the abbreviated keys */
+  int64 input_count;            /* number of abbreviated keys built */
+};
+
+
+static int spatiotemporal_fastcmp(Datum x, Datum y, SortSupport ssup)
+{
+  /* detoasted copies and flattened chunked values are both freed */
+  struct spatiotemporal *da = (struct spatiotemporal*) PG_DETOAST_DATUM(x);
+
+  struct spatiotemporal *db = (struct spatiotemporal*) PG_DETOAST_DATUM(y);
+
+  struct spatiotemporal *a = spatiotemporal_flatten(da);
+
+  struct spatiotemporal *b = spatiotemporal_flatten(db);
+
+  int r = spatiotemporal_cmp_internal(a, b);
+
+  if(a != da)
+    pfree(a);
+
+  if(b != db)
+    pfree(b);
+
+  if((Pointer) da != DatumGetPointer(x))
+    pfree(da);
+
+  if((Pointer) db != DatumGetPointer(y))
+    pfree(db);
+
+  return r;
+}
+
+
+static int spatiotemporal_abbrev_cmp(Datum x, Datum y, SortSupport ssup)
+{
+  uint64 a = (uint64) DatumGetInt64(x);
+  uint64 b = (uint64) DatumGetInt64(y);
+
+  return (a < b) ? -1 : ((a > b) ? 1 : 0);
+}
+
+
+/*
+ * \brief Abbreviated key: the start time, with its sign bit flipped so that
+ *        the unsigned order of the keys is the order of the times.
+ *
+ * \note Only the header is fetched, so the arrays are never detoasted here.
+ *
+ */
+static Datum spatiotemporal_abbrev_convert(Datum original, SortSupport ssup)
+{
+  struct spatiotemporal_sortsupport_state *state = (struct spatiotemporal_sortsupport_state*) ssup->ssup_extra;
+
+  struct spatiotemporal *st = DatumGetSpatioTemporalHeader(original);
+
+  uint64 key = (uint64) st->start_time ^ (UINT64CONST(1) << 63);
+
+  uint32 h = (uint32) (key ^ (key >> 32));
+
+  addHyperLogLog(&state->abbr_card, DatumGetUInt32(hash_uint32(h)));
+
+  ++state->input_count;
+
+  pfree(st);
+
+  return Int64GetDatum((int64) key);
+}
+
+
+/*
+ * \brief Give up abbreviation when the keys are mostly duplicates.
+ *
+ */
+static bool spatiotemporal_abbrev_abort(int memtupcount, SortSupport ssup)
+{
+  struct spatiotemporal_sortsupport_state *state = (struct spatiotemporal_sortsupport_state*) ssup->ssup_extra;
+
+  double abbr_card;
+
+  if(memtupcount < 10000 || state->input_count < 10000)
+    return false;
+
+  abbr_card = estimateHyperLogLog(&state->abbr_card);
+
+  /* same threshold as the text and numeric abbreviations */
+  if(abbr_card < state->input_count / 10000.0 + 0.5)
+    return true;
+
+  return false;
+}
+
+
+PG_FUNCTION_INFO_V1(spatiotemporal_sortsupport);
+
+Datum
+spatiotemporal_sortsupport(PG_FUNCTION_ARGS)
+{
+  SortSupport ssup = (SortSupport) PG_GETARG_POINTER(0);
+
+  ssup->comparator = spatiotemporal_fastcmp;
+
+#if SIZEOF_DATUM >= 8
+  if(ssup->abbreviate)
+  {
+    MemoryContext oldcontext = MemoryContextSwitchTo(ssup->ssup_cxt);
+
+    struct spatiotemporal_sortsupport_state *state = palloc(sizeof(struct spatiotemporal_sortsupport_state));
+
+    initHyperLogLog(&state->abbr_card, 10);
+
+    state->input_count = 0;
+
+    ssup->ssup_extra = state;
+
+    ssup->abbrev_converter = spatiotemporal_abbrev_convert;
+    ssup->abbrev_abort = spatiotemporal_abbrev_abort;
+    ssup->abbrev_full_comparator = spatiotemporal_fastcmp;
+    ssup->comparator = spatiotemporal_abbrev_cmp;
+
+    MemoryContextSwitchTo(oldcontext);
+  }
+#endif
+
+  PG_RETURN_VOID();
+}
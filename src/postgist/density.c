@@ -0,0 +1,454 @@
+/*
+  Copyright (C) 2017 National Institute For Space Research (INPE) - Brazil.
+
+  postgis-t is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License version 3 as
+  published by the Free Software Foundation.
+
+  postgis-t is distributed  "AS-IS" in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY OF ANY KIND; without even the implied warranty
+  of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with postgis-t. See LICENSE. If not, write to
+  Gilberto Ribeiro de Queiroz at <gribeiro@dpi.inpe.br>.
+
+ */
+/*!
+ *
+ * \file postgist/density.c
+ *
+ * \brief Space-time density grid aggregate: the time each trajectory spends
+ *        in every cell of a regular grid, per time bucket.
+ *
+ * Segments are walked cell by cell with a grid traversal (Amanatides-Woo
+ * DDA) over the coordinate array. Positions are linear in time along a
+ * segment, so the time spent in a cell is the fraction of the segment inside
+ * it times the segment duration, split over the time buckets it spans.
+ *
+ * The state is a flat array of nt * ny * nx dwell times, in seconds. Partial
+ * grids built by parallel workers are merged by element-wise addition.
+ *
+ * \author Gilberto Ribeiro de Queiroz
+ * \author Fabiana Zioti
+ *
+ * \date 2017
+ *
+ * \copyright GNU Lesser Public License version 3
+ *
+ */
+
+/* PostGIS-T extension */
+#include "spatiotemporal.h"
+
+/* PostgreSQL */
+#include <catalog/pg_type.h>
+#include <utils/array.h>
+#include <utils/datetime.h>
+
+/* C Standard Library */
+#include <float.h>
+#include <math.h>
+#include <string.h>
+
+
+struct density_grid
+{
+  double xmin;
+  double ymin;
+  double xmax;
+  double ymax;
+  int32 nx;
+  int32 ny;
+  int32 nt;
+  int32 srid;           /* SRID of the extent */
+  Timestamp start;      /* Lower bound of the period */
+  Timestamp end;        /* Upper bound of the period, exclusive */
+  int64 bucket;         /* Width of a time bucket, in microseconds */
+  double cells[FLEXIBLE_ARRAY_MEMBER];
+};
+
+#define DENSITY_GRID_HEADER_SIZE offsetof(struct density_grid, cells)
+#define DENSITY_GRID_SIZE(g) \
+  (DENSITY_GRID_HEADER_SIZE + (Size) (g)->nx * (g)->ny * (g)->nt * sizeof(double))
+
+
+static int64 interval_to_usecs(const Interval *span)
+{
+  return span->time + (int64) span->day * USECS_PER_DAY +
+         (int64) span->month * DAYS_PER_MONTH * USECS_PER_DAY;
+}
+
+
+static struct density_grid *density_grid_create(MemoryContext mcxt, FunctionCallInfo fcinfo)
+{
+  GBOX gbox;
+
+  int32 nx = PG_GETARG_INT32(4);
+
+  int32 ny = PG_GETARG_INT32(5);
+
+  int64 bucket = interval_to_usecs(PG_GETARG_INTERVAL_P(6));
+
+  Timestamp lower, upper;
+
+  int64 nt;
+
+  GSERIALIZED *extent = PG_GETARG_GSERIALIZED_P(2);
+
+  struct density_grid *g;
+
+  if(gserialized_get_gbox_p(extent, &gbox) == LW_FAILURE ||
+     gbox.xmax <= gbox.xmin || gbox.ymax <= gbox.ymin)
+    ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                    errmsg("density grid extent must be a non-empty area")));
+
+  if(!st_period_from_range(PG_GETARG_DATUM(3), &lower, &upper) ||
+     TIMESTAMP_NOT_FINITE(lower) || TIMESTAMP_NOT_FINITE(upper))
+    ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                    errmsg("density grid period must be non-empty and bounded")));
+
+  if(nx <= 0 || ny <= 0)
+    ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                    errmsg("density grid must have at least one column and one row")));
+
+  if(bucket <= 0)
+    ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                    errmsg("density grid time bucket must be positive")));
+
+  /* ceil((upper - lower + 1) / bucket): the last bucket may be partial */
+  nt = (upper - lower + bucket) / bucket;
+
+  if((double) nx * ny * nt > (double) (MaxAllocSize - DENSITY_GRID_HEADER_SIZE) / sizeof(double))
+    ereport(ERROR, (errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
+                    errmsg("density grid of %d x %d cells and " INT64_FORMAT " time buckets is too large",
+                           nx, ny, nt)));
+
+  g = (struct density_grid*) MemoryContextAllocZero(mcxt, DENSITY_GRID_HEADER_SIZE +
+                                                    (Size) nx * ny * nt * sizeof(double));
+
+  g->xmin = gbox.xmin;
+  g->ymin = gbox.ymin;
+  g->xmax = gbox.xmax;
+  g->ymax = gbox.ymax;
+  g->nx = nx;
+  g->ny = ny;
+  g->nt = (int32) nt;
+  g->srid = gserialized_get_srid(extent);
+  g->start = lower;
+  g->end = upper + 1;
+  g->bucket = bucket;
+
+  return g;
+}
+
+
+/*
+ * \brief Add the time spent in cell (cx, cy) between the times ta and tb,
+ *        in microseconds from the start of the grid, to its time buckets.
+ *
+ */
+static void density_grid_add(struct density_grid *g, int32 cx, int32 cy, double ta, double tb)
+{
+  double width = (double) g->bucket;
+
+  int32 first = (int32) Max(floor(ta / width), 0);
+
+  int32 last = (int32) Min(floor(tb / width), g->nt - 1);
+
+  for(int32 k = first; k <= last; ++k)
+  {
+    double lo = Max(ta, k * width);
+
+    double hi = Min(tb, (k + 1) * width);
+
+    if(hi > lo)
+      g->cells[((Size) k * g->ny + cy) * g->nx + cx] += (hi - lo) / USECS_PER_SEC;
+  }
+}
+
+
+/*
+ * \brief Clip the segment p0 + u (p1 - p0), u in [*u0, *u1], to the grid
+ *        extent (Liang-Barsky). Returns false if nothing is left.
+ *
+ */
+static bool clip_segment(const struct density_grid *g, double x0, double y0, double dx, double dy,
+                         double *u0, double *u1)
+{
+  double p[4] = { -dx, dx, -dy, dy };
+
+  double q[4] = { x0 - g->xmin, g->xmax - x0, y0 - g->ymin, g->ymax - y0 };
+
+  for(int i = 0; i < 4; ++i)
+  {
+    if(p[i] == 0.0)
+    {
+      if(q[i] < 0.0)
+        return false;
+
+      continue;
+    }
+
+    if(p[i] < 0.0)
+      *u0 = Max(*u0, q[i] / p[i]);
+    else
+      *u1 = Min(*u1, q[i] / p[i]);
+  }
+
+  return *u0 < *u1;
+}
+
+
+static void density_grid_rasterize(struct density_grid *g, const struct spatiotemporal *st)
+{
+  int ndims = ST_NDIMS(st);
+
+  const double *coords = ST_COORDS(st);
+
+  const Timestamp *times = ST_TIMES(st);
+
+  double cw = (g->xmax - g->xmin) / g->nx;
+
+  double ch = (g->ymax - g->ymin) / g->ny;
+
+  /* the last bucket may extend past the period: it is clipped as well */
+  double period = (double) (g->end - g->start);
+
+  for(int32 i = 1; i < st->npoints; ++i)
+  {
+    double x0 = coords[(i - 1) * ndims];
+    double y0 = coords[(i - 1) * ndims + 1];
+    double dx = coords[i * ndims] - x0;
+    double dy = coords[i * ndims + 1] - y0;
+
+    /* times relative to the start of the grid */
+    double t0 = (double) (times[i - 1] - g->start);
+    double dt = (double) (times[i] - times[i - 1]);
+
+    double u0 = 0.0, u1 = 1.0;
+
+    double u, t_max_x, t_max_y, t_delta_x, t_delta_y;
+
+    int32 cx, cy, step_x, step_y;
+
+    /* restrict to the period first, it is the cheaper test */
+    if(t0 + dt <= 0.0 || t0 >= period)
+      continue;
+
+    u0 = Max(u0, -t0 / dt);
+    u1 = Min(u1, (period - t0) / dt);
+
+    if(!clip_segment(g, x0, y0, dx, dy, &u0, &u1))
+      continue;
+
+    u = u0;
+
+    cx = (int32) floor((x0 + dx * u - g->xmin) / cw);
+    cy = (int32) floor((y0 + dy * u - g->ymin) / ch);
+
+    cx = Min(Max(cx, 0), g->nx - 1);
+    cy = Min(Max(cy, 0), g->ny - 1);
+
+    step_x = (dx > 0.0) ? 1 : -1;
+    step_y = (dy > 0.0) ? 1 : -1;
+
+    /* parameter of the next cell boundary on each axis, and between boundaries */
+    t_max_x = (dx != 0.0) ? (g->xmin + (cx + (dx > 0.0)) * cw - x0) / dx : DBL_MAX;
+    t_max_y = (dy != 0.0) ? (g->ymin + (cy + (dy > 0.0)) * ch - y0) / dy : DBL_MAX;
+
+    t_delta_x = (dx != 0.0) ? cw / fabs(dx) : DBL_MAX;
+    t_delta_y = (dy != 0.0) ? ch / fabs(dy) : DBL_MAX;
+
+    for(;;)
+    {
+      double next = Min(Min(t_max_x, t_max_y), u1);
+
+      if(next > u)
+        density_grid_add(g, cx, cy, t0 + u * dt, t0 + next * dt);
+
+      if(next >= u1)
+        break;
+
+      u = next;
+
+      if(t_max_x < t_max_y)
+      {
+        cx += step_x;
+        t_max_x += t_delta_x;
+      }
+      else
+      {
+        cy += step_y;
+        t_max_y += t_delta_y;
+      }
+
+      /* rounding may step out of the grid at the very end of the segment */
+      if(cx < 0 || cx >= g->nx || cy < 0 || cy >= g->ny)
+        break;
+    }
+  }
+}
+
+
+PG_FUNCTION_INFO_V1(spatiotemporal_density_grid_transfn);
+
+Datum
+spatiotemporal_density_grid_transfn(PG_FUNCTION_ARGS)
+{
+  MemoryContext agg_context;
+
+  struct density_grid *g;
+
+  if(!AggCheckCallContext(fcinfo, &agg_context))
+    elog(ERROR, "spatiotemporal_density_grid_transfn called in non-aggregate context");
+
+  for(int i = 2; i <= 6; ++i)
+    if(PG_ARGISNULL(i))
+      ereport(ERROR, (errcode(ERRCODE_NULL_VALUE_NOT_ALLOWED),
+                      errmsg("density grid parameters can not be NULL")));
+
+  g = PG_ARGISNULL(0) ? density_grid_create(agg_context, fcinfo)
+                      : (struct density_grid*) PG_GETARG_POINTER(0);
+
+  if(!PG_ARGISNULL(1))
+  {
+    struct spatiotemporal *st = PG_GETARG_SPATIOTEMPORAL_P(1);
+
+    if(st->srid != g->srid)
+      ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                      errmsg("spatiotemporal SRID (%d) does not match density grid extent SRID (%d)",
+                             st->srid, g->srid)));
+
+    density_grid_rasterize(g, st);
+  }
+
+  PG_RETURN_POINTER(g);
+}
+
+
+PG_FUNCTION_INFO_V1(spatiotemporal_density_grid_combinefn);
+
+Datum
+spatiotemporal_density_grid_combinefn(PG_FUNCTION_ARGS)
+{
+  MemoryContext agg_context;
+
+  struct density_grid *a;
+
+  struct density_grid *b;
+
+  Size ncells;
+
+  if(!AggCheckCallContext(fcinfo, &agg_context))
+    elog(ERROR, "spatiotemporal_density_grid_combinefn called in non-aggregate context");
+
+  if(PG_ARGISNULL(1))
+    PG_RETURN_DATUM(PG_GETARG_DATUM(0));
+
+  b = (struct density_grid*) PG_GETARG_POINTER(1);
+
+  if(PG_ARGISNULL(0))
+  {
+    a = (struct density_grid*) MemoryContextAlloc(agg_context, DENSITY_GRID_SIZE(b));
+
+    memcpy(a, b, DENSITY_GRID_SIZE(b));
+
+    PG_RETURN_POINTER(a);
+  }
+
+  a = (struct density_grid*) PG_GETARG_POINTER(0);
+
+  if(memcmp(a, b, DENSITY_GRID_HEADER_SIZE) != 0)
+    ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                    errmsg("density grids with different extents, sizes or periods can not be merged")));
+
+  ncells = (Size) a->nx * a->ny * a->nt;
+
+  for(Size i = 0; i < ncells; ++i)
+    a->cells[i] += b->cells[i];
+
+  PG_RETURN_POINTER(a);
+}
+
+
+PG_FUNCTION_INFO_V1(spatiotemporal_density_grid_serialfn);
+
+Datum
+spatiotemporal_density_grid_serialfn(PG_FUNCTION_ARGS)
+{
+  struct density_grid *g = (struct density_grid*) PG_GETARG_POINTER(0);
+
+  Size size = DENSITY_GRID_SIZE(g);
+
+  bytea *result = (bytea*) palloc(VARHDRSZ + size);
+
+  SET_VARSIZE(result, VARHDRSZ + size);
+
+  memcpy(VARDATA(result), g, size);
+
+  PG_RETURN_BYTEA_P(result);
+}
+
+
+PG_FUNCTION_INFO_V1(spatiotemporal_density_grid_deserialfn);
+
+Datum
+spatiotemporal_density_grid_deserialfn(PG_FUNCTION_ARGS)
+{
+  bytea *data = PG_GETARG_BYTEA_PP(0);
+
+  Size size = VARSIZE_ANY_EXHDR(data);
+
+  /* the payload may be unaligned, so the state is copied before use */
+  struct density_grid *g = (struct density_grid*) palloc(Max(size, DENSITY_GRID_HEADER_SIZE));
+
+  memcpy(g, VARDATA_ANY(data), size);
+
+  if(size < DENSITY_GRID_HEADER_SIZE || size != DENSITY_GRID_SIZE(g))
+    elog(ERROR, "invalid serialized density grid");
+
+  PG_RETURN_POINTER(g);
+}
+
+
+/*
+ * \brief Return the grid as a float8[nt][ny][nx] array of dwell times in
+ *        seconds; rows go from ymin to ymax.
+ *
+ */
+PG_FUNCTION_INFO_V1(spatiotemporal_density_grid_finalfn);
+
+Datum
+spatiotemporal_density_grid_finalfn(PG_FUNCTION_ARGS)
+{
+  struct density_grid *g;
+
+  Size ncells;
+
+  Datum *elems;
+
+  int dims[3];
+
+  int lbs[3] = { 1, 1, 1 };
+
+  if(PG_ARGISNULL(0))
+    PG_RETURN_NULL();
+
+  g = (struct density_grid*) PG_GETARG_POINTER(0);
+
+  ncells = (Size) g->nx * g->ny * g->nt;
+
+  elems = (Datum*) palloc(ncells * sizeof(Datum));
+
+  for(Size i = 0; i < ncells; ++i)
+    elems[i] = Float8GetDatum(g->cells[i]);
+
+  dims[0] = g->nt;
+  dims[1] = g->ny;
+  dims[2] = g->nx;
+
+  PG_RETURN_ARRAYTYPE_P(construct_md_array(elems, NULL, 3, dims, lbs, FLOAT8OID,
+                                           sizeof(float8), FLOAT8PASSBYVAL, 'd'));
+}
@@ -0,0 +1,138 @@
+/*
+  Copyright (C) 2017 National Institute For Space Research (INPE) - Brazil.
+
+  postgis-t is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License version 3 as
+  published by the Free Software Foundation.
+
+  postgis-t is distributed  "AS-IS" in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY OF ANY KIND; without even the implied warranty
+  of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with postgis-t. See LICENSE. If not, write to
+  Gilberto Ribeiro de Queiroz at <gribeiro@dpi.inpe.br>.
+
+ */
+
+/*!
+ *
+ * \file postgist/dims.c
+ *
+ * \brief Dimension-specialized coordinate kernels (XY, XYZ, XYM and XYZM).
+ *
+ * \author Gilberto Ribeiro de Queiroz
+ * \author Fabiana Zioti
+ *
+ * \date 2017
+ *
+ * \copyright GNU Lesser Public License version 3
+ *
+ */
+
+/* PostGIS-T extension */
+#include "dims.h"
+
+
+/* XY */
+
+static void encode_2d(double *dst, const POINT4D *p)
+{
+  dst[0] = p->x;
+  dst[1] = p->y;
+}
+
+static void decode_2d(const double *src, POINT4D *p)
+{
+  p->x = src[0];
+  p->y = src[1];
+  p->z = 0.0;
+  p->m = 0.0;
+}
+
+
+/* XYZ */
+
+static void encode_3dz(double *dst, const POINT4D *p)
+{
+  dst[0] = p->x;
+  dst[1] = p->y;
+  dst[2] = p->z;
+}
+
+static void decode_3dz(const double *src, POINT4D *p)
+{
+  p->x = src[0];
+  p->y = src[1];
+  p->z = src[2];
+  p->m = 0.0;
+}
+
+
+/* XYM */
+
+static void encode_3dm(double *dst, const POINT4D *p)
+{
+  dst[0] = p->x;
+  dst[1] = p->y;
+  dst[2] = p->m;
+}
+
+static void decode_3dm(const double *src, POINT4D *p)
+{
+  p->x = src[0];
+  p->y = src[1];
+  p->z = 0.0;
+  p->m = src[2];
+}
+
+
+/* XYZM */
+
+static void encode_4d(double *dst, const POINT4D *p)
+{
+  dst[0] = p->x;
+  dst[1] = p->y;
+  dst[2] = p->z;
+  dst[3] = p->m;
+}
+
+static void decode_4d(const double *src, POINT4D *p)
+{
+  p->x = src[0];
+  p->y = src[1];
+  p->z = src[2];
+  p->m = src[3];
+}
+
+
+/*
+ * The extent only covers x and y, so the variants differ only by the
+ * stride between two consecutive positions.
+ */
+#define ST_DEFINE_EXTENT(name, stride) \
+static void name(const double *coords, int32 npoints, struct st_extent *e) \
+{ \
+  for(int32 i = 0; i < npoints; ++i) \
+    st_extent_expand(e, coords[i * (stride)], coords[i * (stride) + 1]); \
+}
+
+ST_DEFINE_EXTENT(extent_2d, 2)
+ST_DEFINE_EXTENT(extent_3d, 3)
+ST_DEFINE_EXTENT(extent_4d, 4)
+
+
+static const struct st_dims_ops dims_ops[4] =
+{
+  { 2, encode_2d, decode_2d, extent_2d },                  /* XY   */
+  { 3, encode_3dz, decode_3dz, extent_3d },                /* XYZ  */
+  { 3, encode_3dm, decode_3dm, extent_3d },                /* XYM  */
+  { 4, encode_4d, decode_4d, extent_4d }                   /* XYZM */
+};
+
+
+const struct st_dims_ops *st_dims_ops_get(int32 flags)
+{
+  return &dims_ops[flags & (ST_FLAG_Z | ST_FLAG_M)];
+}
@@ -0,0 +1,81 @@
+/*
+  Copyright (C) 2017 National Institute For Space Research (INPE) - Brazil.
+
+  postgis-t is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License version 3 as
+  published by the Free Software Foundation.
+
+  postgis-t is distributed  "AS-IS" in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY OF ANY KIND; without even the implied warranty
+  of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with postgis-t. See LICENSE. If not, write to
+  Gilberto Ribeiro de Queiroz at <gribeiro@dpi.inpe.br>.
+
+ */
+
+/*!
+ *
+ * \file postgist/dims.h
+ *
+ * \brief Dimension-specialized coordinate kernels (XY, XYZ, XYM and XYZM).
+ *
+ * \author Gilberto Ribeiro de Queiroz
+ * \author Fabiana Zioti
+ *
+ * \date 2017
+ *
+ * \copyright GNU Lesser Public License version 3
+ *
+ */
+
+#ifndef __POSTGIST_DIMS_H__
+#define __POSTGIST_DIMS_H__
+
+/* PostGIS-T extension */
+#include "spatiotemporal.h"
+
+
+/*
+ * \brief Coordinate kernels for one dimensionality.
+ *
+ * \note Each variant is compiled with a constant stride, so callers should
+ *       pick the table once per value with st_dims_ops_get() and not test
+ *       the Z/M flags for every vertex.
+ *
+ */
+struct st_dims_ops
+{
+  int ndims;
+
+  /* write the point 'p' into the coordinate slot 'dst' */
+  void (*encode)(double *dst, const POINT4D *p);
+
+  /* read the coordinate slot 'src' into 'p' (missing ordinates are zero) */
+  void (*decode)(const double *src, POINT4D *p);
+
+  /* grow 'e' to include the first 'npoints' positions of 'coords' */
+  void (*extent)(const double *coords, int32 npoints, struct st_extent *e);
+};
+
+
+/*
+ * \brief Return the kernels for the dimensionality in the layout 'flags'.
+ *
+ */
+const struct st_dims_ops *st_dims_ops_get(int32 flags);
+
+
+/*
+ * \brief Convert PostGIS geometry flags to spatiotemporal layout flags.
+ *
+ */
+static inline int32
+st_flags_from_lwflags(uint8_t lwflags)
+{
+  return (FLAGS_GET_Z(lwflags) ? ST_FLAG_Z : 0) | (FLAGS_GET_M(lwflags) ? ST_FLAG_M : 0);
+}
+
+#endif  /* __POSTGIST_DIMS_H__ */
@@ -0,0 +1,743 @@
+/*
+  Copyright (C) 2017 National Institute For Space Research (INPE) - Brazil.
+
+  postgis-t is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License version 3 as
+  published by the Free Software Foundation.
+
+  postgis-t is distributed  "AS-IS" in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY OF ANY KIND; without even the implied warranty
+  of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with postgis-t. See LICENSE. If not, write to
+  Gilberto Ribeiro de Queiroz at <gribeiro@dpi.inpe.br>.
+
+ */
+
+/*!
+ *
+ * \file postgist/estimate.c
+ *
+ * \brief Planner statistics and selectivity estimators for spatiotemporal.
+ *
+ * ANALYZE keeps one equi-depth histogram for each side of the space-time
+ * extent of the sampled values: xmin, xmax, ymin, ymax, start and end time.
+ * Two intervals [s1, e1] and [s2, e2] overlap unless s1 > e2 or e1 < s2, and
+ * these two events are disjoint, so the histograms give the overlap
+ * probability along each axis directly. The axes are combined assuming
+ * independence. A join with a geometry column uses the 2D histogram that
+ * PostGIS keeps for it.
+ *
+ * \author Gilberto Ribeiro de Queiroz
+ * \author Fabiana Zioti
+ *
+ * \date 2017
+ *
+ * \copyright GNU Lesser Public License version 3
+ *
+ */
+
+/* PostGIS-T extension */
+#include "spatiotemporal.h"
+
+/* PostgreSQL */
+#include <access/htup_details.h>
+#include <catalog/pg_statistic.h>
+#include <catalog/pg_type.h>
+#include <commands/vacuum.h>
+#include <miscadmin.h>
+#include <utils/lsyscache.h>
+#include <utils/selfuncs.h>
+
+/* C Standard Library */
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+
+
+/* kinds 300-9999 are free for use by other projects */
+#define STATISTIC_KIND_SPATIOTEMPORAL 3101
+
+/* order of the histograms in the statistics slot */
+#define HIST_XMIN   0
+#define HIST_XMAX   1
+#define HIST_YMIN   2
+#define HIST_YMAX   3
+#define HIST_TSTART 4
+#define HIST_TEND   5
+#define HIST_COUNT  6
+
+#define DEFAULT_ST_SEL      0.005
+#define DEFAULT_ST_JOINSEL  0.0005
+
+/*
+ * PostGIS keeps the 2D histogram of a geometry column as an ND_STATS
+ * structure, stored as a float4 array in a slot of this kind
+ */
+#define STATISTIC_KIND_POSTGIS_2D 103
+
+
+/* layout of ND_STATS, see gserialized_estimate.c in PostGIS */
+struct postgis_nd_stats
+{
+  float4 ndims;
+  float4 size[4];           /* Number of cells along each dimension */
+  float4 min[4];            /* Extent covered by the cells */
+  float4 max[4];
+  float4 table_features;
+  float4 sample_features;
+  float4 not_null_features;
+  float4 histogram_features;
+  float4 histogram_cells;
+  float4 cells_covered;
+  float4 value[1];          /* Features per cell, x varying fastest */
+};
+
+
+/* query window: closed bounds along each axis */
+struct st_window
+{
+  double lower[3];
+  double upper[3];
+};
+
+
+static int double_cmp(const void *a, const void *b)
+{
+  double x = *(const double*) a;
+  double y = *(const double*) b;
+
+  return (x < y) ? -1 : ((x > y) ? 1 : 0);
+}
+
+
+/*
+ * \brief Fraction of the values with the histogram 'h' that are <= v.
+ *
+ */
+static double hist_cdf(const double *h, int nbounds, double v)
+{
+  int lo, hi;
+
+  if(v < h[0])
+    return 0.0;
+
+  if(v >= h[nbounds - 1] || nbounds == 1)
+    return 1.0;
+
+  /* find the last bound <= v */
+  lo = 0;
+  hi = nbounds - 1;
+
+  while(hi - lo > 1)
+  {
+    int mid = (lo + hi) / 2;
+
+    if(h[mid] <= v)
+      lo = mid;
+    else
+      hi = mid;
+  }
+
+  return (lo + (v - h[lo]) / (h[hi] - h[lo])) / (nbounds - 1);
+}
+
+
+static double clamp_probability(double p)
+{
+  return p < 0.0 ? 0.0 : (p > 1.0 ? 1.0 : p);
+}
+
+
+/*
+ * \brief Probability that a value overlaps the closed window [a, b] along
+ *        the axis whose lower/upper histograms are 'hlo' and 'hhi'.
+ *
+ */
+static double axis_overlap(const double *hlo, const double *hhi, int nbounds, double a, double b)
+{
+  /* P(lower <= b) - P(upper < a) */
+  return clamp_probability(hist_cdf(hlo, nbounds, b) - hist_cdf(hhi, nbounds, a));
+}
+
+
+/*
+ * \brief Probability that a value from each of two columns overlap along
+ *        one axis: 1 - P(lo1 > hi2) - P(lo2 > hi1).
+ *
+ */
+static double axis_join_overlap(const double *hlo1, const double *hhi1, int n1,
+                                const double *hlo2, const double *hhi2, int n2)
+{
+  double p12 = 0.0;
+
+  double p21 = 0.0;
+
+  /* each bound of an equi-depth histogram stands for the same mass */
+  for(int i = 0; i < n2; ++i)
+    p12 += 1.0 - hist_cdf(hlo1, n1, hhi2[i]);
+
+  for(int i = 0; i < n1; ++i)
+    p21 += 1.0 - hist_cdf(hlo2, n2, hhi1[i]);
+
+  return clamp_probability(1.0 - p12 / n2 - p21 / n1);
+}
+
+
+static void compute_spatiotemporal_stats(VacAttrStatsP stats, AnalyzeAttrFetchFunc fetchfunc,
+                                         int samplerows, double totalrows)
+{
+  double *values[HIST_COUNT];
+
+  int nonnull = 0;
+
+  int nempty = 0;
+
+  int nnull = 0;
+
+  double total_width = 0.0;
+
+  int nvalues = 0;
+
+  for(int h = 0; h < HIST_COUNT; ++h)
+    values[h] = (double*) palloc(samplerows * sizeof(double));
+
+  for(int i = 0; i < samplerows; ++i)
+  {
+    bool isnull;
+
+    Datum value;
+
+    struct spatiotemporal *st;
+
+    vacuum_delay_point();
+
+    value = fetchfunc(stats, i, &isnull);
+
+    if(isnull)
+    {
+      ++nnull;
+      continue;
+    }
+
+    ++nonnull;
+
+    total_width += VARSIZE_ANY(DatumGetPointer(value));
+
+    /* the extent and the times are in the header */
+    st = DatumGetSpatioTemporalHeader(value);
+
+    if(st->npoints == 0)
+    {
+      ++nempty;
+    }
+    else
+    {
+      values[HIST_XMIN][nvalues] = st->extent.xmin;
+      values[HIST_XMAX][nvalues] = st->extent.xmax;
+      values[HIST_YMIN][nvalues] = st->extent.ymin;
+      values[HIST_YMAX][nvalues] = st->extent.ymax;
+      values[HIST_TSTART][nvalues] = (double) st->start_time;
+      values[HIST_TEND][nvalues] = (double) st->end_time;
+
+      ++nvalues;
+    }
+
+    pfree(st);
+  }
+
+  if(nonnull == 0)
+  {
+    stats->stats_valid = true;
+    stats->stanullfrac = 1.0;
+    stats->stawidth = 0;
+    stats->stadistinct = 0.0;
+    return;
+  }
+
+  stats->stats_valid = true;
+  stats->stanullfrac = (float4) ((double) nnull / samplerows);
+  stats->stawidth = (int32) (total_width / nonnull);
+  stats->stadistinct = 0.0;  /* unknown */
+
+  if(nvalues > 0)
+  {
+#if PG_VERSION_NUM >= 170000
+    int nbounds = Min(nvalues, stats->attstattarget + 1);
+#else
+    int nbounds = Min(nvalues, stats->attr->attstattarget + 1);
+#endif
+
+    MemoryContext old_context;
+
+    Datum *bounds;
+
+    float4 *numbers;
+
+    nbounds = Max(nbounds, 1);
+
+    old_context = MemoryContextSwitchTo(stats->anl_context);
+
+    bounds = (Datum*) palloc(HIST_COUNT * nbounds * sizeof(Datum));
+
+    numbers = (float4*) palloc(sizeof(float4));
+
+    MemoryContextSwitchTo(old_context);
+
+    for(int h = 0; h < HIST_COUNT; ++h)
+    {
+      qsort(values[h], nvalues, sizeof(double), double_cmp);
+
+      for(int j = 0; j < nbounds; ++j)
+      {
+        int pos = (nbounds == 1) ? 0 : (int) (((int64) j * (nvalues - 1)) / (nbounds - 1));
+
+        bounds[h * nbounds + j] = Float8GetDatum(values[h][pos]);
+      }
+    }
+
+    /* fraction of the non-null values without any instant */
+    numbers[0] = (float4) ((double) nempty / nonnull);
+
+    stats->stakind[0] = STATISTIC_KIND_SPATIOTEMPORAL;
+    stats->staop[0] = InvalidOid;
+    stats->stanumbers[0] = numbers;
+    stats->numnumbers[0] = 1;
+    stats->stavalues[0] = bounds;
+    stats->numvalues[0] = HIST_COUNT * nbounds;
+    stats->statypid[0] = FLOAT8OID;
+    stats->statyplen[0] = sizeof(float8);
+    stats->statypbyval[0] = FLOAT8PASSBYVAL;
+    stats->statypalign[0] = 'd';
+  }
+
+  for(int h = 0; h < HIST_COUNT; ++h)
+    pfree(values[h]);
+}
+
+
+PG_FUNCTION_INFO_V1(spatiotemporal_analyze);
+
+Datum
+spatiotemporal_analyze(PG_FUNCTION_ARGS)
+{
+  VacAttrStats *stats = (VacAttrStats*) PG_GETARG_POINTER(0);
+
+#if PG_VERSION_NUM < 170000
+  if(stats->attr->attstattarget < 0)
+    stats->attr->attstattarget = default_statistics_target;
+
+  stats->minrows = 300 * stats->attr->attstattarget;
+#else
+  stats->minrows = 300 * stats->attstattarget;
+#endif
+
+  stats->compute_stats = compute_spatiotemporal_stats;
+
+  PG_RETURN_BOOL(true);
+}
+
+
+/*
+ * \brief Histograms of a column: returns the number of bounds per histogram,
+ *        or 0 if there are no statistics.
+ *
+ * \note On success the caller must release 'sslot' with free_attstatsslot.
+ *
+ */
+static int stats_histograms(VariableStatData *vardata, AttStatsSlot *sslot,
+                            double **hist, double *empty_frac)
+{
+  int nbounds;
+
+  if(!HeapTupleIsValid(vardata->statsTuple))
+    return 0;
+
+  if(!get_attstatsslot(sslot, vardata->statsTuple, STATISTIC_KIND_SPATIOTEMPORAL, InvalidOid,
+                       ATTSTATSSLOT_VALUES | ATTSTATSSLOT_NUMBERS))
+    return 0;
+
+  nbounds = sslot->nvalues / HIST_COUNT;
+
+  if(nbounds < 1 || sslot->nnumbers < 1)
+  {
+    free_attstatsslot(sslot);
+    return 0;
+  }
+
+  *hist = (double*) palloc(sslot->nvalues * sizeof(double));
+
+  for(int i = 0; i < sslot->nvalues; ++i)
+    (*hist)[i] = DatumGetFloat8(sslot->values[i]);
+
+  *empty_frac = sslot->numbers[0];
+
+  return nbounds;
+}
+
+
+static double stats_null_frac(VariableStatData *vardata)
+{
+  if(!HeapTupleIsValid(vardata->statsTuple))
+    return 0.0;
+
+  return ((Form_pg_statistic) GETSTRUCT(vardata->statsTuple))->stanullfrac;
+}
+
+
+/*
+ * \brief Build the query window from the constant side of an operator.
+ *
+ * \note Returns false when the constant can not overlap anything.
+ *
+ */
+static bool const_window(Const *c, Oid st_typid, struct st_window *w)
+{
+  for(int d = 0; d < 3; ++d)
+  {
+    w->lower[d] = -DBL_MAX;
+    w->upper[d] = DBL_MAX;
+  }
+
+  if(c->consttype == st_typid)
+  {
+    struct spatiotemporal *st = DatumGetSpatioTemporalHeader(c->constvalue);
+
+    if(st->npoints == 0)
+      return false;
+
+    w->lower[0] = st->extent.xmin;
+    w->upper[0] = st->extent.xmax;
+    w->lower[1] = st->extent.ymin;
+    w->upper[1] = st->extent.ymax;
+    w->lower[2] = (double) st->start_time;
+    w->upper[2] = (double) st->end_time;
+  }
+  else if(c->consttype == TSRANGEOID)
+  {
+    Timestamp lower, upper;
+
+    if(!st_period_from_range(c->constvalue, &lower, &upper))
+      return false;
+
+    w->lower[2] = (double) lower;
+    w->upper[2] = (double) upper;
+  }
+  else
+  {
+    /* the operators on spatiotemporal only take a geometry otherwise */
+    GSERIALIZED *gser = (GSERIALIZED*) PG_DETOAST_DATUM(c->constvalue);
+
+    GBOX gbox;
+
+    if(gserialized_get_gbox_p(gser, &gbox) == LW_FAILURE)
+      return false;
+
+    w->lower[0] = gbox.xmin;
+    w->upper[0] = gbox.xmax;
+    w->lower[1] = gbox.ymin;
+    w->upper[1] = gbox.ymax;
+  }
+
+  return true;
+}
+
+
+/*
+ * \brief Probability that a spatiotemporal value overlaps a value of a
+ *        geometry column, from the extent histograms of the former and the
+ *        2D histogram PostGIS keeps for the latter.
+ *
+ * \note Each cell of the 2D histogram is taken as a query window, weighted
+ *       by its share of the features. Returns a negative value if the
+ *       geometry column has no usable statistics.
+ *
+ */
+static double geometry_join_overlap(VariableStatData *geom_vardata, const double *hist, int nbounds)
+{
+  AttStatsSlot sslot;
+
+  const struct postgis_nd_stats *nd;
+
+  int nx, ny;
+
+  double cw, ch;
+
+  double total = 0.0;
+
+  double p = 0.0;
+
+  if(!HeapTupleIsValid(geom_vardata->statsTuple))
+    return -1.0;
+
+  if(!get_attstatsslot(&sslot, geom_vardata->statsTuple, STATISTIC_KIND_POSTGIS_2D, InvalidOid,
+                       ATTSTATSSLOT_NUMBERS))
+    return -1.0;
+
+  nd = (const struct postgis_nd_stats*) sslot.numbers;
+
+  nx = (sslot.nnumbers > 2) ? (int) nd->size[0] : 0;
+
+  ny = (sslot.nnumbers > 2) ? (int) nd->size[1] : 0;
+
+  if(nx < 1 || ny < 1 ||
+     (Size) sslot.nnumbers * sizeof(float4) < offsetof(struct postgis_nd_stats, value) + (Size) nx * ny * sizeof(float4))
+  {
+    free_attstatsslot(&sslot);
+    return -1.0;
+  }
+
+  cw = ((double) nd->max[0] - nd->min[0]) / nx;
+
+  ch = ((double) nd->max[1] - nd->min[1]) / ny;
+
+  for(int y = 0; y < ny; ++y)
+  {
+    double ylo = nd->min[1] + y * ch;
+
+    double py = axis_overlap(hist + HIST_YMIN * nbounds, hist + HIST_YMAX * nbounds, nbounds, ylo, ylo + ch);
+
+    for(int x = 0; x < nx; ++x)
+    {
+      double v = nd->value[y * nx + x];
+
+      double xlo = nd->min[0] + x * cw;
+
+      if(v <= 0.0)
+        continue;
+
+      total += v;
+
+      p += v * py * axis_overlap(hist + HIST_XMIN * nbounds, hist + HIST_XMAX * nbounds, nbounds, xlo, xlo + cw);
+    }
+  }
+
+  free_attstatsslot(&sslot);
+
+  return (total > 0.0) ? p / total : -1.0;
+}
+
+
+/*
+ * \brief Join selectivity of 'spatiotemporal && geometry'; time does not
+ *        restrict this join.
+ *
+ */
+static double geometry_joinsel(Oid st_typid, VariableStatData *vardata1, VariableStatData *vardata2)
+{
+  VariableStatData *st_vardata = (vardata1->vartype == st_typid) ? vardata1 : vardata2;
+
+  VariableStatData *geom_vardata = (st_vardata == vardata1) ? vardata2 : vardata1;
+
+  AttStatsSlot sslot;
+
+  double *hist;
+
+  double empty_frac;
+
+  int nbounds;
+
+  double p;
+
+  if(!OidIsValid(st_typid) || st_vardata->vartype != st_typid || geom_vardata->vartype == TSRANGEOID)
+    return DEFAULT_ST_JOINSEL;
+
+  nbounds = stats_histograms(st_vardata, &sslot, &hist, &empty_frac);
+
+  if(nbounds == 0)
+    return DEFAULT_ST_JOINSEL;
+
+  p = geometry_join_overlap(geom_vardata, hist, nbounds);
+
+  free_attstatsslot(&sslot);
+
+  if(p < 0.0)
+    return DEFAULT_ST_JOINSEL;
+
+  return (1.0 - stats_null_frac(st_vardata)) * (1.0 - empty_frac) *
+         (1.0 - stats_null_frac(geom_vardata)) * p;
+}
+
+
+/*
+ * \brief The spatiotemporal type, the left argument of every && operator
+ *        of the extension; InvalidOid if the operator is not known.
+ *
+ * \note The estimators are also called directly by the planner support
+ *       function, without flinfo, so the type comes from the operator.
+ *
+ */
+static Oid spatiotemporal_typid(Oid oproid)
+{
+  Oid lefttype, righttype;
+
+  if(!OidIsValid(oproid))
+    return InvalidOid;
+
+  op_input_types(oproid, &lefttype, &righttype);
+
+  return lefttype;
+}
+
+
+PG_FUNCTION_INFO_V1(spatiotemporal_overlaps_sel);
+
+Datum
+spatiotemporal_overlaps_sel(PG_FUNCTION_ARGS)
+{
+  PlannerInfo *root = (PlannerInfo*) PG_GETARG_POINTER(0);
+
+  List *args = (List*) PG_GETARG_POINTER(2);
+
+  int varRelid = PG_GETARG_INT32(3);
+
+  VariableStatData vardata;
+
+  Node *other;
+
+  bool varonleft;
+
+  AttStatsSlot sslot;
+
+  double *hist;
+
+  double empty_frac;
+
+  int nbounds;
+
+  struct st_window w;
+
+  double selec;
+
+  Oid st_typid = spatiotemporal_typid(PG_GETARG_OID(1));
+
+  if(!get_restriction_variable(root, args, varRelid, &vardata, &other, &varonleft))
+    PG_RETURN_FLOAT8(DEFAULT_ST_SEL);
+
+  /*
+   * The variable may be on either side: with 'geom_col && <spatiotemporal>'
+   * the constant is the spatiotemporal value and there are no statistics
+   * to use.
+   */
+  if(!OidIsValid(st_typid) || vardata.vartype != st_typid || !IsA(other, Const))
+  {
+    ReleaseVariableStats(vardata);
+    PG_RETURN_FLOAT8(DEFAULT_ST_SEL);
+  }
+
+  if(((Const*) other)->constisnull || !const_window((Const*) other, st_typid, &w))
+  {
+    ReleaseVariableStats(vardata);
+    PG_RETURN_FLOAT8(0.0);
+  }
+
+  nbounds = stats_histograms(&vardata, &sslot, &hist, &empty_frac);
+
+  if(nbounds == 0)
+  {
+    ReleaseVariableStats(vardata);
+    PG_RETURN_FLOAT8(DEFAULT_ST_SEL);
+  }
+
+  selec = (1.0 - stats_null_frac(&vardata)) * (1.0 - empty_frac);
+
+  selec *= axis_overlap(hist + HIST_XMIN * nbounds, hist + HIST_XMAX * nbounds, nbounds, w.lower[0], w.upper[0]);
+  selec *= axis_overlap(hist + HIST_YMIN * nbounds, hist + HIST_YMAX * nbounds, nbounds, w.lower[1], w.upper[1]);
+  selec *= axis_overlap(hist + HIST_TSTART * nbounds, hist + HIST_TEND * nbounds, nbounds, w.lower[2], w.upper[2]);
+
+  free_attstatsslot(&sslot);
+
+  ReleaseVariableStats(vardata);
+
+  CLAMP_PROBABILITY(selec);
+
+  PG_RETURN_FLOAT8(selec);
+}
+
+
+PG_FUNCTION_INFO_V1(spatiotemporal_overlaps_joinsel);
+
+Datum
+spatiotemporal_overlaps_joinsel(PG_FUNCTION_ARGS)
+{
+  PlannerInfo *root = (PlannerInfo*) PG_GETARG_POINTER(0);
+
+  List *args = (List*) PG_GETARG_POINTER(2);
+
+  JoinType jointype = (JoinType) PG_GETARG_INT16(3);
+
+  SpecialJoinInfo *sjinfo = (SpecialJoinInfo*) PG_GETARG_POINTER(4);
+
+  VariableStatData vardata1, vardata2;
+
+  bool join_is_reversed;
+
+  AttStatsSlot sslot1, sslot2;
+
+  double *hist1, *hist2;
+
+  double empty1, empty2;
+
+  int n1, n2;
+
+  double selec;
+
+  /*
+   * only plain inner joins of a spatiotemporal column with another one or
+   * with a geometry column are estimated
+   */
+  if(jointype != JOIN_INNER || list_length(args) != 2)
+    PG_RETURN_FLOAT8(DEFAULT_ST_JOINSEL);
+
+  get_join_variables(root, args, sjinfo, &vardata1, &vardata2, &join_is_reversed);
+
+  if(vardata1.vartype != vardata2.vartype)
+  {
+    selec = geometry_joinsel(spatiotemporal_typid(PG_GETARG_OID(1)), &vardata1, &vardata2);
+
+    ReleaseVariableStats(vardata1);
+    ReleaseVariableStats(vardata2);
+
+    CLAMP_PROBABILITY(selec);
+
+    PG_RETURN_FLOAT8(selec);
+  }
+
+  n1 = stats_histograms(&vardata1, &sslot1, &hist1, &empty1);
+
+  n2 = (n1 == 0) ? 0 : stats_histograms(&vardata2, &sslot2, &hist2, &empty2);
+
+  if(n1 == 0 || n2 == 0)
+  {
+    if(n1 != 0)
+      free_attstatsslot(&sslot1);
+
+    ReleaseVariableStats(vardata1);
+    ReleaseVariableStats(vardata2);
+    PG_RETURN_FLOAT8(DEFAULT_ST_JOINSEL);
+  }
+
+  selec = (1.0 - stats_null_frac(&vardata1)) * (1.0 - empty1) *
+          (1.0 - stats_null_frac(&vardata2)) * (1.0 - empty2);
+
+  for(int axis = 0; axis < 3; ++axis)
+  {
+    int lo = 2 * axis;
+    int hi = 2 * axis + 1;
+
+    selec *= axis_join_overlap(hist1 + lo * n1, hist1 + hi * n1, n1,
+                               hist2 + lo * n2, hist2 + hi * n2, n2);
+  }
+
+  free_attstatsslot(&sslot1);
+  free_attstatsslot(&sslot2);
+
+  ReleaseVariableStats(vardata1);
+  ReleaseVariableStats(vardata2);
+
+  CLAMP_PROBABILITY(selec);
+
+  PG_RETURN_FLOAT8(selec);
+}
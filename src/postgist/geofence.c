@@ -0,0 +1,1409 @@
+/*
+  Copyright (C) 2017 National Institute For Space Research (INPE) - Brazil.
+
+  postgis-t is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License version 3 as
+  published by the Free Software Foundation.
+
+  postgis-t is distributed  "AS-IS" in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY OF ANY KIND; without even the implied warranty
+  of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with postgis-t. See LICENSE. If not, write to
+  Gilberto Ribeiro de Queiroz at <gribeiro@dpi.inpe.br>.
+
+ */
+
+
+/*!
+ *
+ * \file postgist/geofence.c
+ *
+ * \brief Geofences kept in shared memory and tested as trajectories grow.
+ *
+ * \author Gilberto Ribeiro de Queiroz
+ * \author Fabiana Zioti
+ *
+ * \date 2017
+ *
+ * \copyright GNU Lesser Public License version 3
+ *
+ */
+
+/* PostGIS-T extension */
+#include "geofence.h"
+#include "spatiotemporal.h"
+
+/* PostgreSQL */
+#include <access/htup_details.h>
+#include <access/xact.h>
+#include <catalog/pg_type.h>
+#include <commands/trigger.h>
+#include <executor/spi.h>
+#include <funcapi.h>
+#include <miscadmin.h>
+#include <storage/ipc.h>
+#include <storage/lwlock.h>
+#include <storage/shmem.h>
+#include <utils/builtins.h>
+#include <utils/guc.h>
+#include <utils/lsyscache.h>
+
+/* C Standard Library */
+#include <float.h>
+#include <limits.h>
+#include <math.h>
+#include <string.h>
+
+
+/* children per R-tree node */
+#define GEOFENCE_FANOUT 16
+
+#define GEOFENCE_MAX_LEVELS 8
+
+#define GEOFENCE_TRANCHE "postgist geofence"
+
+
+struct geofence
+{
+  int32 id;             /* Key in postgist_geofence */
+  int32 srid;
+  struct st_extent box;
+  int32 first_ring;
+  int32 nrings;
+};
+
+struct geofence_ring
+{
+  int32 first_vertex;
+  int32 nvertices;
+};
+
+/* node of the packed R-tree; children of level 0 nodes are fences */
+struct geofence_node
+{
+  struct st_extent box;
+  int32 first;          /* First child: a position in 'order' or a node */
+  int32 count;
+};
+
+
+/*
+ * \brief Fences with their rings and index, either being built in local
+ *        memory or viewing the shared registry.
+ *
+ */
+struct geofence_set
+{
+  int32 nfences;
+  int32 nrings;
+  int32 nvertices;
+  int32 nlevels;
+  int32 level_offset[GEOFENCE_MAX_LEVELS + 1];  /* First node of each level */
+  struct geofence *fences;
+  struct geofence_ring *rings;
+  double *vertices;     /* x, y pairs */
+  int32 *order;         /* Fences in R-tree order */
+  struct geofence_node *nodes;
+};
+
+
+/* header of the shared registry; the arrays follow it */
+struct geofence_registry
+{
+  LWLock *lock;
+  Oid dboid;            /* Database the fences were read from */
+  bool loaded;          /* False until loaded and after a change of the table */
+  uint64 generation;    /* Bumped by each committed change of the table */
+  struct geofence_set set;
+};
+
+
+struct geofence_event
+{
+  int32 fence_id;
+  bool enter;
+  Timestamp t;
+  double x;
+  double y;
+};
+
+struct geofence_events
+{
+  int32 n;
+  int32 capacity;
+  struct geofence_event *data;
+};
+
+
+static int geofence_max_fences = 1024;
+
+static int geofence_max_vertices = 262144;
+
+static struct geofence_registry *registry = NULL;
+
+static shmem_startup_hook_type prev_shmem_startup_hook = NULL;
+
+#if PG_VERSION_NUM >= 150000
+static shmem_request_hook_type prev_shmem_request_hook = NULL;
+#endif
+
+/* the table changed in the current transaction */
+static bool geofence_pending = false;
+
+static bool geofence_callback_registered = false;
+
+static SPIPlanPtr event_plan = NULL;
+
+
+static inline int32 geofence_max_rings(void)
+{
+  return Max(geofence_max_vertices / 4, 1);
+}
+
+
+static inline int32 geofence_max_nodes(void)
+{
+  return geofence_max_fences + GEOFENCE_MAX_LEVELS;
+}
+
+
+static Size geofence_shmem_size(void)
+{
+  Size size = MAXALIGN(sizeof(struct geofence_registry));
+
+  size = add_size(size, MAXALIGN(mul_size(geofence_max_fences, sizeof(struct geofence))));
+  size = add_size(size, MAXALIGN(mul_size(geofence_max_rings(), sizeof(struct geofence_ring))));
+  size = add_size(size, MAXALIGN(mul_size(geofence_max_vertices, 2 * sizeof(double))));
+  size = add_size(size, MAXALIGN(mul_size(geofence_max_fences, sizeof(int32))));
+  size = add_size(size, MAXALIGN(mul_size(geofence_max_nodes(), sizeof(struct geofence_node))));
+
+  return size;
+}
+
+
+static void geofence_shmem_request(void)
+{
+#if PG_VERSION_NUM >= 150000
+  if(prev_shmem_request_hook)
+    prev_shmem_request_hook();
+#endif
+
+  RequestAddinShmemSpace(geofence_shmem_size());
+
+  RequestNamedLWLockTranche(GEOFENCE_TRANCHE, 1);
+}
+
+
+static void geofence_shmem_startup(void)
+{
+  bool found;
+
+  char *p;
+
+  if(prev_shmem_startup_hook)
+    prev_shmem_startup_hook();
+
+  LWLockAcquire(AddinShmemInitLock, LW_EXCLUSIVE);
+
+  registry = (struct geofence_registry*) ShmemInitStruct("postgist geofence registry",
+                                                         geofence_shmem_size(), &found);
+
+  if(!found)
+  {
+    memset(registry, 0, sizeof(struct geofence_registry));
+
+    registry->lock = &(GetNamedLWLockTranche(GEOFENCE_TRANCHE))->lock;
+
+    /* the arrays are at the same addresses in every backend */
+    p = (char*) registry + MAXALIGN(sizeof(struct geofence_registry));
+
+    registry->set.fences = (struct geofence*) p;
+    p += MAXALIGN(mul_size(geofence_max_fences, sizeof(struct geofence)));
+
+    registry->set.rings = (struct geofence_ring*) p;
+    p += MAXALIGN(mul_size(geofence_max_rings(), sizeof(struct geofence_ring)));
+
+    registry->set.vertices = (double*) p;
+    p += MAXALIGN(mul_size(geofence_max_vertices, 2 * sizeof(double)));
+
+    registry->set.order = (int32*) p;
+    p += MAXALIGN(mul_size(geofence_max_fences, sizeof(int32)));
+
+    registry->set.nodes = (struct geofence_node*) p;
+  }
+
+  LWLockRelease(AddinShmemInitLock);
+}
+
+
+void st_geofence_init(void)
+{
+  if(!process_shared_preload_libraries_in_progress)
+    return;
+
+  DefineCustomIntVariable("postgist.geofence_max_fences",
+                          "Maximum number of geofences kept in shared memory.",
+                          NULL,
+                          &geofence_max_fences,
+                          1024, 1, INT_MAX / 64,
+                          PGC_POSTMASTER, 0,
+                          NULL, NULL, NULL);
+
+  DefineCustomIntVariable("postgist.geofence_max_vertices",
+                          "Maximum number of vertices of all geofences kept in shared memory.",
+                          NULL,
+                          &geofence_max_vertices,
+                          262144, 4, INT_MAX / 64,
+                          PGC_POSTMASTER, 0,
+                          NULL, NULL, NULL);
+
+#if PG_VERSION_NUM >= 150000
+  prev_shmem_request_hook = shmem_request_hook;
+  shmem_request_hook = geofence_shmem_request;
+#else
+  geofence_shmem_request();
+#endif
+
+  prev_shmem_startup_hook = shmem_startup_hook;
+  shmem_startup_hook = geofence_shmem_startup;
+}
+
+
+static int geofence_cmp_x(const void *a, const void *b, void *arg)
+{
+  const struct geofence *fences = (const struct geofence*) arg;
+
+  const struct st_extent *ea = &fences[*(const int32*) a].box;
+
+  const struct st_extent *eb = &fences[*(const int32*) b].box;
+
+  double ca = ea->xmin + ea->xmax;
+
+  double cb = eb->xmin + eb->xmax;
+
+  return (ca > cb) - (ca < cb);
+}
+
+
+static int geofence_cmp_y(const void *a, const void *b, void *arg)
+{
+  const struct geofence *fences = (const struct geofence*) arg;
+
+  const struct st_extent *ea = &fences[*(const int32*) a].box;
+
+  const struct st_extent *eb = &fences[*(const int32*) b].box;
+
+  double ca = ea->ymin + ea->ymax;
+
+  double cb = eb->ymin + eb->ymax;
+
+  return (ca > cb) - (ca < cb);
+}
+
+
+static void geofence_node_init(struct geofence_node *node, int32 first, int32 count)
+{
+  node->first = first;
+  node->count = count;
+
+  node->box.xmin = node->box.ymin = DBL_MAX;
+  node->box.xmax = node->box.ymax = -DBL_MAX;
+}
+
+
+static void geofence_node_add(struct geofence_node *node, const struct st_extent *e)
+{
+  st_extent_expand(&node->box, e->xmin, e->ymin);
+  st_extent_expand(&node->box, e->xmax, e->ymax);
+}
+
+
+/*
+ * \brief Build a packed R-tree over the fences: the leaves are ordered by
+ *        Sort-Tile-Recursive and each level groups GEOFENCE_FANOUT nodes
+ *        of the level below.
+ *
+ */
+static void geofence_set_index(struct geofence_set *set)
+{
+  int32 n = set->nfences;
+
+  int32 nleaves;
+
+  int32 slice;
+
+  int32 nnodes = 0;
+
+  int32 level = 0;
+
+  int32 below;
+
+  set->nlevels = 0;
+
+  if(n == 0)
+    return;
+
+  for(int32 i = 0; i < n; ++i)
+    set->order[i] = i;
+
+  nleaves = (n + GEOFENCE_FANOUT - 1) / GEOFENCE_FANOUT;
+
+  slice = (int32) ceil(sqrt((double) nleaves)) * GEOFENCE_FANOUT;
+
+  qsort_arg(set->order, n, sizeof(int32), geofence_cmp_x, set->fences);
+
+  for(int32 i = 0; i < n; i += slice)
+    qsort_arg(set->order + i, Min(slice, n - i), sizeof(int32), geofence_cmp_y, set->fences);
+
+  /* level 0: groups of fences */
+  set->level_offset[0] = 0;
+
+  for(int32 i = 0; i < n; i += GEOFENCE_FANOUT)
+  {
+    struct geofence_node *node = &set->nodes[nnodes++];
+
+    geofence_node_init(node, i, Min(GEOFENCE_FANOUT, n - i));
+
+    for(int32 j = i; j < i + node->count; ++j)
+      geofence_node_add(node, &set->fences[set->order[j]].box);
+  }
+
+  below = nnodes;
+
+  /* upper levels: groups of nodes, up to a single root */
+  while(below > 1 && level + 1 < GEOFENCE_MAX_LEVELS)
+  {
+    int32 first = set->level_offset[level];
+
+    ++level;
+
+    set->level_offset[level] = nnodes;
+
+    for(int32 i = 0; i < below; i += GEOFENCE_FANOUT)
+    {
+      struct geofence_node *node = &set->nodes[nnodes++];
+
+      geofence_node_init(node, first + i, Min(GEOFENCE_FANOUT, below - i));
+
+      for(int32 j = first + i; j < first + i + node->count; ++j)
+        geofence_node_add(node, &set->nodes[j].box);
+    }
+
+    below = nnodes - set->level_offset[level];
+  }
+
+  set->nlevels = level + 1;
+  set->level_offset[set->nlevels] = nnodes;
+}
+
+
+/*
+ * \brief Write to 'out' the fences in 'srid' whose box overlaps 'e'.
+ *
+ */
+static int32 geofence_set_query(const struct geofence_set *set, const struct st_extent *e,
+                                int32 srid, int32 *out)
+{
+  int32 stack[GEOFENCE_MAX_LEVELS * GEOFENCE_FANOUT];
+
+  int32 levels[GEOFENCE_MAX_LEVELS * GEOFENCE_FANOUT];
+
+  int32 top = 0;
+
+  int32 n = 0;
+
+  if(set->nlevels == 0)
+    return 0;
+
+  /* the top level may hold several nodes if GEOFENCE_MAX_LEVELS was hit */
+  for(int32 i = set->level_offset[set->nlevels - 1]; i < set->level_offset[set->nlevels]; ++i)
+  {
+    stack[top] = i;
+    levels[top++] = set->nlevels - 1;
+  }
+
+  while(top > 0)
+  {
+    const struct geofence_node *node = &set->nodes[stack[--top]];
+
+    int32 level = levels[top];
+
+    if(!st_extent_overlaps(&node->box, e))
+      continue;
+
+    if(level == 0)
+    {
+      for(int32 i = node->first; i < node->first + node->count; ++i)
+      {
+        const struct geofence *f = &set->fences[set->order[i]];
+
+        if(f->srid == srid && st_extent_overlaps(&f->box, e))
+          out[n++] = set->order[i];
+      }
+
+      continue;
+    }
+
+    for(int32 i = node->first; i < node->first + node->count; ++i)
+    {
+      stack[top] = i;
+      levels[top++] = level - 1;
+    }
+  }
+
+  return n;
+}
+
+
+/*
+ * \brief Copy into 'local' the fences of 'set' in 'srid' whose box
+ *        overlaps 'e', with their rings and vertices.
+ *
+ * \note Only the copy is done under the registry lock: the caller indexes
+ *       the local set with geofence_set_index once the lock is released.
+ *
+ */
+static void geofence_set_copy(const struct geofence_set *set, const struct st_extent *e,
+                              int32 srid, struct geofence_set *local)
+{
+  int32 *candidates;
+
+  int32 n;
+
+  int32 nrings = 0;
+
+  int32 nvertices = 0;
+
+  memset(local, 0, sizeof(struct geofence_set));
+
+  if(set->nfences == 0)
+    return;
+
+  candidates = (int32*) palloc(set->nfences * sizeof(int32));
+
+  n = geofence_set_query(set, e, srid, candidates);
+
+  for(int32 c = 0; c < n; ++c)
+  {
+    const struct geofence *f = &set->fences[candidates[c]];
+
+    nrings += f->nrings;
+
+    for(int32 r = f->first_ring; r < f->first_ring + f->nrings; ++r)
+      nvertices += set->rings[r].nvertices;
+  }
+
+  local->fences = (struct geofence*) palloc(Max(n, 1) * sizeof(struct geofence));
+  local->rings = (struct geofence_ring*) palloc(Max(nrings, 1) * sizeof(struct geofence_ring));
+  local->vertices = (double*) palloc(Max(nvertices, 1) * 2 * sizeof(double));
+  local->order = (int32*) palloc(Max(n, 1) * sizeof(int32));
+  local->nodes = (struct geofence_node*) palloc((n + GEOFENCE_MAX_LEVELS) * sizeof(struct geofence_node));
+
+  for(int32 c = 0; c < n; ++c)
+  {
+    const struct geofence *f = &set->fences[candidates[c]];
+
+    struct geofence *g = &local->fences[local->nfences++];
+
+    *g = *f;
+
+    g->first_ring = local->nrings;
+
+    for(int32 r = f->first_ring; r < f->first_ring + f->nrings; ++r)
+    {
+      const struct geofence_ring *ring = &set->rings[r];
+
+      struct geofence_ring *copy = &local->rings[local->nrings++];
+
+      copy->first_vertex = local->nvertices;
+      copy->nvertices = ring->nvertices;
+
+      memcpy(local->vertices + 2 * local->nvertices, set->vertices + 2 * ring->first_vertex,
+             ring->nvertices * 2 * sizeof(double));
+
+      local->nvertices += ring->nvertices;
+    }
+  }
+
+  pfree(candidates);
+}
+
+
+/* point in polygon by the even-odd rule over all rings, holes included */
+static bool geofence_contains(const struct geofence_set *set, const struct geofence *f, double x, double y)
+{
+  bool inside = false;
+
+  if(x < f->box.xmin || x > f->box.xmax || y < f->box.ymin || y > f->box.ymax)
+    return false;
+
+  for(int32 r = f->first_ring; r < f->first_ring + f->nrings; ++r)
+  {
+    const double *v = set->vertices + 2 * set->rings[r].first_vertex;
+
+    int32 nv = set->rings[r].nvertices;
+
+    for(int32 i = 0, j = nv - 1; i < nv; j = i++)
+    {
+      double xi = v[2 * i], yi = v[2 * i + 1];
+
+      double xj = v[2 * j], yj = v[2 * j + 1];
+
+      if((yi > y) != (yj > y) && x < (xj - xi) * (y - yi) / (yj - yi) + xi)
+        inside = !inside;
+    }
+  }
+
+  return inside;
+}
+
+
+static int double_cmp(const void *a, const void *b)
+{
+  double da = *(const double*) a;
+
+  double db = *(const double*) b;
+
+  return (da > db) - (da < db);
+}
+
+
+/*
+ * \brief Positions u in (0, 1] along p0 -> p1 where the segment crosses
+ *        the boundary of 'f', in increasing order.
+ *
+ */
+static int32 geofence_crossings(const struct geofence_set *set, const struct geofence *f,
+                                double x0, double y0, double x1, double y1,
+                                double **u, int32 *capacity)
+{
+  double dx = x1 - x0;
+
+  double dy = y1 - y0;
+
+  int32 n = 0;
+
+  for(int32 r = f->first_ring; r < f->first_ring + f->nrings; ++r)
+  {
+    const double *v = set->vertices + 2 * set->rings[r].first_vertex;
+
+    for(int32 i = 1; i < set->rings[r].nvertices; ++i)
+    {
+      double ax = v[2 * i - 2], ay = v[2 * i - 1];
+
+      double ex = v[2 * i] - ax, ey = v[2 * i + 1] - ay;
+
+      double d = dx * ey - dy * ex;
+
+      double s, w;
+
+      if(d == 0.0)
+        continue;
+
+      s = ((ax - x0) * ey - (ay - y0) * ex) / d;
+
+      w = ((ax - x0) * dy - (ay - y0) * dx) / d;
+
+      /* half-open on the edge, so a shared vertex counts once */
+      if(s <= 0.0 || s > 1.0 || w < 0.0 || w >= 1.0)
+        continue;
+
+      if(n == *capacity)
+      {
+        *capacity *= 2;
+        *u = (double*) repalloc(*u, *capacity * sizeof(double));
+      }
+
+      (*u)[n++] = s;
+    }
+  }
+
+  if(n > 1)
+    qsort(*u, n, sizeof(double), double_cmp);
+
+  return n;
+}
+
+
+static void geofence_events_push(struct geofence_events *events, int32 fence_id, bool enter,
+                                 Timestamp t, double x, double y)
+{
+  struct geofence_event *e;
+
+  if(events->n == events->capacity)
+  {
+    events->capacity = Max(events->capacity * 2, 16);
+
+    events->data = events->data ? (struct geofence_event*) repalloc(events->data, events->capacity * sizeof(struct geofence_event))
+                                : (struct geofence_event*) palloc(events->capacity * sizeof(struct geofence_event));
+  }
+
+  e = &events->data[events->n++];
+
+  e->fence_id = fence_id;
+  e->enter = enter;
+  e->t = t;
+  e->x = x;
+  e->y = y;
+}
+
+
+static int geofence_event_cmp(const void *a, const void *b)
+{
+  const struct geofence_event *ea = (const struct geofence_event*) a;
+
+  const struct geofence_event *eb = (const struct geofence_event*) b;
+
+  if(ea->t != eb->t)
+    return ea->t < eb->t ? -1 : 1;
+
+  return (ea->fence_id > eb->fence_id) - (ea->fence_id < eb->fence_id);
+}
+
+
+/*
+ * \brief Enter and exit events along the segments after instant 'anchor'.
+ *
+ * \note With 'initial', being inside a fence at 'anchor' is an enter
+ *       event. Each segment only looks at the fences the R-tree returns
+ *       for its box, so the cost does not grow with the trajectory.
+ *
+ */
+static void geofence_evaluate(const struct geofence_set *set, const struct spatiotemporal *st,
+                              int32 anchor, bool initial, struct geofence_events *events)
+{
+  int ndims = ST_NDIMS(st);
+
+  const double *coords = ST_COORDS(st);
+
+  const Timestamp *times = ST_TIMES(st);
+
+  int32 *candidates;
+
+  int32 capacity = 16;
+
+  double *u;
+
+  if(set->nfences == 0 || st->npoints == 0)
+    return;
+
+  candidates = (int32*) palloc(set->nfences * sizeof(int32));
+
+  u = (double*) palloc(capacity * sizeof(double));
+
+  if(initial)
+  {
+    double x = coords[anchor * ndims];
+
+    double y = coords[anchor * ndims + 1];
+
+    struct st_extent e = { x, y, x, y };
+
+    int32 n = geofence_set_query(set, &e, st->srid, candidates);
+
+    int32 first = events->n;
+
+    for(int32 c = 0; c < n; ++c)
+    {
+      const struct geofence *f = &set->fences[candidates[c]];
+
+      if(geofence_contains(set, f, x, y))
+        geofence_events_push(events, f->id, true, times[anchor], x, y);
+    }
+
+    if(events->n - first > 1)
+      qsort(events->data + first, events->n - first, sizeof(struct geofence_event), geofence_event_cmp);
+  }
+
+  for(int32 i = anchor + 1; i < st->npoints; ++i)
+  {
+    double x0 = coords[(i - 1) * ndims], y0 = coords[(i - 1) * ndims + 1];
+
+    double x1 = coords[i * ndims], y1 = coords[i * ndims + 1];
+
+    Timestamp t0 = times[i - 1];
+
+    double dt = (double) (times[i] - t0);
+
+    struct st_extent e = { Min(x0, x1), Min(y0, y1), Max(x0, x1), Max(y0, y1) };
+
+    int32 n = geofence_set_query(set, &e, st->srid, candidates);
+
+    int32 first = events->n;
+
+    for(int32 c = 0; c < n; ++c)
+    {
+      const struct geofence *f = &set->fences[candidates[c]];
+
+      bool inside = geofence_contains(set, f, x0, y0);
+
+      bool inside_end = geofence_contains(set, f, x1, y1);
+
+      int32 ncrossings = geofence_crossings(set, f, x0, y0, x1, y1, &u, &capacity);
+
+      for(int32 k = 0; k < ncrossings; ++k)
+      {
+        inside = !inside;
+
+        geofence_events_push(events, f->id, inside, t0 + (Timestamp) rint(u[k] * dt),
+                             x0 + u[k] * (x1 - x0), y0 + u[k] * (y1 - y0));
+      }
+
+      /* grazing a vertex can leave the parity off: trust the end point */
+      if(inside != inside_end)
+        geofence_events_push(events, f->id, inside_end, times[i], x1, y1);
+    }
+
+    if(events->n - first > 1)
+      qsort(events->data + first, events->n - first, sizeof(struct geofence_event), geofence_event_cmp);
+  }
+
+  pfree(u);
+  pfree(candidates);
+}
+
+
+static void geofence_set_add(struct geofence_set *set, int32 id, const LWGEOM *lwgeom)
+{
+  struct geofence *f;
+
+  LWPOLY *single = (LWPOLY*) lwgeom;
+
+  LWPOLY **polys = &single;
+
+  int32 npolys = 1;
+
+  if(lwgeom->type == MULTIPOLYGONTYPE)
+  {
+    polys = ((const LWMPOLY*) lwgeom)->geoms;
+    npolys = ((const LWMPOLY*) lwgeom)->ngeoms;
+  }
+
+  if(set->nfences == geofence_max_fences)
+    ereport(ERROR, (errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
+                    errmsg("too many geofences"),
+                    errhint("Increase postgist.geofence_max_fences.")));
+
+  f = &set->fences[set->nfences++];
+
+  f->id = id;
+  f->srid = lwgeom->srid;
+  f->first_ring = set->nrings;
+  f->nrings = 0;
+
+  f->box.xmin = f->box.ymin = DBL_MAX;
+  f->box.xmax = f->box.ymax = -DBL_MAX;
+
+  for(int32 i = 0; i < npolys; ++i)
+  {
+    for(int32 r = 0; r < (int32) polys[i]->nrings; ++r)
+    {
+      const POINTARRAY *pa = polys[i]->rings[r];
+
+      struct geofence_ring *ring;
+
+      if(set->nrings == geofence_max_rings() || set->nvertices + (int32) pa->npoints > geofence_max_vertices)
+        ereport(ERROR, (errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
+                        errmsg("too many geofence vertices"),
+                        errhint("Increase postgist.geofence_max_vertices.")));
+
+      ring = &set->rings[set->nrings++];
+
+      ring->first_vertex = set->nvertices;
+      ring->nvertices = pa->npoints;
+
+      for(int32 j = 0; j < (int32) pa->npoints; ++j)
+      {
+        POINT2D p;
+
+        getPoint2d_p(pa, j, &p);
+
+        set->vertices[2 * set->nvertices] = p.x;
+        set->vertices[2 * set->nvertices + 1] = p.y;
+
+        ++set->nvertices;
+
+        st_extent_expand(&f->box, p.x, p.y);
+      }
+
+      ++f->nrings;
+    }
+  }
+}
+
+
+/*
+ * \brief Read postgist_geofence of the schema 'nspid' into the registry.
+ *
+ * \note The table is read with a new snapshot, not the one of the
+ *       calling statement. The registry is only marked loaded if the table
+ *       did not change while it was read, this transaction has no
+ *       uncommitted change of it and it does not run on a transaction
+ *       snapshot (REPEATABLE READ or SERIALIZABLE), which may predate
+ *       committed changes; otherwise the next use reads it again.
+ *
+ */
+static int32 geofence_load(Oid nspid)
+{
+  StringInfoData query;
+
+  struct geofence_set set;
+
+  uint64 generation;
+
+  int32 nfences;
+
+  LWLockAcquire(registry->lock, LW_SHARED);
+  generation = registry->generation;
+  LWLockRelease(registry->lock);
+
+  if(SPI_connect() != SPI_OK_CONNECT)
+    elog(ERROR, "could not connect to SPI");
+
+  initStringInfo(&query);
+
+  appendStringInfo(&query, "SELECT id, geom FROM %s.postgist_geofence",
+                   quote_identifier(get_namespace_name(nspid)));
+
+  /* not read-only: under READ COMMITTED SPI takes a fresh snapshot */
+  if(SPI_execute(query.data, false, 0) != SPI_OK_SELECT)
+    elog(ERROR, "could not read %s", query.data);
+
+  /* local copy, freed by SPI_finish */
+  memset(&set, 0, sizeof(set));
+
+  set.fences = (struct geofence*) palloc(Max(geofence_max_fences, 1) * sizeof(struct geofence));
+  set.rings = (struct geofence_ring*) palloc(geofence_max_rings() * sizeof(struct geofence_ring));
+  set.vertices = (double*) palloc(mul_size(geofence_max_vertices, 2 * sizeof(double)));
+  set.order = (int32*) palloc(Max(geofence_max_fences, 1) * sizeof(int32));
+  set.nodes = (struct geofence_node*) palloc(geofence_max_nodes() * sizeof(struct geofence_node));
+
+  for(uint64 i = 0; i < SPI_processed; ++i)
+  {
+    HeapTuple tuple = SPI_tuptable->vals[i];
+
+    bool isnull;
+
+    int32 id = DatumGetInt32(SPI_getbinval(tuple, SPI_tuptable->tupdesc, 1, &isnull));
+
+    Datum geom = SPI_getbinval(tuple, SPI_tuptable->tupdesc, 2, &isnull);
+
+    LWGEOM *lwgeom;
+
+    if(isnull)
+      continue;
+
+    lwgeom = lwgeom_from_gserialized((GSERIALIZED*) PG_DETOAST_DATUM(geom));
+
+    if((lwgeom->type != POLYGONTYPE && lwgeom->type != MULTIPOLYGONTYPE) || lwgeom_is_empty(lwgeom))
+    {
+      ereport(WARNING, (errmsg("geofence %d skipped: not a non-empty POLYGON or MULTIPOLYGON", id)));
+      continue;
+    }
+
+    geofence_set_add(&set, id, lwgeom);
+
+    lwgeom_free(lwgeom);
+  }
+
+  geofence_set_index(&set);
+
+  LWLockAcquire(registry->lock, LW_EXCLUSIVE);
+
+  registry->set.nfences = set.nfences;
+  registry->set.nrings = set.nrings;
+  registry->set.nvertices = set.nvertices;
+  registry->set.nlevels = set.nlevels;
+
+  memcpy(registry->set.level_offset, set.level_offset, sizeof(set.level_offset));
+
+  memcpy(registry->set.fences, set.fences, set.nfences * sizeof(struct geofence));
+  memcpy(registry->set.rings, set.rings, set.nrings * sizeof(struct geofence_ring));
+  memcpy(registry->set.vertices, set.vertices, set.nvertices * 2 * sizeof(double));
+  memcpy(registry->set.order, set.order, set.nfences * sizeof(int32));
+  memcpy(registry->set.nodes, set.nodes, set.level_offset[set.nlevels] * sizeof(struct geofence_node));
+
+  registry->dboid = MyDatabaseId;
+
+  /*
+   * Rows changed by this transaction are not visible to the others yet,
+   * and a transaction snapshot may miss changes committed since it began.
+   */
+  registry->loaded = (registry->generation == generation && !geofence_pending &&
+                      !IsolationUsesXactSnapshot());
+
+  LWLockRelease(registry->lock);
+
+  nfences = set.nfences;
+
+  SPI_finish();
+
+  return nfences;
+}
+
+
+static void geofence_check_registry(void)
+{
+  if(registry == NULL)
+    ereport(ERROR, (errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+                    errmsg("postgist must be loaded via shared_preload_libraries to use geofences")));
+}
+
+
+/*
+ * \brief Take the registry in shared mode, reading the table first if it
+ *        is not loaded for this database.
+ *
+ * \note The registry serves one database at a time.
+ *
+ */
+static void geofence_acquire(Oid nspid)
+{
+  geofence_check_registry();
+
+  LWLockAcquire(registry->lock, LW_SHARED);
+
+  if(registry->loaded && registry->dboid == MyDatabaseId)
+    return;
+
+  LWLockRelease(registry->lock);
+
+  geofence_load(nspid);
+
+  LWLockAcquire(registry->lock, LW_SHARED);
+
+  if(registry->dboid != MyDatabaseId)
+  {
+    LWLockRelease(registry->lock);
+
+    ereport(ERROR, (errcode(ERRCODE_OBJECT_IN_USE),
+                    errmsg("the geofence registry is being loaded by another database")));
+  }
+}
+
+
+/*
+ * \brief Copy the fences that the instants of 'st' from 'anchor' on may
+ *        cross into 'local', so that they are tested without holding the
+ *        registry lock.
+ *
+ */
+static void geofence_fetch(Oid nspid, const struct spatiotemporal *st, int32 anchor,
+                           struct geofence_set *local)
+{
+  int ndims = ST_NDIMS(st);
+
+  const double *coords = ST_COORDS(st);
+
+  struct st_extent e;
+
+  e.xmin = e.ymin = DBL_MAX;
+  e.xmax = e.ymax = -DBL_MAX;
+
+  for(int32 i = anchor; i < st->npoints; ++i)
+    st_extent_expand(&e, coords[i * ndims], coords[i * ndims + 1]);
+
+  geofence_acquire(nspid);
+
+  geofence_set_copy(&registry->set, &e, st->srid, local);
+
+  LWLockRelease(registry->lock);
+
+  geofence_set_index(local);
+}
+
+
+static void geofence_xact_callback(XactEvent event, void *arg)
+{
+  if(!geofence_pending)
+    return;
+
+  /*
+   * After an abort the registry may still hold fences this transaction
+   * read before rolling back: it is marked stale as after a commit.
+   */
+  switch(event)
+  {
+    case XACT_EVENT_COMMIT:
+    case XACT_EVENT_PREPARE:
+    case XACT_EVENT_ABORT:
+      if(registry != NULL)
+      {
+        LWLockAcquire(registry->lock, LW_EXCLUSIVE);
+
+        ++registry->generation;
+        registry->loaded = false;
+
+        LWLockRelease(registry->lock);
+      }
+
+      geofence_pending = false;
+      break;
+
+    default:
+      break;
+  }
+}
+
+
+/*
+ * \brief Append the events of 'object_id' to postgist_geofence_event
+ *        through a plan prepared once per backend.
+ *
+ */
+static void geofence_insert_events(Oid nspid, const char *object_id, int32 srid,
+                                   const struct geofence_events *events)
+{
+  if(SPI_connect() != SPI_OK_CONNECT)
+    elog(ERROR, "could not connect to SPI");
+
+  if(event_plan == NULL)
+  {
+    StringInfoData query;
+
+    Oid relid = get_relname_relid("postgist_geofence_event", nspid);
+
+    Oid argtypes[5];
+
+    if(!OidIsValid(relid))
+      ereport(ERROR, (errcode(ERRCODE_UNDEFINED_TABLE),
+                      errmsg("table postgist_geofence_event does not exist")));
+
+    argtypes[0] = TEXTOID;
+    argtypes[1] = INT4OID;
+    argtypes[2] = TEXTOID;
+    argtypes[3] = TIMESTAMPOID;
+    argtypes[4] = get_atttype(relid, get_attnum(relid, "position"));
+
+    initStringInfo(&query);
+
+    appendStringInfo(&query, "INSERT INTO %s.postgist_geofence_event (object_id, fence_id, event, t, position) "
+                             "VALUES ($1, $2, $3, $4, $5)",
+                     quote_identifier(get_namespace_name(nspid)));
+
+    event_plan = SPI_prepare(query.data, 5, argtypes);
+
+    if(event_plan == NULL)
+      elog(ERROR, "could not prepare the insert of geofence events: %s", SPI_result_code_string(SPI_result));
+
+    SPI_keepplan(event_plan);
+  }
+
+  for(int32 i = 0; i < events->n; ++i)
+  {
+    const struct geofence_event *e = &events->data[i];
+
+    Datum values[5];
+
+    LWPOINT *lwpoint = lwpoint_make2d(srid, e->x, e->y);
+
+    values[0] = CStringGetTextDatum(object_id);
+    values[1] = Int32GetDatum(e->fence_id);
+    values[2] = CStringGetTextDatum(e->enter ? "enter" : "exit");
+    values[3] = TimestampGetDatum(e->t);
+    values[4] = PointerGetDatum(geometry_serialize((LWGEOM*) lwpoint));
+
+    if(SPI_execute_plan(event_plan, values, NULL, false, 0) != SPI_OK_INSERT)
+      elog(ERROR, "could not insert a geofence event");
+
+    lwpoint_free(lwpoint);
+  }
+
+  SPI_finish();
+}
+
+
+/* index of the last instant at or before 't', -1 if there is none */
+static int32 geofence_anchor(const struct spatiotemporal *st, Timestamp t)
+{
+  const Timestamp *times = ST_TIMES(st);
+
+  int32 lo = 0;
+
+  int32 hi = st->npoints - 1;
+
+  if(st->npoints == 0 || times[0] > t)
+    return -1;
+
+  while(lo < hi)
+  {
+    int32 mid = lo + (hi - lo + 1) / 2;
+
+    if(times[mid] <= t)
+      lo = mid;
+    else
+      hi = mid - 1;
+  }
+
+  return lo;
+}
+
+
+PG_FUNCTION_INFO_V1(postgist_geofence_reload);
+
+Datum
+postgist_geofence_reload(PG_FUNCTION_ARGS)
+{
+  geofence_check_registry();
+
+  PG_RETURN_INT32(geofence_load(get_func_namespace(fcinfo->flinfo->fn_oid)));
+}
+
+
+/*
+ * \brief Statement trigger of postgist_geofence: the registry is marked
+ *        stale when the transaction commits.
+ *
+ */
+PG_FUNCTION_INFO_V1(postgist_geofence_invalidate);
+
+Datum
+postgist_geofence_invalidate(PG_FUNCTION_ARGS)
+{
+  if(!CALLED_AS_TRIGGER(fcinfo))
+    elog(ERROR, "postgist_geofence_invalidate: not called by trigger manager");
+
+  if(!geofence_callback_registered)
+  {
+    RegisterXactCallback(geofence_xact_callback, NULL);
+
+    geofence_callback_registered = true;
+  }
+
+  geofence_pending = true;
+
+  return PointerGetDatum(NULL);
+}
+
+
+/*
+ * \brief Row trigger on a table of trajectories:
+ *        postgist_geofence_trigger(id_column, track_column).
+ *
+ * \note On UPDATE only the instants after the end of the old track are
+ *       fetched and tested, starting from the last instant the old track
+ *       covered, so the cost of an append does not grow with the track.
+ *
+ */
+PG_FUNCTION_INFO_V1(postgist_geofence_trigger);
+
+Datum
+postgist_geofence_trigger(PG_FUNCTION_ARGS)
+{
+  TriggerData *trigdata = (TriggerData*) fcinfo->context;
+
+  Oid nspid = get_func_namespace(fcinfo->flinfo->fn_oid);
+
+  Trigger *trigger;
+
+  TupleDesc tupdesc;
+
+  HeapTuple newtuple;
+
+  HeapTuple oldtuple = NULL;
+
+  int id_attnum;
+
+  int track_attnum;
+
+  Datum d;
+
+  bool isnull;
+
+  char *object_id;
+
+  struct spatiotemporal *st = NULL;
+
+  struct geofence_events events = { 0, 0, NULL };
+
+  struct geofence_set fences;
+
+  bool initial = true;
+
+  if(!CALLED_AS_TRIGGER(fcinfo))
+    elog(ERROR, "postgist_geofence_trigger: not called by trigger manager");
+
+  if(!TRIGGER_FIRED_AFTER(trigdata->tg_event) || !TRIGGER_FIRED_FOR_ROW(trigdata->tg_event))
+    ereport(ERROR, (errcode(ERRCODE_E_R_I_E_TRIGGER_PROTOCOL_VIOLATED),
+                    errmsg("postgist_geofence_trigger must be fired AFTER ... FOR EACH ROW")));
+
+  if(TRIGGER_FIRED_BY_INSERT(trigdata->tg_event))
+    newtuple = trigdata->tg_trigtuple;
+  else if(TRIGGER_FIRED_BY_UPDATE(trigdata->tg_event))
+  {
+    newtuple = trigdata->tg_newtuple;
+    oldtuple = trigdata->tg_trigtuple;
+  }
+  else
+    ereport(ERROR, (errcode(ERRCODE_E_R_I_E_TRIGGER_PROTOCOL_VIOLATED),
+                    errmsg("postgist_geofence_trigger must be fired for INSERT or UPDATE")));
+
+  trigger = trigdata->tg_trigger;
+
+  if(trigger->tgnargs != 2)
+    ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                    errmsg("usage: postgist_geofence_trigger(id_column, track_column)")));
+
+  tupdesc = trigdata->tg_relation->rd_att;
+
+  id_attnum = SPI_fnumber(tupdesc, trigger->tgargs[0]);
+
+  track_attnum = SPI_fnumber(tupdesc, trigger->tgargs[1]);
+
+  if(id_attnum <= 0 || track_attnum <= 0)
+    ereport(ERROR, (errcode(ERRCODE_UNDEFINED_COLUMN),
+                    errmsg("column \"%s\" or \"%s\" does not exist", trigger->tgargs[0], trigger->tgargs[1])));
+
+  if(strcmp(SPI_gettype(tupdesc, track_attnum), "spatiotemporal") != 0)
+    ereport(ERROR, (errcode(ERRCODE_DATATYPE_MISMATCH),
+                    errmsg("column \"%s\" is not of type spatiotemporal", trigger->tgargs[1])));
+
+  d = SPI_getbinval(newtuple, tupdesc, track_attnum, &isnull);
+
+  object_id = SPI_getvalue(newtuple, tupdesc, id_attnum);
+
+  if(isnull || object_id == NULL)
+    return PointerGetDatum(NULL);
+
+  if(oldtuple != NULL)
+  {
+    Datum old = SPI_getbinval(oldtuple, tupdesc, track_attnum, &isnull);
+
+    if(!isnull)
+    {
+      struct spatiotemporal *old_hdr = DatumGetSpatioTemporalHeader(old);
+
+      struct spatiotemporal *hdr = DatumGetSpatioTemporalHeader(d);
+
+      if(old_hdr->npoints > 0)
+      {
+        /* nothing was appended */
+        if(hdr->npoints == 0 || hdr->end_time <= old_hdr->end_time)
+          return PointerGetDatum(NULL);
+
+        /* only the appended instants are fetched, not the whole track */
+        st = spatiotemporal_tail(d, hdr, old_hdr->end_time);
+
+        initial = (ST_TIMES(st)[0] > old_hdr->end_time);
+      }
+    }
+  }
+
+  if(st == NULL)
+    st = DatumGetSpatioTemporal(d);
+
+  geofence_fetch(nspid, st, 0, &fences);
+
+  geofence_evaluate(&fences, st, 0, initial, &events);
+
+  if(events.n > 0)
+    geofence_insert_events(nspid, object_id, st->srid, &events);
+
+  return PointerGetDatum(NULL);
+}
+
+
+struct geofence_events_cursor
+{
+  struct geofence_events events;
+
+  int32 srid;
+
+  int32 next;
+};
+
+
+PG_FUNCTION_INFO_V1(spatiotemporal_geofence_events);
+
+Datum
+spatiotemporal_geofence_events(PG_FUNCTION_ARGS)
+{
+  FuncCallContext *funcctx;
+
+  struct geofence_events_cursor *cursor;
+
+  if(SRF_IS_FIRSTCALL())
+  {
+    MemoryContext oldcontext;
+
+    TupleDesc tupdesc;
+
+    struct spatiotemporal *st;
+
+    struct geofence_set fences;
+
+    int32 anchor = 0;
+
+    bool initial = true;
+
+    funcctx = SRF_FIRSTCALL_INIT();
+
+    oldcontext = MemoryContextSwitchTo(funcctx->multi_call_memory_ctx);
+
+    if(get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+      ereport(ERROR, (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+                      errmsg("function returning record called in context that cannot accept type record")));
+
+    funcctx->tuple_desc = BlessTupleDesc(tupdesc);
+
+    cursor = (struct geofence_events_cursor*) palloc0(sizeof(struct geofence_events_cursor));
+
+    funcctx->user_fctx = cursor;
+
+    if(!PG_ARGISNULL(0))
+    {
+      st = PG_GETARG_SPATIOTEMPORAL_P(0);
+
+      cursor->srid = st->srid;
+
+      /* since: only the instants after it, as the row trigger does */
+      if(!PG_ARGISNULL(1))
+      {
+        anchor = geofence_anchor(st, PG_GETARG_TIMESTAMP(1));
+
+        initial = (anchor < 0);
+
+        anchor = Max(anchor, 0);
+      }
+
+      geofence_fetch(get_func_namespace(fcinfo->flinfo->fn_oid), st, anchor, &fences);
+
+      geofence_evaluate(&fences, st, anchor, initial, &cursor->events);
+    }
+
+    MemoryContextSwitchTo(oldcontext);
+  }
+
+  funcctx = SRF_PERCALL_SETUP();
+
+  cursor = (struct geofence_events_cursor*) funcctx->user_fctx;
+
+  if(cursor->next < cursor->events.n)
+  {
+    const struct geofence_event *e = &cursor->events.data[cursor->next++];
+
+    Datum values[4];
+
+    bool nulls[4] = { false, false, false, false };
+
+    HeapTuple tuple;
+
+    LWPOINT *lwpoint = lwpoint_make2d(cursor->srid, e->x, e->y);
+
+    values[0] = Int32GetDatum(e->fence_id);
+    values[1] = CStringGetTextDatum(e->enter ? "enter" : "exit");
+    values[2] = TimestampGetDatum(e->t);
+    values[3] = PointerGetDatum(geometry_serialize((LWGEOM*) lwpoint));
+
+    lwpoint_free(lwpoint);
+
+    tuple = heap_form_tuple(funcctx->tuple_desc, values, nulls);
+
+    SRF_RETURN_NEXT(funcctx, HeapTupleGetDatum(tuple));
+  }
+
+  SRF_RETURN_DONE(funcctx);
+}
@@ -0,0 +1,60 @@
+/*
+  Copyright (C) 2017 National Institute For Space Research (INPE) - Brazil.
+
+  postgis-t is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License version 3 as
+  published by the Free Software Foundation.
+
+  postgis-t is distributed  "AS-IS" in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY OF ANY KIND; without even the implied warranty
+  of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with postgis-t. See LICENSE. If not, write to
+  Gilberto Ribeiro de Queiroz at <gribeiro@dpi.inpe.br>.
+
+ */
+
+
+/*!
+ *
+ * \file postgist/geofence.h
+ *
+ * \brief Geofences kept in shared memory and tested as trajectories grow.
+ *
+ * \note The registry is a copy of the postgist_geofence table of one
+ *       database, indexed by a packed R-tree. It is loaded on first use
+ *       and after each committed change of the table.
+ *
+ * \author Gilberto Ribeiro de Queiroz
+ * \author Fabiana Zioti
+ *
+ * \date 2017
+ *
+ * \copyright GNU Lesser Public License version 3
+ *
+ */
+
+#ifndef __POSTGIST_GEOFENCE_H__
+#define __POSTGIST_GEOFENCE_H__
+
+/* PostgreSQL */
+#include <postgres.h>
+#include <fmgr.h>
+
+
+/*
+ * \brief Define the settings and reserve the registry; called from
+ *        _PG_init.
+ *
+ */
+void st_geofence_init(void);
+
+
+extern Datum postgist_geofence_reload(PG_FUNCTION_ARGS);
+extern Datum postgist_geofence_invalidate(PG_FUNCTION_ARGS);
+extern Datum postgist_geofence_trigger(PG_FUNCTION_ARGS);
+extern Datum spatiotemporal_geofence_events(PG_FUNCTION_ARGS);
+
+#endif  /* __POSTGIST_GEOFENCE_H__ */
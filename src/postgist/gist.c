@@ -0,0 +1,462 @@
+/*
+  Copyright (C) 2017 National Institute For Space Research (INPE) - Brazil.
+
+  postgis-t is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License version 3 as
+  published by the Free Software Foundation.
+
+  postgis-t is distributed  "AS-IS" in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY OF ANY KIND; without even the implied warranty
+  of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with postgis-t. See LICENSE. If not, write to
+  Gilberto Ribeiro de Queiroz at <gribeiro@dpi.inpe.br>.
+
+ */
+/*!
+ *
+ * \file postgist/gist.c
+ *
+ * \brief GiST operator class for the && operators.
+ *
+ * Index keys are header-only spatiotemporal values: no instants, just the
+ * period and the 2D extent, which is all the && operators look at. Inner
+ * keys are the union of the periods and extents below them. A key with an
+ * empty extent (xmin > xmax) stands for values without instants.
+ *
+ * \author Gilberto Ribeiro de Queiroz
+ * \author Fabiana Zioti
+ *
+ * \date 2017
+ *
+ * \copyright GNU Lesser Public License version 3
+ *
+ */
+
+/* PostGIS-T extension */
+#include "spatiotemporal.h"
+
+/* PostgreSQL */
+#include <access/gist.h>
+#include <access/stratnum.h>
+
+/* C Standard Library */
+#include <float.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/* strategies: one per right-hand type of && */
+#define ST_GIST_OVERLAPS_ST       1
+#define ST_GIST_OVERLAPS_GEOMETRY 2
+#define ST_GIST_OVERLAPS_PERIOD   3
+
+#define KEY_IS_EMPTY(k) ((k)->extent.xmin > (k)->extent.xmax)
+
+
+static struct spatiotemporal *key_make(const struct spatiotemporal *st)
+{
+  struct spatiotemporal *key = spatiotemporal_alloc(0, 0);
+
+  if(st->npoints > 0)
+  {
+    key->start_time = st->start_time;
+    key->end_time = st->end_time;
+    key->extent = st->extent;
+  }
+
+  key->srid = st->srid;
+
+  return key;
+}
+
+
+/* grow 'a' to cover 'b' */
+static void key_merge(struct spatiotemporal *a, const struct spatiotemporal *b)
+{
+  if(KEY_IS_EMPTY(b))
+    return;
+
+  if(KEY_IS_EMPTY(a))
+  {
+    a->start_time = b->start_time;
+    a->end_time = b->end_time;
+    a->extent = b->extent;
+
+    return;
+  }
+
+  a->start_time = Min(a->start_time, b->start_time);
+  a->end_time = Max(a->end_time, b->end_time);
+
+  a->extent.xmin = Min(a->extent.xmin, b->extent.xmin);
+  a->extent.ymin = Min(a->extent.ymin, b->extent.ymin);
+  a->extent.xmax = Max(a->extent.xmax, b->extent.xmax);
+  a->extent.ymax = Max(a->extent.ymax, b->extent.ymax);
+}
+
+
+/* center and length of a key along x, y and time */
+static void key_axes(const struct spatiotemporal *k, double center[3], double length[3])
+{
+  center[0] = (k->extent.xmin + k->extent.xmax) * 0.5;
+  center[1] = (k->extent.ymin + k->extent.ymax) * 0.5;
+  center[2] = ((double) k->start_time + (double) k->end_time) * 0.5;
+
+  length[0] = k->extent.xmax - k->extent.xmin;
+  length[1] = k->extent.ymax - k->extent.ymin;
+  length[2] = (double) k->end_time - (double) k->start_time;
+}
+
+
+PG_FUNCTION_INFO_V1(spatiotemporal_gist_compress);
+
+Datum
+spatiotemporal_gist_compress(PG_FUNCTION_ARGS)
+{
+  GISTENTRY *entry = (GISTENTRY*) PG_GETARG_POINTER(0);
+
+  GISTENTRY *retval;
+
+  /* inner keys are already in key form */
+  if(!entry->leafkey)
+    PG_RETURN_POINTER(entry);
+
+  retval = (GISTENTRY*) palloc(sizeof(GISTENTRY));
+
+  gistentryinit(*retval, PointerGetDatum(key_make(DatumGetSpatioTemporalHeader(entry->key))),
+                entry->rel, entry->page, entry->offset, false);
+
+  PG_RETURN_POINTER(retval);
+}
+
+
+PG_FUNCTION_INFO_V1(spatiotemporal_gist_decompress);
+
+Datum
+spatiotemporal_gist_decompress(PG_FUNCTION_ARGS)
+{
+  GISTENTRY *entry = (GISTENTRY*) PG_GETARG_POINTER(0);
+
+  /* keys are stored with a short header in index tuples */
+  struct spatiotemporal *key = (struct spatiotemporal*) PG_DETOAST_DATUM(entry->key);
+
+  GISTENTRY *retval;
+
+  if(key == (struct spatiotemporal*) DatumGetPointer(entry->key))
+    PG_RETURN_POINTER(entry);
+
+  retval = (GISTENTRY*) palloc(sizeof(GISTENTRY));
+
+  gistentryinit(*retval, PointerGetDatum(key), entry->rel, entry->page, entry->offset, false);
+
+  PG_RETURN_POINTER(retval);
+}
+
+
+PG_FUNCTION_INFO_V1(spatiotemporal_gist_consistent);
+
+Datum
+spatiotemporal_gist_consistent(PG_FUNCTION_ARGS)
+{
+  GISTENTRY *entry = (GISTENTRY*) PG_GETARG_POINTER(0);
+
+  StrategyNumber strategy = (StrategyNumber) PG_GETARG_UINT16(2);
+
+  bool *recheck = (bool*) PG_GETARG_POINTER(4);
+
+  struct spatiotemporal *key = (struct spatiotemporal*) DatumGetPointer(entry->key);
+
+  /* && only looks at the header, so leaf answers are exact */
+  *recheck = false;
+
+  if(KEY_IS_EMPTY(key))
+    PG_RETURN_BOOL(false);
+
+  switch(strategy)
+  {
+    case ST_GIST_OVERLAPS_ST:
+    {
+      struct spatiotemporal *query = PG_GETARG_SPATIOTEMPORAL_HEADER_P(1);
+
+      PG_RETURN_BOOL(query->npoints > 0 &&
+                     key->start_time <= query->end_time && query->start_time <= key->end_time &&
+                     st_extent_overlaps(&key->extent, &query->extent));
+    }
+
+    case ST_GIST_OVERLAPS_GEOMETRY:
+    {
+      GSERIALIZED *gser = PG_GETARG_GSERIALIZED_P(1);
+
+      GBOX gbox;
+
+      struct st_extent e;
+
+      if(gserialized_get_gbox_p(gser, &gbox) == LW_FAILURE)
+        PG_RETURN_BOOL(false);
+
+      e.xmin = gbox.xmin;
+      e.ymin = gbox.ymin;
+      e.xmax = gbox.xmax;
+      e.ymax = gbox.ymax;
+
+      PG_RETURN_BOOL(st_extent_overlaps(&key->extent, &e));
+    }
+
+    case ST_GIST_OVERLAPS_PERIOD:
+    {
+      Timestamp lower, upper;
+
+      if(!st_period_from_range(PG_GETARG_DATUM(1), &lower, &upper))
+        PG_RETURN_BOOL(false);
+
+      PG_RETURN_BOOL(key->start_time <= upper && lower <= key->end_time);
+    }
+
+    default:
+      elog(ERROR, "unrecognized spatiotemporal GiST strategy: %d", strategy);
+  }
+
+  PG_RETURN_BOOL(false);
+}
+
+
+PG_FUNCTION_INFO_V1(spatiotemporal_gist_union);
+
+Datum
+spatiotemporal_gist_union(PG_FUNCTION_ARGS)
+{
+  GistEntryVector *entryvec = (GistEntryVector*) PG_GETARG_POINTER(0);
+
+  int *sizep = (int*) PG_GETARG_POINTER(1);
+
+  struct spatiotemporal *result = spatiotemporal_alloc(0, 0);
+
+  for(int i = 0; i < entryvec->n; ++i)
+    key_merge(result, (struct spatiotemporal*) DatumGetPointer(entryvec->vector[i].key));
+
+  *sizep = VARSIZE(result);
+
+  PG_RETURN_POINTER(result);
+}
+
+
+/*
+ * \brief Growth of the original key needed to hold the new one.
+ *
+ * \note Space and time have unrelated units, so the growth along each axis
+ *       is taken relative to the length of the merged key and summed.
+ *
+ */
+PG_FUNCTION_INFO_V1(spatiotemporal_gist_penalty);
+
+Datum
+spatiotemporal_gist_penalty(PG_FUNCTION_ARGS)
+{
+  GISTENTRY *origentry = (GISTENTRY*) PG_GETARG_POINTER(0);
+
+  GISTENTRY *newentry = (GISTENTRY*) PG_GETARG_POINTER(1);
+
+  float *penalty = (float*) PG_GETARG_POINTER(2);
+
+  struct spatiotemporal *orig = (struct spatiotemporal*) DatumGetPointer(origentry->key);
+
+  struct spatiotemporal *new_key = (struct spatiotemporal*) DatumGetPointer(newentry->key);
+
+  struct spatiotemporal merged;
+
+  double center[3], before[3], after[3];
+
+  double growth = 0.0;
+
+  if(KEY_IS_EMPTY(new_key))
+  {
+    /* values without instants go where the other empty keys are */
+    *penalty = KEY_IS_EMPTY(orig) ? 0.0f : 1.0f;
+    PG_RETURN_POINTER(penalty);
+  }
+
+  if(KEY_IS_EMPTY(orig))
+  {
+    *penalty = FLT_MAX;
+    PG_RETURN_POINTER(penalty);
+  }
+
+  memcpy(&merged, orig, ST_HEADER_SIZE);
+
+  key_merge(&merged, new_key);
+
+  key_axes(orig, center, before);
+  key_axes(&merged, center, after);
+
+  for(int d = 0; d < 3; ++d)
+    if(after[d] > 0.0)
+      growth += (after[d] - before[d]) / after[d];
+
+  *penalty = (float) growth;
+
+  PG_RETURN_POINTER(penalty);
+}
+
+
+struct split_item
+{
+  OffsetNumber offset;
+  double center;
+};
+
+
+static int split_item_cmp(const void *a, const void *b)
+{
+  double ca = ((const struct split_item*) a)->center;
+
+  double cb = ((const struct split_item*) b)->center;
+
+  return (ca < cb) ? -1 : ((ca > cb) ? 1 : 0);
+}
+
+
+/*
+ * \brief Split on the axis along which the key centers are most spread,
+ *        relative to the union, putting half of the keys on each side.
+ *
+ */
+PG_FUNCTION_INFO_V1(spatiotemporal_gist_picksplit);
+
+Datum
+spatiotemporal_gist_picksplit(PG_FUNCTION_ARGS)
+{
+  GistEntryVector *entryvec = (GistEntryVector*) PG_GETARG_POINTER(0);
+
+  GIST_SPLITVEC *v = (GIST_SPLITVEC*) PG_GETARG_POINTER(1);
+
+  OffsetNumber maxoff = entryvec->n - 1;
+
+  int nitems = maxoff - FirstOffsetNumber + 1;
+
+  struct split_item *items = (struct split_item*) palloc(nitems * sizeof(struct split_item));
+
+  struct spatiotemporal *left = spatiotemporal_alloc(0, 0);
+
+  struct spatiotemporal *right = spatiotemporal_alloc(0, 0);
+
+  double lo[3], hi[3];
+
+  double best_spread = -1.0;
+
+  int axis = 0;
+
+  for(int d = 0; d < 3; ++d)
+  {
+    lo[d] = DBL_MAX;
+    hi[d] = -DBL_MAX;
+  }
+
+  for(OffsetNumber i = FirstOffsetNumber; i <= maxoff; ++i)
+  {
+    struct spatiotemporal *k = (struct spatiotemporal*) DatumGetPointer(entryvec->vector[i].key);
+
+    double center[3], length[3];
+
+    if(KEY_IS_EMPTY(k))
+      continue;
+
+    key_axes(k, center, length);
+
+    for(int d = 0; d < 3; ++d)
+    {
+      lo[d] = Min(lo[d], center[d]);
+      hi[d] = Max(hi[d], center[d]);
+    }
+  }
+
+  /* spread of the centers relative to the union of the keys */
+  {
+    struct spatiotemporal *all = spatiotemporal_alloc(0, 0);
+
+    double center[3], length[3];
+
+    for(OffsetNumber i = FirstOffsetNumber; i <= maxoff; ++i)
+      key_merge(all, (struct spatiotemporal*) DatumGetPointer(entryvec->vector[i].key));
+
+    if(!KEY_IS_EMPTY(all))
+    {
+      key_axes(all, center, length);
+
+      for(int d = 0; d < 3; ++d)
+      {
+        double spread = (length[d] > 0.0) ? (hi[d] - lo[d]) / length[d] : 0.0;
+
+        if(spread > best_spread)
+        {
+          best_spread = spread;
+          axis = d;
+        }
+      }
+    }
+  }
+
+  /* empty keys sort first */
+  for(OffsetNumber i = FirstOffsetNumber; i <= maxoff; ++i)
+  {
+    struct spatiotemporal *k = (struct spatiotemporal*) DatumGetPointer(entryvec->vector[i].key);
+
+    double center[3], length[3];
+
+    key_axes(k, center, length);
+
+    items[i - FirstOffsetNumber].offset = i;
+    items[i - FirstOffsetNumber].center = KEY_IS_EMPTY(k) ? -DBL_MAX : center[axis];
+  }
+
+  qsort(items, nitems, sizeof(struct split_item), split_item_cmp);
+
+  v->spl_left = (OffsetNumber*) palloc(nitems * sizeof(OffsetNumber));
+  v->spl_right = (OffsetNumber*) palloc(nitems * sizeof(OffsetNumber));
+  v->spl_nleft = 0;
+  v->spl_nright = 0;
+
+  for(int i = 0; i < nitems; ++i)
+  {
+    struct spatiotemporal *k = (struct spatiotemporal*) DatumGetPointer(entryvec->vector[items[i].offset].key);
+
+    if(i < nitems / 2)
+    {
+      v->spl_left[v->spl_nleft++] = items[i].offset;
+      key_merge(left, k);
+    }
+    else
+    {
+      v->spl_right[v->spl_nright++] = items[i].offset;
+      key_merge(right, k);
+    }
+  }
+
+  v->spl_ldatum = PointerGetDatum(left);
+  v->spl_rdatum = PointerGetDatum(right);
+
+  PG_RETURN_POINTER(v);
+}
+
+
+PG_FUNCTION_INFO_V1(spatiotemporal_gist_same);
+
+Datum
+spatiotemporal_gist_same(PG_FUNCTION_ARGS)
+{
+  struct spatiotemporal *a = (struct spatiotemporal*) PG_GETARG_POINTER(0);
+
+  struct spatiotemporal *b = (struct spatiotemporal*) PG_GETARG_POINTER(1);
+
+  bool *result = (bool*) PG_GETARG_POINTER(2);
+
+  if(KEY_IS_EMPTY(a) || KEY_IS_EMPTY(b))
+    *result = KEY_IS_EMPTY(a) && KEY_IS_EMPTY(b);
+  else
+    *result = a->start_time == b->start_time && a->end_time == b->end_time &&
+              memcmp(&a->extent, &b->extent, sizeof(struct st_extent)) == 0;
+
+  PG_RETURN_POINTER(result);
+}
@@ -163,8 +163,8 @@ static LWPOINT* lwpoint_from_gserialized_buffer(uint8_t *data_ptr, uint8_t g_fla
 
 	data_ptr += 4; /* Skip past the type. */
 	/* Zero => empty geometry */
-	npoints =  2;
-	 
+	memcpy(&npoints, data_ptr, sizeof(uint32_t));
+
 	data_ptr += 4; /* Skip past the npoints. */
 
 	if ( npoints > 0 )
@@ -231,9 +231,8 @@ size_t gserialized_from_lwgeom_point(const LWGEOM *geom, uint8_t *buf)
 	}
 }
 
-LWGEOM* lwgeom_from_gserialized_buffer(uint8_t *data_ptr)
+LWGEOM* lwgeom_from_gserialized_buffer(uint8_t *data_ptr, uint8_t g_flags)
 {
-	uint8_t g_flags = 0;
 	size_t *g_size = 0;
 
 	elog(INFO, "ate aqui");
@@ -0,0 +1,177 @@
+/*
+  Copyright (C) 2017 National Institute For Space Research (INPE) - Brazil.
+
+  postgis-t is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License version 3 as
+  published by the Free Software Foundation.
+
+  postgis-t is distributed  "AS-IS" in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY OF ANY KIND; without even the implied warranty
+  of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with postgis-t. See LICENSE. If not, write to
+  Gilberto Ribeiro de Queiroz at <gribeiro@dpi.inpe.br>.
+
+ */
+
+/*!
+ *
+ * \file postgist/mfjson.c
+ *
+ * \brief OGC Moving Features JSON (MF-JSON) output for spatiotemporal values.
+ *
+ * \author Gilberto Ribeiro de Queiroz
+ * \author Fabiana Zioti
+ *
+ * \date 2017
+ *
+ * \copyright GNU Lesser Public License version 3
+ *
+ */
+
+/* PostGIS-T extension */
+#include "mfjson.h"
+
+/* PostgreSQL */
+#include <lib/stringinfo.h>
+#include <miscadmin.h>
+#include <utils/datetime.h>
+
+/* C Standard Library */
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+
+/* "yyyy-mm-ddThh:mi:ss.ffffffZ", quoted, plus a separator */
+#define MFJSON_TIME_SIZE 32
+
+/* sign, 17 significant digits, point, exponent and a separator */
+#define MFJSON_DOUBLE_SIZE 28
+
+
+/*
+ * \brief Append 'd' with at most 'precision' decimals and no trailing zeros.
+ *
+ * \note JSON has no NaN or Infinity, so such coordinates are an error.
+ *
+ */
+static inline void mfjson_append_double(StringInfo str, double d, int precision)
+{
+  int avail;
+
+  int len;
+
+  char *start;
+
+  if(!isfinite(d))
+    ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                    errmsg("spatiotemporal with non-finite coordinates can not be written as MF-JSON")));
+
+  avail = str->maxlen - str->len;
+
+  len = snprintf(str->data + str->len, avail, "%.*f", precision, d);
+
+  if(len >= avail)
+  {
+    /* only very large magnitudes get here */
+    enlargeStringInfo(str, len);
+
+    snprintf(str->data + str->len, len + 1, "%.*f", precision, d);
+  }
+
+  start = str->data + str->len;
+
+  if(memchr(start, '.', len) != NULL)
+  {
+    while(start[len - 1] == '0')
+      --len;
+
+    if(start[len - 1] == '.')
+      --len;
+  }
+
+  str->len += len;
+  str->data[str->len] = '\0';
+}
+
+
+static inline void mfjson_append_time(StringInfo str, Timestamp t)
+{
+  struct pg_tm tm;
+
+  fsec_t fsec;
+
+  char buf[MAXDATELEN + 1];
+
+  if(timestamp2tm(t, NULL, &tm, &fsec, NULL, NULL) != 0)
+    ereport(ERROR, (errcode(ERRCODE_DATETIME_VALUE_OUT_OF_RANGE),
+                    errmsg("timestamp out of range")));
+
+  EncodeDateTime(&tm, fsec, false, 0, NULL, USE_XSD_DATES, buf);
+
+  appendStringInfoChar(str, '"');
+  appendStringInfoString(str, buf);
+  appendStringInfoString(str, "Z\"");
+}
+
+
+char *spatiotemporal_to_mfjson(const struct spatiotemporal *st, int precision)
+{
+  int ndims = ST_NDIMS(st);
+
+  const double *coords = ST_COORDS(st);
+
+  const Timestamp *times = ST_TIMES(st);
+
+  StringInfoData str;
+
+  initStringInfo(&str);
+
+  /* one allocation for the whole document */
+  enlargeStringInfo(&str, 256 + st->npoints *
+                          (ndims * (MFJSON_DOUBLE_SIZE + precision) + 4 + MFJSON_TIME_SIZE));
+
+  appendStringInfoString(&str, "{\"type\":\"MovingPoint\",");
+
+  if(st->srid != 0)
+    appendStringInfo(&str, "\"crs\":{\"type\":\"Name\",\"properties\":{\"name\":\"EPSG:%d\"}},", st->srid);
+
+  appendStringInfoString(&str, "\"coordinates\":[");
+
+  for(int32 i = 0; i < st->npoints; ++i)
+  {
+    const double *c = coords + i * ndims;
+
+    if(i > 0)
+      appendStringInfoChar(&str, ',');
+
+    appendStringInfoChar(&str, '[');
+
+    for(int d = 0; d < ndims; ++d)
+    {
+      if(d > 0)
+        appendStringInfoChar(&str, ',');
+
+      mfjson_append_double(&str, c[d], precision);
+    }
+
+    appendStringInfoChar(&str, ']');
+  }
+
+  appendStringInfoString(&str, "],\"datetimes\":[");
+
+  for(int32 i = 0; i < st->npoints; ++i)
+  {
+    if(i > 0)
+      appendStringInfoChar(&str, ',');
+
+    mfjson_append_time(&str, times[i]);
+  }
+
+  appendStringInfoString(&str, "],\"interpolation\":\"Linear\"}");
+
+  return str.data;
+}
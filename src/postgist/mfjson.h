@@ -0,0 +1,49 @@
+/*
+  Copyright (C) 2017 National Institute For Space Research (INPE) - Brazil.
+
+  postgis-t is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License version 3 as
+  published by the Free Software Foundation.
+
+  postgis-t is distributed  "AS-IS" in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY OF ANY KIND; without even the implied warranty
+  of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with postgis-t. See LICENSE. If not, write to
+  Gilberto Ribeiro de Queiroz at <gribeiro@dpi.inpe.br>.
+
+ */
+
+/*!
+ *
+ * \file postgist/mfjson.h
+ *
+ * \brief OGC Moving Features JSON (MF-JSON) output for spatiotemporal values.
+ *
+ * \author Gilberto Ribeiro de Queiroz
+ * \author Fabiana Zioti
+ *
+ * \date 2017
+ *
+ * \copyright GNU Lesser Public License version 3
+ *
+ */
+
+#ifndef __POSTGIST_MFJSON_H__
+#define __POSTGIST_MFJSON_H__
+
+/* PostGIS-T extension */
+#include "spatiotemporal.h"
+
+/*
+ * \brief Encode 'st' as a MF-JSON MovingPoint with at most 'precision'
+ *        decimal digits per coordinate.
+ *
+ * \note Timestamps are written as UTC.
+ *
+ */
+char *spatiotemporal_to_mfjson(const struct spatiotemporal *st, int precision);
+
+#endif  /* __POSTGIST_MFJSON_H__ */
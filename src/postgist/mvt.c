@@ -0,0 +1,712 @@
+/*
+  Copyright (C) 2017 National Institute For Space Research (INPE) - Brazil.
+
+  postgis-t is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License version 3 as
+  published by the Free Software Foundation.
+
+  postgis-t is distributed  "AS-IS" in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY OF ANY KIND; without even the implied warranty
+  of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with postgis-t. See LICENSE. If not, write to
+  Gilberto Ribeiro de Queiroz at <gribeiro@dpi.inpe.br>.
+
+ */
+/*!
+ *
+ * \file postgist/mvt.c
+ *
+ * \brief Mapbox Vector Tile output for spatiotemporal values.
+ *
+ * Positions must already be in Web Mercator (EPSG:3857), see st_transform;
+ * values with another SRID are rejected, values without one are taken as
+ * Web Mercator.
+ * A single pass over the coordinate array maps each position to the tile
+ * grid, clips the segments to the buffered tile and drops the vertices that
+ * snap onto their predecessor. Each part is then simplified by
+ * Douglas-Peucker with a tolerance of ST_MVT_TOLERANCE tile units, so the
+ * detail kept follows the zoom level. The distance used is the synchronized
+ * one, from a vertex to the position interpolated at its time along the
+ * simplified segment, so vertices where the speed changes are kept even
+ * when they are collinear.
+ *
+ * The layer is written with a small protobuf encoder:
+ *
+ *   Tile     3: layers
+ *   Layer   15: version, 1: name, 2: features, 3: keys, 4: values, 5: extent
+ *   Feature  2: tags, 3: type, 4: geometry
+ *   Value    1: string_value, 6: sint_value
+ *
+ * Each feature has the attributes start_time and end_time (seconds since
+ * the Unix epoch) and times, the offset in seconds of every vertex from
+ * start_time as a comma-separated list.
+ *
+ * \author Gilberto Ribeiro de Queiroz
+ * \author Fabiana Zioti
+ *
+ * \date 2017
+ *
+ * \copyright GNU Lesser Public License version 3
+ *
+ */
+
+/* PostGIS-T extension */
+#include "spatiotemporal.h"
+
+/* PostgreSQL */
+#include <lib/stringinfo.h>
+#include <utils/builtins.h>
+#include <utils/datetime.h>
+
+/* C Standard Library */
+#include <math.h>
+#include <string.h>
+
+
+#define ST_MVT_EXTENT 4096
+#define ST_MVT_BUFFER 256
+
+/* simplification tolerance, in tile units */
+#define ST_MVT_TOLERANCE 1.0
+
+/* half the side of the Web Mercator square */
+#define ST_MERCATOR_MAX 20037508.342789244
+
+#define ST_MERCATOR_SRID 3857
+
+/* seconds between the Unix epoch and the PostgreSQL epoch (2000-01-01) */
+#define ST_UNIX_EPOCH_OFFSET ((int64) (POSTGRES_EPOCH_JDATE - UNIX_EPOCH_JDATE) * SECS_PER_DAY)
+
+/* protobuf wire types */
+#define PB_VARINT 0
+#define PB_LENGTH 2
+
+/* geometry commands */
+#define MVT_CMD_MOVE_TO 1
+#define MVT_CMD_LINE_TO 2
+
+#define MVT_LINESTRING 2
+
+
+/* bounds of a tile in Web Mercator */
+struct tile_bounds
+{
+  double xmin;
+  double ymax;
+  double size;
+};
+
+
+/* a trajectory in tile coordinates, split in parts by the clipping */
+struct tile_line
+{
+  int32 npoints;
+  int32 capacity;
+  int32 nparts;
+  int32 *parts;         /* First vertex of each part, plus the end */
+  int32 *xs;
+  int32 *ys;
+  Timestamp *times;
+};
+
+
+/* layer being built by the aggregate */
+struct mvt_layer
+{
+  char *name;
+  int32 z;
+  int32 x;
+  int32 y;
+  int32 nvalues;
+  StringInfoData features;
+  StringInfoData values;
+};
+
+
+static void tile_bounds_make(int32 z, int32 x, int32 y, struct tile_bounds *b)
+{
+  if(z < 0 || z > 30 || x < 0 || y < 0 || x >= (1 << z) || y >= (1 << z))
+    ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                    errmsg("invalid tile %d/%d/%d", z, x, y)));
+
+  b->size = 2.0 * ST_MERCATOR_MAX / (double) (1 << z);
+  b->xmin = -ST_MERCATOR_MAX + x * b->size;
+  b->ymax = ST_MERCATOR_MAX - y * b->size;
+}
+
+
+/*
+ * \brief Tell if the extent of the value touches the buffered tile.
+ *
+ * \note Only needs the header, so values far from the tile are rejected
+ *       before their arrays are fetched.
+ *
+ */
+static bool tile_intersects(const struct tile_bounds *b, const struct st_extent *e)
+{
+  double margin = b->size * ST_MVT_BUFFER / ST_MVT_EXTENT;
+
+  return e->xmin <= b->xmin + b->size + margin && e->xmax >= b->xmin - margin &&
+         e->ymin <= b->ymax + margin && e->ymax >= b->ymax - b->size - margin;
+}
+
+
+static void tile_line_push(struct tile_line *line, double px, double py, Timestamp t, bool new_part)
+{
+  int32 x = (int32) rint(px);
+
+  int32 y = (int32) rint(py);
+
+  int32 n = line->npoints - line->parts[line->nparts];
+
+  if(new_part)
+  {
+    /* a part needs two distinct vertices, otherwise it is reused */
+    if(n >= 2)
+    {
+      ++line->nparts;
+      line->parts[line->nparts] = line->npoints;
+    }
+    else
+      line->npoints = line->parts[line->nparts];
+
+    n = 0;
+  }
+  else if(n > 0)
+  {
+    int32 last = line->npoints - 1;
+
+    /* snapped onto the previous vertex, which keeps its time */
+    if(line->xs[last] == x && line->ys[last] == y)
+      return;
+  }
+
+  line->xs[line->npoints] = x;
+  line->ys[line->npoints] = y;
+  line->times[line->npoints] = t;
+
+  ++line->npoints;
+}
+
+
+/*
+ * \brief Map the positions of 'st' to the tile and clip them, in one pass.
+ *
+ * \note Clip points get a time interpolated along their segment.
+ *
+ */
+static void tile_line_build(const struct spatiotemporal *st, const struct tile_bounds *b,
+                            struct tile_line *line)
+{
+  int ndims = ST_NDIMS(st);
+
+  const double *coords = ST_COORDS(st);
+
+  const Timestamp *times = ST_TIMES(st);
+
+  double scale = ST_MVT_EXTENT / b->size;
+
+  double lo = -ST_MVT_BUFFER;
+
+  double hi = ST_MVT_EXTENT + ST_MVT_BUFFER;
+
+  bool in_part = false;
+
+  /* each segment adds at most two vertices and starts at most one part */
+  line->capacity = 2 * st->npoints;
+  line->xs = (int32*) palloc(line->capacity * sizeof(int32));
+  line->ys = (int32*) palloc(line->capacity * sizeof(int32));
+  line->times = (Timestamp*) palloc(line->capacity * sizeof(Timestamp));
+  line->parts = (int32*) palloc((st->npoints + 1) * sizeof(int32));
+  line->npoints = 0;
+  line->nparts = 0;
+  line->parts[0] = 0;
+
+  for(int32 i = 1; i < st->npoints; ++i)
+  {
+    double x0 = (coords[(i - 1) * ndims] - b->xmin) * scale;
+    double y0 = (b->ymax - coords[(i - 1) * ndims + 1]) * scale;
+    double dx = (coords[i * ndims] - b->xmin) * scale - x0;
+    double dy = (b->ymax - coords[i * ndims + 1]) * scale - y0;
+
+    double p[4] = { -dx, dx, -dy, dy };
+    double q[4] = { x0 - lo, hi - x0, y0 - lo, hi - y0 };
+
+    double u0 = 0.0, u1 = 1.0;
+
+    double dt = (double) (times[i] - times[i - 1]);
+
+    bool inside = true;
+
+    /* Liang-Barsky clipping against the buffered tile */
+    for(int k = 0; k < 4 && inside; ++k)
+    {
+      if(p[k] == 0.0)
+        inside = q[k] >= 0.0;
+      else if(p[k] < 0.0)
+        u0 = Max(u0, q[k] / p[k]);
+      else
+        u1 = Min(u1, q[k] / p[k]);
+    }
+
+    if(!inside || u0 > u1)
+    {
+      in_part = false;
+      continue;
+    }
+
+    if(!in_part || u0 > 0.0)
+      tile_line_push(line, x0 + dx * u0, y0 + dy * u0,
+                     times[i - 1] + (Timestamp) rint(u0 * dt), line->npoints > 0);
+
+    tile_line_push(line, x0 + dx * u1, y0 + dy * u1,
+                   times[i - 1] + (Timestamp) rint(u1 * dt), false);
+
+    in_part = (u1 >= 1.0);
+  }
+
+  /* close the last part, dropping it if it collapsed to a point */
+  if(line->npoints - line->parts[line->nparts] >= 2)
+    ++line->nparts;
+  else
+    line->npoints = line->parts[line->nparts];
+
+  line->parts[line->nparts] = line->npoints;
+}
+
+
+/* distance from vertex 'i' to the position at its time along vertices 'a' and 'b' */
+static double tile_line_sed(const struct tile_line *line, int32 a, int32 b, int32 i)
+{
+  double dt = (double) (line->times[b] - line->times[a]);
+
+  double r = (dt > 0.0) ? (double) (line->times[i] - line->times[a]) / dt : 0.0;
+
+  double x = line->xs[a] + r * (line->xs[b] - line->xs[a]);
+
+  double y = line->ys[a] + r * (line->ys[b] - line->ys[a]);
+
+  return hypot(line->xs[i] - x, line->ys[i] - y);
+}
+
+
+/*
+ * \brief Douglas-Peucker simplification of each part of 'line' in place,
+ *        with the synchronized distance and 'tolerance' in tile units.
+ *
+ * \note Parts that collapse below two distinct vertices are dropped.
+ *
+ */
+static void tile_line_simplify(struct tile_line *line, double tolerance)
+{
+  bool *keep = (bool*) palloc0(line->npoints * sizeof(bool));
+
+  /* pending ranges never overlap, so there are fewer than npoints of them */
+  int32 *stack = (int32*) palloc(2 * line->npoints * sizeof(int32));
+
+  int32 nparts = 0;
+
+  int32 n = 0;
+
+  for(int32 k = 0; k < line->nparts; ++k)
+  {
+    int32 top = 0;
+
+    keep[line->parts[k]] = true;
+    keep[line->parts[k + 1] - 1] = true;
+
+    stack[top++] = line->parts[k];
+    stack[top++] = line->parts[k + 1] - 1;
+
+    while(top > 0)
+    {
+      int32 b = stack[--top];
+
+      int32 a = stack[--top];
+
+      int32 farthest = -1;
+
+      double dmax = tolerance;
+
+      for(int32 i = a + 1; i < b; ++i)
+      {
+        double d = tile_line_sed(line, a, b, i);
+
+        if(d > dmax)
+        {
+          dmax = d;
+          farthest = i;
+        }
+      }
+
+      if(farthest < 0)
+        continue;
+
+      keep[farthest] = true;
+
+      stack[top++] = a;
+      stack[top++] = farthest;
+      stack[top++] = farthest;
+      stack[top++] = b;
+    }
+  }
+
+  /* compact the kept vertices, which may now repeat their predecessor */
+  for(int32 k = 0; k < line->nparts; ++k)
+  {
+    int32 first = n;
+
+    int32 end = line->parts[k + 1];
+
+    for(int32 i = line->parts[k]; i < end; ++i)
+    {
+      if(!keep[i])
+        continue;
+
+      if(n > first && line->xs[n - 1] == line->xs[i] && line->ys[n - 1] == line->ys[i])
+        continue;
+
+      line->xs[n] = line->xs[i];
+      line->ys[n] = line->ys[i];
+      line->times[n] = line->times[i];
+      ++n;
+    }
+
+    if(n - first < 2)
+    {
+      n = first;
+      continue;
+    }
+
+    line->parts[nparts++] = first;
+  }
+
+  line->nparts = nparts;
+  line->parts[nparts] = n;
+  line->npoints = n;
+
+  pfree(keep);
+  pfree(stack);
+}
+
+
+static inline int64 timestamp_to_unix(Timestamp t)
+{
+  return t / USECS_PER_SEC + ST_UNIX_EPOCH_OFFSET;
+}
+
+
+static void pb_varint(StringInfo buf, uint64 v)
+{
+  while(v >= 0x80)
+  {
+    appendStringInfoChar(buf, (char) ((v & 0x7F) | 0x80));
+    v >>= 7;
+  }
+
+  appendStringInfoChar(buf, (char) v);
+}
+
+
+static inline uint64 pb_zigzag(int64 v)
+{
+  return ((uint64) v << 1) ^ (uint64) (v >> 63);
+}
+
+
+static void pb_key(StringInfo buf, int field, int wire_type)
+{
+  pb_varint(buf, (uint64) ((field << 3) | wire_type));
+}
+
+
+static void pb_bytes(StringInfo buf, int field, const char *data, int len)
+{
+  pb_key(buf, field, PB_LENGTH);
+  pb_varint(buf, (uint64) len);
+  appendBinaryStringInfo(buf, data, len);
+}
+
+
+/*
+ * \brief Append a feature for 'line' to the layer, with its attribute
+ *        values appended to the value table.
+ *
+ */
+static void mvt_layer_add(struct mvt_layer *layer, const struct tile_line *line)
+{
+  StringInfoData geom, tags, value, times, feature;
+
+  int64 start_time = timestamp_to_unix(line->times[0]);
+
+  int32 cx = 0, cy = 0;
+
+  initStringInfo(&geom);
+  initStringInfo(&tags);
+  initStringInfo(&value);
+  initStringInfo(&times);
+  initStringInfo(&feature);
+
+  for(int32 k = 0; k < line->nparts; ++k)
+  {
+    int32 first = line->parts[k];
+
+    int32 last = line->parts[k + 1] - 1;
+
+    for(int32 i = first; i <= last; ++i)
+    {
+      if(i == first)
+        pb_varint(&geom, MVT_CMD_MOVE_TO | (1 << 3));
+      else if(i == first + 1)
+        pb_varint(&geom, MVT_CMD_LINE_TO | ((uint64) (last - first) << 3));
+
+      pb_varint(&geom, pb_zigzag(line->xs[i] - cx));
+      pb_varint(&geom, pb_zigzag(line->ys[i] - cy));
+
+      cx = line->xs[i];
+      cy = line->ys[i];
+
+      appendStringInfo(&times, "%s" INT64_FORMAT, (i > 0) ? "," : "",
+                       (int64) ((line->times[i] - line->times[0]) / USECS_PER_SEC));
+    }
+  }
+
+  /* start_time, end_time and times, with keys 0, 1 and 2 */
+  resetStringInfo(&value);
+  pb_key(&value, 6, PB_VARINT);
+  pb_varint(&value, pb_zigzag(start_time));
+  pb_bytes(&layer->values, 4, value.data, value.len);
+
+  resetStringInfo(&value);
+  pb_key(&value, 6, PB_VARINT);
+  pb_varint(&value, pb_zigzag(timestamp_to_unix(line->times[line->npoints - 1])));
+  pb_bytes(&layer->values, 4, value.data, value.len);
+
+  resetStringInfo(&value);
+  pb_bytes(&value, 1, times.data, times.len);
+  pb_bytes(&layer->values, 4, value.data, value.len);
+
+  for(int k = 0; k < 3; ++k)
+  {
+    pb_varint(&tags, (uint64) k);
+    pb_varint(&tags, (uint64) (layer->nvalues + k));
+  }
+
+  layer->nvalues += 3;
+
+  pb_bytes(&feature, 2, tags.data, tags.len);
+  pb_key(&feature, 3, PB_VARINT);
+  pb_varint(&feature, MVT_LINESTRING);
+  pb_bytes(&feature, 4, geom.data, geom.len);
+
+  pb_bytes(&layer->features, 2, feature.data, feature.len);
+
+  pfree(geom.data);
+  pfree(tags.data);
+  pfree(value.data);
+  pfree(times.data);
+  pfree(feature.data);
+}
+
+
+/*
+ * \brief Convert a value to tile coordinates, NULL if it does not touch
+ *        the tile.
+ *
+ */
+static struct tile_line *tile_line_from_datum(Datum d, const struct tile_bounds *b)
+{
+  struct spatiotemporal *hdr = DatumGetSpatioTemporalHeader(d);
+
+  struct tile_line *line;
+
+  if(hdr->srid != ST_MERCATOR_SRID && hdr->srid != SRID_UNKNOWN)
+    ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                    errmsg("vector tiles need spatiotemporal in SRID %d, not %d", ST_MERCATOR_SRID, hdr->srid),
+                    errhint("Use st_transform to project it to Web Mercator.")));
+
+  if(hdr->npoints < 2 || !tile_intersects(b, &hdr->extent))
+    return NULL;
+
+  line = (struct tile_line*) palloc(sizeof(struct tile_line));
+
+  tile_line_build(DatumGetSpatioTemporal(d), b, line);
+
+  tile_line_simplify(line, ST_MVT_TOLERANCE);
+
+  return (line->nparts > 0) ? line : NULL;
+}
+
+
+PG_FUNCTION_INFO_V1(spatiotemporal_as_tile);
+
+Datum
+spatiotemporal_as_tile(PG_FUNCTION_ARGS)
+{
+  struct tile_bounds b;
+
+  struct tile_line *line;
+
+  LWGEOM **lines;
+
+  LWGEOM *lwgeom;
+
+  GSERIALIZED *result;
+
+  tile_bounds_make(PG_GETARG_INT32(1), PG_GETARG_INT32(2), PG_GETARG_INT32(3), &b);
+
+  line = tile_line_from_datum(PG_GETARG_DATUM(0), &b);
+
+  if(line == NULL)
+    PG_RETURN_NULL();
+
+  /* tile coordinates, with the time of each vertex as M in Unix seconds */
+  lines = (LWGEOM**) palloc(line->nparts * sizeof(LWGEOM*));
+
+  for(int32 k = 0; k < line->nparts; ++k)
+  {
+    int32 first = line->parts[k];
+
+    int32 n = line->parts[k + 1] - first;
+
+    POINTARRAY *pa = ptarray_construct(0, 1, n);
+
+    for(int32 i = 0; i < n; ++i)
+    {
+      POINT4D p;
+
+      p.x = line->xs[first + i];
+      p.y = line->ys[first + i];
+      p.z = 0.0;
+      p.m = (double) line->times[first + i] / USECS_PER_SEC + ST_UNIX_EPOCH_OFFSET;
+
+      ptarray_set_point4d(pa, i, &p);
+    }
+
+    lines[k] = (LWGEOM*) lwline_construct(SRID_UNKNOWN, NULL, pa);
+  }
+
+  if(line->nparts == 1)
+    lwgeom = lines[0];
+  else
+    lwgeom = (LWGEOM*) lwcollection_construct(MULTILINETYPE, SRID_UNKNOWN, NULL, line->nparts, lines);
+
+  result = geometry_serialize(lwgeom);
+
+  lwgeom_free(lwgeom);
+
+  PG_RETURN_POINTER(result);
+}
+
+
+PG_FUNCTION_INFO_V1(spatiotemporal_as_mvt_transfn);
+
+Datum
+spatiotemporal_as_mvt_transfn(PG_FUNCTION_ARGS)
+{
+  MemoryContext agg_context, old_context;
+
+  struct mvt_layer *layer;
+
+  struct tile_bounds b;
+
+  struct tile_line *line;
+
+  if(!AggCheckCallContext(fcinfo, &agg_context))
+    elog(ERROR, "spatiotemporal_as_mvt_transfn called in non-aggregate context");
+
+  for(int i = 2; i <= 4; ++i)
+    if(PG_ARGISNULL(i))
+      ereport(ERROR, (errcode(ERRCODE_NULL_VALUE_NOT_ALLOWED),
+                      errmsg("tile coordinates can not be NULL")));
+
+  if(PG_ARGISNULL(0))
+  {
+    old_context = MemoryContextSwitchTo(agg_context);
+
+    layer = (struct mvt_layer*) palloc0(sizeof(struct mvt_layer));
+
+    layer->name = (PG_NARGS() > 5 && !PG_ARGISNULL(5)) ? text_to_cstring(PG_GETARG_TEXT_PP(5))
+                                                       : pstrdup("trajectories");
+    layer->z = PG_GETARG_INT32(2);
+    layer->x = PG_GETARG_INT32(3);
+    layer->y = PG_GETARG_INT32(4);
+
+    initStringInfo(&layer->features);
+    initStringInfo(&layer->values);
+
+    MemoryContextSwitchTo(old_context);
+  }
+  else
+    layer = (struct mvt_layer*) PG_GETARG_POINTER(0);
+
+  if(PG_ARGISNULL(1))
+    PG_RETURN_POINTER(layer);
+
+  tile_bounds_make(layer->z, layer->x, layer->y, &b);
+
+  line = tile_line_from_datum(PG_GETARG_DATUM(1), &b);
+
+  if(line)
+  {
+    old_context = MemoryContextSwitchTo(agg_context);
+
+    mvt_layer_add(layer, line);
+
+    MemoryContextSwitchTo(old_context);
+  }
+
+  PG_RETURN_POINTER(layer);
+}
+
+
+PG_FUNCTION_INFO_V1(spatiotemporal_as_mvt_finalfn);
+
+Datum
+spatiotemporal_as_mvt_finalfn(PG_FUNCTION_ARGS)
+{
+  static const char *keys[] = { "start_time", "end_time", "times" };
+
+  struct mvt_layer *layer;
+
+  StringInfoData body, tile;
+
+  bytea *result;
+
+  if(PG_ARGISNULL(0))
+    PG_RETURN_NULL();
+
+  layer = (struct mvt_layer*) PG_GETARG_POINTER(0);
+
+  initStringInfo(&body);
+
+  pb_key(&body, 15, PB_VARINT);
+  pb_varint(&body, 2);
+
+  pb_bytes(&body, 1, layer->name, strlen(layer->name));
+
+  appendBinaryStringInfo(&body, layer->features.data, layer->features.len);
+
+  for(int k = 0; k < 3; ++k)
+    pb_bytes(&body, 3, keys[k], strlen(keys[k]));
+
+  appendBinaryStringInfo(&body, layer->values.data, layer->values.len);
+
+  pb_key(&body, 5, PB_VARINT);
+  pb_varint(&body, ST_MVT_EXTENT);
+
+  initStringInfo(&tile);
+
+  pb_bytes(&tile, 3, body.data, body.len);
+
+  result = (bytea*) palloc(VARHDRSZ + tile.len);
+
+  SET_VARSIZE(result, VARHDRSZ + tile.len);
+
+  memcpy(VARDATA(result), tile.data, tile.len);
+
+  PG_RETURN_BYTEA_P(result);
+}
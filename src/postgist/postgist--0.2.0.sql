@@ -25,6 +25,26 @@ CREATE OR REPLACE FUNCTION spatiotemporal_out(spatiotemporal)
     AS 'MODULE_PATHNAME', 'spatiotemporal_out'
     LANGUAGE C IMMUTABLE STRICT;
 
+CREATE OR REPLACE FUNCTION spatiotemporal_send(spatiotemporal)
+    RETURNS bytea
+    AS 'MODULE_PATHNAME', 'spatiotemporal_send'
+    LANGUAGE C IMMUTABLE STRICT;
+
+CREATE OR REPLACE FUNCTION spatiotemporal_recv(internal, oid, integer)
+    RETURNS spatiotemporal
+    AS 'MODULE_PATHNAME', 'spatiotemporal_recv'
+    LANGUAGE C IMMUTABLE STRICT;
+
+CREATE OR REPLACE FUNCTION spatiotemporal_typmod_in(cstring[])
+    RETURNS integer
+    AS 'MODULE_PATHNAME', 'spatiotemporal_typmod_in'
+    LANGUAGE C IMMUTABLE STRICT;
+
+CREATE OR REPLACE FUNCTION spatiotemporal_typmod_out(integer)
+    RETURNS cstring
+    AS 'MODULE_PATHNAME', 'spatiotemporal_typmod_out'
+    LANGUAGE C IMMUTABLE STRICT;
+
 CREATE OR REPLACE FUNCTION spatiotemporal_make(cstring)
 	RETURNS spatiotemporal
 	AS 'MODULE_PATHNAME', 'spatiotemporal_make'
@@ -36,6 +56,21 @@ CREATE OR REPLACE FUNCTION to_str(spatiotemporal)
     AS 'MODULE_PATHNAME', 'spatiotemporal_as_text'
     LANGUAGE C IMMUTABLE STRICT;
 
+CREATE OR REPLACE FUNCTION st_as_binary(spatiotemporal, precision integer DEFAULT 6)
+    RETURNS bytea
+    AS 'MODULE_PATHNAME', 'spatiotemporal_as_binary'
+    LANGUAGE C IMMUTABLE STRICT;
+
+CREATE OR REPLACE FUNCTION st_as_mfjson(spatiotemporal, precision integer DEFAULT 15)
+    RETURNS text
+    AS 'MODULE_PATHNAME', 'spatiotemporal_as_mfjson'
+    LANGUAGE C IMMUTABLE STRICT;
+
+CREATE OR REPLACE FUNCTION st_instants(spatiotemporal, OUT geom geometry, OUT t timestamp)
+    RETURNS SETOF record
+    AS 'MODULE_PATHNAME', 'spatiotemporal_instants'
+    LANGUAGE C IMMUTABLE STRICT;
+
 CREATE OR REPLACE FUNCTION get_duration(spatiotemporal)
     RETURNS interval
     AS 'MODULE_PATHNAME', 'spatiotemporal_duration'
@@ -51,11 +86,761 @@ CREATE OR REPLACE FUNCTION get_end_time(spatiotemporal)
     AS 'MODULE_PATHNAME', 'spatiotemporal_get_end_time'
     LANGUAGE C IMMUTABLE STRICT;
 
+--
+-- Append an instant to the end of a spatiotemporal. A NULL spatiotemporal
+-- starts a new one, so the function can be used directly in UPDATEs. Each
+-- call copies the value; st_trajectory_agg appends in place instead.
+--
+CREATE OR REPLACE FUNCTION st_append_instant(spatiotemporal, geometry, timestamp)
+    RETURNS spatiotemporal
+    AS 'MODULE_PATHNAME', 'spatiotemporal_append_instant'
+    LANGUAGE C IMMUTABLE;
+
+CREATE OR REPLACE FUNCTION st_compact(spatiotemporal)
+    RETURNS spatiotemporal
+    AS 'MODULE_PATHNAME', 'spatiotemporal_compact'
+    LANGUAGE C IMMUTABLE STRICT;
+
+-- instants must be aggregated in time order: st_trajectory_agg(geom, t ORDER BY t)
+CREATE AGGREGATE st_trajectory_agg(geometry, timestamp)
+(
+    sfunc = st_append_instant,
+    stype = spatiotemporal,
+    finalfunc = st_compact
+);
+
+CREATE OR REPLACE FUNCTION st_srid(spatiotemporal)
+    RETURNS integer
+    AS 'MODULE_PATHNAME', 'spatiotemporal_get_srid'
+    LANGUAGE C IMMUTABLE STRICT;
+
+CREATE OR REPLACE FUNCTION st_setsrid(spatiotemporal, integer)
+    RETURNS spatiotemporal
+    AS 'MODULE_PATHNAME', 'spatiotemporal_set_srid'
+    LANGUAGE C IMMUTABLE STRICT;
+
+--
+-- Planner statistics
+--
+CREATE OR REPLACE FUNCTION spatiotemporal_analyze(internal)
+    RETURNS boolean
+    AS 'MODULE_PATHNAME', 'spatiotemporal_analyze'
+    LANGUAGE C VOLATILE STRICT;
+
+CREATE OR REPLACE FUNCTION spatiotemporal_overlaps_sel(internal, oid, internal, integer)
+    RETURNS float8
+    AS 'MODULE_PATHNAME', 'spatiotemporal_overlaps_sel'
+    LANGUAGE C IMMUTABLE STRICT;
+
+CREATE OR REPLACE FUNCTION spatiotemporal_overlaps_joinsel(internal, oid, internal, smallint, internal)
+    RETURNS float8
+    AS 'MODULE_PATHNAME', 'spatiotemporal_overlaps_joinsel'
+    LANGUAGE C IMMUTABLE STRICT;
+
 CREATE TYPE spatiotemporal
 (
     input = spatiotemporal_make,
     output = spatiotemporal_out,
+    send = spatiotemporal_send,
+    receive = spatiotemporal_recv,
+    typmod_in = spatiotemporal_typmod_in,
+    typmod_out = spatiotemporal_typmod_out,
+    analyze = spatiotemporal_analyze,
     internallength = variable,
     storage = extended,
     alignment = double
 );
+
+
+--
+-- Type modifier enforcement: spatiotemporal(srid [, dims [, precision]])
+--
+CREATE OR REPLACE FUNCTION spatiotemporal(spatiotemporal, integer, boolean)
+    RETURNS spatiotemporal
+    AS 'MODULE_PATHNAME', 'spatiotemporal_enforce_typmod'
+    LANGUAGE C IMMUTABLE STRICT;
+
+CREATE CAST (spatiotemporal AS spatiotemporal)
+    WITH FUNCTION spatiotemporal(spatiotemporal, integer, boolean)
+    AS IMPLICIT;
+
+
+--
+-- Overlap operators: space-time extent, spatial extent and time period
+--
+CREATE OR REPLACE FUNCTION spatiotemporal_overlaps(spatiotemporal, spatiotemporal)
+    RETURNS boolean
+    AS 'MODULE_PATHNAME', 'spatiotemporal_overlaps'
+    LANGUAGE C IMMUTABLE STRICT;
+
+CREATE OR REPLACE FUNCTION spatiotemporal_overlaps(spatiotemporal, geometry)
+    RETURNS boolean
+    AS 'MODULE_PATHNAME', 'spatiotemporal_overlaps_geometry'
+    LANGUAGE C IMMUTABLE STRICT;
+
+CREATE OR REPLACE FUNCTION spatiotemporal_overlaps(spatiotemporal, tsrange)
+    RETURNS boolean
+    AS 'MODULE_PATHNAME', 'spatiotemporal_overlaps_period'
+    LANGUAGE C IMMUTABLE STRICT;
+
+CREATE OPERATOR && (
+    LEFTARG = spatiotemporal,
+    RIGHTARG = spatiotemporal,
+    PROCEDURE = spatiotemporal_overlaps,
+    COMMUTATOR = &&,
+    RESTRICT = spatiotemporal_overlaps_sel,
+    JOIN = spatiotemporal_overlaps_joinsel
+);
+
+CREATE OPERATOR && (
+    LEFTARG = spatiotemporal,
+    RIGHTARG = geometry,
+    PROCEDURE = spatiotemporal_overlaps,
+    RESTRICT = spatiotemporal_overlaps_sel,
+    JOIN = spatiotemporal_overlaps_joinsel
+);
+
+CREATE OPERATOR && (
+    LEFTARG = spatiotemporal,
+    RIGHTARG = tsrange,
+    PROCEDURE = spatiotemporal_overlaps,
+    RESTRICT = spatiotemporal_overlaps_sel,
+    JOIN = spatiotemporal_overlaps_joinsel
+);
+
+
+--
+-- Casts to and from LINESTRING M, with M holding the Unix epoch of each instant
+--
+CREATE OR REPLACE FUNCTION geometry(spatiotemporal)
+    RETURNS geometry
+    AS 'MODULE_PATHNAME', 'spatiotemporal_to_geometry'
+    LANGUAGE C IMMUTABLE STRICT;
+
+CREATE OR REPLACE FUNCTION spatiotemporal(geometry)
+    RETURNS spatiotemporal
+    AS 'MODULE_PATHNAME', 'spatiotemporal_from_geometry'
+    LANGUAGE C IMMUTABLE STRICT;
+
+CREATE CAST (spatiotemporal AS geometry) WITH FUNCTION geometry(spatiotemporal);
+
+CREATE CAST (geometry AS spatiotemporal) WITH FUNCTION spatiotemporal(geometry);
+
+
+--
+-- B-tree and hash support
+--
+CREATE OR REPLACE FUNCTION st_normalize(spatiotemporal)
+    RETURNS spatiotemporal
+    AS 'MODULE_PATHNAME', 'spatiotemporal_normalize'
+    LANGUAGE C IMMUTABLE STRICT;
+
+CREATE OR REPLACE FUNCTION spatiotemporal_cmp(spatiotemporal, spatiotemporal)
+    RETURNS integer
+    AS 'MODULE_PATHNAME', 'spatiotemporal_cmp'
+    LANGUAGE C IMMUTABLE STRICT;
+
+CREATE OR REPLACE FUNCTION spatiotemporal_sortsupport(internal)
+    RETURNS void
+    AS 'MODULE_PATHNAME', 'spatiotemporal_sortsupport'
+    LANGUAGE C IMMUTABLE STRICT;
+
+CREATE OR REPLACE FUNCTION spatiotemporal_eq(spatiotemporal, spatiotemporal)
+    RETURNS boolean
+    AS 'MODULE_PATHNAME', 'spatiotemporal_eq'
+    LANGUAGE C IMMUTABLE STRICT;
+
+CREATE OR REPLACE FUNCTION spatiotemporal_ne(spatiotemporal, spatiotemporal)
+    RETURNS boolean
+    AS 'MODULE_PATHNAME', 'spatiotemporal_ne'
+    LANGUAGE C IMMUTABLE STRICT;
+
+CREATE OR REPLACE FUNCTION spatiotemporal_lt(spatiotemporal, spatiotemporal)
+    RETURNS boolean
+    AS 'MODULE_PATHNAME', 'spatiotemporal_lt'
+    LANGUAGE C IMMUTABLE STRICT;
+
+CREATE OR REPLACE FUNCTION spatiotemporal_le(spatiotemporal, spatiotemporal)
+    RETURNS boolean
+    AS 'MODULE_PATHNAME', 'spatiotemporal_le'
+    LANGUAGE C IMMUTABLE STRICT;
+
+CREATE OR REPLACE FUNCTION spatiotemporal_gt(spatiotemporal, spatiotemporal)
+    RETURNS boolean
+    AS 'MODULE_PATHNAME', 'spatiotemporal_gt'
+    LANGUAGE C IMMUTABLE STRICT;
+
+CREATE OR REPLACE FUNCTION spatiotemporal_ge(spatiotemporal, spatiotemporal)
+    RETURNS boolean
+    AS 'MODULE_PATHNAME', 'spatiotemporal_ge'
+    LANGUAGE C IMMUTABLE STRICT;
+
+CREATE OR REPLACE FUNCTION spatiotemporal_hash(spatiotemporal)
+    RETURNS integer
+    AS 'MODULE_PATHNAME', 'spatiotemporal_hash'
+    LANGUAGE C IMMUTABLE STRICT;
+
+CREATE OR REPLACE FUNCTION spatiotemporal_hash_extended(spatiotemporal, bigint)
+    RETURNS bigint
+    AS 'MODULE_PATHNAME', 'spatiotemporal_hash_extended'
+    LANGUAGE C IMMUTABLE STRICT;
+
+CREATE OPERATOR = (
+    LEFTARG = spatiotemporal,
+    RIGHTARG = spatiotemporal,
+    PROCEDURE = spatiotemporal_eq,
+    COMMUTATOR = =,
+    NEGATOR = <>,
+    RESTRICT = eqsel,
+    JOIN = eqjoinsel,
+    HASHES,
+    MERGES
+);
+
+CREATE OPERATOR <> (
+    LEFTARG = spatiotemporal,
+    RIGHTARG = spatiotemporal,
+    PROCEDURE = spatiotemporal_ne,
+    COMMUTATOR = <>,
+    NEGATOR = =,
+    RESTRICT = neqsel,
+    JOIN = neqjoinsel
+);
+
+CREATE OPERATOR < (
+    LEFTARG = spatiotemporal,
+    RIGHTARG = spatiotemporal,
+    PROCEDURE = spatiotemporal_lt,
+    COMMUTATOR = >,
+    NEGATOR = >=,
+    RESTRICT = scalarltsel,
+    JOIN = scalarltjoinsel
+);
+
+CREATE OPERATOR <= (
+    LEFTARG = spatiotemporal,
+    RIGHTARG = spatiotemporal,
+    PROCEDURE = spatiotemporal_le,
+    COMMUTATOR = >=,
+    NEGATOR = >,
+    RESTRICT = scalarltsel,
+    JOIN = scalarltjoinsel
+);
+
+CREATE OPERATOR > (
+    LEFTARG = spatiotemporal,
+    RIGHTARG = spatiotemporal,
+    PROCEDURE = spatiotemporal_gt,
+    COMMUTATOR = <,
+    NEGATOR = <=,
+    RESTRICT = scalargtsel,
+    JOIN = scalargtjoinsel
+);
+
+CREATE OPERATOR >= (
+    LEFTARG = spatiotemporal,
+    RIGHTARG = spatiotemporal,
+    PROCEDURE = spatiotemporal_ge,
+    COMMUTATOR = <=,
+    NEGATOR = <,
+    RESTRICT = scalargtsel,
+    JOIN = scalargtjoinsel
+);
+
+CREATE OPERATOR CLASS spatiotemporal_btree_ops
+    DEFAULT FOR TYPE spatiotemporal USING btree AS
+        OPERATOR 1 <,
+        OPERATOR 2 <=,
+        OPERATOR 3 =,
+        OPERATOR 4 >=,
+        OPERATOR 5 >,
+        FUNCTION 1 spatiotemporal_cmp(spatiotemporal, spatiotemporal),
+        FUNCTION 2 spatiotemporal_sortsupport(internal);
+
+CREATE OPERATOR CLASS spatiotemporal_hash_ops
+    DEFAULT FOR TYPE spatiotemporal USING hash AS
+        OPERATOR 1 =,
+        FUNCTION 1 spatiotemporal_hash(spatiotemporal),
+        FUNCTION 2 spatiotemporal_hash_extended(spatiotemporal, bigint);
+
+
+--
+-- Trajectory similarity. A negative band disables the Sakoe-Chiba band;
+-- results above the threshold are returned as Infinity.
+--
+CREATE OR REPLACE FUNCTION st_dtw(spatiotemporal, spatiotemporal,
+                                  band integer DEFAULT -1,
+                                  threshold float8 DEFAULT 'Infinity')
+    RETURNS float8
+    AS 'MODULE_PATHNAME', 'spatiotemporal_dtw'
+    LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE OR REPLACE FUNCTION st_frechet(spatiotemporal, spatiotemporal,
+                                      band integer DEFAULT -1,
+                                      threshold float8 DEFAULT 'Infinity')
+    RETURNS float8
+    AS 'MODULE_PATHNAME', 'spatiotemporal_frechet'
+    LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE OR REPLACE FUNCTION st_hausdorff(spatiotemporal, spatiotemporal,
+                                        threshold float8 DEFAULT 'Infinity')
+    RETURNS float8
+    AS 'MODULE_PATHNAME', 'spatiotemporal_hausdorff'
+    LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+
+--
+-- Proximity join: intervals during which two trajectories of the array are
+-- within distance of each other. Instants more than max_gap apart are not
+-- interpolated; a NULL max_gap joins all consecutive instants. The distance
+-- is planar, in the coordinate units of the SRID (degrees for SRID 4326).
+--
+CREATE OR REPLACE FUNCTION st_proximity_pairs(spatiotemporal[], distance float8, max_gap interval,
+                                              OUT i integer, OUT j integer,
+                                              OUT t_from timestamp, OUT t_to timestamp)
+    RETURNS SETOF record
+    AS 'MODULE_PATHNAME', 'spatiotemporal_proximity_pairs'
+    LANGUAGE C IMMUTABLE CALLED ON NULL INPUT;
+
+
+--
+-- Chunked storage and time restriction. st_value_at and st_at_period only
+-- fetch the chunks they need from chunked values stored uncompressed
+-- (ALTER TABLE ... ALTER COLUMN ... SET STORAGE EXTERNAL). st_at_period
+-- starts and ends the result with positions interpolated at the bounds of
+-- the period. Chunked values keep their layout in typmod'd columns.
+--
+CREATE OR REPLACE FUNCTION st_chunk(spatiotemporal, chunk_interval interval)
+    RETURNS spatiotemporal
+    AS 'MODULE_PATHNAME', 'spatiotemporal_chunk'
+    LANGUAGE C IMMUTABLE STRICT;
+
+CREATE OR REPLACE FUNCTION st_value_at(spatiotemporal, timestamp)
+    RETURNS geometry
+    AS 'MODULE_PATHNAME', 'spatiotemporal_value_at'
+    LANGUAGE C IMMUTABLE STRICT;
+
+CREATE OR REPLACE FUNCTION st_at_period(spatiotemporal, tsrange)
+    RETURNS spatiotemporal
+    AS 'MODULE_PATHNAME', 'spatiotemporal_at_period'
+    LANGUAGE C IMMUTABLE STRICT;
+
+
+--
+-- Reprojection
+--
+CREATE OR REPLACE FUNCTION st_transform(spatiotemporal, integer)
+    RETURNS spatiotemporal
+    AS 'MODULE_PATHNAME', 'spatiotemporal_transform'
+    LANGUAGE C IMMUTABLE STRICT;
+
+
+--
+-- temporal_float: a time series of float values sharing the time layout of
+-- spatiotemporal, linearly interpolated between instants
+--
+DROP TYPE IF EXISTS temporal_float;
+CREATE TYPE temporal_float;
+
+CREATE OR REPLACE FUNCTION temporal_float_in(cstring)
+    RETURNS temporal_float
+    AS 'MODULE_PATHNAME', 'temporal_float_in'
+    LANGUAGE C IMMUTABLE STRICT;
+
+CREATE OR REPLACE FUNCTION temporal_float_out(temporal_float)
+    RETURNS cstring
+    AS 'MODULE_PATHNAME', 'temporal_float_out'
+    LANGUAGE C IMMUTABLE STRICT;
+
+CREATE TYPE temporal_float
+(
+    input = temporal_float_in,
+    output = temporal_float_out,
+    internallength = variable,
+    storage = extended,
+    alignment = double
+);
+
+CREATE OR REPLACE FUNCTION tf_append_instant(temporal_float, float8, timestamp)
+    RETURNS temporal_float
+    AS 'MODULE_PATHNAME', 'temporal_float_append_instant'
+    LANGUAGE C IMMUTABLE;
+
+CREATE OR REPLACE FUNCTION st_compact(temporal_float)
+    RETURNS temporal_float
+    AS 'MODULE_PATHNAME', 'temporal_float_compact'
+    LANGUAGE C IMMUTABLE STRICT;
+
+-- instants must be aggregated in time order: temporal_float_agg(v, t ORDER BY t)
+CREATE AGGREGATE temporal_float_agg(float8, timestamp)
+(
+    sfunc = tf_append_instant,
+    stype = temporal_float,
+    finalfunc = st_compact
+);
+
+CREATE OR REPLACE FUNCTION get_start_time(temporal_float)
+    RETURNS timestamp
+    AS 'MODULE_PATHNAME', 'temporal_float_get_start_time'
+    LANGUAGE C IMMUTABLE STRICT;
+
+CREATE OR REPLACE FUNCTION get_end_time(temporal_float)
+    RETURNS timestamp
+    AS 'MODULE_PATHNAME', 'temporal_float_get_end_time'
+    LANGUAGE C IMMUTABLE STRICT;
+
+CREATE OR REPLACE FUNCTION tw_avg(temporal_float)
+    RETURNS float8
+    AS 'MODULE_PATHNAME', 'temporal_float_tw_avg'
+    LANGUAGE C IMMUTABLE STRICT;
+
+CREATE OR REPLACE FUNCTION tw_min(temporal_float)
+    RETURNS float8
+    AS 'MODULE_PATHNAME', 'temporal_float_tw_min'
+    LANGUAGE C IMMUTABLE STRICT;
+
+CREATE OR REPLACE FUNCTION tw_max(temporal_float)
+    RETURNS float8
+    AS 'MODULE_PATHNAME', 'temporal_float_tw_max'
+    LANGUAGE C IMMUTABLE STRICT;
+
+CREATE OR REPLACE FUNCTION st_value_at(temporal_float, timestamp)
+    RETURNS float8
+    AS 'MODULE_PATHNAME', 'temporal_float_value_at'
+    LANGUAGE C IMMUTABLE STRICT;
+
+-- values at the bounds of the period are interpolated
+CREATE OR REPLACE FUNCTION st_at_period(temporal_float, tsrange)
+    RETURNS temporal_float
+    AS 'MODULE_PATHNAME', 'temporal_float_at_period'
+    LANGUAGE C IMMUTABLE STRICT;
+
+
+--
+-- Space-time density grid: seconds spent by the trajectories in each cell of
+-- a regular grid over 'extent', per 'time_bucket' of 'period'. The last
+-- bucket stops at the end of 'period'. The trajectories must be in the SRID
+-- of 'extent'. The result is a float8[time bucket][row][column] array.
+--
+CREATE OR REPLACE FUNCTION st_density_grid_transfn(internal, spatiotemporal, geometry, tsrange, integer, integer, interval)
+    RETURNS internal
+    AS 'MODULE_PATHNAME', 'spatiotemporal_density_grid_transfn'
+    LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+CREATE OR REPLACE FUNCTION st_density_grid_combinefn(internal, internal)
+    RETURNS internal
+    AS 'MODULE_PATHNAME', 'spatiotemporal_density_grid_combinefn'
+    LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+CREATE OR REPLACE FUNCTION st_density_grid_serialfn(internal)
+    RETURNS bytea
+    AS 'MODULE_PATHNAME', 'spatiotemporal_density_grid_serialfn'
+    LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE OR REPLACE FUNCTION st_density_grid_deserialfn(bytea, internal)
+    RETURNS internal
+    AS 'MODULE_PATHNAME', 'spatiotemporal_density_grid_deserialfn'
+    LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE OR REPLACE FUNCTION st_density_grid_finalfn(internal)
+    RETURNS float8[]
+    AS 'MODULE_PATHNAME', 'spatiotemporal_density_grid_finalfn'
+    LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+CREATE AGGREGATE st_density_grid(track spatiotemporal, extent geometry, period tsrange,
+                                 ncols integer, nrows integer, time_bucket interval)
+(
+    sfunc = st_density_grid_transfn,
+    stype = internal,
+    finalfunc = st_density_grid_finalfn,
+    combinefunc = st_density_grid_combinefn,
+    serialfunc = st_density_grid_serialfn,
+    deserialfunc = st_density_grid_deserialfn,
+    parallel = safe
+);
+
+
+--
+-- Vector tiles: positions must be in Web Mercator (EPSG:3857); values with
+-- another SRID are rejected, values without one are taken as Web Mercator
+--
+CREATE OR REPLACE FUNCTION st_as_trajectory_tile(spatiotemporal, z integer, x integer, y integer)
+    RETURNS geometry
+    AS 'MODULE_PATHNAME', 'spatiotemporal_as_tile'
+    LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE OR REPLACE FUNCTION st_as_trajectory_mvt_transfn(internal, spatiotemporal, integer, integer, integer)
+    RETURNS internal
+    AS 'MODULE_PATHNAME', 'spatiotemporal_as_mvt_transfn'
+    LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+CREATE OR REPLACE FUNCTION st_as_trajectory_mvt_transfn(internal, spatiotemporal, integer, integer, integer, text)
+    RETURNS internal
+    AS 'MODULE_PATHNAME', 'spatiotemporal_as_mvt_transfn'
+    LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+CREATE OR REPLACE FUNCTION st_as_trajectory_mvt_finalfn(internal)
+    RETURNS bytea
+    AS 'MODULE_PATHNAME', 'spatiotemporal_as_mvt_finalfn'
+    LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+CREATE AGGREGATE st_as_trajectory_mvt(spatiotemporal, z integer, x integer, y integer)
+(
+    sfunc = st_as_trajectory_mvt_transfn,
+    stype = internal,
+    finalfunc = st_as_trajectory_mvt_finalfn
+);
+
+CREATE AGGREGATE st_as_trajectory_mvt(spatiotemporal, z integer, x integer, y integer, name text)
+(
+    sfunc = st_as_trajectory_mvt_transfn,
+    stype = internal,
+    finalfunc = st_as_trajectory_mvt_finalfn
+);
+
+
+--
+-- GiST operator class for &&. Index keys are header-only spatiotemporal
+-- values holding the period and the extent.
+--
+CREATE OR REPLACE FUNCTION spatiotemporal_gist_consistent(internal, spatiotemporal, smallint, oid, internal)
+    RETURNS boolean
+    AS 'MODULE_PATHNAME', 'spatiotemporal_gist_consistent'
+    LANGUAGE C IMMUTABLE STRICT;
+
+CREATE OR REPLACE FUNCTION spatiotemporal_gist_union(internal, internal)
+    RETURNS spatiotemporal
+    AS 'MODULE_PATHNAME', 'spatiotemporal_gist_union'
+    LANGUAGE C IMMUTABLE STRICT;
+
+CREATE OR REPLACE FUNCTION spatiotemporal_gist_compress(internal)
+    RETURNS internal
+    AS 'MODULE_PATHNAME', 'spatiotemporal_gist_compress'
+    LANGUAGE C IMMUTABLE STRICT;
+
+CREATE OR REPLACE FUNCTION spatiotemporal_gist_decompress(internal)
+    RETURNS internal
+    AS 'MODULE_PATHNAME', 'spatiotemporal_gist_decompress'
+    LANGUAGE C IMMUTABLE STRICT;
+
+CREATE OR REPLACE FUNCTION spatiotemporal_gist_penalty(internal, internal, internal)
+    RETURNS internal
+    AS 'MODULE_PATHNAME', 'spatiotemporal_gist_penalty'
+    LANGUAGE C IMMUTABLE STRICT;
+
+CREATE OR REPLACE FUNCTION spatiotemporal_gist_picksplit(internal, internal)
+    RETURNS internal
+    AS 'MODULE_PATHNAME', 'spatiotemporal_gist_picksplit'
+    LANGUAGE C IMMUTABLE STRICT;
+
+CREATE OR REPLACE FUNCTION spatiotemporal_gist_same(spatiotemporal, spatiotemporal, internal)
+    RETURNS internal
+    AS 'MODULE_PATHNAME', 'spatiotemporal_gist_same'
+    LANGUAGE C IMMUTABLE STRICT;
+
+CREATE OPERATOR CLASS spatiotemporal_gist_ops
+    DEFAULT FOR TYPE spatiotemporal USING gist AS
+    OPERATOR 1 && (spatiotemporal, spatiotemporal),
+    OPERATOR 2 && (spatiotemporal, geometry),
+    OPERATOR 3 && (spatiotemporal, tsrange),
+    FUNCTION 1 spatiotemporal_gist_consistent(internal, spatiotemporal, smallint, oid, internal),
+    FUNCTION 2 spatiotemporal_gist_union(internal, internal),
+    FUNCTION 3 spatiotemporal_gist_compress(internal),
+    FUNCTION 4 spatiotemporal_gist_decompress(internal),
+    FUNCTION 5 spatiotemporal_gist_penalty(internal, internal, internal),
+    FUNCTION 6 spatiotemporal_gist_picksplit(internal, internal),
+    FUNCTION 7 spatiotemporal_gist_same(spatiotemporal, spatiotemporal, internal);
+
+
+--
+-- Predicates. On PostgreSQL 12 and later a support function turns them
+-- into && index conditions and estimates their selectivity and cost.
+--
+CREATE OR REPLACE FUNCTION st_intersects(spatiotemporal, geometry)
+    RETURNS boolean
+    AS 'MODULE_PATHNAME', 'spatiotemporal_intersects'
+    LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE OR REPLACE FUNCTION st_during(spatiotemporal, tsrange)
+    RETURNS boolean
+    AS 'MODULE_PATHNAME', 'spatiotemporal_during'
+    LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+DO $$
+BEGIN
+    IF current_setting('server_version_num')::integer >= 120000 THEN
+        EXECUTE $sql$
+            CREATE OR REPLACE FUNCTION spatiotemporal_intersects_support(internal)
+                RETURNS internal
+                AS 'MODULE_PATHNAME', 'spatiotemporal_intersects_support'
+                LANGUAGE C IMMUTABLE STRICT
+        $sql$;
+
+        EXECUTE $sql$
+            CREATE OR REPLACE FUNCTION spatiotemporal_during_support(internal)
+                RETURNS internal
+                AS 'MODULE_PATHNAME', 'spatiotemporal_during_support'
+                LANGUAGE C IMMUTABLE STRICT
+        $sql$;
+
+        EXECUTE 'ALTER FUNCTION st_intersects(spatiotemporal, geometry) SUPPORT spatiotemporal_intersects_support';
+        EXECUTE 'ALTER FUNCTION st_during(spatiotemporal, tsrange) SUPPORT spatiotemporal_during_support';
+    END IF;
+END;
+$$;
+
+
+--
+-- Parallel conversion of a table of fixes into one spatiotemporal per id.
+-- Needs postgist in shared_preload_libraries. The target table must start
+-- with an id column of the type of the source id, followed by a
+-- spatiotemporal column.
+--
+CREATE OR REPLACE FUNCTION postgist_build_trajectories(source regclass, id_col text, geom_col text, time_col text,
+                                                       target regclass, workers integer DEFAULT 4)
+    RETURNS bigint
+    AS 'MODULE_PATHNAME', 'postgist_build_trajectories'
+    LANGUAGE C VOLATILE STRICT;
+
+CREATE OR REPLACE FUNCTION postgist_build_status(OUT build_id bigint, OUT worker integer, OUT workers integer,
+                                                 OUT pid integer, OUT state text,
+                                                 OUT source regclass, OUT target regclass,
+                                                 OUT rows_read bigint, OUT rows_skipped bigint,
+                                                 OUT trajectories bigint,
+                                                 OUT started timestamptz, OUT finished timestamptz,
+                                                 OUT error text)
+    RETURNS SETOF record
+    AS 'MODULE_PATHNAME', 'postgist_build_status'
+    LANGUAGE C VOLATILE STRICT;
+
+CREATE VIEW postgist_build_status AS SELECT * FROM postgist_build_status();
+
+
+--
+-- moving_region: time-stamped POLYGON or MULTIPOLYGON snapshots, e.g.
+-- 'SRID=4326;ST_MOVINGREGION(POLYGON((0 0,1 0,1 1,0 0)), 2015-05-18 10:00:00; ...)'.
+-- Vertices move linearly between snapshots with the same rings.
+--
+DROP TYPE IF EXISTS moving_region;
+CREATE TYPE moving_region;
+
+CREATE OR REPLACE FUNCTION moving_region_in(cstring)
+    RETURNS moving_region
+    AS 'MODULE_PATHNAME', 'moving_region_in'
+    LANGUAGE C IMMUTABLE STRICT;
+
+CREATE OR REPLACE FUNCTION moving_region_out(moving_region)
+    RETURNS cstring
+    AS 'MODULE_PATHNAME', 'moving_region_out'
+    LANGUAGE C IMMUTABLE STRICT;
+
+CREATE TYPE moving_region
+(
+    input = moving_region_in,
+    output = moving_region_out,
+    internallength = variable,
+    storage = extended,
+    alignment = double
+);
+
+CREATE OR REPLACE FUNCTION moving_region_agg_transfn(internal, geometry, timestamp)
+    RETURNS internal
+    AS 'MODULE_PATHNAME', 'moving_region_agg_transfn'
+    LANGUAGE C IMMUTABLE;
+
+CREATE OR REPLACE FUNCTION moving_region_agg_finalfn(internal)
+    RETURNS moving_region
+    AS 'MODULE_PATHNAME', 'moving_region_agg_finalfn'
+    LANGUAGE C IMMUTABLE;
+
+-- snapshots must be aggregated in time order: moving_region_agg(geom, t ORDER BY t)
+CREATE AGGREGATE moving_region_agg(geometry, timestamp)
+(
+    sfunc = moving_region_agg_transfn,
+    stype = internal,
+    finalfunc = moving_region_agg_finalfn
+);
+
+CREATE OR REPLACE FUNCTION get_start_time(moving_region)
+    RETURNS timestamp
+    AS 'MODULE_PATHNAME', 'moving_region_get_start_time'
+    LANGUAGE C IMMUTABLE STRICT;
+
+CREATE OR REPLACE FUNCTION get_end_time(moving_region)
+    RETURNS timestamp
+    AS 'MODULE_PATHNAME', 'moving_region_get_end_time'
+    LANGUAGE C IMMUTABLE STRICT;
+
+CREATE OR REPLACE FUNCTION st_value_at(moving_region, timestamp)
+    RETURNS geometry
+    AS 'MODULE_PATHNAME', 'moving_region_value_at'
+    LANGUAGE C IMMUTABLE STRICT;
+
+CREATE OR REPLACE FUNCTION st_snapshots(moving_region, OUT geom geometry, OUT t timestamp)
+    RETURNS SETOF record
+    AS 'MODULE_PATHNAME', 'moving_region_snapshots'
+    LANGUAGE C IMMUTABLE STRICT;
+
+CREATE OR REPLACE FUNCTION st_intersects(moving_region, geometry)
+    RETURNS boolean
+    AS 'MODULE_PATHNAME', 'moving_region_intersects'
+    LANGUAGE C IMMUTABLE STRICT;
+
+--
+-- Geofences: the polygons of postgist_geofence are kept in shared memory,
+-- indexed by an R-tree. postgist_geofence_trigger(id_column, track_column),
+-- as an AFTER INSERT OR UPDATE ... FOR EACH ROW trigger on a table of
+-- trajectories, tests the instants appended to the track and records the
+-- enter and exit events in postgist_geofence_event. On UPDATE only the end
+-- of the track is read; with STORAGE EXTERNAL on the track column that read
+-- does not depend on the length of the track. Needs postgist in
+-- shared_preload_libraries.
+--
+CREATE TABLE postgist_geofence
+(
+    id integer PRIMARY KEY,
+    name text,
+    geom geometry NOT NULL
+);
+
+CREATE TABLE postgist_geofence_event
+(
+    event_id bigserial PRIMARY KEY,
+    object_id text NOT NULL,
+    fence_id integer NOT NULL,
+    event text NOT NULL,
+    t timestamp NOT NULL,
+    position geometry,
+    created timestamptz NOT NULL DEFAULT now()
+);
+
+SELECT pg_catalog.pg_extension_config_dump('postgist_geofence', '');
+SELECT pg_catalog.pg_extension_config_dump('postgist_geofence_event', '');
+SELECT pg_catalog.pg_extension_config_dump('postgist_geofence_event_event_id_seq', '');
+
+CREATE OR REPLACE FUNCTION postgist_geofence_reload()
+    RETURNS integer
+    AS 'MODULE_PATHNAME', 'postgist_geofence_reload'
+    LANGUAGE C VOLATILE STRICT;
+
+CREATE OR REPLACE FUNCTION postgist_geofence_invalidate()
+    RETURNS trigger
+    AS 'MODULE_PATHNAME', 'postgist_geofence_invalidate'
+    LANGUAGE C;
+
+CREATE OR REPLACE FUNCTION postgist_geofence_trigger()
+    RETURNS trigger
+    AS 'MODULE_PATHNAME', 'postgist_geofence_trigger'
+    LANGUAGE C;
+
+CREATE TRIGGER postgist_geofence_invalidate
+    AFTER INSERT OR UPDATE OR DELETE OR TRUNCATE ON postgist_geofence
+    FOR EACH STATEMENT EXECUTE PROCEDURE postgist_geofence_invalidate();
+
+-- events of the instants after 'since', or of the whole track if it is NULL
+CREATE OR REPLACE FUNCTION st_geofence_events(spatiotemporal, since timestamp DEFAULT NULL,
+                                              OUT fence_id integer, OUT event text,
+                                              OUT t timestamp, OUT position geometry)
+    RETURNS SETOF record
+    AS 'MODULE_PATHNAME', 'spatiotemporal_geofence_events'
+    LANGUAGE C STABLE;
@@ -31,6 +31,10 @@
  *
  */
 
+/* PostGIS-T extension */
+#include "build.h"
+#include "geofence.h"
+
 /* PostgreSQL */
 #include <postgres.h>
 #include <fmgr.h>
@@ -52,6 +56,12 @@ PG_MODULE_MAGIC;
 void _PG_init()
 {
   /*elog(NOTICE, "PostGIS-T initialized!");*/
+
+  /* shared status of the trajectory build workers */
+  st_build_init();
+
+  /* shared geofence registry */
+  st_geofence_init();
 }
 
 
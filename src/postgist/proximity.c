@@ -0,0 +1,687 @@
+/*
+  Copyright (C) 2017 National Institute For Space Research (INPE) - Brazil.
+
+  postgis-t is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License version 3 as
+  published by the Free Software Foundation.
+
+  postgis-t is distributed  "AS-IS" in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY OF ANY KIND; without even the implied warranty
+  of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with postgis-t. See LICENSE. If not, write to
+  Gilberto Ribeiro de Queiroz at <gribeiro@dpi.inpe.br>.
+
+ */
+
+/*!
+ *
+ * \file postgist/proximity.c
+ *
+ * \brief Proximity join of a set of trajectories: the time intervals during
+ *        which two moving objects are within a given distance.
+ *
+ * Consecutive instants of a trajectory form a segment along which the
+ * position is linearly interpolated; instants farther apart than the
+ * maximum gap are not joined. Segments are swept in start time order.
+ * Segments that have not ended yet stay registered in a uniform grid, so
+ * each new segment is only tested against nearby, concurrent segments of
+ * other trajectories. Distances are planar, in the raw coordinate units of
+ * the SRID: degrees, not meters, for a geographic SRID such as 4326.
+ *
+ * \author Gilberto Ribeiro de Queiroz
+ * \author Fabiana Zioti
+ *
+ * \date 2017
+ *
+ * \copyright GNU Lesser Public License version 3
+ *
+ */
+
+/* PostGIS-T extension */
+#include "spatiotemporal.h"
+
+/* PostgreSQL */
+#include <access/htup_details.h>
+#include <funcapi.h>
+#include <miscadmin.h>
+#include <utils/array.h>
+#include <utils/hsearch.h>
+#include <utils/lsyscache.h>
+
+/* C Standard Library */
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+
+
+/*
+ * segments spanning more grid cells than this along an axis are kept in a
+ * list that every probe checks instead of being registered in each cell
+ */
+#define MAX_CELLS_PER_AXIS 64
+
+/*
+ * grid cell indices are clamped to this magnitude so that huge coordinates
+ * or a tiny cell size can not overflow the conversion to int64
+ */
+#define MAX_CELL_INDEX 4503599627370496.0
+
+
+struct segment
+{
+  int32 traj;       /* 1-based index in the input array */
+  double t0, t1;    /* seconds since the earliest instant */
+  double x0, y0;
+  double x1, y1;
+};
+
+
+struct encounter
+{
+  int32 i;
+  int32 j;
+  double t_from;
+  double t_to;
+};
+
+
+struct grid_key
+{
+  int64 cx;
+  int64 cy;
+};
+
+
+struct grid_cell
+{
+  struct grid_key key;
+  int32 *items;
+  int32 nitems;
+  int32 capacity;
+};
+
+
+struct proximity_state
+{
+  struct encounter *encounters;
+  int32 nencounters;
+  int32 next;
+  Timestamp base;
+};
+
+
+static int segment_cmp(const void *a, const void *b)
+{
+  const struct segment *s = (const struct segment*) a;
+  const struct segment *t = (const struct segment*) b;
+
+  return (s->t0 < t->t0) ? -1 : ((s->t0 > t->t0) ? 1 : 0);
+}
+
+
+static int encounter_cmp(const void *a, const void *b)
+{
+  const struct encounter *e = (const struct encounter*) a;
+  const struct encounter *f = (const struct encounter*) b;
+
+  if(e->i != f->i)
+    return e->i < f->i ? -1 : 1;
+
+  if(e->j != f->j)
+    return e->j < f->j ? -1 : 1;
+
+  return (e->t_from < f->t_from) ? -1 : ((e->t_from > f->t_from) ? 1 : 0);
+}
+
+
+static inline void segment_position(const struct segment *s, double t, double *x, double *y)
+{
+  double f = (t - s->t0) / (s->t1 - s->t0);
+
+  *x = s->x0 + (s->x1 - s->x0) * f;
+  *y = s->y0 + (s->y1 - s->y0) * f;
+}
+
+
+/*
+ * \brief Time window during which two concurrent segments are within
+ *        'distance': solves |r0 + v t|^2 <= d^2 over their common time.
+ *
+ */
+static bool segment_encounter(const struct segment *a, const struct segment *b, double distance,
+                              double *t_from, double *t_to)
+{
+  double ts = Max(a->t0, b->t0);
+
+  double te = Min(a->t1, b->t1);
+
+  double ax, ay, bx, by, ex, ey;
+
+  double rx, ry, vx, vy;
+
+  double qa, qb, qc;
+
+  double lo, hi;
+
+  if(ts > te)
+    return false;
+
+  segment_position(a, ts, &ax, &ay);
+  segment_position(b, ts, &bx, &by);
+  segment_position(a, te, &ex, &ey);
+
+  rx = ax - bx;
+  ry = ay - by;
+
+  segment_position(b, te, &bx, &by);
+
+  /* relative velocity over the common window */
+  vx = (te > ts) ? ((ex - bx) - rx) / (te - ts) : 0.0;
+  vy = (te > ts) ? ((ey - by) - ry) / (te - ts) : 0.0;
+
+  qa = vx * vx + vy * vy;
+  qb = 2.0 * (rx * vx + ry * vy);
+  qc = rx * rx + ry * ry - distance * distance;
+
+  if(qa == 0.0)
+  {
+    if(qc > 0.0)
+      return false;
+
+    lo = 0.0;
+    hi = te - ts;
+  }
+  else
+  {
+    double disc = qb * qb - 4.0 * qa * qc;
+
+    double sq;
+
+    if(disc < 0.0)
+      return false;
+
+    sq = sqrt(disc);
+
+    lo = Max((-qb - sq) / (2.0 * qa), 0.0);
+    hi = Min((-qb + sq) / (2.0 * qa), te - ts);
+
+    if(lo > hi)
+      return false;
+  }
+
+  *t_from = ts + lo;
+  *t_to = ts + hi;
+
+  return true;
+}
+
+
+/*
+ * \brief Grid cell index of coordinate 'v', clamped to MAX_CELL_INDEX.
+ *
+ */
+static inline int64 cell_index(double v, double cell_size)
+{
+  double c = floor(v / cell_size);
+
+  if(isnan(c) || c < -MAX_CELL_INDEX)
+    c = -MAX_CELL_INDEX;
+  else if(c > MAX_CELL_INDEX)
+    c = MAX_CELL_INDEX;
+
+  return (int64) c;
+}
+
+
+/*
+ * \brief Grid cells covered by a box; returns false if they are more than
+ *        MAX_CELLS_PER_AXIS along an axis.
+ *
+ */
+static inline bool cell_range(double xmin, double ymin, double xmax, double ymax, double cell_size,
+                              int64 *cx0, int64 *cy0, int64 *cx1, int64 *cy1)
+{
+  *cx0 = cell_index(xmin, cell_size);
+  *cy0 = cell_index(ymin, cell_size);
+  *cx1 = cell_index(xmax, cell_size);
+  *cy1 = cell_index(ymax, cell_size);
+
+  return (*cx1 - *cx0 < MAX_CELLS_PER_AXIS) && (*cy1 - *cy0 < MAX_CELLS_PER_AXIS);
+}
+
+
+static void add_encounter(struct proximity_state *state, int32 *capacity,
+                          int32 i, int32 j, double t_from, double t_to)
+{
+  struct encounter *e;
+
+  if(state->nencounters == *capacity)
+  {
+    *capacity *= 2;
+    state->encounters = (struct encounter*) repalloc(state->encounters, *capacity * sizeof(struct encounter));
+  }
+
+  e = &state->encounters[state->nencounters++];
+
+  e->i = Min(i, j);
+  e->j = Max(i, j);
+  e->t_from = t_from;
+  e->t_to = t_to;
+}
+
+
+/*
+ * \brief Build the segments of all trajectories, sorted by start time.
+ *
+ */
+static struct segment *build_segments(Datum *elems, bool *nulls, int nelems, int64 max_gap,
+                                      int32 *nsegments, Timestamp *base, double *mean_length)
+{
+  struct segment *segments;
+
+  int32 total = 0;
+
+  int32 n = 0;
+
+  int32 srid = -1;
+
+  double length_sum = 0.0;
+
+  struct spatiotemporal **values = (struct spatiotemporal**) palloc0(nelems * sizeof(struct spatiotemporal*));
+
+  *base = DT_NOEND;
+
+  for(int k = 0; k < nelems; ++k)
+  {
+    struct spatiotemporal *st;
+
+    if(nulls[k])
+      continue;
+
+    st = DatumGetSpatioTemporal(elems[k]);
+
+    if(st->npoints < 2)
+      continue;
+
+    if(srid != -1 && st->srid != srid)
+      ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                      errmsg("spatiotemporal values have different SRIDs (%d, %d)", srid, st->srid)));
+
+    srid = st->srid;
+
+    values[k] = st;
+
+    total += st->npoints - 1;
+
+    *base = Min(*base, ST_TIMES(st)[0]);
+  }
+
+  segments = (struct segment*) palloc(Max(total, 1) * sizeof(struct segment));
+
+  for(int k = 0; k < nelems; ++k)
+  {
+    struct spatiotemporal *st = values[k];
+
+    const double *coords;
+
+    const Timestamp *times;
+
+    int ndims;
+
+    if(st == NULL)
+      continue;
+
+    coords = ST_COORDS(st);
+    times = ST_TIMES(st);
+    ndims = ST_NDIMS(st);
+
+    for(int32 p = 0; p + 1 < st->npoints; ++p)
+    {
+      struct segment *s;
+
+      if(max_gap >= 0 && times[p + 1] - times[p] > max_gap)
+        continue;
+
+      s = &segments[n++];
+
+      s->traj = k + 1;
+      s->t0 = (double) (times[p] - *base) / USECS_PER_SEC;
+      s->t1 = (double) (times[p + 1] - *base) / USECS_PER_SEC;
+      s->x0 = coords[p * ndims];
+      s->y0 = coords[p * ndims + 1];
+      s->x1 = coords[(p + 1) * ndims];
+      s->y1 = coords[(p + 1) * ndims + 1];
+
+      length_sum += Max(fabs(s->x1 - s->x0), fabs(s->y1 - s->y0));
+    }
+  }
+
+  qsort(segments, n, sizeof(struct segment), segment_cmp);
+
+  *nsegments = n;
+
+  *mean_length = (n > 0) ? length_sum / n : 0.0;
+
+  return segments;
+}
+
+
+/*
+ * \brief Test segment 'k' against the earlier segment 'o' once.
+ *
+ */
+static inline void probe_pair(struct proximity_state *state, int32 *capacity, struct segment *segments,
+                              int32 *tested, int32 k, int32 o, double distance)
+{
+  struct segment *s = &segments[k];
+
+  struct segment *other = &segments[o];
+
+  double t_from, t_to;
+
+  if(other->traj == s->traj || tested[o] == k)
+    return;
+
+  tested[o] = k;
+
+  if(segment_encounter(s, other, distance, &t_from, &t_to))
+    add_encounter(state, capacity, s->traj, other->traj, t_from, t_to);
+}
+
+
+/*
+ * \brief Plane sweep over the segments, collecting the merged encounter
+ *        intervals of every pair of trajectories.
+ *
+ * \note Segments too long for the grid go to the 'large' list, checked by
+ *       every probe. A probe too long for the grid checks all the earlier
+ *       segments still under the sweep line.
+ *
+ */
+static void sweep(struct proximity_state *state, struct segment *segments, int32 nsegments,
+                  double distance, double mean_length)
+{
+  HASHCTL ctl;
+
+  HTAB *grid;
+
+  int32 *tested = (int32*) palloc(Max(nsegments, 1) * sizeof(int32));
+
+  int32 *large = (int32*) palloc(Max(nsegments, 1) * sizeof(int32));
+
+  int32 nlarge = 0;
+
+  int32 capacity = 64;
+
+  double cell_size = Max(distance, mean_length);
+
+  int32 nmerged = 0;
+
+  if(cell_size <= 0.0)
+    cell_size = 1.0;
+
+  memset(&ctl, 0, sizeof(ctl));
+  ctl.keysize = sizeof(struct grid_key);
+  ctl.entrysize = sizeof(struct grid_cell);
+  ctl.hcxt = CurrentMemoryContext;
+
+  grid = hash_create("spatiotemporal proximity grid", 1024, &ctl, HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+
+  state->encounters = (struct encounter*) palloc(capacity * sizeof(struct encounter));
+  state->nencounters = 0;
+
+  for(int32 k = 0; k < nsegments; ++k)
+    tested[k] = -1;
+
+  for(int32 k = 0; k < nsegments; ++k)
+  {
+    struct segment *s = &segments[k];
+
+    double xmin = Min(s->x0, s->x1), xmax = Max(s->x0, s->x1);
+    double ymin = Min(s->y0, s->y1), ymax = Max(s->y0, s->y1);
+
+    int64 cx0, cy0, cx1, cy1;
+
+    CHECK_FOR_INTERRUPTS();
+
+    /* probe the cells near the segment */
+    if(!cell_range(xmin - distance, ymin - distance, xmax + distance, ymax + distance, cell_size,
+                   &cx0, &cy0, &cx1, &cy1))
+    {
+      for(int32 o = 0; o < k; ++o)
+        if(segments[o].t1 >= s->t0)
+          probe_pair(state, &capacity, segments, tested, k, o, distance);
+    }
+    else
+    {
+      int32 live = 0;
+
+      for(int64 cx = cx0; cx <= cx1; ++cx)
+      {
+        for(int64 cy = cy0; cy <= cy1; ++cy)
+        {
+          struct grid_key key = { cx, cy };
+
+          struct grid_cell *cell = (struct grid_cell*) hash_search(grid, &key, HASH_FIND, NULL);
+
+          int32 nlive = 0;
+
+          if(cell == NULL)
+            continue;
+
+          for(int32 c = 0; c < cell->nitems; ++c)
+          {
+            int32 o = cell->items[c];
+
+            /* drop segments that ended before the sweep line */
+            if(segments[o].t1 < s->t0)
+              continue;
+
+            cell->items[nlive++] = o;
+
+            probe_pair(state, &capacity, segments, tested, k, o, distance);
+          }
+
+          cell->nitems = nlive;
+        }
+      }
+
+      for(int32 c = 0; c < nlarge; ++c)
+      {
+        int32 o = large[c];
+
+        if(segments[o].t1 < s->t0)
+          continue;
+
+        large[live++] = o;
+
+        probe_pair(state, &capacity, segments, tested, k, o, distance);
+      }
+
+      nlarge = live;
+    }
+
+    /* register the segment in the cells it covers */
+    if(!cell_range(xmin, ymin, xmax, ymax, cell_size, &cx0, &cy0, &cx1, &cy1))
+    {
+      large[nlarge++] = k;
+      continue;
+    }
+
+    for(int64 cx = cx0; cx <= cx1; ++cx)
+    {
+      for(int64 cy = cy0; cy <= cy1; ++cy)
+      {
+        struct grid_key key = { cx, cy };
+
+        bool found;
+
+        struct grid_cell *cell = (struct grid_cell*) hash_search(grid, &key, HASH_ENTER, &found);
+
+        if(!found)
+        {
+          cell->capacity = 8;
+          cell->nitems = 0;
+          cell->items = (int32*) palloc(cell->capacity * sizeof(int32));
+        }
+        else if(cell->nitems == cell->capacity)
+        {
+          cell->capacity *= 2;
+          cell->items = (int32*) repalloc(cell->items, cell->capacity * sizeof(int32));
+        }
+
+        cell->items[cell->nitems++] = k;
+      }
+    }
+  }
+
+  hash_destroy(grid);
+
+  pfree(large);
+  pfree(tested);
+
+  /* merge the touching intervals of each pair */
+  qsort(state->encounters, state->nencounters, sizeof(struct encounter), encounter_cmp);
+
+  for(int32 k = 0; k < state->nencounters; ++k)
+  {
+    struct encounter *e = &state->encounters[k];
+
+    if(nmerged > 0)
+    {
+      struct encounter *last = &state->encounters[nmerged - 1];
+
+      if(last->i == e->i && last->j == e->j && e->t_from <= last->t_to)
+      {
+        last->t_to = Max(last->t_to, e->t_to);
+        continue;
+      }
+    }
+
+    state->encounters[nmerged++] = *e;
+  }
+
+  state->nencounters = nmerged;
+}
+
+
+static int64 interval_to_usecs(const Interval *span)
+{
+  return span->time + (int64) span->day * USECS_PER_DAY +
+         (int64) span->month * DAYS_PER_MONTH * USECS_PER_DAY;
+}
+
+
+PG_FUNCTION_INFO_V1(spatiotemporal_proximity_pairs);
+
+Datum
+spatiotemporal_proximity_pairs(PG_FUNCTION_ARGS)
+{
+  FuncCallContext *funcctx;
+
+  struct proximity_state *state;
+
+  if(SRF_IS_FIRSTCALL())
+  {
+    MemoryContext oldcontext;
+
+    TupleDesc tupdesc;
+
+    ArrayType *arr;
+
+    double distance;
+
+    int64 max_gap = PG_ARGISNULL(2) ? -1 : interval_to_usecs(PG_GETARG_INTERVAL_P(2));
+
+    int16 typlen;
+
+    bool typbyval;
+
+    char typalign;
+
+    Datum *elems;
+
+    bool *nulls;
+
+    int nelems;
+
+    struct segment *segments;
+
+    int32 nsegments;
+
+    double mean_length;
+
+    funcctx = SRF_FIRSTCALL_INIT();
+
+    oldcontext = MemoryContextSwitchTo(funcctx->multi_call_memory_ctx);
+
+    if(get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+      ereport(ERROR, (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+                      errmsg("function returning record called in context that cannot accept type record")));
+
+    funcctx->tuple_desc = BlessTupleDesc(tupdesc);
+
+    state = (struct proximity_state*) palloc0(sizeof(struct proximity_state));
+
+    funcctx->user_fctx = state;
+
+    if(PG_ARGISNULL(0) || PG_ARGISNULL(1))
+    {
+      MemoryContextSwitchTo(oldcontext);
+      SRF_RETURN_DONE(funcctx);
+    }
+
+    arr = PG_GETARG_ARRAYTYPE_P(0);
+
+    distance = PG_GETARG_FLOAT8(1);
+
+    if(!isfinite(distance) || distance < 0.0)
+      ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                      errmsg("proximity distance must be finite and non-negative")));
+
+    if(ARR_NDIM(arr) > 1)
+      ereport(ERROR, (errcode(ERRCODE_ARRAY_SUBSCRIPT_ERROR),
+                      errmsg("spatiotemporal array must be one-dimensional")));
+
+    get_typlenbyvalalign(ARR_ELEMTYPE(arr), &typlen, &typbyval, &typalign);
+
+    deconstruct_array(arr, ARR_ELEMTYPE(arr), typlen, typbyval, typalign, &elems, &nulls, &nelems);
+
+    segments = build_segments(elems, nulls, nelems, max_gap, &nsegments, &state->base, &mean_length);
+
+    sweep(state, segments, nsegments, distance, mean_length);
+
+    pfree(segments);
+
+    MemoryContextSwitchTo(oldcontext);
+  }
+
+  funcctx = SRF_PERCALL_SETUP();
+
+  state = (struct proximity_state*) funcctx->user_fctx;
+
+  if(state->next < state->nencounters)
+  {
+    struct encounter *e = &state->encounters[state->next++];
+
+    Datum values[4];
+
+    bool nulls[4] = { false, false, false, false };
+
+    HeapTuple tuple;
+
+    values[0] = Int32GetDatum(e->i);
+    values[1] = Int32GetDatum(e->j);
+    values[2] = TimestampGetDatum(state->base + (Timestamp) rint(e->t_from * USECS_PER_SEC));
+    values[3] = TimestampGetDatum(state->base + (Timestamp) rint(e->t_to * USECS_PER_SEC));
+
+    tuple = heap_form_tuple(funcctx->tuple_desc, values, nulls);
+
+    SRF_RETURN_NEXT(funcctx, HeapTupleGetDatum(tuple));
+  }
+
+  SRF_RETURN_DONE(funcctx);
+}
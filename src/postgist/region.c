@@ -0,0 +1,1188 @@
+/*
+  Copyright (C) 2017 National Institute For Space Research (INPE) - Brazil.
+
+  postgis-t is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License version 3 as
+  published by the Free Software Foundation.
+
+  postgis-t is distributed  "AS-IS" in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY OF ANY KIND; without even the implied warranty
+  of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with postgis-t. See LICENSE. If not, write to
+  Gilberto Ribeiro de Queiroz at <gribeiro@dpi.inpe.br>.
+
+ */
+
+
+/*!
+ *
+ * \file postgist/region.c
+ *
+ * \brief Moving regions: time-stamped polygons and multipolygons.
+ *
+ * \author Gilberto Ribeiro de Queiroz
+ * \author Fabiana Zioti
+ *
+ * \date 2017
+ *
+ * \copyright GNU Lesser Public License version 3
+ *
+ */
+
+/* PostGIS-T extension */
+#include "region.h"
+#include "cache.h"
+#include "wkt.h"
+
+/* PostgreSQL */
+#include <access/htup_details.h>
+#include <funcapi.h>
+#include <lib/stringinfo.h>
+#include <utils/builtins.h>
+
+/* C Standard Library */
+#include <ctype.h>
+#include <float.h>
+#include <string.h>
+
+
+#define MR_WKT_TOKEN "ST_MOVINGREGION"
+#define MR_WKT_TOKEN_LEN 15
+
+#define SRID_WKT_TOKEN "SRID="
+#define SRID_WKT_TOKEN_LEN 5
+
+#define LDELIM '('
+#define RDELIM ')'
+#define VALUE_DELIM ','
+#define COLLECTION_DELIM ';'
+
+
+/*
+ * \brief A snapshot split in its topology and its x, y pairs.
+ *
+ */
+struct mr_shape
+{
+  int32 *topology;
+
+  int32 ntopology;
+
+  double *coords;
+
+  int32 npoints;
+};
+
+
+/*
+ * \brief Growing moving region, used by the input function and by the
+ *        aggregate.
+ *
+ * \note The buffers live in 'mcxt'; the coordinates of the last snapshot
+ *       are kept decoded as the reference of the next delta.
+ *
+ */
+struct mr_builder
+{
+  MemoryContext mcxt;
+
+  int32 srid;
+
+  int32 nsnapshots;
+
+  Timestamp start_time;
+
+  Timestamp end_time;
+
+  struct st_extent extent;
+
+  StringInfoData times;
+
+  StringInfoData boxes;
+
+  StringInfoData snapshots;
+
+  StringInfoData topology;
+
+  StringInfoData coords;
+
+  struct mr_snapshot last;
+
+  int32 last_ntopology;
+
+  double *last_coords;
+
+  int32 since_keyframe;
+};
+
+
+/*
+ * \brief Sequential decoder of the snapshot coordinates.
+ *
+ */
+struct mr_cursor
+{
+  const struct moving_region *mr;
+
+  MemoryContext mcxt;
+
+  int32 current;        /* Snapshot held in 'coords', -1 if none */
+
+  double *coords;
+
+  int32 capacity;       /* Number of doubles 'coords' has room for */
+};
+
+
+static inline void varint_append(StringInfo str, uint64 v)
+{
+  uint8 buf[10];
+
+  int n = 0;
+
+  do
+  {
+    uint8 byte = v & 0x7f;
+
+    v >>= 7;
+
+    if(v != 0)
+      byte |= 0x80;
+
+    buf[n++] = byte;
+  }
+  while(v != 0);
+
+  appendBinaryStringInfo(str, (char*) buf, n);
+}
+
+
+static inline const uint8 *varint_read(const uint8 *p, uint64 *v)
+{
+  uint64 result = 0;
+
+  int shift = 0;
+
+  for(;;)
+  {
+    uint8 byte = *p++;
+
+    result |= (uint64) (byte & 0x7f) << shift;
+
+    if((byte & 0x80) == 0)
+      break;
+
+    shift += 7;
+  }
+
+  *v = result;
+
+  return p;
+}
+
+
+static inline uint64 double_bits(double d)
+{
+  uint64 bits;
+
+  memcpy(&bits, &d, sizeof(bits));
+
+  return bits;
+}
+
+
+static void mr_shape_from_lwgeom(const LWGEOM *lwgeom, struct mr_shape *shape)
+{
+  LWPOLY *single = (LWPOLY*) lwgeom;
+
+  LWPOLY **polys;
+
+  int32 npolys;
+
+  int32 t = 0;
+
+  int32 k = 0;
+
+  if(lwgeom->type != POLYGONTYPE && lwgeom->type != MULTIPOLYGONTYPE)
+    ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                    errmsg("moving_region snapshots must be POLYGON or MULTIPOLYGON, not %s",
+                           lwtype_name(lwgeom->type))));
+
+  if(FLAGS_GET_Z(lwgeom->flags) || FLAGS_GET_M(lwgeom->flags))
+    ereport(ERROR, (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+                    errmsg("moving_region snapshots must be 2D")));
+
+  if(lwgeom_is_empty(lwgeom))
+    ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                    errmsg("moving_region snapshots can not be empty")));
+
+  if(lwgeom->type == POLYGONTYPE)
+  {
+    polys = &single;
+    npolys = 1;
+  }
+  else
+  {
+    polys = ((const LWMPOLY*) lwgeom)->geoms;
+    npolys = ((const LWMPOLY*) lwgeom)->ngeoms;
+  }
+
+  shape->ntopology = 2;
+  shape->npoints = 0;
+
+  for(int32 i = 0; i < npolys; ++i)
+  {
+    shape->ntopology += 1 + polys[i]->nrings;
+
+    for(int32 r = 0; r < (int32) polys[i]->nrings; ++r)
+      shape->npoints += polys[i]->rings[r]->npoints;
+  }
+
+  shape->topology = (int32*) palloc(shape->ntopology * sizeof(int32));
+
+  shape->coords = (double*) palloc(Max(shape->npoints, 1) * 2 * sizeof(double));
+
+  shape->topology[t++] = lwgeom->type;
+  shape->topology[t++] = npolys;
+
+  for(int32 i = 0; i < npolys; ++i)
+  {
+    shape->topology[t++] = polys[i]->nrings;
+
+    for(int32 r = 0; r < (int32) polys[i]->nrings; ++r)
+    {
+      const POINTARRAY *pa = polys[i]->rings[r];
+
+      shape->topology[t++] = pa->npoints;
+
+      for(int32 j = 0; j < (int32) pa->npoints; ++j)
+      {
+        POINT2D p;
+
+        getPoint2d_p(pa, j, &p);
+
+        shape->coords[k++] = p.x;
+        shape->coords[k++] = p.y;
+      }
+    }
+  }
+}
+
+
+static void mr_builder_init(struct mr_builder *b, MemoryContext mcxt)
+{
+  MemoryContext oldcontext = MemoryContextSwitchTo(mcxt);
+
+  memset(b, 0, sizeof(*b));
+
+  b->mcxt = mcxt;
+
+  b->extent.xmin = b->extent.ymin = DBL_MAX;
+  b->extent.xmax = b->extent.ymax = -DBL_MAX;
+
+  initStringInfo(&b->times);
+  initStringInfo(&b->boxes);
+  initStringInfo(&b->snapshots);
+  initStringInfo(&b->topology);
+  initStringInfo(&b->coords);
+
+  MemoryContextSwitchTo(oldcontext);
+}
+
+
+static void mr_builder_append(struct mr_builder *b, const struct mr_shape *shape, Timestamp t)
+{
+  struct mr_snapshot snap;
+
+  struct st_extent box;
+
+  int32 ncoords = shape->npoints * 2;
+
+  bool same_topology;
+
+  if(b->nsnapshots > 0 && t <= b->end_time)
+    ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                    errmsg("moving_region snapshots must be in increasing time order")));
+
+  box.xmin = box.ymin = DBL_MAX;
+  box.xmax = box.ymax = -DBL_MAX;
+
+  for(int32 i = 0; i < ncoords; i += 2)
+    st_extent_expand(&box, shape->coords[i], shape->coords[i + 1]);
+
+  same_topology = b->nsnapshots > 0 && shape->ntopology == b->last_ntopology &&
+                  memcmp(b->topology.data + b->last.topology * sizeof(int32), shape->topology,
+                         shape->ntopology * sizeof(int32)) == 0;
+
+  snap.topology = same_topology ? b->last.topology : (int32) (b->topology.len / sizeof(int32));
+  snap.coords = b->coords.len;
+  snap.npoints = shape->npoints;
+  snap.flags = 0;
+
+  if(!same_topology)
+    appendBinaryStringInfo(&b->topology, (char*) shape->topology, shape->ntopology * sizeof(int32));
+
+  if(same_topology && b->since_keyframe + 1 < MR_KEYFRAME_INTERVAL)
+  {
+    snap.flags = MR_SNAPSHOT_DELTA;
+
+    for(int32 i = 0; i < ncoords; ++i)
+      varint_append(&b->coords, double_bits(shape->coords[i]) ^ double_bits(b->last_coords[i]));
+
+    ++b->since_keyframe;
+  }
+  else
+  {
+    appendBinaryStringInfo(&b->coords, (char*) shape->coords, ncoords * sizeof(double));
+
+    b->since_keyframe = 0;
+  }
+
+  appendBinaryStringInfo(&b->times, (char*) &t, sizeof(Timestamp));
+  appendBinaryStringInfo(&b->boxes, (char*) &box, sizeof(struct st_extent));
+  appendBinaryStringInfo(&b->snapshots, (char*) &snap, sizeof(struct mr_snapshot));
+
+  if(b->last_coords != NULL)
+    pfree(b->last_coords);
+
+  b->last_coords = (double*) MemoryContextAlloc(b->mcxt, Max(ncoords, 1) * sizeof(double));
+
+  memcpy(b->last_coords, shape->coords, ncoords * sizeof(double));
+
+  b->last = snap;
+  b->last_ntopology = shape->ntopology;
+
+  if(b->nsnapshots == 0)
+    b->start_time = t;
+
+  b->end_time = t;
+
+  st_extent_expand(&b->extent, box.xmin, box.ymin);
+  st_extent_expand(&b->extent, box.xmax, box.ymax);
+
+  ++b->nsnapshots;
+}
+
+
+static struct moving_region *mr_builder_finish(const struct mr_builder *b)
+{
+  int32 ntopology = b->topology.len / sizeof(int32);
+
+  size_t size = MR_SIZE(b->nsnapshots, ntopology, b->coords.len);
+
+  struct moving_region *mr;
+
+  if(size > MaxAllocSize)
+    ereport(ERROR, (errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
+                    errmsg("moving_region of %d snapshots is too large", b->nsnapshots)));
+
+  mr = (struct moving_region*) palloc0(size);
+
+  SET_VARSIZE(mr, size);
+
+  mr->srid = b->srid;
+  mr->nsnapshots = b->nsnapshots;
+  mr->ntopology = ntopology;
+  mr->ncoordbytes = b->coords.len;
+
+  if(b->nsnapshots > 0)
+  {
+    mr->start_time = b->start_time;
+    mr->end_time = b->end_time;
+    mr->extent = b->extent;
+  }
+
+  memcpy(MR_TIMES(mr), b->times.data, b->times.len);
+  memcpy(MR_BOXES(mr), b->boxes.data, b->boxes.len);
+  memcpy(MR_SNAPSHOTS(mr), b->snapshots.data, b->snapshots.len);
+  memcpy(MR_TOPOLOGY(mr), b->topology.data, b->topology.len);
+  memcpy(MR_COORDS(mr), b->coords.data, b->coords.len);
+
+  return mr;
+}
+
+
+static void mr_cursor_init(struct mr_cursor *c, const struct moving_region *mr)
+{
+  c->mr = mr;
+  c->mcxt = CurrentMemoryContext;
+  c->current = -1;
+  c->coords = NULL;
+  c->capacity = 0;
+}
+
+
+/*
+ * \brief Return the coordinates of snapshot 'k'.
+ *
+ * \note Walking the snapshots in order decodes each delta once; a seek
+ *       backwards restarts from the closest keyframe.
+ *
+ */
+static const double *mr_cursor_seek(struct mr_cursor *c, int32 k)
+{
+  const struct mr_snapshot *snaps = MR_SNAPSHOTS(c->mr);
+
+  const uint8 *stream = MR_COORDS(c->mr);
+
+  int32 first = k;
+
+  while(snaps[first].flags & MR_SNAPSHOT_DELTA)
+    --first;
+
+  if(c->current < first || c->current > k)
+  {
+    int32 ncoords = snaps[first].npoints * 2;
+
+    if(ncoords > c->capacity)
+    {
+      if(c->coords != NULL)
+        pfree(c->coords);
+
+      c->coords = (double*) MemoryContextAlloc(c->mcxt, ncoords * sizeof(double));
+      c->capacity = ncoords;
+    }
+
+    memcpy(c->coords, stream + snaps[first].coords, ncoords * sizeof(double));
+
+    c->current = first;
+  }
+
+  for(int32 i = c->current + 1; i <= k; ++i)
+  {
+    const uint8 *p = stream + snaps[i].coords;
+
+    for(int32 j = 0; j < snaps[i].npoints * 2; ++j)
+    {
+      uint64 x;
+
+      uint64 bits;
+
+      p = varint_read(p, &x);
+
+      bits = double_bits(c->coords[j]) ^ x;
+
+      memcpy(&c->coords[j], &bits, sizeof(double));
+    }
+  }
+
+  c->current = k;
+
+  return c->coords;
+}
+
+
+static LWGEOM *mr_snapshot_to_lwgeom(const struct moving_region *mr, int32 k, const double *coords)
+{
+  const int32 *topology = MR_TOPOLOGY(mr) + MR_SNAPSHOTS(mr)[k].topology;
+
+  int32 type = *topology++;
+
+  int32 npolys = *topology++;
+
+  LWGEOM **polys = (LWGEOM**) lwalloc(Max(npolys, 1) * sizeof(LWGEOM*));
+
+  for(int32 i = 0; i < npolys; ++i)
+  {
+    int32 nrings = *topology++;
+
+    POINTARRAY **rings;
+
+    if(nrings == 0)
+    {
+      polys[i] = (LWGEOM*) lwpoly_construct_empty(mr->srid, 0, 0);
+      continue;
+    }
+
+    rings = (POINTARRAY**) lwalloc(nrings * sizeof(POINTARRAY*));
+
+    for(int32 r = 0; r < nrings; ++r)
+    {
+      int32 npoints = *topology++;
+
+      rings[r] = ptarray_construct_copy_data(0, 0, npoints, (const uint8_t*) coords);
+
+      coords += npoints * 2;
+    }
+
+    polys[i] = (LWGEOM*) lwpoly_construct(mr->srid, NULL, nrings, rings);
+  }
+
+  if(type == POLYGONTYPE)
+  {
+    LWGEOM *result = polys[0];
+
+    lwfree(polys);
+
+    return result;
+  }
+
+  return (LWGEOM*) lwcollection_construct(MULTIPOLYGONTYPE, mr->srid, NULL, npolys, polys);
+}
+
+
+static void mr_append_polygon(StringInfo str, const int32 **topology, const double **coords)
+{
+  int32 nrings = *(*topology)++;
+
+  if(nrings == 0)
+  {
+    appendStringInfoString(str, "EMPTY");
+    return;
+  }
+
+  appendStringInfoChar(str, LDELIM);
+
+  for(int32 r = 0; r < nrings; ++r)
+  {
+    int32 npoints = *(*topology)++;
+
+    if(r > 0)
+      appendStringInfoChar(str, VALUE_DELIM);
+
+    appendStringInfoChar(str, LDELIM);
+
+    for(int32 j = 0; j < npoints; ++j)
+    {
+      if(j > 0)
+        appendStringInfoChar(str, VALUE_DELIM);
+
+      wkt_append_double(str, (*coords)[0]);
+      appendStringInfoChar(str, ' ');
+      wkt_append_double(str, (*coords)[1]);
+
+      *coords += 2;
+    }
+
+    appendStringInfoChar(str, RDELIM);
+  }
+
+  appendStringInfoChar(str, RDELIM);
+}
+
+
+static void syntax_error(const char *str, const char *detail)
+{
+  ereport(ERROR, (errcode(ERRCODE_INVALID_TEXT_REPRESENTATION),
+                  errmsg("invalid input syntax for type moving_region: \"%s\"", str),
+                  errdetail("%s", detail)));
+}
+
+
+PG_FUNCTION_INFO_V1(moving_region_in);
+
+Datum
+moving_region_in(PG_FUNCTION_ARGS)
+{
+  char *str = PG_GETARG_CSTRING(0);
+
+  char *cp = str;
+
+  struct mr_builder b;
+
+  mr_builder_init(&b, CurrentMemoryContext);
+
+  while(isspace((unsigned char) *cp))
+    ++cp;
+
+  /* optional EWKT-like prefix: SRID=4326; */
+  if(strncasecmp(cp, SRID_WKT_TOKEN, SRID_WKT_TOKEN_LEN) == 0)
+  {
+    char *endptr;
+
+    long srid;
+
+    cp += SRID_WKT_TOKEN_LEN;
+
+    srid = strtol(cp, &endptr, 10);
+
+    if(endptr == cp || *endptr != COLLECTION_DELIM || srid < 0 || srid > SRID_MAXIMUM)
+      syntax_error(str, "Bad SRID.");
+
+    b.srid = (int32) srid;
+
+    cp = endptr + 1;
+
+    while(isspace((unsigned char) *cp))
+      ++cp;
+  }
+
+  if(strncasecmp(cp, MR_WKT_TOKEN, MR_WKT_TOKEN_LEN) != 0)
+    syntax_error(str, "Expected ST_MOVINGREGION.");
+
+  cp += MR_WKT_TOKEN_LEN;
+
+  while(isspace((unsigned char) *cp))
+    ++cp;
+
+  if(*cp != LDELIM)
+    syntax_error(str, "Expected \"(\".");
+
+  ++cp;
+
+  for(;;)
+  {
+    char *end;
+
+    char *semicolon;
+
+    char *text;
+
+    int depth = 0;
+
+    LWGEOM *lwgeom;
+
+    struct mr_shape shape;
+
+    Timestamp t;
+
+    while(isspace((unsigned char) *cp))
+      ++cp;
+
+    if(*cp == RDELIM)
+      break;
+
+    /* geometry, up to its balanced closing parenthesis */
+    end = strchr(cp, LDELIM);
+
+    if(end == NULL)
+      syntax_error(str, "Expected a POLYGON or MULTIPOLYGON.");
+
+    for(; *end != '\0'; ++end)
+    {
+      if(*end == LDELIM)
+        ++depth;
+      else if(*end == RDELIM && --depth == 0)
+        break;
+    }
+
+    if(*end == '\0')
+      syntax_error(str, "Unbalanced parentheses.");
+
+    ++end;
+
+    text = pnstrdup(cp, end - cp);
+
+    lwgeom = lwgeom_from_wkt(text, LW_PARSER_CHECK_ALL);
+
+    if(lwgeom == NULL)
+      syntax_error(str, "Invalid geometry.");
+
+    pfree(text);
+
+    cp = end;
+
+    while(isspace((unsigned char) *cp))
+      ++cp;
+
+    if(*cp != VALUE_DELIM)
+      syntax_error(str, "Expected \",\" after a geometry.");
+
+    ++cp;
+
+    /* time, up to the ';' that closes the snapshot */
+    semicolon = strchr(cp, COLLECTION_DELIM);
+
+    if(semicolon == NULL)
+      syntax_error(str, "Expected \";\" after a time.");
+
+    text = pnstrdup(cp, semicolon - cp);
+
+    t = DatumGetTimestamp(DirectFunctionCall3(timestamp_in, CStringGetDatum(text),
+                                              ObjectIdGetDatum(InvalidOid), Int32GetDatum(-1)));
+
+    pfree(text);
+
+    if(TIMESTAMP_NOT_FINITE(t))
+      syntax_error(str, "Snapshot times must be finite.");
+
+    if(b.nsnapshots > 0 && t <= b.end_time)
+      syntax_error(str, "Snapshots must be in increasing time order.");
+
+    mr_shape_from_lwgeom(lwgeom, &shape);
+
+    mr_builder_append(&b, &shape, t);
+
+    lwgeom_free(lwgeom);
+
+    pfree(shape.topology);
+    pfree(shape.coords);
+
+    cp = semicolon + 1;
+  }
+
+  /* skip the ')' */
+  ++cp;
+
+  while(isspace((unsigned char) *cp))
+    ++cp;
+
+  if(*cp != '\0')
+    syntax_error(str, "Unexpected characters after \")\".");
+
+  PG_RETURN_MOVING_REGION_P(mr_builder_finish(&b));
+}
+
+
+PG_FUNCTION_INFO_V1(moving_region_out);
+
+Datum
+moving_region_out(PG_FUNCTION_ARGS)
+{
+  struct moving_region *mr = PG_GETARG_MOVING_REGION_P(0);
+
+  const struct mr_snapshot *snaps = MR_SNAPSHOTS(mr);
+
+  struct mr_cursor cursor;
+
+  struct wkt_date_cache cache;
+
+  StringInfoData str;
+
+  mr_cursor_init(&cursor, mr);
+
+  cache.valid = false;
+
+  initStringInfo(&str);
+
+  if(mr->srid != 0)
+    appendStringInfo(&str, SRID_WKT_TOKEN "%d%c", mr->srid, COLLECTION_DELIM);
+
+  appendStringInfoString(&str, MR_WKT_TOKEN "(");
+
+  for(int32 k = 0; k < mr->nsnapshots; ++k)
+  {
+    const int32 *topology = MR_TOPOLOGY(mr) + snaps[k].topology;
+
+    const double *coords = mr_cursor_seek(&cursor, k);
+
+    int32 type = *topology++;
+
+    int32 npolys = *topology++;
+
+    if(k > 0)
+      appendStringInfoChar(&str, ' ');
+
+    if(type == POLYGONTYPE)
+    {
+      appendStringInfoString(&str, "POLYGON");
+      mr_append_polygon(&str, &topology, &coords);
+    }
+    else
+    {
+      appendStringInfoString(&str, "MULTIPOLYGON(");
+
+      for(int32 i = 0; i < npolys; ++i)
+      {
+        if(i > 0)
+          appendStringInfoChar(&str, VALUE_DELIM);
+
+        mr_append_polygon(&str, &topology, &coords);
+      }
+
+      appendStringInfoChar(&str, RDELIM);
+    }
+
+    appendStringInfoString(&str, ", ");
+
+    wkt_append_timestamp(&str, MR_TIMES(mr)[k], &cache);
+
+    appendStringInfoChar(&str, COLLECTION_DELIM);
+  }
+
+  appendStringInfoChar(&str, RDELIM);
+
+  PG_RETURN_CSTRING(str.data);
+}
+
+
+PG_FUNCTION_INFO_V1(moving_region_agg_transfn);
+
+Datum
+moving_region_agg_transfn(PG_FUNCTION_ARGS)
+{
+  MemoryContext agg_context;
+
+  struct mr_builder *b;
+
+  GSERIALIZED *gser;
+
+  LWGEOM *lwgeom;
+
+  struct mr_shape shape;
+
+  Timestamp t;
+
+  if(!AggCheckCallContext(fcinfo, &agg_context))
+    elog(ERROR, "moving_region_agg_transfn called in non-aggregate context");
+
+  b = PG_ARGISNULL(0) ? NULL : (struct mr_builder*) PG_GETARG_POINTER(0);
+
+  if(PG_ARGISNULL(1) || PG_ARGISNULL(2))
+  {
+    if(b == NULL)
+      PG_RETURN_NULL();
+
+    PG_RETURN_POINTER(b);
+  }
+
+  gser = PG_GETARG_GSERIALIZED_P(1);
+
+  t = PG_GETARG_TIMESTAMP(2);
+
+  if(TIMESTAMP_NOT_FINITE(t))
+    ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                    errmsg("timestamp for moving_region snapshot must be finite")));
+
+  if(b == NULL)
+  {
+    b = (struct mr_builder*) MemoryContextAlloc(agg_context, sizeof(struct mr_builder));
+
+    mr_builder_init(b, agg_context);
+
+    b->srid = gserialized_get_srid(gser);
+  }
+  else if(gserialized_get_srid(gser) != b->srid)
+    ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                    errmsg("moving_region snapshots with mixed SRID (%d and %d)",
+                           b->srid, gserialized_get_srid(gser))));
+
+  lwgeom = lwgeom_from_gserialized(gser);
+
+  mr_shape_from_lwgeom(lwgeom, &shape);
+
+  mr_builder_append(b, &shape, t);
+
+  lwgeom_free(lwgeom);
+
+  pfree(shape.topology);
+  pfree(shape.coords);
+
+  PG_RETURN_POINTER(b);
+}
+
+
+PG_FUNCTION_INFO_V1(moving_region_agg_finalfn);
+
+Datum
+moving_region_agg_finalfn(PG_FUNCTION_ARGS)
+{
+  if(PG_ARGISNULL(0))
+    PG_RETURN_NULL();
+
+  PG_RETURN_MOVING_REGION_P(mr_builder_finish((struct mr_builder*) PG_GETARG_POINTER(0)));
+}
+
+
+PG_FUNCTION_INFO_V1(moving_region_get_start_time);
+
+Datum
+moving_region_get_start_time(PG_FUNCTION_ARGS)
+{
+  struct moving_region *mr = PG_GETARG_MOVING_REGION_HEADER_P(0);
+
+  PG_RETURN_TIMESTAMP(mr->start_time);
+}
+
+
+PG_FUNCTION_INFO_V1(moving_region_get_end_time);
+
+Datum
+moving_region_get_end_time(PG_FUNCTION_ARGS)
+{
+  struct moving_region *mr = PG_GETARG_MOVING_REGION_HEADER_P(0);
+
+  PG_RETURN_TIMESTAMP(mr->end_time);
+}
+
+
+/*
+ * \brief The region at time 't': between two snapshots with the same
+ *        topology the vertices move linearly, otherwise the earlier
+ *        snapshot holds until the next one.
+ *
+ */
+PG_FUNCTION_INFO_V1(moving_region_value_at);
+
+Datum
+moving_region_value_at(PG_FUNCTION_ARGS)
+{
+  struct moving_region *mr = PG_GETARG_MOVING_REGION_P(0);
+
+  Timestamp t = PG_GETARG_TIMESTAMP(1);
+
+  const Timestamp *times = MR_TIMES(mr);
+
+  const struct mr_snapshot *snaps = MR_SNAPSHOTS(mr);
+
+  struct mr_cursor cursor;
+
+  const double *coords;
+
+  LWGEOM *lwgeom;
+
+  int32 lo = 0;
+
+  int32 hi;
+
+  if(mr->nsnapshots == 0 || t < mr->start_time || t > mr->end_time)
+    PG_RETURN_NULL();
+
+  /* last snapshot at or before t */
+  hi = mr->nsnapshots - 1;
+
+  while(lo < hi)
+  {
+    int32 mid = lo + (hi - lo + 1) / 2;
+
+    if(times[mid] <= t)
+      lo = mid;
+    else
+      hi = mid - 1;
+  }
+
+  mr_cursor_init(&cursor, mr);
+
+  coords = mr_cursor_seek(&cursor, lo);
+
+  if(times[lo] == t || lo == mr->nsnapshots - 1 || snaps[lo + 1].topology != snaps[lo].topology)
+    lwgeom = mr_snapshot_to_lwgeom(mr, lo, coords);
+  else
+  {
+    int32 ncoords = snaps[lo].npoints * 2;
+
+    double *a = (double*) palloc(Max(ncoords, 1) * sizeof(double));
+
+    const double *b;
+
+    double r = (double) (t - times[lo]) / (double) (times[lo + 1] - times[lo]);
+
+    memcpy(a, coords, ncoords * sizeof(double));
+
+    b = mr_cursor_seek(&cursor, lo + 1);
+
+    for(int32 j = 0; j < ncoords; ++j)
+      a[j] += r * (b[j] - a[j]);
+
+    lwgeom = mr_snapshot_to_lwgeom(mr, lo, a);
+  }
+
+  PG_RETURN_POINTER(geometry_serialize(lwgeom));
+}
+
+
+struct moving_region_snapshots_cursor
+{
+  struct moving_region *mr;
+
+  struct mr_cursor cursor;
+
+  int32 next;
+};
+
+
+PG_FUNCTION_INFO_V1(moving_region_snapshots);
+
+Datum
+moving_region_snapshots(PG_FUNCTION_ARGS)
+{
+  FuncCallContext *funcctx;
+
+  struct moving_region_snapshots_cursor *state;
+
+  if(SRF_IS_FIRSTCALL())
+  {
+    MemoryContext oldcontext;
+
+    TupleDesc tupdesc;
+
+    funcctx = SRF_FIRSTCALL_INIT();
+
+    oldcontext = MemoryContextSwitchTo(funcctx->multi_call_memory_ctx);
+
+    if(get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+      ereport(ERROR, (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+                      errmsg("function returning record called in context that cannot accept type record")));
+
+    funcctx->tuple_desc = BlessTupleDesc(tupdesc);
+
+    state = (struct moving_region_snapshots_cursor*) palloc(sizeof(struct moving_region_snapshots_cursor));
+
+    state->mr = PG_GETARG_MOVING_REGION_P(0);
+
+    /* the decoded coordinates must survive between calls */
+    mr_cursor_init(&state->cursor, state->mr);
+
+    state->next = 0;
+
+    funcctx->user_fctx = state;
+
+    MemoryContextSwitchTo(oldcontext);
+  }
+
+  funcctx = SRF_PERCALL_SETUP();
+
+  state = (struct moving_region_snapshots_cursor*) funcctx->user_fctx;
+
+  if(state->next < state->mr->nsnapshots)
+  {
+    Datum values[2];
+
+    bool nulls[2] = { false, false };
+
+    HeapTuple tuple;
+
+    const double *coords = mr_cursor_seek(&state->cursor, state->next);
+
+    LWGEOM *lwgeom = mr_snapshot_to_lwgeom(state->mr, state->next, coords);
+
+    values[0] = PointerGetDatum(geometry_serialize(lwgeom));
+
+    values[1] = TimestampGetDatum(MR_TIMES(state->mr)[state->next]);
+
+    lwgeom_free(lwgeom);
+
+    ++state->next;
+
+    tuple = heap_form_tuple(funcctx->tuple_desc, values, nulls);
+
+    SRF_RETURN_NEXT(funcctx, HeapTupleGetDatum(tuple));
+  }
+
+  SRF_RETURN_DONE(funcctx);
+}
+
+
+/* destroy a geometry prepared for a single call; cached ones have no 'g' */
+static void mr_prepared_release(const GEOSPreparedGeometry *prepared, GEOSGeometry *g)
+{
+  if(g == NULL)
+    return;
+
+  GEOSPreparedGeom_destroy(prepared);
+  GEOSGeom_destroy(g);
+}
+
+
+/*
+ * \brief True if the region intersects 'geom' at some snapshot.
+ *
+ * \note Only the snapshots whose box overlaps the box of 'geom' are
+ *       built and tested.
+ *
+ */
+PG_FUNCTION_INFO_V1(moving_region_intersects);
+
+Datum
+moving_region_intersects(PG_FUNCTION_ARGS)
+{
+  Datum d = PG_GETARG_DATUM(0);
+
+  struct moving_region *hdr = DatumGetMovingRegionHeader(d);
+
+  GSERIALIZED *gser = PG_GETARG_GSERIALIZED_P(1);
+
+  struct moving_region *mr;
+
+  const struct st_extent *boxes;
+
+  struct mr_cursor cursor;
+
+  GBOX gbox;
+
+  struct st_extent e;
+
+  LWGEOM *lwgeom;
+
+  GEOSGeometry *g2 = NULL;
+
+  const GEOSPreparedGeometry *prepared;
+
+  bool found = false;
+
+  if(gserialized_get_srid(gser) != hdr->srid)
+    ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                    errmsg("operation on mixed SRID moving_region (%d) and geometry (%d)",
+                           hdr->srid, gserialized_get_srid(gser))));
+
+  if(hdr->nsnapshots == 0 || gserialized_get_gbox_p(gser, &gbox) == LW_FAILURE)
+    PG_RETURN_BOOL(false);
+
+  e.xmin = gbox.xmin;
+  e.ymin = gbox.ymin;
+  e.xmax = gbox.xmax;
+  e.ymax = gbox.ymax;
+
+  /* the extents are compared before the snapshots are fetched */
+  if(!st_extent_overlaps(&hdr->extent, &e))
+    PG_RETURN_BOOL(false);
+
+  mr = DatumGetMovingRegion(d);
+
+  boxes = MR_BOXES(mr);
+
+  initGEOS(lwpgnotice, lwgeom_geos_error);
+
+  /* a geometry repeated across rows is prepared once per call site; g2 stays NULL */
+  prepared = geometry_cache_prepared(fcinfo, 1);
+
+  if(prepared == NULL)
+  {
+    lwgeom = lwgeom_from_gserialized(gser);
+
+    g2 = LWGEOM2GEOS(lwgeom, 0);
+
+    lwgeom_free(lwgeom);
+
+    if(g2 == NULL)
+      ereport(ERROR, (errcode(ERRCODE_INTERNAL_ERROR),
+                      errmsg("could not convert geometry to GEOS: %s", lwgeom_geos_errmsg)));
+
+    prepared = GEOSPrepare(g2);
+  }
+
+  mr_cursor_init(&cursor, mr);
+
+  for(int32 k = 0; k < mr->nsnapshots && !found; ++k)
+  {
+    GEOSGeometry *g1;
+
+    char result;
+
+    if(!st_extent_overlaps(&boxes[k], &e))
+      continue;
+
+    lwgeom = mr_snapshot_to_lwgeom(mr, k, mr_cursor_seek(&cursor, k));
+
+    g1 = LWGEOM2GEOS(lwgeom, 0);
+
+    lwgeom_free(lwgeom);
+
+    if(g1 == NULL)
+    {
+      mr_prepared_release(prepared, g2);
+      ereport(ERROR, (errcode(ERRCODE_INTERNAL_ERROR),
+                      errmsg("could not convert moving_region to GEOS: %s", lwgeom_geos_errmsg)));
+    }
+
+    result = GEOSPreparedIntersects(prepared, g1);
+
+    GEOSGeom_destroy(g1);
+
+    if(result == 2)
+    {
+      mr_prepared_release(prepared, g2);
+      ereport(ERROR, (errcode(ERRCODE_INTERNAL_ERROR),
+                      errmsg("GEOSPreparedIntersects: %s", lwgeom_geos_errmsg)));
+    }
+
+    found = (result == 1);
+  }
+
+  mr_prepared_release(prepared, g2);
+
+  PG_RETURN_BOOL(found);
+}
@@ -0,0 +1,119 @@
+/*
+  Copyright (C) 2017 National Institute For Space Research (INPE) - Brazil.
+
+  postgis-t is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License version 3 as
+  published by the Free Software Foundation.
+
+  postgis-t is distributed  "AS-IS" in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY OF ANY KIND; without even the implied warranty
+  of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with postgis-t. See LICENSE. If not, write to
+  Gilberto Ribeiro de Queiroz at <gribeiro@dpi.inpe.br>.
+
+ */
+
+
+/*!
+ *
+ * \file postgist/region.h
+ *
+ * \brief Moving regions: time-stamped polygons and multipolygons.
+ *
+ * \author Gilberto Ribeiro de Queiroz
+ * \author Fabiana Zioti
+ *
+ * \date 2017
+ *
+ * \copyright GNU Lesser Public License version 3
+ *
+ */
+
+#ifndef __POSTGIST_REGION_H__
+#define __POSTGIST_REGION_H__
+
+/* PostGIS-T extension */
+#include "spatiotemporal.h"
+
+
+/*
+ * Layout: the header is followed by one timestamp, one extent and one
+ * struct mr_snapshot per snapshot, then by the topology array and the
+ * coordinate stream.
+ *
+ * The topology of a snapshot is { geometry type, number of polygons, and
+ * for each polygon the number of rings followed by the number of points of
+ * each ring }. Snapshots with the same topology as the previous one share
+ * its entry.
+ *
+ * The coordinates of a snapshot are either stored as they are (a keyframe)
+ * or, when the topology did not change, as the XOR of each ordinate with
+ * the previous snapshot's, written as a varint: vertices that did not move
+ * take one byte. A keyframe is forced every MR_KEYFRAME_INTERVAL snapshots
+ * to bound the work of decoding one snapshot.
+ */
+struct moving_region
+{
+  int32 vl_len_;        /* Varlena header */
+  int32 flags;          /* Reserved, always 0 */
+  int32 srid;
+  int32 nsnapshots;
+  int32 ntopology;      /* Number of entries in the topology array */
+  int32 ncoordbytes;    /* Size of the coordinate stream */
+  Timestamp start_time;
+  Timestamp end_time;
+  struct st_extent extent;
+  double data[1];
+};
+
+struct mr_snapshot
+{
+  int32 topology;       /* Offset of the topology in the topology array */
+  int32 coords;         /* Byte offset of the coordinates in the stream */
+  int32 npoints;
+  int32 flags;
+};
+
+/* snapshot flags */
+#define MR_SNAPSHOT_DELTA 0x01
+
+#define MR_KEYFRAME_INTERVAL 32
+
+#define MR_HEADER_SIZE  offsetof(struct moving_region, data)
+#define MR_TIMES(mr)     ((Timestamp*) (mr)->data)
+#define MR_BOXES(mr)     ((struct st_extent*) (MR_TIMES(mr) + (mr)->nsnapshots))
+#define MR_SNAPSHOTS(mr) ((struct mr_snapshot*) (MR_BOXES(mr) + (mr)->nsnapshots))
+#define MR_TOPOLOGY(mr)  ((int32*) (MR_SNAPSHOTS(mr) + (mr)->nsnapshots))
+#define MR_COORDS(mr)    ((uint8*) (MR_TOPOLOGY(mr) + (mr)->ntopology))
+#define MR_SIZE(nsnapshots, ntopology, ncoordbytes) \
+  (MR_HEADER_SIZE + \
+   (nsnapshots) * (sizeof(Timestamp) + sizeof(struct st_extent) + sizeof(struct mr_snapshot)) + \
+   (ntopology) * sizeof(int32) + (ncoordbytes))
+
+#define DatumGetMovingRegion(X)      ((struct moving_region*) PG_DETOAST_DATUM(X))
+#define PG_GETARG_MOVING_REGION_P(n)  DatumGetMovingRegion(PG_GETARG_DATUM(n))
+#define PG_RETURN_MOVING_REGION_P(x)  PG_RETURN_POINTER(x)
+
+/* fetch only the header, see DatumGetSpatioTemporalHeader */
+#define DatumGetMovingRegionHeader(X) \
+  ((struct moving_region*) PG_DETOAST_DATUM_SLICE(X, 0, MR_HEADER_SIZE - VARHDRSZ))
+#define PG_GETARG_MOVING_REGION_HEADER_P(n)  DatumGetMovingRegionHeader(PG_GETARG_DATUM(n))
+
+
+extern Datum moving_region_in(PG_FUNCTION_ARGS);
+extern Datum moving_region_out(PG_FUNCTION_ARGS);
+
+extern Datum moving_region_agg_transfn(PG_FUNCTION_ARGS);
+extern Datum moving_region_agg_finalfn(PG_FUNCTION_ARGS);
+
+extern Datum moving_region_get_start_time(PG_FUNCTION_ARGS);
+extern Datum moving_region_get_end_time(PG_FUNCTION_ARGS);
+
+extern Datum moving_region_value_at(PG_FUNCTION_ARGS);
+extern Datum moving_region_snapshots(PG_FUNCTION_ARGS);
+extern Datum moving_region_intersects(PG_FUNCTION_ARGS);
+
+#endif  /* __POSTGIST_REGION_H__ */
@@ -0,0 +1,435 @@
+/*
+  Copyright (C) 2017 National Institute For Space Research (INPE) - Brazil.
+
+  postgis-t is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License version 3 as
+  published by the Free Software Foundation.
+
+  postgis-t is distributed  "AS-IS" in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY OF ANY KIND; without even the implied warranty
+  of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with postgis-t. See LICENSE. If not, write to
+  Gilberto Ribeiro de Queiroz at <gribeiro@dpi.inpe.br>.
+
+ */
+
+/*!
+ *
+ * \file postgist/similarity.c
+ *
+ * \brief Trajectory similarity: Dynamic Time Warping, discrete Fréchet and
+ *        Hausdorff distances.
+ *
+ * Distances are planar (x, y) in the units of the SRID. All measures take
+ * a threshold: as soon as the result is known to exceed it, the
+ * computation is abandoned and Infinity is returned. Cheap lower bounds
+ * derived from the extents and end points are checked before the dynamic
+ * programming starts, and the DP keeps only two rows. The extent bounds
+ * only need the headers, so they are checked before the values are
+ * detoasted.
+ *
+ * \author Gilberto Ribeiro de Queiroz
+ * \author Fabiana Zioti
+ *
+ * \date 2017
+ *
+ * \copyright GNU Lesser Public License version 3
+ *
+ */
+
+/* PostGIS-T extension */
+#include "cache.h"
+#include "spatiotemporal.h"
+
+/* PostgreSQL */
+#include <miscadmin.h>
+
+/* C Standard Library */
+#include <math.h>
+
+
+/* a trajectory seen as a list of x, y positions */
+struct st_polyline
+{
+  const double *coords;
+  int32 npoints;
+  int ndims;
+};
+
+
+static inline void polyline_init(struct st_polyline *p, const struct spatiotemporal *st)
+{
+  p->coords = ST_COORDS(st);
+  p->npoints = st->npoints;
+  p->ndims = ST_NDIMS(st);
+}
+
+
+static inline double vertex_distance(const struct st_polyline *a, int32 i,
+                                     const struct st_polyline *b, int32 j)
+{
+  const double *p = a->coords + i * a->ndims;
+  const double *q = b->coords + j * b->ndims;
+
+  double dx = p[0] - q[0];
+  double dy = p[1] - q[1];
+
+  return sqrt(dx * dx + dy * dy);
+}
+
+
+/*
+ * \brief Smallest distance between any two points of the extents.
+ *
+ */
+static double extent_distance(const struct st_extent *a, const struct st_extent *b)
+{
+  double dx = Max(0.0, Max(a->xmin - b->xmax, b->xmin - a->xmax));
+  double dy = Max(0.0, Max(a->ymin - b->ymax, b->ymin - a->ymax));
+
+  return sqrt(dx * dx + dy * dy);
+}
+
+
+/*
+ * \brief Columns of row 'i' inside a Sakoe-Chiba band of half-width 'band'
+ *        around the diagonal of an n x m matrix.
+ *
+ */
+static inline void band_limits(int32 i, int32 n, int32 m, int32 band, int32 *lo, int32 *hi)
+{
+  int32 center;
+
+  if(band < 0)
+  {
+    *lo = 0;
+    *hi = m - 1;
+    return;
+  }
+
+  center = (n > 1) ? (int32) (((int64) i * (m - 1)) / (n - 1)) : 0;
+
+  *lo = Max(0, center - band);
+  *hi = Min(m - 1, center + band);
+}
+
+
+/*
+ * \brief Band half-width that keeps consecutive rows connected.
+ *
+ */
+static inline int32 band_width(int32 band, int32 n, int32 m)
+{
+  if(band < 0)
+    return -1;
+
+  return Max(band, (m + n - 1) / n);
+}
+
+
+static void check_inputs(const struct spatiotemporal *a, const struct spatiotemporal *b)
+{
+  if(a->srid != b->srid)
+    ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                    errmsg("spatiotemporal values have different SRIDs (%d, %d)", a->srid, b->srid)));
+}
+
+
+/*
+ * \brief Argument 'argno' from the cache if it was seen before, otherwise
+ *        only its header: the extent bounds are checked on the headers, so
+ *        pairs pruned by them are never detoasted.
+ *
+ * \note Sets 'cached' to the cached value, or NULL.
+ *
+ */
+static inline struct spatiotemporal *argument_header(FunctionCallInfo fcinfo, int argno,
+                                                     struct spatiotemporal **cached)
+{
+  *cached = spatiotemporal_cache_lookup(fcinfo, argno);
+
+  return *cached ? *cached : DatumGetSpatioTemporalHeader(PG_GETARG_DATUM(argno));
+}
+
+
+/*
+ * \brief Two-row dynamic programming shared by DTW and discrete Fréchet.
+ *
+ * \note For DTW a cell is the distance plus the best predecessor, for
+ *       Fréchet the largest of the two. Both are non-decreasing along any
+ *       warping path, so once a whole row exceeds the threshold the result
+ *       must exceed it too.
+ *
+ */
+static double dp_distance(const struct st_polyline *a, const struct st_polyline *b,
+                          int32 band, double threshold, bool frechet)
+{
+  int32 n = a->npoints;
+
+  int32 m = b->npoints;
+
+  double *prev = (double*) palloc((m + 1) * sizeof(double));
+
+  double *cur = (double*) palloc((m + 1) * sizeof(double));
+
+  int32 prev_lo = 0;
+
+  int32 prev_hi = m - 1;
+
+  double result;
+
+  band = band_width(band, n, m);
+
+  /* column 0 is a sentinel; only cell (-1, -1) is reachable for free */
+  prev[0] = 0.0;
+
+  for(int32 j = 1; j <= m; ++j)
+    prev[j] = INFINITY;
+
+  for(int32 j = 0; j <= m; ++j)
+    cur[j] = INFINITY;
+
+  for(int32 i = 0; i < n; ++i)
+  {
+    int32 lo, hi;
+
+    double row_min = INFINITY;
+
+    double *tmp;
+
+    CHECK_FOR_INTERRUPTS();
+
+    band_limits(i, n, m, band, &lo, &hi);
+
+    for(int32 j = lo; j <= hi; ++j)
+    {
+      double d = vertex_distance(a, i, b, j);
+
+      double best = Min(Min(prev[j], prev[j + 1]), cur[j]);
+
+      double v = frechet ? Max(best, d) : best + d;
+
+      cur[j + 1] = v;
+
+      if(v < row_min)
+        row_min = v;
+    }
+
+    if(row_min > threshold)
+    {
+      pfree(prev);
+      pfree(cur);
+      return INFINITY;
+    }
+
+    /* the free start only applies to the first row */
+    prev[0] = INFINITY;
+
+    /* recycle the older row: clear the cells its band had set */
+    for(int32 j = prev_lo; j <= prev_hi; ++j)
+      prev[j + 1] = INFINITY;
+
+    tmp = prev;
+    prev = cur;
+    cur = tmp;
+
+    prev_lo = lo;
+    prev_hi = hi;
+  }
+
+  result = prev[m];
+
+  pfree(prev);
+  pfree(cur);
+
+  return result > threshold ? INFINITY : result;
+}
+
+
+/*
+ * \brief Directed Hausdorff distance h(a, b) with the early break of Taha
+ *        and Hanbury: the inner loop stops once a point of 'b' is closer
+ *        than the current maximum.
+ *
+ */
+static double directed_hausdorff(const struct st_polyline *a, const struct st_polyline *b,
+                                 double cmax, double threshold)
+{
+  for(int32 i = 0; i < a->npoints; ++i)
+  {
+    double cmin = INFINITY;
+
+    bool skip = false;
+
+    CHECK_FOR_INTERRUPTS();
+
+    for(int32 j = 0; j < b->npoints; ++j)
+    {
+      double d = vertex_distance(a, i, b, j);
+
+      if(d < cmax)
+      {
+        skip = true;
+        break;
+      }
+
+      if(d < cmin)
+        cmin = d;
+    }
+
+    if(!skip && cmin > cmax)
+    {
+      cmax = cmin;
+
+      if(cmax > threshold)
+        return INFINITY;
+    }
+  }
+
+  return cmax;
+}
+
+
+PG_FUNCTION_INFO_V1(spatiotemporal_dtw);
+
+Datum
+spatiotemporal_dtw(PG_FUNCTION_ARGS)
+{
+  struct spatiotemporal *ca, *cb;
+
+  struct spatiotemporal *a = argument_header(fcinfo, 0, &ca);
+
+  struct spatiotemporal *b = argument_header(fcinfo, 1, &cb);
+
+  int32 band = PG_GETARG_INT32(2);
+
+  double threshold = PG_GETARG_FLOAT8(3);
+
+  struct st_polyline pa, pb;
+
+  double lower_bound;
+
+  check_inputs(a, b);
+
+  if(a->npoints == 0 || b->npoints == 0)
+    PG_RETURN_NULL();
+
+  /* every cell of a warping path costs at least the extent distance */
+  lower_bound = Max(a->npoints, b->npoints) * extent_distance(&a->extent, &b->extent);
+
+  if(lower_bound > threshold)
+    PG_RETURN_FLOAT8(INFINITY);
+
+  a = ca ? ca : PG_GETARG_SPATIOTEMPORAL_P(0);
+  b = cb ? cb : PG_GETARG_SPATIOTEMPORAL_P(1);
+
+  polyline_init(&pa, a);
+  polyline_init(&pb, b);
+
+  /* and the path always goes through both pairs of end points */
+  lower_bound = Max(lower_bound, vertex_distance(&pa, 0, &pb, 0) +
+                    ((a->npoints > 1 || b->npoints > 1) ?
+                     vertex_distance(&pa, a->npoints - 1, &pb, b->npoints - 1) : 0.0));
+
+  if(lower_bound > threshold)
+    PG_RETURN_FLOAT8(INFINITY);
+
+  PG_RETURN_FLOAT8(dp_distance(&pa, &pb, band, threshold, false));
+}
+
+
+PG_FUNCTION_INFO_V1(spatiotemporal_frechet);
+
+Datum
+spatiotemporal_frechet(PG_FUNCTION_ARGS)
+{
+  struct spatiotemporal *ca, *cb;
+
+  struct spatiotemporal *a = argument_header(fcinfo, 0, &ca);
+
+  struct spatiotemporal *b = argument_header(fcinfo, 1, &cb);
+
+  int32 band = PG_GETARG_INT32(2);
+
+  double threshold = PG_GETARG_FLOAT8(3);
+
+  struct st_polyline pa, pb;
+
+  double lower_bound;
+
+  check_inputs(a, b);
+
+  if(a->npoints == 0 || b->npoints == 0)
+    PG_RETURN_NULL();
+
+  /* Fréchet >= Hausdorff >= extent distance, and both ends are matched */
+  lower_bound = extent_distance(&a->extent, &b->extent);
+
+  if(lower_bound > threshold)
+    PG_RETURN_FLOAT8(INFINITY);
+
+  a = ca ? ca : PG_GETARG_SPATIOTEMPORAL_P(0);
+  b = cb ? cb : PG_GETARG_SPATIOTEMPORAL_P(1);
+
+  polyline_init(&pa, a);
+  polyline_init(&pb, b);
+
+  lower_bound = Max(lower_bound, vertex_distance(&pa, 0, &pb, 0));
+
+  lower_bound = Max(lower_bound, vertex_distance(&pa, a->npoints - 1, &pb, b->npoints - 1));
+
+  if(lower_bound > threshold)
+    PG_RETURN_FLOAT8(INFINITY);
+
+  PG_RETURN_FLOAT8(dp_distance(&pa, &pb, band, threshold, true));
+}
+
+
+PG_FUNCTION_INFO_V1(spatiotemporal_hausdorff);
+
+Datum
+spatiotemporal_hausdorff(PG_FUNCTION_ARGS)
+{
+  struct spatiotemporal *ca, *cb;
+
+  struct spatiotemporal *a = argument_header(fcinfo, 0, &ca);
+
+  struct spatiotemporal *b = argument_header(fcinfo, 1, &cb);
+
+  double threshold = PG_GETARG_FLOAT8(2);
+
+  struct st_polyline pa, pb;
+
+  double lower_bound;
+
+  double h;
+
+  check_inputs(a, b);
+
+  if(a->npoints == 0 || b->npoints == 0)
+    PG_RETURN_NULL();
+
+  lower_bound = extent_distance(&a->extent, &b->extent);
+
+  if(lower_bound > threshold)
+    PG_RETURN_FLOAT8(INFINITY);
+
+  a = ca ? ca : PG_GETARG_SPATIOTEMPORAL_P(0);
+  b = cb ? cb : PG_GETARG_SPATIOTEMPORAL_P(1);
+
+  polyline_init(&pa, a);
+  polyline_init(&pb, b);
+
+  h = directed_hausdorff(&pa, &pb, lower_bound, threshold);
+
+  if(isinf(h))
+    PG_RETURN_FLOAT8(INFINITY);
+
+  /* the second direction only has to beat the first one */
+  h = directed_hausdorff(&pb, &pa, h, threshold);
+
+  PG_RETURN_FLOAT8(h);
+}
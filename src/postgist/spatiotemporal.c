@@ -33,13 +33,24 @@
 
 /* PostGIS-T extension */
 #include "spatiotemporal.h"
+#include "cache.h"
 #include "wkt.h"
 #include "hexutils.h"
+#include "dims.h"
+#include "twkb.h"
+#include "mfjson.h"
 
 /* PostgreSQL */
+#include <access/htup_details.h>
+#include <funcapi.h>
 #include <libpq/pqformat.h>
 #include <utils/builtins.h>
 #include <utils/rangetypes.h>
+#include <utils/typcache.h>
+
+/* C Standard Library */
+#include <float.h>
+#include <math.h>
 
 
 
@@ -53,15 +64,16 @@ spatiotemporal_make(PG_FUNCTION_ARGS)
 
   struct spatiotemporal *st  =  spatiotemporal_decode(str);
 
+  /* as a type input function we may also get the column typmod */
+  if(PG_NARGS() > 2 && PG_GETARG_INT32(2) != -1)
+    st = spatiotemporal_apply_typmod(st, PG_GETARG_INT32(2));
+
   // char *timestamp = palloc(2 * sizeof(Timestamp) + 1);
 
   // timestamp = DatumGetCString(DirectFunctionCall1(timestamp_out, PointerGetDatum(st->start_time)));
 
   // elog(INFO, "trajectory_elem_out timestamp: %s", timestamp);
 
-
-  elog(INFO, "spatiotemporal_make FINISH");
-
   PG_RETURN_SPATIOTEMPORAL_P(st);
 }
 
@@ -73,7 +85,6 @@ spatiotemporal_in(PG_FUNCTION_ARGS){
 
   char *str = PG_GETARG_CSTRING(0);
 
-  elog(INFO, "spatiotemporal_in CALL");
 
   char *hstr = str;
 
@@ -103,17 +114,143 @@ spatiotemporal_in(PG_FUNCTION_ARGS){
 
 }
 
+
+/*
+ * Binary send/receive format, in network byte order:
+ *
+ *   int32   flags (ST_FLAG_Z, ST_FLAG_M)
+ *   int32   srid
+ *   int32   npoints
+ *   int32   reserved, 0
+ *   int64   start_time and end_time, in microseconds since 2000-01-01
+ *   float8  npoints * ndims coordinates, interleaved as in ST_COORDS
+ *   int64   npoints times
+ *
+ * The arrays start at 8-byte offsets, so clients can map them directly.
+ */
+PG_FUNCTION_INFO_V1(spatiotemporal_send);
+
+Datum
+spatiotemporal_send(PG_FUNCTION_ARGS)
+{
+  struct spatiotemporal *st = PG_GETARG_SPATIOTEMPORAL_P(0);
+
+  int32 ncoords = st->npoints * ST_NDIMS(st);
+
+  const double *coords = ST_COORDS(st);
+
+  const Timestamp *times = ST_TIMES(st);
+
+  StringInfoData buf;
+
+  pq_begintypsend(&buf);
+
+  enlargeStringInfo(&buf, 32 + ncoords * sizeof(double) + st->npoints * sizeof(Timestamp));
+
+  pq_sendint32(&buf, st->flags & (ST_FLAG_Z | ST_FLAG_M));
+  pq_sendint32(&buf, st->srid);
+  pq_sendint32(&buf, st->npoints);
+  pq_sendint32(&buf, 0);
+  pq_sendint64(&buf, st->start_time);
+  pq_sendint64(&buf, st->end_time);
+
+  for(int32 i = 0; i < ncoords; ++i)
+    pq_sendfloat8(&buf, coords[i]);
+
+  for(int32 i = 0; i < st->npoints; ++i)
+    pq_sendint64(&buf, times[i]);
+
+  PG_RETURN_BYTEA_P(pq_endtypsend(&buf));
+}
+
+
+PG_FUNCTION_INFO_V1(spatiotemporal_recv);
+
+Datum
+spatiotemporal_recv(PG_FUNCTION_ARGS)
+{
+  StringInfo buf = (StringInfo) PG_GETARG_POINTER(0);
+
+  int32 flags = pq_getmsgint(buf, 4);
+
+  int32 srid = pq_getmsgint(buf, 4);
+
+  int32 npoints = pq_getmsgint(buf, 4);
+
+  struct spatiotemporal *st;
+
+  double *coords;
+
+  Timestamp *times;
+
+  int ndims;
+
+  if((flags & ~(ST_FLAG_Z | ST_FLAG_M)) != 0 || srid < 0 || srid > SRID_MAXIMUM)
+    ereport(ERROR, (errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+                    errmsg("invalid flags or SRID in external spatiotemporal value")));
+
+  ndims = ST_FLAGS_NDIMS(flags);
+
+  /* reject counts the message can not hold before allocating for them */
+  if(npoints < 0 || (int64) npoints * (ndims + 1) * 8 > buf->len - buf->cursor)
+    ereport(ERROR, (errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+                    errmsg("invalid number of instants in external spatiotemporal value")));
+
+  pq_getmsgint(buf, 4);
+
+  st = spatiotemporal_alloc(npoints, flags);
+
+  st->srid = srid;
+  st->npoints = npoints;
+  st->start_time = pq_getmsgint64(buf);
+  st->end_time = pq_getmsgint64(buf);
+
+  coords = ST_COORDS(st);
+
+  times = ST_TIMES(st);
+
+  for(int32 i = 0; i < npoints * ndims; ++i)
+  {
+    coords[i] = pq_getmsgfloat8(buf);
+
+    if(!isfinite(coords[i]))
+      ereport(ERROR, (errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+                      errmsg("external spatiotemporal coordinates must be finite")));
+  }
+
+  for(int32 i = 0; i < npoints; ++i)
+  {
+    times[i] = pq_getmsgint64(buf);
+
+    if(TIMESTAMP_NOT_FINITE(times[i]) || (i > 0 && times[i] <= times[i - 1]))
+      ereport(ERROR, (errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+                      errmsg("external spatiotemporal instants must be finite and in increasing time order")));
+  }
+
+  if(npoints > 0)
+  {
+    if(st->start_time != times[0] || st->end_time != times[npoints - 1])
+      ereport(ERROR, (errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+                      errmsg("external spatiotemporal period does not match its instants")));
+
+    st_dims_ops_get(flags)->extent(coords, npoints, &st->extent);
+  }
+
+  if(PG_NARGS() > 2 && PG_GETARG_INT32(2) != -1)
+    st = spatiotemporal_apply_typmod(st, PG_GETARG_INT32(2));
+
+  PG_RETURN_SPATIOTEMPORAL_P(st);
+}
+
 PG_FUNCTION_INFO_V1(spatiotemporal_out);
 
 Datum
 spatiotemporal_out(PG_FUNCTION_ARGS)
 {
-  elog(INFO, "spatiotemporal_out CALL ");
-
   struct spatiotemporal *st = PG_GETARG_SPATIOTEMPORAL_P(0);
 
   /* alloc a buffer for hex-string plus a trailing '\0' */
-  char *hstr = palloc((2 * sizeof(struct spatiotemporal)) + 1);
+  char *hstr = palloc((2 * VARSIZE(st)) + 1);
 
   /*elog(NOTICE, "spatiotemporal called");*/
 
@@ -121,7 +258,7 @@ spatiotemporal_out(PG_FUNCTION_ARGS)
     ereport(ERROR, (errcode (ERRCODE_INVALID_PARAMETER_VALUE),
                     errmsg("missing argument for spatiotemporal")));
 
-  binary2hex((char*)st, sizeof(struct spatiotemporal), hstr);
+  binary2hex((char*)st, VARSIZE(st), hstr);
 
   PG_RETURN_CSTRING(hstr);
 
@@ -136,68 +273,124 @@ spatiotemporal_as_text(PG_FUNCTION_ARGS)
 {
   struct spatiotemporal *st = PG_GETARG_SPATIOTEMPORAL_P(0);
 
-  char *start_time;
+  PG_RETURN_CSTRING(spatiotemporal_encode(st));
+}
 
-  char *end_time;
 
-  StringInfoData str;
+PG_FUNCTION_INFO_V1(spatiotemporal_as_binary);
 
-  initStringInfo(&str);
+Datum
+spatiotemporal_as_binary(PG_FUNCTION_ARGS)
+{
+  struct spatiotemporal *st = PG_GETARG_SPATIOTEMPORAL_P(0);
 
-  start_time = DatumGetCString(DirectFunctionCall1(timestamp_out, st->start_time));
-  end_time = DatumGetCString(DirectFunctionCall1(timestamp_out, st->end_time));
+  int precision = PG_GETARG_INT32(1);
 
-  appendStringInfoString(&str, start_time);
+  PG_RETURN_BYTEA_P(spatiotemporal_to_twkb(st, precision));
+}
 
-  appendStringInfoChar(&str, ',');
 
-  appendStringInfoString(&str, end_time);
+PG_FUNCTION_INFO_V1(spatiotemporal_as_mfjson);
 
-  appendStringInfoChar(&str, ',');
+Datum
+spatiotemporal_as_mfjson(PG_FUNCTION_ARGS)
+{
+  struct spatiotemporal *st = PG_GETARG_SPATIOTEMPORAL_P(0);
 
-  char *hexwkb;
+  int precision = PG_GETARG_INT32(1);
 
-  size_t hexwkb_size;
+  if(precision < 0 || precision > DBL_DIG)
+    ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                    errmsg("MF-JSON precision must be between 0 and %d", DBL_DIG)));
 
-  LWGEOM *lwgeom;
+  PG_RETURN_TEXT_P(cstring_to_text(spatiotemporal_to_mfjson(st, precision)));
+}
 
-  Point *point;
-	LWPOINT *lwpoint;
 
-  point = (Point*)palloc(sizeof(Point));
+/*
+ * \brief Cursor kept across the calls of st_instants.
+ *
+ */
+struct spatiotemporal_instants_cursor
+{
+  struct spatiotemporal *st;
+  int32 next;
+};
 
-  for(int i = 0; i < 6; i+=2 ){
-    point->x = st->data[i];
-    // st->data += sizeof(double);
-    point->y = st->data[i+1];
 
-    if ( ! point ){
-      elog(INFO, "null");
-      PG_RETURN_NULL();
+PG_FUNCTION_INFO_V1(spatiotemporal_instants);
+
+Datum
+spatiotemporal_instants(PG_FUNCTION_ARGS)
+{
+  FuncCallContext *funcctx;
+
+  struct spatiotemporal_instants_cursor *cursor;
+
+  struct spatiotemporal *st;
+
+  if(SRF_IS_FIRSTCALL())
+  {
+    MemoryContext oldcontext;
+
+    TupleDesc tupdesc;
 
-    }
+    funcctx = SRF_FIRSTCALL_INIT();
 
-  	lwpoint = lwpoint_make2d(SRID_UNKNOWN, point->x, point->y);
+    oldcontext = MemoryContextSwitchTo(funcctx->multi_call_memory_ctx);
 
-    //lwgeom = lwpoint_as_lwgeom(lwpoint);
-    lwgeom = (LWGEOM*)lwpoint;
-    // hexwkb = lwgeom_to_hexwkb(lwgeom, WKB_EXTENDED, &hexwkb_size);
-    hexwkb = lwgeom_to_wkt(lwgeom, WKT_ISO, DBL_DIG, &hexwkb_size);
-    elog(INFO, "lwgeom_to_hexwkb");
+    if(get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+      ereport(ERROR, (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+                      errmsg("function returning record called in context that cannot accept type record")));
 
-    appendStringInfoChar(&str, '-');
+    funcctx->tuple_desc = BlessTupleDesc(tupdesc);
 
-    appendStringInfoString(&str, hexwkb);
+    /* detoast once, the arrays are then walked in place */
+    cursor = (struct spatiotemporal_instants_cursor*) palloc(sizeof(struct spatiotemporal_instants_cursor));
 
+    cursor->st = PG_GETARG_SPATIOTEMPORAL_P(0);
+
+    cursor->next = 0;
+
+    funcctx->user_fctx = cursor;
+
+    MemoryContextSwitchTo(oldcontext);
   }
 
+  funcctx = SRF_PERCALL_SETUP();
+
+  cursor = (struct spatiotemporal_instants_cursor*) funcctx->user_fctx;
+
+  st = cursor->st;
+
+  if(cursor->next < st->npoints)
+  {
+    Datum values[2];
+
+    bool nulls[2] = { false, false };
+
+    HeapTuple tuple;
+
+    /* the point array references the stored coordinates, no copy is made */
+    POINTARRAY *pa = ptarray_construct_reference_data(ST_HAS_Z(st), ST_HAS_M(st), 1,
+                       (uint8_t*) (ST_COORDS(st) + cursor->next * ST_NDIMS(st)));
 
-  /*teste PointerGetDatum(gserialized_from_lwgeom())*/
-  pfree(start_time);
-  pfree(end_time);
+    LWPOINT *lwpoint = lwpoint_construct(st->srid, NULL, pa);
 
-  PG_RETURN_CSTRING(str.data);
+    values[0] = PointerGetDatum(geometry_serialize((LWGEOM*) lwpoint));
 
+    values[1] = TimestampGetDatum(ST_TIMES(st)[cursor->next]);
+
+    lwpoint_free(lwpoint);
+
+    ++cursor->next;
+
+    tuple = heap_form_tuple(funcctx->tuple_desc, values, nulls);
+
+    SRF_RETURN_NEXT(funcctx, HeapTupleGetDatum(tuple));
+  }
+
+  SRF_RETURN_DONE(funcctx);
 }
 
 
@@ -234,3 +427,415 @@ spatiotemporal_get_end_time(PG_FUNCTION_ARGS)
 
  PG_RETURN_TIMESTAMP(st->end_time);
 }
+
+
+struct spatiotemporal *spatiotemporal_alloc(int32 capacity, int32 flags)
+{
+  size_t size = ST_SIZE(capacity, ST_FLAGS_NDIMS(flags));
+
+  struct spatiotemporal *st = (struct spatiotemporal*) palloc0(size);
+
+  SET_VARSIZE(st, size);
+
+  st->flags = flags;
+
+  st->capacity = capacity;
+
+  st->extent.xmin = st->extent.ymin = DBL_MAX;
+  st->extent.xmax = st->extent.ymax = -DBL_MAX;
+
+  return st;
+}
+
+
+/*
+ * \brief Copy 'st' into a new value with room for 'capacity' instants.
+ *
+ * \note The time array follows the coordinate array, so both arrays must
+ *       be moved when the capacity changes.
+ *
+ */
+static struct spatiotemporal *spatiotemporal_grow(struct spatiotemporal *st, int32 capacity)
+{
+  struct spatiotemporal *result = spatiotemporal_alloc(capacity, st->flags);
+
+  memcpy(result, st, ST_HEADER_SIZE);
+
+  SET_VARSIZE(result, ST_SIZE(capacity, ST_NDIMS(st)));
+
+  result->capacity = capacity;
+
+  memcpy(ST_COORDS(result), ST_COORDS(st), st->npoints * ST_NDIMS(st) * sizeof(double));
+
+  memcpy(ST_TIMES(result), ST_TIMES(st), st->npoints * sizeof(Timestamp));
+
+  return result;
+}
+
+
+PG_FUNCTION_INFO_V1(spatiotemporal_append_instant);
+
+Datum
+spatiotemporal_append_instant(PG_FUNCTION_ARGS)
+{
+  struct spatiotemporal *st;
+
+  GSERIALIZED *gser;
+
+  LWGEOM *lwgeom;
+
+  LWPOINT *lwpoint;
+
+  Timestamp t;
+
+  POINT4D p;
+
+  int32 flags;
+
+  if(PG_ARGISNULL(1) || PG_ARGISNULL(2))
+  {
+    if(PG_ARGISNULL(0))
+      PG_RETURN_NULL();
+
+    PG_RETURN_DATUM(PG_GETARG_DATUM(0));
+  }
+
+  gser = PG_GETARG_GSERIALIZED_P(1);
+
+  t = PG_GETARG_TIMESTAMP(2);
+
+  if(TIMESTAMP_NOT_FINITE(t))
+    ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                    errmsg("timestamp for spatiotemporal instant must be finite")));
+
+  if(gserialized_get_type(gser) != POINTTYPE || gserialized_is_empty(gser))
+    ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                    errmsg("spatiotemporal instant must be a non-empty point")));
+
+  lwgeom = lwgeom_from_gserialized(gser);
+
+  lwpoint = lwgeom_as_lwpoint(lwgeom);
+
+  getPoint4d_p(lwpoint->point, 0, &p);
+
+  flags = st_flags_from_lwflags(lwgeom->flags);
+
+  lwgeom_free(lwgeom);
+
+  if(PG_ARGISNULL(0))
+  {
+    st = spatiotemporal_alloc(ST_MIN_CAPACITY, flags);
+
+    st->srid = gserialized_get_srid(gser);
+  }
+  else
+  {
+    /*
+     * An aggregate owns its transition state, so it is written in place
+     * and grows geometrically: st_trajectory_agg is linear in the number
+     * of rows. Otherwise the result is a new value, sized exactly so that
+     * no spare room is stored.
+     */
+    bool in_place = AggCheckCallContext(fcinfo, NULL);
+
+    st = PG_GETARG_SPATIOTEMPORAL_P(0);
+
+    if(flags != (st->flags & (ST_FLAG_Z | ST_FLAG_M)))
+      ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                      errmsg("spatiotemporal instant dimensionality does not match the spatiotemporal")));
+
+    if(gserialized_get_srid(gser) != SRID_UNKNOWN && gserialized_get_srid(gser) != st->srid)
+      ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                      errmsg("spatiotemporal instant SRID (%d) does not match the spatiotemporal SRID (%d)",
+                             gserialized_get_srid(gser), st->srid)));
+
+    if(st->npoints > 0 && t <= st->end_time)
+      ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                      errmsg("spatiotemporal instants must be appended in increasing time order")));
+
+    if(!in_place)
+      st = spatiotemporal_grow(st, st->npoints + 1);
+    else if(st->npoints == st->capacity)
+      st = spatiotemporal_grow(st, Max(st->capacity * 2, ST_MIN_CAPACITY));
+  }
+
+  st_dims_ops_get(st->flags)->encode(ST_COORDS(st) + st->npoints * ST_NDIMS(st), &p);
+
+  ST_TIMES(st)[st->npoints] = t;
+
+  if(st->npoints == 0)
+    st->start_time = t;
+
+  st->end_time = t;
+
+  st_extent_expand(&st->extent, p.x, p.y);
+
+  ++st->npoints;
+
+  PG_RETURN_SPATIOTEMPORAL_P(st);
+}
+
+
+/*
+ * \brief Drop the spare room of a value; final function of
+ *        st_trajectory_agg.
+ *
+ */
+PG_FUNCTION_INFO_V1(spatiotemporal_compact);
+
+Datum
+spatiotemporal_compact(PG_FUNCTION_ARGS)
+{
+  struct spatiotemporal *st = PG_GETARG_SPATIOTEMPORAL_P(0);
+
+  if(st->capacity == st->npoints)
+    PG_RETURN_SPATIOTEMPORAL_P(st);
+
+  PG_RETURN_SPATIOTEMPORAL_P(spatiotemporal_grow(st, st->npoints));
+}
+
+
+PG_FUNCTION_INFO_V1(spatiotemporal_get_srid);
+
+Datum
+spatiotemporal_get_srid(PG_FUNCTION_ARGS)
+{
+  struct spatiotemporal *st = PG_GETARG_SPATIOTEMPORAL_P(0);
+
+  PG_RETURN_INT32(st->srid);
+}
+
+
+PG_FUNCTION_INFO_V1(spatiotemporal_set_srid);
+
+Datum
+spatiotemporal_set_srid(PG_FUNCTION_ARGS)
+{
+  struct spatiotemporal *st = PG_GETARG_SPATIOTEMPORAL_P_COPY(0);
+
+  int32 srid = PG_GETARG_INT32(1);
+
+  if(srid < 0 || srid > SRID_MAXIMUM)
+    ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                    errmsg("invalid SRID for spatiotemporal: %d", srid)));
+
+  st->srid = srid;
+
+  PG_RETURN_SPATIOTEMPORAL_P(st);
+}
+
+
+bool st_period_from_range(Datum range, Timestamp *lower, Timestamp *upper)
+{
+  RangeType *r = DatumGetRangeTypeP(range);
+
+  TypeCacheEntry *typcache = lookup_type_cache(RangeTypeGetOid(r), TYPECACHE_RANGE_INFO);
+
+  RangeBound lb, ub;
+
+  bool empty;
+
+  range_deserialize(typcache, r, &lb, &ub, &empty);
+
+  if(empty)
+    return false;
+
+  if(lb.infinite)
+    TIMESTAMP_NOBEGIN(*lower);
+  else
+    *lower = DatumGetTimestamp(lb.val) + (lb.inclusive ? 0 : 1);
+
+  if(ub.infinite)
+    TIMESTAMP_NOEND(*upper);
+  else
+    *upper = DatumGetTimestamp(ub.val) - (ub.inclusive ? 0 : 1);
+
+  return *lower <= *upper;
+}
+
+
+PG_FUNCTION_INFO_V1(spatiotemporal_overlaps);
+
+Datum
+spatiotemporal_overlaps(PG_FUNCTION_ARGS)
+{
+  struct spatiotemporal *a = PG_GETARG_SPATIOTEMPORAL_HEADER_P(0);
+
+  struct spatiotemporal *b = PG_GETARG_SPATIOTEMPORAL_HEADER_P(1);
+
+  PG_RETURN_BOOL(a->start_time <= b->end_time && b->start_time <= a->end_time &&
+                 st_extent_overlaps(&a->extent, &b->extent));
+}
+
+
+PG_FUNCTION_INFO_V1(spatiotemporal_overlaps_geometry);
+
+Datum
+spatiotemporal_overlaps_geometry(PG_FUNCTION_ARGS)
+{
+  struct spatiotemporal *st = PG_GETARG_SPATIOTEMPORAL_HEADER_P(0);
+
+  GSERIALIZED *gser = PG_GETARG_GSERIALIZED_P(1);
+
+  GBOX gbox;
+
+  struct st_extent e;
+
+  if(gserialized_get_gbox_p(gser, &gbox) == LW_FAILURE)
+    PG_RETURN_BOOL(false);
+
+  e.xmin = gbox.xmin;
+  e.ymin = gbox.ymin;
+  e.xmax = gbox.xmax;
+  e.ymax = gbox.ymax;
+
+  PG_RETURN_BOOL(st_extent_overlaps(&st->extent, &e));
+}
+
+
+PG_FUNCTION_INFO_V1(spatiotemporal_overlaps_period);
+
+Datum
+spatiotemporal_overlaps_period(PG_FUNCTION_ARGS)
+{
+  struct spatiotemporal *st = PG_GETARG_SPATIOTEMPORAL_HEADER_P(0);
+
+  Timestamp lower, upper;
+
+  if(st->npoints == 0 || !st_period_from_range(PG_GETARG_DATUM(1), &lower, &upper))
+    PG_RETURN_BOOL(false);
+
+  PG_RETURN_BOOL(st->start_time <= upper && lower <= st->end_time);
+}
+
+
+PG_FUNCTION_INFO_V1(spatiotemporal_during);
+
+Datum
+spatiotemporal_during(PG_FUNCTION_ARGS)
+{
+  struct spatiotemporal *st = PG_GETARG_SPATIOTEMPORAL_HEADER_P(0);
+
+  Timestamp lower, upper;
+
+  if(st->npoints == 0 || !st_period_from_range(PG_GETARG_DATUM(1), &lower, &upper))
+    PG_RETURN_BOOL(false);
+
+  PG_RETURN_BOOL(lower <= st->start_time && st->end_time <= upper);
+}
+
+
+PG_FUNCTION_INFO_V1(spatiotemporal_intersects);
+
+Datum
+spatiotemporal_intersects(PG_FUNCTION_ARGS)
+{
+  Datum d = PG_GETARG_DATUM(0);
+
+  struct spatiotemporal *hdr = DatumGetSpatioTemporalHeader(d);
+
+  GSERIALIZED *gser = PG_GETARG_GSERIALIZED_P(1);
+
+  struct spatiotemporal *st;
+
+  GBOX gbox;
+
+  struct st_extent e;
+
+  POINTARRAY *pa;
+
+  LWGEOM *lwgeom;
+
+  GEOSGeometry *g1, *g2;
+
+  const GEOSPreparedGeometry *prepared;
+
+  char result;
+
+  if(gserialized_get_srid(gser) != hdr->srid)
+    ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                    errmsg("operation on mixed SRID spatiotemporal (%d) and geometry (%d)",
+                           hdr->srid, gserialized_get_srid(gser))));
+
+  if(hdr->npoints == 0 || gserialized_get_gbox_p(gser, &gbox) == LW_FAILURE)
+    PG_RETURN_BOOL(false);
+
+  e.xmin = gbox.xmin;
+  e.ymin = gbox.ymin;
+  e.xmax = gbox.xmax;
+  e.ymax = gbox.ymax;
+
+  /* the extents are compared before the arrays are fetched */
+  if(!st_extent_overlaps(&hdr->extent, &e))
+    PG_RETURN_BOOL(false);
+
+  st = spatiotemporal_cache_get(fcinfo, 0);
+
+  pa = ptarray_construct(0, 0, st->npoints);
+
+  for(int32 i = 0; i < st->npoints; ++i)
+  {
+    POINT4D p;
+
+    p.x = ST_COORDS(st)[i * ST_NDIMS(st)];
+    p.y = ST_COORDS(st)[i * ST_NDIMS(st) + 1];
+    p.z = p.m = 0.0;
+
+    ptarray_set_point4d(pa, i, &p);
+  }
+
+  if(st->npoints == 1)
+    lwgeom = (LWGEOM*) lwpoint_construct(st->srid, NULL, pa);
+  else
+    lwgeom = (LWGEOM*) lwline_construct(st->srid, NULL, pa);
+
+  initGEOS(lwpgnotice, lwgeom_geos_error);
+
+  g1 = LWGEOM2GEOS(lwgeom, 0);
+
+  lwgeom_free(lwgeom);
+
+  if(g1 == NULL)
+    ereport(ERROR, (errcode(ERRCODE_INTERNAL_ERROR),
+                    errmsg("could not convert spatiotemporal to GEOS: %s", lwgeom_geos_errmsg)));
+
+  /* a geometry repeated across rows is prepared once per call site */
+  prepared = geometry_cache_prepared(fcinfo, 1);
+
+  if(prepared)
+  {
+    result = GEOSPreparedIntersects(prepared, g1);
+
+    GEOSGeom_destroy(g1);
+
+    if(result == 2)
+      ereport(ERROR, (errcode(ERRCODE_INTERNAL_ERROR),
+                      errmsg("GEOSPreparedIntersects: %s", lwgeom_geos_errmsg)));
+
+    PG_RETURN_BOOL(result == 1);
+  }
+
+  lwgeom = lwgeom_from_gserialized(gser);
+
+  g2 = LWGEOM2GEOS(lwgeom, 0);
+
+  lwgeom_free(lwgeom);
+
+  if(g2 == NULL)
+  {
+    GEOSGeom_destroy(g1);
+    ereport(ERROR, (errcode(ERRCODE_INTERNAL_ERROR),
+                    errmsg("could not convert geometry to GEOS: %s", lwgeom_geos_errmsg)));
+  }
+
+  result = GEOSIntersects(g1, g2);
+
+  GEOSGeom_destroy(g1);
+  GEOSGeom_destroy(g2);
+
+  if(result == 2)
+    ereport(ERROR, (errcode(ERRCODE_INTERNAL_ERROR),
+                    errmsg("GEOSIntersects: %s", lwgeom_geos_errmsg)));
+
+  PG_RETURN_BOOL(result == 1);
+}
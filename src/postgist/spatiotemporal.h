@@ -46,21 +46,124 @@
 #include <liblwgeom_internal.h>
 #include <lwgeom_geos.h>
 
+/* 2D extent of the positions stored in a spatiotemporal */
+struct st_extent
+{
+  double xmin;
+  double ymin;
+  double xmax;
+  double ymax;
+};
+
+/*
+ * Layout: the header is followed by the coordinate array (capacity * ndims
+ * doubles) and then by the time array (capacity timestamps). Only the first
+ * npoints entries of each array are in use; the remaining slots are spare
+ * room for st_append_instant.
+ *
+ * Chunked layout (ST_FLAG_CHUNKED): the header is followed by a directory
+ * of nchunks st_chunk entries, and each chunk holds its own coordinate and
+ * time arrays at the offset recorded in the directory. It lets functions
+ * fetch only the chunks they need with PG_DETOAST_DATUM_SLICE.
+ */
 struct spatiotemporal
 {
-	int32 vl_len_;        /*Varlena header*/
-  int32 dummy;
-	Timestamp start_time;
-	Timestamp end_time;
-	double data[1]; // 
+  int32 vl_len_;        /* Varlena header */
+  int32 flags;          /* Layout flags: ST_FLAG_Z, ST_FLAG_M */
+  Timestamp start_time;
+  Timestamp end_time;
+  int32 npoints;        /* Number of instants in use */
+  int32 capacity;       /* Number of instants the arrays have room for */
+  int32 srid;           /* Spatial reference system of the positions */
+  int32 nchunks;        /* Number of chunks in the chunked layout */
+  struct st_extent extent;
+  double data[1];
 };
 
+/* directory entry of a chunked value */
+struct st_chunk
+{
+  Timestamp start_time;
+  Timestamp end_time;
+  struct st_extent extent;
+  int32 offset;         /* Byte offset of the chunk arrays in the value */
+  int32 npoints;
+};
+
+/* layout flags */
+#define ST_FLAG_Z       0x01
+#define ST_FLAG_M       0x02
+#define ST_FLAG_CHUNKED 0x04
+
+#define ST_FLAGS_NDIMS(f) (2 + (((f) & ST_FLAG_Z) ? 1 : 0) + (((f) & ST_FLAG_M) ? 1 : 0))
+
+#define ST_HEADER_SIZE  offsetof(struct spatiotemporal, data)
+#define ST_HAS_Z(st)    (((st)->flags & ST_FLAG_Z) != 0)
+#define ST_HAS_M(st)    (((st)->flags & ST_FLAG_M) != 0)
+#define ST_NDIMS(st)    ST_FLAGS_NDIMS((st)->flags)
+#define ST_IS_CHUNKED(st)  (((st)->flags & ST_FLAG_CHUNKED) != 0)
+#define ST_CHUNKS(st)   ((struct st_chunk*) (st)->data)
+#define ST_COORDS(st)   ((st)->data)
+#define ST_TIMES(st)    ((Timestamp*) ((st)->data + (st)->capacity * ST_NDIMS(st)))
+#define ST_SIZE(capacity, ndims) \
+  (ST_HEADER_SIZE + (capacity) * ((ndims) * sizeof(double) + sizeof(Timestamp)))
 
-/*#define DatumGetSpatioTemporal(X)      ((struct spatiotemporal*) PG_DETOAST_DATUM(X))*/
-#define DatumGetSpatioTemporal(X)      ((struct spatiotemporal*) DatumGetPointer(X))
+/*
+ * Type modifier: spatiotemporal(srid [, dims [, precision]])
+ *
+ *   bits  0-1: ST_FLAG_Z / ST_FLAG_M
+ *   bit     2: dimensionality was given
+ *   bits  3-7: precision + 1 (0 means no precision was given)
+ *   bits 8-28: SRID
+ */
+#define ST_TYPMOD_DIMS_SET      0x04
+#define ST_TYPMOD_MAX_PRECISION 30
+
+#define ST_TYPMOD_GET_FLAGS(t)      ((t) & (ST_FLAG_Z | ST_FLAG_M))
+#define ST_TYPMOD_HAS_DIMS(t)       (((t) & ST_TYPMOD_DIMS_SET) != 0)
+#define ST_TYPMOD_GET_PRECISION(t)  ((((t) >> 3) & 0x1F) - 1)
+#define ST_TYPMOD_GET_SRID(t)       (((t) >> 8) & 0x1FFFFF)
+
+#define ST_TYPMOD_MAKE(srid, flags, dims_set, precision) \
+  ((((srid) & 0x1FFFFF) << 8) | ((((precision) + 1) & 0x1F) << 3) | \
+   ((dims_set) ? ST_TYPMOD_DIMS_SET : 0) | ((flags) & (ST_FLAG_Z | ST_FLAG_M)))
+
+/* minimum number of slots allocated when a value has to grow */
+#define ST_MIN_CAPACITY 8
+
+
+/* chunked values are handed to functions in the contiguous layout */
+#define DatumGetSpatioTemporal(X)      spatiotemporal_flatten((struct spatiotemporal*) PG_DETOAST_DATUM(X))
 #define PG_GETARG_SPATIOTEMPORAL_P(n)  DatumGetSpatioTemporal(PG_GETARG_DATUM(n))
+#define PG_GETARG_SPATIOTEMPORAL_P_COPY(n)  \
+  spatiotemporal_flatten((struct spatiotemporal*) PG_DETOAST_DATUM_COPY(PG_GETARG_DATUM(n)))
 #define PG_RETURN_SPATIOTEMPORAL_P(x)  PG_RETURN_POINTER(x)
 
+/*
+ * Fetch only the fixed-size header of a value. Functions that just need the
+ * times, SRID or extent avoid detoasting the arrays this way; ST_COORDS and
+ * ST_TIMES must not be used on the result.
+ */
+#define DatumGetSpatioTemporalHeader(X) \
+  ((struct spatiotemporal*) PG_DETOAST_DATUM_SLICE(X, 0, ST_HEADER_SIZE - VARHDRSZ))
+#define PG_GETARG_SPATIOTEMPORAL_HEADER_P(n)  DatumGetSpatioTemporalHeader(PG_GETARG_DATUM(n))
+
+
+/*
+ * \brief Grow the extent to include the point (x, y).
+ *
+ * \note An empty extent is represented by xmin > xmax.
+ *
+ */
+static inline void
+st_extent_expand(struct st_extent *e, double x, double y)
+{
+  if(x < e->xmin) e->xmin = x;
+  if(x > e->xmax) e->xmax = x;
+  if(y < e->ymin) e->ymin = y;
+  if(y > e->ymax) e->ymax = y;
+}
+
 
 /* create a spatiotemporal */
 extern Datum spatiotemporal_make(PG_FUNCTION_ARGS);
@@ -70,6 +173,11 @@ extern Datum spatiotemporal_make(PG_FUNCTION_ARGS);
 extern Datum spatiotemporal_in(PG_FUNCTION_ARGS);
 extern Datum spatiotemporal_out(PG_FUNCTION_ARGS);
 extern Datum spatiotemporal_as_text(PG_FUNCTION_ARGS);
+extern Datum spatiotemporal_send(PG_FUNCTION_ARGS);
+extern Datum spatiotemporal_recv(PG_FUNCTION_ARGS);
+extern Datum spatiotemporal_as_binary(PG_FUNCTION_ARGS);
+extern Datum spatiotemporal_as_mfjson(PG_FUNCTION_ARGS);
+extern Datum spatiotemporal_instants(PG_FUNCTION_ARGS);
 /*extern Datum spatiotemporal_from_text(PG_FUNCTION_ARGS);*/
 
 
@@ -78,14 +186,167 @@ extern Datum spatiotemporal_duration(PG_FUNCTION_ARGS);
 extern Datum spatiotemporal_get_start_time(PG_FUNCTION_ARGS);
 extern Datum spatiotemporal_get_end_time(PG_FUNCTION_ARGS);
 
+extern Datum spatiotemporal_append_instant(PG_FUNCTION_ARGS);
+extern Datum spatiotemporal_compact(PG_FUNCTION_ARGS);
+
+extern Datum spatiotemporal_overlaps(PG_FUNCTION_ARGS);
+extern Datum spatiotemporal_overlaps_geometry(PG_FUNCTION_ARGS);
+extern Datum spatiotemporal_overlaps_period(PG_FUNCTION_ARGS);
+extern Datum spatiotemporal_during(PG_FUNCTION_ARGS);
+extern Datum spatiotemporal_intersects(PG_FUNCTION_ARGS);
+
+/* statistics and selectivity */
+
+extern Datum spatiotemporal_analyze(PG_FUNCTION_ARGS);
+extern Datum spatiotemporal_overlaps_sel(PG_FUNCTION_ARGS);
+extern Datum spatiotemporal_overlaps_joinsel(PG_FUNCTION_ARGS);
+
+extern Datum spatiotemporal_get_srid(PG_FUNCTION_ARGS);
+extern Datum spatiotemporal_set_srid(PG_FUNCTION_ARGS);
+
+/* casts */
+
+extern Datum spatiotemporal_to_geometry(PG_FUNCTION_ARGS);
+extern Datum spatiotemporal_from_geometry(PG_FUNCTION_ARGS);
+
+/* similarity */
+
+extern Datum spatiotemporal_dtw(PG_FUNCTION_ARGS);
+extern Datum spatiotemporal_frechet(PG_FUNCTION_ARGS);
+extern Datum spatiotemporal_hausdorff(PG_FUNCTION_ARGS);
+
+extern Datum spatiotemporal_proximity_pairs(PG_FUNCTION_ARGS);
+
+/* chunked storage and time restriction */
+
+extern Datum spatiotemporal_chunk(PG_FUNCTION_ARGS);
+extern Datum spatiotemporal_value_at(PG_FUNCTION_ARGS);
+extern Datum spatiotemporal_at_period(PG_FUNCTION_ARGS);
+
+/* reprojection */
+
+extern Datum spatiotemporal_transform(PG_FUNCTION_ARGS);
+
+/* density grid aggregate */
+
+extern Datum spatiotemporal_density_grid_transfn(PG_FUNCTION_ARGS);
+extern Datum spatiotemporal_density_grid_combinefn(PG_FUNCTION_ARGS);
+extern Datum spatiotemporal_density_grid_serialfn(PG_FUNCTION_ARGS);
+extern Datum spatiotemporal_density_grid_deserialfn(PG_FUNCTION_ARGS);
+extern Datum spatiotemporal_density_grid_finalfn(PG_FUNCTION_ARGS);
+
+/* vector tiles */
+
+extern Datum spatiotemporal_as_tile(PG_FUNCTION_ARGS);
+extern Datum spatiotemporal_as_mvt_transfn(PG_FUNCTION_ARGS);
+extern Datum spatiotemporal_as_mvt_finalfn(PG_FUNCTION_ARGS);
+
+/* GiST operator class and planner support */
+
+extern Datum spatiotemporal_gist_compress(PG_FUNCTION_ARGS);
+extern Datum spatiotemporal_gist_decompress(PG_FUNCTION_ARGS);
+extern Datum spatiotemporal_gist_consistent(PG_FUNCTION_ARGS);
+extern Datum spatiotemporal_gist_union(PG_FUNCTION_ARGS);
+extern Datum spatiotemporal_gist_penalty(PG_FUNCTION_ARGS);
+extern Datum spatiotemporal_gist_picksplit(PG_FUNCTION_ARGS);
+extern Datum spatiotemporal_gist_same(PG_FUNCTION_ARGS);
+
+extern Datum spatiotemporal_intersects_support(PG_FUNCTION_ARGS);
+extern Datum spatiotemporal_during_support(PG_FUNCTION_ARGS);
+
+/* comparison and hashing */
+
+extern Datum spatiotemporal_cmp(PG_FUNCTION_ARGS);
+extern Datum spatiotemporal_eq(PG_FUNCTION_ARGS);
+extern Datum spatiotemporal_ne(PG_FUNCTION_ARGS);
+extern Datum spatiotemporal_lt(PG_FUNCTION_ARGS);
+extern Datum spatiotemporal_le(PG_FUNCTION_ARGS);
+extern Datum spatiotemporal_gt(PG_FUNCTION_ARGS);
+extern Datum spatiotemporal_ge(PG_FUNCTION_ARGS);
+extern Datum spatiotemporal_sortsupport(PG_FUNCTION_ARGS);
+extern Datum spatiotemporal_hash(PG_FUNCTION_ARGS);
+extern Datum spatiotemporal_hash_extended(PG_FUNCTION_ARGS);
+extern Datum spatiotemporal_normalize(PG_FUNCTION_ARGS);
+
+/* type modifiers */
+
+extern Datum spatiotemporal_typmod_in(PG_FUNCTION_ARGS);
+extern Datum spatiotemporal_typmod_out(PG_FUNCTION_ARGS);
+extern Datum spatiotemporal_enforce_typmod(PG_FUNCTION_ARGS);
+
 
 
 /*Internal operation*/
 
+/*
+ * \brief Allocate an empty spatiotemporal with room for 'capacity' instants
+ *        with the dimensionality given by 'flags'.
+ *
+ */
+extern struct spatiotemporal *spatiotemporal_alloc(int32 capacity, int32 flags);
+
+/*
+ * \brief Return 'st' in the contiguous layout: 'st' itself if it is not
+ *        chunked, otherwise a new value.
+ *
+ */
+extern struct spatiotemporal *spatiotemporal_flatten(struct spatiotemporal *st);
+
+/*
+ * \brief The instants of the value 'd' after 't', preceded by the last one
+ *        at or before 't' if there is one, in the contiguous layout.
+ *
+ * \note 'hdr' is the header of 'd'. Only the chunks, or the end of the
+ *       arrays, holding those instants are fetched, so the cost follows the
+ *       size of the tail rather than the size of the value.
+ *
+ */
+extern struct spatiotemporal *spatiotemporal_tail(Datum d, const struct spatiotemporal *hdr, Timestamp t);
+
+/*
+ * \brief Order two values: start time, end time and then payload bytes.
+ *
+ */
+extern int spatiotemporal_cmp_internal(const struct spatiotemporal *a, const struct spatiotemporal *b);
+
+/*
+ * \brief Check 'st' against the type modifier 'typmod' and return a value
+ *        that satisfies it.
+ *
+ * \note A value without SRID takes the SRID of the modifier and, when the
+ *       modifier has a precision, a rounded copy of 'st' is returned. A
+ *       chunked value keeps its layout.
+ *
+ */
+extern struct spatiotemporal *spatiotemporal_apply_typmod(struct spatiotemporal *st, int32 typmod);
+
 extern size_t lwgeom_size(const LWGEOM *lwgeom);
 extern size_t gserialized_from_lwgeom_point(const LWGEOM *geom, uint8_t *buf);
-extern LWGEOM* lwgeom_from_gserialized_buffer(uint8_t *data_ptr);
+extern LWGEOM* lwgeom_from_gserialized_buffer(uint8_t *data_ptr, uint8_t g_flags);
+
 
 
+/*
+ * \brief Tell if two extents share at least one point.
+ *
+ * \note An empty extent does not overlap anything.
+ *
+ */
+static inline bool
+st_extent_overlaps(const struct st_extent *a, const struct st_extent *b)
+{
+  return a->xmin <= b->xmax && b->xmin <= a->xmax &&
+         a->ymin <= b->ymax && b->ymin <= a->ymax;
+}
+
+
+/*
+ * \brief Convert a tsrange to closed bounds [lower, upper].
+ *
+ * \note Unbounded sides become DT_NOBEGIN/DT_NOEND. Returns false for an
+ *       empty range.
+ *
+ */
+extern bool st_period_from_range(Datum range, Timestamp *lower, Timestamp *upper);
 
 #endif  /* __POSTGIST_H__ */
@@ -0,0 +1,51 @@
+--
+-- Building spatiotemporal values one instant at a time
+--
+SET datestyle TO ISO;
+
+SELECT to_str(st_append_instant(NULL, 'SRID=4326;POINT(1 2)', '2015-05-18 10:00')) AS text;
+
+-- a point without SRID takes the SRID of the spatiotemporal
+SELECT to_str(st_append_instant(st_append_instant(NULL, 'SRID=4326;POINT(1 2)', '2015-05-18 10:00'),
+                                 'POINT(3 4)', '2015-05-18 10:30')) AS text;
+
+-- a NULL instant leaves the value alone
+SELECT st_append_instant(NULL, NULL, '2015-05-18 10:00') IS NULL AS is_null;
+
+-- invalid instants
+SELECT st_append_instant(st_append_instant(NULL, 'SRID=4326;POINT(1 2)', '2015-05-18 10:00'), 'POINT(3 4)', '2015-05-18 09:00');
+SELECT st_append_instant(st_append_instant(NULL, 'SRID=4326;POINT(1 2)', '2015-05-18 10:00'), 'POINT(3 4)', '2015-05-18 10:00');
+SELECT st_append_instant(st_append_instant(NULL, 'SRID=4326;POINT(1 2)', '2015-05-18 10:00'), 'SRID=3857;POINT(3 4)', '2015-05-18 11:00');
+SELECT st_append_instant(st_append_instant(NULL, 'SRID=4326;POINT(1 2)', '2015-05-18 10:00'), 'POINT(3 4 5)', '2015-05-18 11:00');
+SELECT st_append_instant(NULL, 'POINT EMPTY', '2015-05-18 10:00');
+SELECT st_append_instant(NULL, 'LINESTRING(0 0, 1 1)', '2015-05-18 10:00');
+SELECT st_append_instant(NULL, 'POINT(0 0)', 'infinity');
+
+-- aggregation
+CREATE TABLE st_points AS
+  SELECT i % 2 + 1 AS id, ST_SetSRID(ST_MakePoint(i, i * 0.5), 4326) AS geom,
+         '2015-05-18 10:00'::timestamp + i * interval '1 hour' AS t
+    FROM generate_series(0, 5) AS i;
+
+SELECT id, to_str(st_trajectory_agg(geom, t ORDER BY t)) AS text FROM st_points GROUP BY id ORDER BY id;
+
+-- the aggregate agrees with repeated st_append_instant
+SELECT id, st_trajectory_agg(geom, t ORDER BY t) =
+           CASE id
+             WHEN 1 THEN spatiotemporal_make('SRID=4326;ST_TRAJECTORY(2015-05-18 10:00:00;2015-05-18 14:00:00;POINT(0 0), 2015-05-18 10:00:00;POINT(2 1), 2015-05-18 12:00:00;POINT(4 2), 2015-05-18 14:00:00;)')
+             ELSE spatiotemporal_make('SRID=4326;ST_TRAJECTORY(2015-05-18 11:00:00;2015-05-18 15:00:00;POINT(1 0.5), 2015-05-18 11:00:00;POINT(3 1.5), 2015-05-18 13:00:00;POINT(5 2.5), 2015-05-18 15:00:00;)')
+           END AS equal
+  FROM st_points GROUP BY id ORDER BY id;
+
+-- the state grows past its initial capacity
+SELECT get_start_time(track) AS start_time, get_end_time(track) AS end_time,
+       (SELECT count(*) FROM st_instants(track)) AS instants
+  FROM (SELECT st_trajectory_agg(ST_MakePoint(i, i), '2015-05-18 00:00'::timestamp + i * interval '1 minute' ORDER BY i) AS track
+          FROM generate_series(1, 100) AS i) AS s;
+
+-- instants out of time order
+SELECT st_trajectory_agg(geom, t)
+  FROM (VALUES ('POINT(0 0)'::geometry, '2015-05-18 10:00'::timestamp),
+               ('POINT(1 1)'::geometry, '2015-05-18 09:00'::timestamp)) AS v(geom, t);
+
+DROP TABLE st_points;
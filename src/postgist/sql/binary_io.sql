@@ -0,0 +1,33 @@
+--
+-- Binary send and receive of spatiotemporal
+--
+SET datestyle TO ISO;
+
+CREATE TABLE st_bin (id integer, track spatiotemporal);
+
+INSERT INTO st_bin VALUES
+  (1, 'ST_TRAJECTORY(2015-05-18 10:00:00;2015-05-18 20:00:00;POINT(12 4), 2015-05-18 10:00:00;POINT(13.5 5), 2015-05-18 20:00:00;)'),
+  (2, 'SRID=4326;ST_TRAJECTORY(2015-05-18 10:00:00;2015-05-19 11:00:00.25;POINT(12 4), 2015-05-18 10:00:00;POINT(-0.5 0.25), 2015-05-18 20:00:00;POINT(15 10), 2015-05-19 11:00:00.25;)'),
+  (3, 'SRID=4326;ST_TRAJECTORY(2015-05-18 10:00:00;2015-05-18 11:00:00;POINT Z (1 2 3), 2015-05-18 10:00:00;POINT Z (4 5 6), 2015-05-18 11:00:00;)'),
+  (4, 'ST_TRAJECTORY(2015-05-18 10:00:00;2015-05-18 11:00:00;POINT M (1 2 3), 2015-05-18 10:00:00;POINT M (4 5 6), 2015-05-18 11:00:00;)'),
+  (5, 'SRID=4326;ST_TRAJECTORY(2015-05-18 10:00:00;2015-05-18 11:00:00;POINT ZM (1 2 3 4), 2015-05-18 10:00:00;POINT ZM (5 6 7 8), 2015-05-18 11:00:00;)');
+
+SELECT spatiotemporal_send(track) AS send FROM st_bin WHERE id = 1;
+
+\copy st_bin TO 'results/st_bin.bin' WITH (FORMAT binary)
+
+CREATE TABLE st_bin_copy (id integer, track spatiotemporal);
+
+\copy st_bin_copy FROM 'results/st_bin.bin' WITH (FORMAT binary)
+
+SELECT a.id, a.track = b.track AS equal, to_str(a.track)::text = to_str(b.track)::text AS same_text
+  FROM st_bin a JOIN st_bin_copy b USING (id) ORDER BY a.id;
+
+-- the column type modifier applies to received values too
+CREATE TABLE st_bin_4326 (id integer, track spatiotemporal(4326));
+
+\copy st_bin_4326 FROM 'results/st_bin.bin' WITH (FORMAT binary)
+
+SELECT id, st_srid(track) AS srid FROM st_bin_4326 ORDER BY id;
+
+DROP TABLE st_bin, st_bin_copy, st_bin_4326;
@@ -0,0 +1,27 @@
+--
+-- Casts between spatiotemporal and LINESTRING M geometries
+--
+SET datestyle TO ISO;
+
+-- the M ordinate holds seconds since 1970-01-01
+SELECT to_str('SRID=4326;LINESTRING M (1 2 1431943200, 3 4 1431943230.5)'::geometry::spatiotemporal) AS text;
+
+SELECT to_str('LINESTRING ZM (1 2 3 1431943200, 4 5 6 1431943260)'::geometry::spatiotemporal) AS text;
+
+SELECT ST_SRID(g) AS srid, ST_AsText(g) AS geom
+  FROM (SELECT spatiotemporal_make('SRID=4326;ST_TRAJECTORY(2015-05-18 10:00:00;2015-05-18 10:00:30;POINT(1 2), 2015-05-18 10:00:00;POINT(3 4), 2015-05-18 10:00:30;)')::geometry AS g) AS s;
+
+SELECT ST_AsText(spatiotemporal_make('ST_TRAJECTORY(2015-05-18 10:00:00;2015-05-18 10:01:00;POINT Z (1 2 3), 2015-05-18 10:00:00;POINT Z (4 5 6), 2015-05-18 10:01:00;)')::geometry) AS geom;
+
+-- round trips
+SELECT track::geometry::spatiotemporal = track AS st_round_trip
+  FROM (SELECT spatiotemporal_make('SRID=4326;ST_TRAJECTORY(2015-05-18 10:00:00;2015-05-18 20:00:00;POINT(12 4), 2015-05-18 10:00:00;POINT(13.5 5), 2015-05-18 12:00:00.25;POINT(15 10), 2015-05-18 20:00:00;)') AS track) AS s;
+
+SELECT ST_AsEWKB(g::spatiotemporal::geometry) = ST_AsEWKB(g) AS geom_round_trip FROM (SELECT 'LINESTRING M (1 2 1431943200, 3 4 1431943230)'::geometry AS g) AS s;
+
+-- geometries that do not describe a spatiotemporal
+SELECT 'LINESTRING(0 0, 1 1)'::geometry::spatiotemporal;
+SELECT 'POINT M (0 0 1431943200)'::geometry::spatiotemporal;
+SELECT 'LINESTRING M (0 0 1e300, 1 1 2e300)'::geometry::spatiotemporal;
+SELECT 'LINESTRING M (0 0 1431943230, 1 1 1431943200)'::geometry::spatiotemporal;
+SELECT spatiotemporal_make('ST_TRAJECTORY(2015-05-18 10:00:00;2015-05-18 11:00:00;POINT M (1 2 3), 2015-05-18 10:00:00;POINT M (4 5 6), 2015-05-18 11:00:00;)')::geometry;
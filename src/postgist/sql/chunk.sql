@@ -0,0 +1,54 @@
+--
+-- Chunked values in a column with a type modifier, stored uncompressed
+--
+SET datestyle TO ISO;
+
+-- hourly positions over 10 days
+CREATE TABLE st_flat AS
+  SELECT format('SRID=4326;ST_TRAJECTORY(%s;%s;%s)', min(t), max(t),
+                string_agg(format('POINT(%s %s), %s;', i, i * 0.5, t), '' ORDER BY t))::spatiotemporal AS track
+    FROM generate_series(0, 239) AS i, LATERAL (SELECT '2015-05-18 00:00'::timestamp + i * interval '1 hour' AS t) AS s;
+
+CREATE TABLE st_chunked (id integer, track spatiotemporal(4326, XY, 1));
+
+ALTER TABLE st_chunked ALTER COLUMN track SET STORAGE EXTERNAL;
+
+-- the column rounds the coordinates back to those of st_flat and sets the SRID of 2
+INSERT INTO st_chunked
+  SELECT 1, st_chunk(format('SRID=4326;ST_TRAJECTORY(%s;%s;%s)', min(t), max(t),
+                           string_agg(format('POINT(%s %s), %s;', i + 0.04, i * 0.5, t), '' ORDER BY t))::spatiotemporal, '1 day')
+    FROM generate_series(0, 239) AS i, LATERAL (SELECT '2015-05-18 00:00'::timestamp + i * interval '1 hour' AS t) AS s;
+INSERT INTO st_chunked
+  SELECT 2, st_chunk(format('ST_TRAJECTORY(%s;%s;%s)', min(t), max(t),
+                           string_agg(format('POINT(%s %s), %s;', i - 0.04, i * 0.5, t), '' ORDER BY t))::spatiotemporal, '12 hours')
+    FROM generate_series(0, 239) AS i, LATERAL (SELECT '2015-05-18 00:00'::timestamp + i * interval '1 hour' AS t) AS s;
+
+SELECT c.id, st_srid(c.track) AS srid, get_start_time(c.track) AS start_time, get_end_time(c.track) AS end_time,
+       c.track = f.track AS equal
+  FROM st_chunked c, st_flat f
+ ORDER BY c.id;
+
+-- the chunk directory takes room that the flat value does not
+SELECT id, pg_column_size(track) > pg_column_size(st_compact(track)) AS chunked FROM st_chunked ORDER BY id;
+
+-- positions inside a chunk, at an instant and between two chunks
+SELECT t, ST_AsText(st_value_at(track, t)) AS position
+  FROM st_chunked, (VALUES ('2015-05-19 12:30'::timestamp), ('2015-05-20 05:00'), ('2015-05-18 23:30'),
+                           ('2015-05-27 23:00'), ('2015-05-28 00:00')) AS v(t)
+ WHERE id = 1
+ ORDER BY t;
+
+-- a period across a chunk boundary
+SELECT to_str(st_at_period(track, '[2015-05-19 22:30, 2015-05-20 01:30]')) AS text FROM st_chunked WHERE id = 1;
+
+-- chunked and flat values give the same answers
+SELECT c.id, count(*) FILTER (WHERE ST_AsEWKB(st_value_at(c.track, t)) IS DISTINCT FROM ST_AsEWKB(st_value_at(f.track, t))) AS value_at,
+       count(*) FILTER (WHERE st_at_period(c.track, tsrange(t, t + interval '5 hours 10 minutes'))
+                              IS DISTINCT FROM st_at_period(f.track, tsrange(t, t + interval '5 hours 10 minutes'))) AS at_period
+  FROM st_chunked c, st_flat f, generate_series('2015-05-17 23:00'::timestamp, '2015-05-28 01:00', '47 minutes') AS t
+ GROUP BY c.id
+ ORDER BY c.id;
+
+SELECT st_chunk(track, '0 seconds') FROM st_flat;
+
+DROP TABLE st_flat, st_chunked;
@@ -0,0 +1,67 @@
+--
+-- Equality, ordering and hashing of spatiotemporal
+--
+SET datestyle TO ISO;
+
+CREATE TABLE st_cmp (id integer, track spatiotemporal);
+
+-- 2 differs from 1 only in the sign of a zero, 6 from 5 only in the sign of a NaN
+INSERT INTO st_cmp VALUES
+  (1, 'ST_TRAJECTORY(2015-05-18 10:00:00;2015-05-18 11:00:00;POINT(0 1), 2015-05-18 10:00:00;POINT(2 3), 2015-05-18 11:00:00;)'),
+  (2, 'ST_TRAJECTORY(2015-05-18 10:00:00;2015-05-18 11:00:00;POINT(-0 1), 2015-05-18 10:00:00;POINT(2 3), 2015-05-18 11:00:00;)'),
+  (3, 'ST_TRAJECTORY(2015-05-18 10:00:00;2015-05-18 11:00:00;POINT(0 1), 2015-05-18 10:00:00;POINT(2 4), 2015-05-18 11:00:00;)'),
+  (4, 'ST_TRAJECTORY(2015-06-18 10:00:00;2015-06-18 11:00:00;POINT(0 1), 2015-06-18 10:00:00;POINT(2 3), 2015-06-18 11:00:00;)');
+INSERT INTO st_cmp
+  SELECT id, st_append_instant(st_append_instant(NULL, ST_MakePoint(x, 1), '2015-05-18 10:00'),
+                               ST_MakePoint(2, 3), '2015-05-18 11:00')
+    FROM (VALUES (5, 'NaN'::float8), (6, -'NaN'::float8)) AS v(id, x);
+
+ANALYZE st_cmp;
+
+-- hash join
+SET enable_mergejoin TO off;
+SET enable_nestloop TO off;
+
+SELECT a.id, b.id FROM st_cmp a JOIN st_cmp b ON a.track = b.track WHERE a.id < b.id ORDER BY 1, 2;
+
+-- merge join
+SET enable_mergejoin TO on;
+SET enable_hashjoin TO off;
+
+SELECT a.id, b.id FROM st_cmp a JOIN st_cmp b ON a.track = b.track WHERE a.id < b.id ORDER BY 1, 2;
+
+RESET enable_mergejoin;
+RESET enable_nestloop;
+RESET enable_hashjoin;
+
+-- sorted and hashed grouping agree
+SELECT count(DISTINCT track) FROM st_cmp;
+
+SET enable_sort TO off;
+
+SELECT count(*) FROM (SELECT track FROM st_cmp GROUP BY track) AS s;
+
+RESET enable_sort;
+
+-- exactly one of <, = and > holds for every pair
+SELECT count(*) FROM st_cmp a, st_cmp b
+ WHERE (a.track < b.track)::int + (a.track = b.track)::int + (a.track > b.track)::int <> 1
+    OR (a.track <= b.track) <> (a.track < b.track OR a.track = b.track)
+    OR (a.track <> b.track) = (a.track = b.track)
+    OR sign(spatiotemporal_cmp(a.track, b.track)) <> -sign(spatiotemporal_cmp(b.track, a.track));
+
+-- values sort by start time, end time and then payload
+SELECT id FROM st_cmp ORDER BY track, id;
+
+-- btree index lookups
+CREATE INDEX st_cmp_btree ON st_cmp (track);
+
+SET enable_seqscan TO off;
+
+SELECT id FROM st_cmp WHERE track = spatiotemporal_make('ST_TRAJECTORY(2015-05-18 10:00:00;2015-05-18 11:00:00;POINT(0 1), 2015-05-18 10:00:00;POINT(2 3), 2015-05-18 11:00:00;)') ORDER BY id;
+
+SELECT id FROM st_cmp WHERE track = spatiotemporal_make('ST_TRAJECTORY(2015-06-18 10:00:00;2015-06-18 11:00:00;POINT(0 1), 2015-06-18 10:00:00;POINT(2 3), 2015-06-18 11:00:00;)') ORDER BY id;
+
+RESET enable_seqscan;
+
+DROP TABLE st_cmp;
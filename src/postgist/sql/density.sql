@@ -0,0 +1,34 @@
+--
+-- Space-time density grid
+--
+SET datestyle TO ISO;
+
+-- 1 moves right across the lower row, then up the right column; 2 enters the
+-- grid from the left half way through; 3 crosses it diagonally, starting early
+CREATE TABLE st_dens (id integer, track spatiotemporal);
+
+INSERT INTO st_dens VALUES
+  (1, 'ST_TRAJECTORY(2015-05-18 00:00:00;2015-05-18 02:00:00;POINT(0.5 0.5), 2015-05-18 00:00:00;POINT(1.5 0.5), 2015-05-18 01:00:00;POINT(1.5 1.5), 2015-05-18 02:00:00;)'),
+  (2, 'ST_TRAJECTORY(2015-05-18 00:30:00;2015-05-18 01:30:00;POINT(-1 1.5), 2015-05-18 00:30:00;POINT(1 1.5), 2015-05-18 01:30:00;)'),
+  (3, 'ST_TRAJECTORY(2015-05-17 23:00:00;2015-05-18 02:00:00;POINT(0.25 1.75), 2015-05-17 23:00:00;POINT(1.75 0.25), 2015-05-18 02:00:00;)');
+
+SELECT st_density_grid(track, ST_MakeEnvelope(0, 0, 2, 2), '[2015-05-18 00:00, 2015-05-18 02:00)', 2, 2, '1 hour')
+  FROM st_dens WHERE id = 1;
+
+SELECT st_density_grid(track, ST_MakeEnvelope(0, 0, 2, 2), '[2015-05-18 00:00, 2015-05-18 02:00)', 2, 2, '1 hour') FROM st_dens;
+
+-- the last bucket stops at the end of the period
+SELECT st_density_grid(track, ST_MakeEnvelope(0, 0, 2, 2), '[2015-05-18 00:00, 2015-05-18 01:30)', 2, 2, '1 hour') FROM st_dens;
+
+-- no rows, no grid
+SELECT st_density_grid(track, ST_MakeEnvelope(0, 0, 2, 2), '[2015-05-18 00:00, 2015-05-18 02:00)', 2, 2, '1 hour') IS NULL AS is_null FROM st_dens WHERE id = 0;
+
+-- invalid grids
+SELECT st_density_grid(track, ST_MakeEnvelope(0, 0, 2, 2), '[2015-05-18 00:00, 2015-05-18 02:00)', 0, 2, '1 hour') FROM st_dens;
+SELECT st_density_grid(track, ST_MakeEnvelope(0, 0, 2, 2), '[2015-05-18 00:00,)', 2, 2, '1 hour') FROM st_dens;
+SELECT st_density_grid(track, 'LINESTRING(0 0, 2 0)', '[2015-05-18 00:00, 2015-05-18 02:00)', 2, 2, '1 hour') FROM st_dens;
+SELECT st_density_grid(track, ST_MakeEnvelope(0, 0, 2, 2), '[2015-05-18 00:00, 2015-05-18 02:00)', 2, 2, '0 hours') FROM st_dens;
+SELECT st_density_grid(track, ST_MakeEnvelope(0, 0, 2, 2), NULL, 2, 2, '1 hour') FROM st_dens;
+SELECT st_density_grid(track, ST_MakeEnvelope(0, 0, 2, 2, 4326), '[2015-05-18 00:00, 2015-05-18 02:00)', 2, 2, '1 hour') FROM st_dens;
+
+DROP TABLE st_dens;
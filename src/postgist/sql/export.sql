@@ -0,0 +1,25 @@
+--
+-- TWKB-like binary and MF-JSON output
+--
+SET datestyle TO ISO;
+
+CREATE TABLE st_export (id integer, track spatiotemporal);
+
+INSERT INTO st_export VALUES
+  (1, 'ST_TRAJECTORY(2015-05-18 10:00:00;2015-05-18 20:00:00;POINT(12 4), 2015-05-18 10:00:00;POINT(13.5 5), 2015-05-18 20:00:00;)'),
+  (2, 'SRID=4326;ST_TRAJECTORY(2015-05-18 10:00:00;2015-05-19 11:00:00.25;POINT(12 4), 2015-05-18 10:00:00;POINT(-0.5 0.25), 2015-05-18 20:00:00;POINT(15 10), 2015-05-19 11:00:00.25;)'),
+  (3, 'SRID=4326;ST_TRAJECTORY(2015-05-18 10:00:00;2015-05-18 11:00:00;POINT Z (1 2 3), 2015-05-18 10:00:00;POINT Z (4 5 6), 2015-05-18 11:00:00;)');
+
+SELECT id, st_as_binary(track, 1) AS twkb FROM st_export ORDER BY id;
+
+SELECT id, st_as_mfjson(track) AS mfjson FROM st_export WHERE id IN (2, 3) ORDER BY id;
+
+SELECT st_as_mfjson(track, 16) FROM st_export WHERE id = 1;
+SELECT st_as_binary(track, 8) FROM st_export WHERE id = 1;
+
+-- coordinates that TWKB and MF-JSON can not hold
+SELECT st_as_binary(st_append_instant(NULL, ST_MakePoint('NaN', 0), '2015-05-18 10:00'), 1);
+SELECT st_as_binary(st_append_instant(NULL, ST_MakePoint(1e300, 0), '2015-05-18 10:00'), 1);
+SELECT st_as_mfjson(st_append_instant(NULL, ST_MakePoint('Infinity', 0), '2015-05-18 10:00'));
+
+DROP TABLE st_export;
@@ -0,0 +1,8 @@
+--
+-- Instants of a spatiotemporal, one per call
+--
+SET datestyle TO ISO;
+
+SELECT ST_AsText(geom) AS geom, t FROM st_instants('SRID=4326;ST_TRAJECTORY(2015-05-18 10:00:00;2015-05-19 11:00:00.25;POINT(12 4), 2015-05-18 10:00:00;POINT(-0.5 0.25), 2015-05-18 20:00:00;POINT(15 10), 2015-05-19 11:00:00.25;)'::spatiotemporal);
+
+SELECT count(*) FROM st_instants('SRID=4326;ST_TRAJECTORY(2015-05-18 10:00:00;2015-05-18 11:00:00;POINT Z (1 2 3), 2015-05-18 10:00:00;POINT Z (4 5 6), 2015-05-18 11:00:00;)'::spatiotemporal);
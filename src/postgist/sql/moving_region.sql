@@ -0,0 +1,58 @@
+--
+-- Moving regions
+--
+SET datestyle TO ISO;
+
+-- 1 slides to the right, then splits; 2 has more snapshots than fit
+-- between two keyframes
+CREATE TABLE st_regions (id integer, region moving_region);
+
+INSERT INTO st_regions VALUES
+  (1, 'srid=4326; st_movingregion( POLYGON((0 0, 4 0, 4 4, 0 4, 0 0)), 2015-05-18 10:00;
+    POLYGON((2 0, 6 0, 6 4, 2 4, 2 0)), 2015-05-18 11:00;
+    MULTIPOLYGON(((10 10, 11 10, 11 11, 10 10)), ((20 20, 21 20, 21 21, 20 20))), 2015-05-18 12:00; )');
+
+INSERT INTO st_regions
+SELECT 2, moving_region_agg(ST_Translate(ST_MakeEnvelope(0, 0, 1, 1, 4326), i * 0.5, 0),
+                            '2015-05-18 00:00'::timestamp + i * interval '1 hour' ORDER BY i)
+  FROM generate_series(0, 39) AS i;
+
+SELECT region FROM st_regions WHERE id = 1;
+
+SELECT id, get_start_time(region), get_end_time(region) FROM st_regions ORDER BY id;
+
+SELECT ST_AsText(geom), t FROM st_snapshots((SELECT region FROM st_regions WHERE id = 1));
+
+-- every snapshot decodes back to the geometry it was built from
+SELECT count(*) AS snapshots,
+       count(*) FILTER (WHERE ST_AsEWKB(s.geom) <> ST_AsEWKB(ST_Translate(ST_MakeEnvelope(0, 0, 1, 1, 4326), i * 0.5, 0))) AS mismatches
+  FROM st_regions, st_snapshots(region) s,
+       LATERAL (SELECT extract(epoch FROM s.t - '2015-05-18 00:00') / 3600 AS i) n
+ WHERE id = 2;
+
+-- vertices move linearly between snapshots with the same rings, a split
+-- holds the earlier snapshot
+SELECT t, ST_AsText(st_value_at(region, t))
+  FROM st_regions,
+       unnest(ARRAY['2015-05-18 09:00', '2015-05-18 10:00', '2015-05-18 10:30', '2015-05-18 11:30',
+                    '2015-05-18 12:00', '2015-05-18 12:30']::timestamp[]) AS t
+ WHERE id = 1;
+
+SELECT ST_AsText(st_value_at(region, '2015-05-19 11:30')) FROM st_regions WHERE id = 2;
+
+-- intersects at some snapshot
+SELECT id, st_intersects(region, ST_SetSRID(ST_MakePoint(5, 2), 4326)) AS point,
+       st_intersects(region, ST_MakeEnvelope(20.5, 20.1, 20.6, 20.2, 4326)) AS box,
+       st_intersects(region, ST_SetSRID(ST_MakePoint(15, 15), 4326)) AS elsewhere
+  FROM st_regions ORDER BY id;
+
+SELECT st_intersects(region, 'POINT(5 2)'::geometry) FROM st_regions;
+
+-- invalid regions
+SELECT moving_region_in('ST_MOVINGREGION(POLYGON((0 0,1 0,1 1,0 0)), 2015-05-18 11:00; POLYGON((0 0,1 0,1 1,0 0)), 2015-05-18 10:00;)');
+SELECT moving_region_in('ST_TRAJECTORY(POLYGON((0 0,1 0,1 1,0 0)), 2015-05-18 10:00;)');
+SELECT moving_region_agg(g, t) FROM (VALUES ('POLYGON((0 0,1 0,1 1,0 0))'::geometry, '2015-05-18 11:00'::timestamp), ('POLYGON((0 0,1 0,1 1,0 0))', '2015-05-18 10:00')) v(g, t);
+SELECT moving_region_agg(g, '2015-05-18 10:00') FROM (VALUES ('LINESTRING(0 0,1 1)'::geometry)) v(g);
+SELECT moving_region_agg(g, t) FROM (VALUES ('SRID=4326;POLYGON((0 0,1 0,1 1,0 0))'::geometry, '2015-05-18 10:00'::timestamp), ('POLYGON((0 0,1 0,1 1,0 0))', '2015-05-18 11:00')) v(g, t);
+
+DROP TABLE st_regions;
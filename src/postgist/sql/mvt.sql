@@ -0,0 +1,38 @@
+--
+-- Vector tiles
+--
+SET datestyle TO ISO;
+
+-- 1 bends by less than a tile unit at zoom 0; 2 is straight but slows down
+-- after its first 10 minutes
+CREATE TABLE st_tiles (id integer, track spatiotemporal(3857));
+
+INSERT INTO st_tiles VALUES
+  (1, 'SRID=3857;ST_TRAJECTORY(2015-05-18 10:00:00;2015-05-18 11:00:00;POINT(0 0), 2015-05-18 10:00:00;POINT(1000000 5000), 2015-05-18 10:30:00;POINT(2000000 0), 2015-05-18 11:00:00;)'),
+  (2, 'SRID=3857;ST_TRAJECTORY(2015-05-18 10:00:00;2015-05-18 11:00:00;POINT(0 0), 2015-05-18 10:00:00;POINT(1000000 0), 2015-05-18 10:10:00;POINT(2000000 0), 2015-05-18 11:00:00;)');
+
+SELECT id, ST_AsText(st_as_trajectory_tile(track, 0, 0, 0)) FROM st_tiles ORDER BY id;
+
+SELECT id, ST_AsText(st_as_trajectory_tile(track, 1, 1, 0)) FROM st_tiles ORDER BY id;
+
+-- clipped to the tile buffer, the end point gets an interpolated time
+SELECT id, ST_AsText(ST_Force2D(t)), floor(ST_M(ST_EndPoint(t)))::bigint AS end_time
+  FROM (SELECT id, st_as_trajectory_tile(track, 1, 0, 0) AS t FROM st_tiles) s
+ ORDER BY id;
+
+-- far from the tile
+SELECT id, st_as_trajectory_tile(track, 4, 0, 0) IS NULL AS is_null FROM st_tiles ORDER BY id;
+
+SELECT st_as_trajectory_tile(track, 1, 2, 0) FROM st_tiles;
+
+SELECT encode(st_as_trajectory_mvt(track, 0, 0, 0, 'tracks' ORDER BY id), 'hex') FROM st_tiles;
+
+SELECT encode(st_as_trajectory_mvt(track, 4, 0, 0), 'hex') FROM st_tiles;
+
+SELECT st_as_trajectory_mvt(track, 0, NULL, 0) FROM st_tiles;
+
+-- positions must be in Web Mercator
+SELECT st_as_trajectory_tile(st_setsrid(track, 4326), 0, 0, 0) FROM st_tiles;
+SELECT st_as_trajectory_mvt(st_setsrid(track, 4326), 0, 0, 0) FROM st_tiles;
+
+DROP TABLE st_tiles;
@@ -0,0 +1,25 @@
+--
+-- Overlap operators
+--
+SET datestyle TO ISO;
+
+-- track i goes from (i, i) to (i + 2, i) between hours i and i + 2 of 2015-05-18
+CREATE TABLE st_tracks AS
+  SELECT i AS id,
+         format('SRID=4326;ST_TRAJECTORY(%s;%s;%s)', min(t), max(t),
+                string_agg(format('POINT(%s %s), %s;', x, y, t), '' ORDER BY t))::spatiotemporal AS track
+    FROM (SELECT i, i + j AS x, i AS y, '2015-05-18 00:00'::timestamp + (i + j) * interval '1 hour' AS t
+            FROM generate_series(1, 50) AS i, generate_series(0, 2) AS j) AS p
+   GROUP BY i;
+
+ANALYZE st_tracks;
+
+SELECT id FROM st_tracks WHERE track && spatiotemporal_make('SRID=4326;ST_TRAJECTORY(2015-05-18 10:00:00;2015-05-18 12:00:00;POINT(9 9), 2015-05-18 10:00:00;POINT(13 13), 2015-05-18 12:00:00;)') ORDER BY id;
+
+SELECT id FROM st_tracks WHERE spatiotemporal_make('SRID=4326;ST_TRAJECTORY(2015-05-18 10:00:00;2015-05-18 12:00:00;POINT(9 9), 2015-05-18 10:00:00;POINT(13 13), 2015-05-18 12:00:00;)') && track ORDER BY id;
+
+SELECT id FROM st_tracks WHERE track && ST_MakeEnvelope(20, 20, 21, 21, 4326) ORDER BY id;
+
+SELECT id FROM st_tracks WHERE track && tsrange('2015-05-19 23:00', '2015-05-20 01:00') ORDER BY id;
+
+DROP TABLE st_tracks;
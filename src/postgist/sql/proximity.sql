@@ -0,0 +1,46 @@
+--
+-- Proximity join of trajectories
+--
+SET datestyle TO ISO;
+
+CREATE TABLE st_prox (id integer, track spatiotemporal);
+
+-- 1 crosses the whole area in a single long segment, 2 stands still near
+-- its path with an instant every 6 seconds, 3 stands still with a 20 minute gap
+INSERT INTO st_prox VALUES
+  (1, 'ST_TRAJECTORY(2015-05-18 10:00:00;2015-05-18 10:10:00;POINT(0 0), 2015-05-18 10:00:00;POINT(1000 0), 2015-05-18 10:10:00;)'),
+  (3, 'ST_TRAJECTORY(2015-05-18 10:00:00;2015-05-18 10:20:00;POINT(900 -1), 2015-05-18 10:00:00;POINT(900 -1), 2015-05-18 10:20:00;)');
+INSERT INTO st_prox
+  SELECT 2, format('ST_TRAJECTORY(%s;%s;%s)', min(t), max(t),
+                   string_agg(format('POINT(900 1), %s;', t), '' ORDER BY t))::spatiotemporal
+    FROM generate_series('2015-05-18 10:00'::timestamp, '2015-05-18 10:10', '6 seconds') AS t;
+
+SELECT p.*
+  FROM (SELECT array_agg(track ORDER BY id) AS tracks FROM st_prox) AS s,
+       st_proximity_pairs(s.tracks, 2, NULL) AS p;
+
+-- instants more than max_gap apart are not joined
+SELECT p.*
+  FROM (SELECT array_agg(track ORDER BY id) AS tracks FROM st_prox) AS s,
+       st_proximity_pairs(s.tracks, 2, '15 minutes') AS p;
+
+SELECT p.*
+  FROM (SELECT array_agg(track ORDER BY id) AS tracks FROM st_prox) AS s,
+       st_proximity_pairs(s.tracks, 1.5, NULL) AS p;
+
+-- NULL elements keep their position in the array
+SELECT p.*
+  FROM (SELECT array_agg(CASE WHEN id = 2 THEN NULL ELSE track END ORDER BY id) AS tracks FROM st_prox) AS s,
+       st_proximity_pairs(s.tracks, 2, NULL) AS p;
+
+SELECT p.*
+  FROM (SELECT array_agg(track ORDER BY id) AS tracks FROM st_prox) AS s,
+       st_proximity_pairs(s.tracks, -1, NULL) AS p;
+SELECT p.*
+  FROM (SELECT array_agg(track ORDER BY id) AS tracks FROM st_prox) AS s,
+       st_proximity_pairs(s.tracks, 'Infinity', NULL) AS p;
+SELECT p.*
+  FROM (SELECT array_agg(CASE WHEN id = 3 THEN st_setsrid(track, 4326) ELSE track END ORDER BY id) AS tracks FROM st_prox) AS s,
+       st_proximity_pairs(s.tracks, 2, NULL) AS p;
+
+DROP TABLE st_prox;
@@ -0,0 +1,45 @@
+--
+-- Trajectory similarity measures
+--
+SET datestyle TO ISO;
+
+-- position k of each track is at minute k
+CREATE TABLE st_sim AS
+  SELECT id,
+         format('SRID=4326;ST_TRAJECTORY(%s;%s;%s)', min(t), max(t),
+                string_agg(format('POINT(%s %s), %s;', x, y, t), '' ORDER BY t))::spatiotemporal AS track
+    FROM (SELECT id, x, y, '2015-05-18 10:00'::timestamp + k * interval '1 minute' AS t
+            FROM (VALUES (1, 0, 0, 0), (1, 1, 0, 1), (1, 2, 0, 2), (1, 3, 0, 3),
+                         (2, 0, 1, 0), (2, 1, 1, 1), (2, 2, 1, 2), (2, 3, 1, 3),
+                         (3, 0, 0, 0), (3, 3, 4, 1), (4, 0, 0, 0), (4, 0, 0, 1),
+                         (4, 0, 0, 2), (4, 0, 0, 3), (4, 0, 0, 4), (4, 1, 0, 5),
+                         (4, 2, 0, 6), (4, 3, 0, 7)) AS v(id, x, y, k)) AS p
+   GROUP BY id;
+
+SELECT a.id AS a, b.id AS b, st_dtw(a.track, b.track) AS dtw, st_frechet(a.track, b.track) AS frechet,
+       st_hausdorff(a.track, b.track) AS hausdorff
+  FROM st_sim a JOIN st_sim b ON a.id < b.id
+ ORDER BY a.id, b.id;
+
+-- the measures are symmetric
+SELECT count(*) FROM st_sim a, st_sim b
+ WHERE st_dtw(a.track, b.track) <> st_dtw(b.track, a.track)
+    OR st_frechet(a.track, b.track) <> st_frechet(b.track, a.track)
+    OR st_hausdorff(a.track, b.track) <> st_hausdorff(b.track, a.track);
+
+-- a Sakoe-Chiba band restricts the warping path
+SELECT band, st_dtw(a.track, b.track, band) AS dtw, st_frechet(a.track, b.track, band) AS frechet
+  FROM st_sim a, st_sim b, (VALUES (-1), (0), (1)) AS v(band)
+ WHERE a.id = 1 AND b.id = 4
+ ORDER BY band;
+
+-- results above the threshold are Infinity
+SELECT st_dtw(a.track, b.track, threshold => 3.5) AS dtw, st_frechet(a.track, b.track, threshold => 0.5) AS frechet,
+       st_hausdorff(a.track, b.track, threshold => 0.5) AS hausdorff,
+       st_frechet(a.track, b.track, threshold => 1) AS frechet_at_threshold
+  FROM st_sim a, st_sim b
+ WHERE a.id = 1 AND b.id = 2;
+
+SELECT st_dtw(track, st_setsrid(track, 3857)) FROM st_sim WHERE id = 1;
+
+DROP TABLE st_sim;
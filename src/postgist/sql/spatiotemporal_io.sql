@@ -0,0 +1,31 @@
+--
+-- Text input and output of spatiotemporal
+--
+SET datestyle TO ISO;
+
+CREATE TABLE st_io (id integer, track spatiotemporal);
+
+INSERT INTO st_io VALUES
+  (1, 'ST_TRAJECTORY(2015-05-18 10:00:00;2015-05-18 20:00:00;POINT(12 4), 2015-05-18 10:00:00;POINT(13.5 5), 2015-05-18 20:00:00;)'),
+  (2, 'SRID=4326;ST_TRAJECTORY(2015-05-18 10:00:00;2015-05-19 11:00:00.25;POINT(12 4), 2015-05-18 10:00:00;POINT(-0.5 0.25), 2015-05-18 20:00:00;POINT(15 10), 2015-05-19 11:00:00.25;)'),
+  (3, 'SRID=4326;ST_TRAJECTORY(2015-05-18 10:00:00;2015-05-18 11:00:00;POINT Z (1 2 3), 2015-05-18 10:00:00;POINT Z (4 5 6), 2015-05-18 11:00:00;)'),
+  (4, 'ST_TRAJECTORY(2015-05-18 10:00:00;2015-05-18 11:00:00;POINT M (1 2 3), 2015-05-18 10:00:00;POINT M (4 5 6), 2015-05-18 11:00:00;)'),
+  (5, 'SRID=4326;ST_TRAJECTORY(2015-05-18 10:00:00;2015-05-18 11:00:00;POINT ZM (1 2 3 4), 2015-05-18 10:00:00;POINT ZM (5 6 7 8), 2015-05-18 11:00:00;)'),
+  (6, 'srid=4326;  st_trajectory( 2015-05-18 10:00:00;2015-05-18 10:30:00;  POINT(1.50 2), 2015-05-18 10:00:00;  POINT(3 4),2015-05-18 10:30:00; )');
+
+-- canonical text
+SELECT id, to_str(track) AS text FROM st_io ORDER BY id;
+
+-- the canonical text reads back to an equal value
+SELECT id, spatiotemporal_make(to_str(track)) = track AS round_trip FROM st_io ORDER BY id;
+
+SELECT id, st_srid(track) AS srid, get_start_time(track) AS start_time, get_end_time(track) AS end_time,
+       get_duration(track) AS duration
+  FROM st_io ORDER BY id;
+
+-- malformed text
+SELECT spatiotemporal_make('ST_TRAJECTORY(2015-05-18 10:00:00;2015-05-18 21:00:00;POINT(12 4), 2015-05-18 10:00:00;POINT(13 5), 2015-05-18 20:00:00;)');
+SELECT spatiotemporal_make('ST_TRAJECTORY(2015-05-18 20:00:00;2015-05-18 10:00:00;POINT(12 4), 2015-05-18 20:00:00;POINT(13 5), 2015-05-18 10:00:00;)');
+SELECT spatiotemporal_make('ST_TRAJECTORY(2015-05-18 10:00:00;2015-05-18 20:00:00;POINT(12 4), 2015-05-18 10:00:00;POINT Z (13 5 1), 2015-05-18 20:00:00;)');
+
+DROP TABLE st_io;
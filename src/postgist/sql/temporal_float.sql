@@ -0,0 +1,49 @@
+--
+-- temporal_float: a linearly interpolated series of float values
+--
+SET datestyle TO ISO;
+
+CREATE TABLE tf_test (id integer, temperature temporal_float);
+
+INSERT INTO tf_test VALUES
+  (1, 'temporal_float (21.5,2015-05-18 10:00;  22.25, 2015-05-18 20:00:00;20 , 2015-05-19 11:00:00; ) '),
+  (2, 'TEMPORAL_FLOAT()');
+
+INSERT INTO tf_test
+  SELECT 3, temporal_float_agg(v, t ORDER BY t)
+    FROM (VALUES (22.25, '2015-05-18 20:00'::timestamp), (21.5, '2015-05-18 10:00'), (20, '2015-05-19 11:00')) AS v(v, t);
+
+SELECT id, temperature FROM tf_test ORDER BY id;
+
+SELECT get_start_time(temperature) AS start_time, get_end_time(temperature) AS end_time,
+       tw_avg(temperature), tw_min(temperature), tw_max(temperature)
+  FROM tf_test WHERE id = 1;
+
+-- an empty series has no value
+SELECT tw_avg(temperature), tw_min(temperature), tw_max(temperature) FROM tf_test WHERE id = 2;
+
+-- values between the instants are interpolated
+SELECT t, st_value_at(temperature, t) AS value
+  FROM tf_test, (VALUES ('2015-05-18 09:00'::timestamp), ('2015-05-18 10:00'), ('2015-05-18 15:00'),
+                        ('2015-05-19 00:00'), ('2015-05-19 11:00'), ('2015-05-19 12:00')) AS v(t)
+ WHERE id = 1
+ ORDER BY t;
+
+-- the value at a bound of the period is interpolated
+SELECT st_at_period(temperature, '[2015-05-18 12:00, 2015-05-19 11:00]') FROM tf_test WHERE id = 1;
+
+-- the time-weighted average over a window of the series
+SELECT tw_avg(st_at_period(temperature, '[2015-05-18 15:00, 2015-05-19 00:00]')) FROM tf_test WHERE id = 1;
+
+-- the aggregate drops the spare room of its state
+SELECT pg_column_size(temporal_float_agg(v, t ORDER BY t)) AS size
+  FROM (VALUES (22.25, '2015-05-18 20:00'::timestamp), (21.5, '2015-05-18 10:00'), (20, '2015-05-19 11:00')) AS v(v, t);
+
+-- invalid series
+SELECT temporal_float_in('TEMPORAL_FLOAT(21.5, 2015-05-18 10:00; 20, 2015-05-18 09:00;)');
+SELECT temporal_float_in('TEMPORAL_FLOAT(NaN, 2015-05-18 10:00;)');
+SELECT temporal_float_in('TEMPORAL_FLOAT(21.5 2015-05-18 10:00;)');
+SELECT tf_append_instant(temperature, 19, '2015-05-19 10:00') FROM tf_test WHERE id = 1;
+SELECT tf_append_instant(temperature, 'Infinity', '2015-05-19 12:00') FROM tf_test WHERE id = 1;
+
+DROP TABLE tf_test;
@@ -0,0 +1,48 @@
+--
+-- Reprojection of spatiotemporal
+--
+SET datestyle TO ISO;
+
+CREATE TABLE st_proj (id integer, track spatiotemporal);
+
+INSERT INTO st_proj VALUES
+  (1, 'SRID=4326;ST_TRAJECTORY(2015-05-18 10:00:00;2015-05-18 12:00:00;POINT(-45.5 -23.25), 2015-05-18 10:00:00;POINT(0 0), 2015-05-18 11:00:00;POINT(12 4), 2015-05-18 12:00:00;)'),
+  (2, 'SRID=4326;ST_TRAJECTORY(2015-05-18 10:00:00;2015-05-18 11:00:00;POINT Z (12 4 100), 2015-05-18 10:00:00;POINT Z (13 5 200), 2015-05-18 11:00:00;)');
+
+SELECT id, st_srid(st_transform(track, 3857)) AS srid FROM st_proj ORDER BY id;
+
+SELECT round(ST_X(geom)::numeric, 3) AS x, round(ST_Y(geom)::numeric, 3) AS y, t
+  FROM st_proj, st_instants(st_transform(track, 3857)) WHERE id = 1;
+
+-- every instant agrees with ST_Transform of its position; times, z and
+-- the number of instants do not change
+SELECT id, count(*) AS instants,
+       bool_and(ST_DWithin(p.geom, ST_Transform(g.geom, 3857), 1e-6)) AS same_position,
+       bool_and(ST_Z(p.geom) IS NOT DISTINCT FROM ST_Z(g.geom)) AS same_z,
+       bool_and(p.t = g.t) AS same_time
+  FROM st_proj,
+       st_instants(track) WITH ORDINALITY AS g(geom, t, n),
+       st_instants(st_transform(track, 3857)) WITH ORDINALITY AS p(geom, t, n)
+ WHERE p.n = g.n
+ GROUP BY id ORDER BY id;
+
+-- there and back again
+SELECT id, bool_and(ST_DWithin(p.geom, g.geom, 1e-9)) AS round_trip
+  FROM st_proj,
+       st_instants(track) WITH ORDINALITY AS g(geom, t, n),
+       st_instants(st_transform(st_transform(track, 3857), 4326)) WITH ORDINALITY AS p(geom, t, n)
+ WHERE p.n = g.n
+ GROUP BY id ORDER BY id;
+
+-- the extent follows the positions
+SELECT id, st_transform(track, 3857) && ST_Transform('SRID=4326;POINT(12 4)'::geometry, 3857) AS overlaps
+  FROM st_proj ORDER BY id;
+
+-- the same SRID gives the value back
+SELECT st_transform(track, 4326) = track AS unchanged FROM st_proj WHERE id = 1;
+
+-- errors
+SELECT st_transform('ST_TRAJECTORY(2015-05-18 10:00:00;2015-05-18 11:00:00;POINT(1 2), 2015-05-18 10:00:00;POINT(3 4), 2015-05-18 11:00:00;)'::spatiotemporal, 3857);
+SELECT st_transform(track, 999999) FROM st_proj WHERE id = 1;
+
+DROP TABLE st_proj;
@@ -0,0 +1,33 @@
+--
+-- spatiotemporal(srid [, dims [, precision]]) column type modifiers
+--
+SET datestyle TO ISO;
+
+CREATE TABLE st_tm (id integer, a spatiotemporal(4326), b spatiotemporal(4326, XYZ), c spatiotemporal(0, xy, 2));
+
+SELECT attname, format_type(atttypid, atttypmod) FROM pg_attribute WHERE attrelid = 'st_tm'::regclass AND attnum > 1 ORDER BY attnum;
+
+SELECT NULL::spatiotemporal(4326, xyw);
+SELECT NULL::spatiotemporal(4326, XY, 2, 1);
+SELECT NULL::spatiotemporal(4326, XY, 31);
+
+-- a value without SRID takes the column SRID, as a literal and through the cast
+INSERT INTO st_tm (id, a) VALUES (1, 'ST_TRAJECTORY(2015-05-18 10:00:00;2015-05-18 11:00:00;POINT(1 2), 2015-05-18 10:00:00;POINT(3 4), 2015-05-18 11:00:00;)');
+INSERT INTO st_tm (id, a) SELECT 2, spatiotemporal_make('ST_TRAJECTORY(2015-05-18 10:00:00;2015-05-18 11:00:00;POINT(5 6), 2015-05-18 10:00:00;POINT(7 8), 2015-05-18 11:00:00;)');
+INSERT INTO st_tm (id, b) SELECT 3, spatiotemporal_make('SRID=4326;ST_TRAJECTORY(2015-05-18 10:00:00;2015-05-18 11:00:00;POINT Z (1 2 3), 2015-05-18 10:00:00;POINT Z (4 5 6), 2015-05-18 11:00:00;)');
+
+SELECT id, to_str(coalesce(a, b)) AS text FROM st_tm ORDER BY id;
+
+-- coordinates are rounded to the column precision
+INSERT INTO st_tm (id, c) SELECT 4, spatiotemporal_make('ST_TRAJECTORY(2015-05-18 10:00:00;2015-05-18 11:00:00;POINT(1.23456 7.891), 2015-05-18 10:00:00;POINT(3.14159 -2.5), 2015-05-18 11:00:00;)');
+
+SELECT to_str(c) AS text FROM st_tm WHERE id = 4;
+
+SELECT to_str(spatiotemporal_make('ST_TRAJECTORY(2015-05-18 10:00:00;2015-05-18 11:00:00;POINT(1.25 7.891), 2015-05-18 10:00:00;POINT(3.14159 -2.5), 2015-05-18 11:00:00;)')::spatiotemporal(4326, XY, 1)) AS text;
+
+-- values the column can not hold
+INSERT INTO st_tm (id, a) SELECT 5, spatiotemporal_make('SRID=3857;ST_TRAJECTORY(2015-05-18 10:00:00;2015-05-18 11:00:00;POINT(1 2), 2015-05-18 10:00:00;POINT(3 4), 2015-05-18 11:00:00;)');
+INSERT INTO st_tm (id, b) SELECT 6, spatiotemporal_make('SRID=4326;ST_TRAJECTORY(2015-05-18 10:00:00;2015-05-18 11:00:00;POINT(1 2), 2015-05-18 10:00:00;POINT(3 4), 2015-05-18 11:00:00;)');
+UPDATE st_tm SET c = spatiotemporal_make('ST_TRAJECTORY(2015-05-18 10:00:00;2015-05-18 11:00:00;POINT M (1 2 3), 2015-05-18 10:00:00;POINT M (4 5 6), 2015-05-18 11:00:00;)') WHERE id = 4;
+
+DROP TABLE st_tm;
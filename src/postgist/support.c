@@ -0,0 +1,262 @@
+/*
+  Copyright (C) 2017 National Institute For Space Research (INPE) - Brazil.
+
+  postgis-t is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License version 3 as
+  published by the Free Software Foundation.
+
+  postgis-t is distributed  "AS-IS" in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY OF ANY KIND; without even the implied warranty
+  of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with postgis-t. See LICENSE. If not, write to
+  Gilberto Ribeiro de Queiroz at <gribeiro@dpi.inpe.br>.
+
+ */
+/*!
+ *
+ * \file postgist/support.c
+ *
+ * \brief Planner support for the predicate functions st_intersects and
+ *        st_during.
+ *
+ * Both predicates imply &&, so when the spatiotemporal argument is an
+ * indexed column the planner is handed a lossy && index condition, and
+ * the predicate is checked on the rows the index returns. Selectivity comes
+ * from the && estimators and the cost from the expected number of instants.
+ *
+ * Support functions need PostgreSQL 12 or later.
+ *
+ * \author Gilberto Ribeiro de Queiroz
+ * \author Fabiana Zioti
+ *
+ * \date 2017
+ *
+ * \copyright GNU Lesser Public License version 3
+ *
+ */
+
+/* PostGIS-T extension */
+#include "spatiotemporal.h"
+
+#if PG_VERSION_NUM >= 120000
+
+/* PostgreSQL */
+#include <catalog/pg_operator.h>
+#include <catalog/pg_type.h>
+#include <nodes/makefuncs.h>
+#include <nodes/nodeFuncs.h>
+#include <nodes/pathnodes.h>
+#include <nodes/supportnodes.h>
+#include <optimizer/cost.h>
+#include <optimizer/optimizer.h>
+#include <parser/parsetree.h>
+#include <utils/lsyscache.h>
+#include <utils/syscache.h>
+
+/* C Standard Library */
+#include <string.h>
+
+
+/* strategies of the && operators in the GiST operator class */
+#define ST_GIST_FIRST_STRATEGY 1
+#define ST_GIST_LAST_STRATEGY  3
+
+/* planner guess when the column width is unknown */
+#define ST_DEFAULT_NPOINTS 100
+
+
+/*
+ * \brief Find the && operator for (lefttype, righttype) in the index
+ *        operator family, InvalidOid if there is none.
+ *
+ */
+static Oid overlaps_operator(Oid opfamily, Oid lefttype, Oid righttype)
+{
+  for(int s = ST_GIST_FIRST_STRATEGY; s <= ST_GIST_LAST_STRATEGY; ++s)
+  {
+    Oid oid = get_opfamily_member(opfamily, lefttype, righttype, s);
+
+    if(OidIsValid(oid))
+    {
+      char *name = get_opname(oid);
+
+      if(name && strcmp(name, "&&") == 0)
+        return oid;
+    }
+  }
+
+  return InvalidOid;
+}
+
+
+/*
+ * \brief The && operator of the schema of predicate 'funcid' for the types
+ *        of its arguments, InvalidOid if there is none.
+ *
+ */
+static Oid predicate_operator(Oid funcid, List *args)
+{
+  if(list_length(args) != 2)
+    return InvalidOid;
+
+  return GetSysCacheOid4(OPERNAMENSP, Anum_pg_operator_oid, CStringGetDatum("&&"),
+                         ObjectIdGetDatum(exprType((Node*) linitial(args))),
+                         ObjectIdGetDatum(exprType((Node*) lsecond(args))),
+                         ObjectIdGetDatum(get_func_namespace(funcid)));
+}
+
+
+/*
+ * \brief Expected number of instants of the spatiotemporal argument, from
+ *        the average width of the column it comes from.
+ *
+ */
+static double expected_npoints(PlannerInfo *root, Node *arg)
+{
+  Var *var;
+
+  RangeTblEntry *rte;
+
+  int32 width;
+
+  if(root == NULL || !IsA(arg, Var))
+    return ST_DEFAULT_NPOINTS;
+
+  var = (Var*) arg;
+
+  if(var->varno < 1 || var->varno >= root->simple_rel_array_size || var->varlevelsup != 0)
+    return ST_DEFAULT_NPOINTS;
+
+  rte = planner_rt_fetch(var->varno, root);
+
+  if(rte->rtekind != RTE_RELATION)
+    return ST_DEFAULT_NPOINTS;
+
+  width = get_attavgwidth(rte->relid, var->varattno);
+
+  if(width <= (int32) ST_HEADER_SIZE)
+    return ST_DEFAULT_NPOINTS;
+
+  /* an XY instant takes two doubles and a timestamp */
+  return (double) (width - ST_HEADER_SIZE) / (3 * sizeof(double));
+}
+
+
+/*
+ * \brief Answer a planner support request for a predicate;
+ *        'walks_segments' tells if its cost grows with the number of
+ *        instants.
+ *
+ */
+static Node *predicate_support(FunctionCallInfo fcinfo, bool walks_segments)
+{
+  Node *rawreq = (Node*) PG_GETARG_POINTER(0);
+
+  if(IsA(rawreq, SupportRequestIndexCondition))
+  {
+    SupportRequestIndexCondition *req = (SupportRequestIndexCondition*) rawreq;
+
+    FuncExpr *clause;
+
+    Node *leftarg, *rightarg;
+
+    Oid oproid;
+
+    /* only the spatiotemporal argument, the first one, can use the index */
+    if(!is_funcclause(req->node) || req->indexarg != 0)
+      return NULL;
+
+    clause = (FuncExpr*) req->node;
+
+    if(list_length(clause->args) != 2)
+      return NULL;
+
+    leftarg = (Node*) linitial(clause->args);
+    rightarg = (Node*) lsecond(clause->args);
+
+    oproid = overlaps_operator(req->opfamily, exprType(leftarg), exprType(rightarg));
+
+    if(!OidIsValid(oproid))
+      return NULL;
+
+#if PG_VERSION_NUM >= 140000
+    if(!is_pseudo_constant_for_index(req->root, rightarg, req->index))
+#else
+    if(!is_pseudo_constant_for_index(rightarg, req->index))
+#endif
+      return NULL;
+
+    req->lossy = true;
+
+    return (Node*) list_make1(make_opclause(oproid, BOOLOID, false,
+                                            (Expr*) leftarg, (Expr*) rightarg,
+                                            InvalidOid, InvalidOid));
+  }
+
+  if(IsA(rawreq, SupportRequestSelectivity))
+  {
+    SupportRequestSelectivity *req = (SupportRequestSelectivity*) rawreq;
+
+    Oid oproid = predicate_operator(req->funcid, req->args);
+
+    /* the && estimate is an upper bound of the predicate selectivity */
+    if(req->is_join)
+      req->selectivity = DatumGetFloat8(DirectFunctionCall5(spatiotemporal_overlaps_joinsel,
+                                                            PointerGetDatum(req->root),
+                                                            ObjectIdGetDatum(oproid),
+                                                            PointerGetDatum(req->args),
+                                                            Int16GetDatum(req->jointype),
+                                                            PointerGetDatum(req->sjinfo)));
+    else
+      req->selectivity = DatumGetFloat8(DirectFunctionCall4(spatiotemporal_overlaps_sel,
+                                                            PointerGetDatum(req->root),
+                                                            ObjectIdGetDatum(oproid),
+                                                            PointerGetDatum(req->args),
+                                                            Int32GetDatum(req->varRelid)));
+
+    return (Node*) req;
+  }
+
+  if(IsA(rawreq, SupportRequestCost))
+  {
+    SupportRequestCost *req = (SupportRequestCost*) rawreq;
+
+    FuncExpr *clause = (FuncExpr*) req->node;
+
+    req->startup = 0;
+
+    if(walks_segments && clause && IsA(clause, FuncExpr))
+      req->per_tuple = cpu_operator_cost * (10.0 + expected_npoints(req->root, (Node*) linitial(clause->args)));
+    else
+      req->per_tuple = cpu_operator_cost;
+
+    return (Node*) req;
+  }
+
+  return NULL;
+}
+
+
+/* st_intersects walks every segment */
+PG_FUNCTION_INFO_V1(spatiotemporal_intersects_support);
+
+Datum
+spatiotemporal_intersects_support(PG_FUNCTION_ARGS)
+{
+  PG_RETURN_POINTER(predicate_support(fcinfo, true));
+}
+
+
+/* st_during only reads the header */
+PG_FUNCTION_INFO_V1(spatiotemporal_during_support);
+
+Datum
+spatiotemporal_during_support(PG_FUNCTION_ARGS)
+{
+  PG_RETURN_POINTER(predicate_support(fcinfo, false));
+}
+
+#endif  /* PG_VERSION_NUM >= 120000 */
@@ -0,0 +1,534 @@
+/*
+  Copyright (C) 2017 National Institute For Space Research (INPE) - Brazil.
+
+  postgis-t is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License version 3 as
+  published by the Free Software Foundation.
+
+  postgis-t is distributed  "AS-IS" in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY OF ANY KIND; without even the implied warranty
+  of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with postgis-t. See LICENSE. If not, write to
+  Gilberto Ribeiro de Queiroz at <gribeiro@dpi.inpe.br>.
+
+ */
+/*!
+ *
+ * \file postgist/temporal_float.c
+ *
+ * \brief Input/output, construction and time-weighted kernels of the
+ *        temporal_float type.
+ *
+ * The text representation is:
+ *
+ *   TEMPORAL_FLOAT(21.5, 2015-05-18 10:00:00; 22.25, 2015-05-18 20:00:00;)
+ *
+ * \author Gilberto Ribeiro de Queiroz
+ * \author Fabiana Zioti
+ *
+ * \date 2017
+ *
+ * \copyright GNU Lesser Public License version 3
+ *
+ */
+
+/* PostGIS-T extension */
+#include "temporal_float.h"
+
+/* PostgreSQL */
+#include <lib/stringinfo.h>
+#include <utils/builtins.h>
+
+/* C Standard Library */
+#include <ctype.h>
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#define TF_WKT_TOKEN "TEMPORAL_FLOAT"
+#define TF_WKT_TOKEN_LEN 14
+
+#define LDELIM '('
+#define RDELIM ')'
+#define VALUE_DELIM ','
+#define COLLECTION_DELIM ';'
+
+
+struct temporal_float *temporal_float_alloc(int32 capacity)
+{
+  size_t size = TF_SIZE(capacity);
+
+  struct temporal_float *tf = (struct temporal_float*) palloc0(size);
+
+  SET_VARSIZE(tf, size);
+
+  tf->capacity = capacity;
+
+  tf->min = DBL_MAX;
+  tf->max = -DBL_MAX;
+
+  return tf;
+}
+
+
+static struct temporal_float *temporal_float_grow(struct temporal_float *tf, int32 capacity)
+{
+  struct temporal_float *result = temporal_float_alloc(capacity);
+
+  memcpy(result, tf, TF_HEADER_SIZE);
+
+  SET_VARSIZE(result, TF_SIZE(capacity));
+
+  result->capacity = capacity;
+
+  memcpy(TF_VALUES(result), TF_VALUES(tf), tf->npoints * sizeof(double));
+
+  memcpy(TF_TIMES(result), TF_TIMES(tf), tf->npoints * sizeof(Timestamp));
+
+  return result;
+}
+
+
+static void temporal_float_push(struct temporal_float *tf, double v, Timestamp t)
+{
+  TF_VALUES(tf)[tf->npoints] = v;
+
+  TF_TIMES(tf)[tf->npoints] = t;
+
+  if(tf->npoints == 0)
+    tf->start_time = t;
+
+  tf->end_time = t;
+
+  if(v < tf->min) tf->min = v;
+  if(v > tf->max) tf->max = v;
+
+  ++tf->npoints;
+}
+
+
+static void syntax_error(const char *str, const char *detail)
+{
+  ereport(ERROR, (errcode(ERRCODE_INVALID_TEXT_REPRESENTATION),
+                  errmsg("invalid input syntax for type temporal_float: \"%s\"", str),
+                  errdetail("%s", detail)));
+}
+
+
+PG_FUNCTION_INFO_V1(temporal_float_in);
+
+Datum
+temporal_float_in(PG_FUNCTION_ARGS)
+{
+  char *str = PG_GETARG_CSTRING(0);
+
+  char *cp = str;
+
+  struct temporal_float *tf = temporal_float_alloc(ST_MIN_CAPACITY);
+
+  while(isspace((unsigned char) *cp))
+    ++cp;
+
+  if(strncasecmp(cp, TF_WKT_TOKEN, TF_WKT_TOKEN_LEN) != 0)
+    syntax_error(str, "Expected TEMPORAL_FLOAT.");
+
+  cp += TF_WKT_TOKEN_LEN;
+
+  while(isspace((unsigned char) *cp))
+    ++cp;
+
+  if(*cp != LDELIM)
+    syntax_error(str, "Expected \"(\".");
+
+  ++cp;
+
+  for(;;)
+  {
+    char *endptr;
+
+    char *semicolon;
+
+    char *time;
+
+    double v;
+
+    Timestamp t;
+
+    while(isspace((unsigned char) *cp))
+      ++cp;
+
+    if(*cp == RDELIM)
+      break;
+
+    /* value */
+    v = strtod(cp, &endptr);
+
+    if(endptr == cp || !isfinite(v))
+      syntax_error(str, "Expected a finite value.");
+
+    cp = endptr;
+
+    while(isspace((unsigned char) *cp))
+      ++cp;
+
+    if(*cp != VALUE_DELIM)
+      syntax_error(str, "Expected \",\" after a value.");
+
+    ++cp;
+
+    /* time, up to the ';' that closes the instant */
+    semicolon = strchr(cp, COLLECTION_DELIM);
+
+    if(semicolon == NULL)
+      syntax_error(str, "Expected \";\" after a time.");
+
+    time = pnstrdup(cp, semicolon - cp);
+
+    t = DatumGetTimestamp(DirectFunctionCall3(timestamp_in, CStringGetDatum(time),
+                                              ObjectIdGetDatum(InvalidOid), Int32GetDatum(-1)));
+
+    pfree(time);
+
+    if(TIMESTAMP_NOT_FINITE(t))
+      syntax_error(str, "Instant times must be finite.");
+
+    if(tf->npoints > 0 && t <= tf->end_time)
+      syntax_error(str, "Instants must be in increasing time order.");
+
+    if(tf->npoints == tf->capacity)
+      tf = temporal_float_grow(tf, tf->capacity * 2);
+
+    temporal_float_push(tf, v, t);
+
+    cp = semicolon + 1;
+  }
+
+  /* skip the ')' */
+  ++cp;
+
+  while(isspace((unsigned char) *cp))
+    ++cp;
+
+  if(*cp != '\0')
+    syntax_error(str, "Unexpected characters after \")\".");
+
+  PG_RETURN_TEMPORAL_FLOAT_P(tf);
+}
+
+
+PG_FUNCTION_INFO_V1(temporal_float_out);
+
+Datum
+temporal_float_out(PG_FUNCTION_ARGS)
+{
+  struct temporal_float *tf = PG_GETARG_TEMPORAL_FLOAT_P(0);
+
+  const double *values = TF_VALUES(tf);
+
+  const Timestamp *times = TF_TIMES(tf);
+
+  StringInfoData str;
+
+  initStringInfo(&str);
+
+  appendStringInfoString(&str, TF_WKT_TOKEN "(");
+
+  for(int32 i = 0; i < tf->npoints; ++i)
+  {
+    char *value = DatumGetCString(DirectFunctionCall1(float8out, Float8GetDatum(values[i])));
+
+    char *time = DatumGetCString(DirectFunctionCall1(timestamp_out, TimestampGetDatum(times[i])));
+
+    appendStringInfo(&str, "%s%s, %s;", (i > 0) ? " " : "", value, time);
+
+    pfree(value);
+    pfree(time);
+  }
+
+  appendStringInfoChar(&str, RDELIM);
+
+  PG_RETURN_CSTRING(str.data);
+}
+
+
+PG_FUNCTION_INFO_V1(temporal_float_append_instant);
+
+Datum
+temporal_float_append_instant(PG_FUNCTION_ARGS)
+{
+  struct temporal_float *tf;
+
+  double v;
+
+  Timestamp t;
+
+  if(PG_ARGISNULL(1) || PG_ARGISNULL(2))
+  {
+    if(PG_ARGISNULL(0))
+      PG_RETURN_NULL();
+
+    PG_RETURN_DATUM(PG_GETARG_DATUM(0));
+  }
+
+  v = PG_GETARG_FLOAT8(1);
+
+  t = PG_GETARG_TIMESTAMP(2);
+
+  if(TIMESTAMP_NOT_FINITE(t))
+    ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                    errmsg("timestamp for temporal_float instant must be finite")));
+
+  if(!isfinite(v))
+    ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                    errmsg("value for temporal_float instant must be finite")));
+
+  if(PG_ARGISNULL(0))
+    tf = temporal_float_alloc(ST_MIN_CAPACITY);
+  else
+  {
+    /*
+     * An aggregate owns its transition state, so it can be written in
+     * place; that keeps temporal_float_agg linear in the number of rows.
+     */
+    if(AggCheckCallContext(fcinfo, NULL))
+      tf = PG_GETARG_TEMPORAL_FLOAT_P(0);
+    else
+      tf = PG_GETARG_TEMPORAL_FLOAT_P_COPY(0);
+
+    if(tf->npoints > 0 && t <= tf->end_time)
+      ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                      errmsg("temporal_float instants must be appended in increasing time order")));
+
+    /* geometric growth: amortizes the cost of moving the arrays */
+    if(tf->npoints == tf->capacity)
+      tf = temporal_float_grow(tf, Max(tf->capacity * 2, ST_MIN_CAPACITY));
+  }
+
+  temporal_float_push(tf, v, t);
+
+  PG_RETURN_TEMPORAL_FLOAT_P(tf);
+}
+
+
+/*
+ * \brief Drop the spare room of a series; final function of
+ *        temporal_float_agg.
+ *
+ */
+PG_FUNCTION_INFO_V1(temporal_float_compact);
+
+Datum
+temporal_float_compact(PG_FUNCTION_ARGS)
+{
+  struct temporal_float *tf = PG_GETARG_TEMPORAL_FLOAT_P(0);
+
+  if(tf->capacity == tf->npoints)
+    PG_RETURN_TEMPORAL_FLOAT_P(tf);
+
+  PG_RETURN_TEMPORAL_FLOAT_P(temporal_float_grow(tf, tf->npoints));
+}
+
+
+PG_FUNCTION_INFO_V1(temporal_float_get_start_time);
+
+Datum
+temporal_float_get_start_time(PG_FUNCTION_ARGS)
+{
+  struct temporal_float *tf = PG_GETARG_TEMPORAL_FLOAT_HEADER_P(0);
+
+  PG_RETURN_TIMESTAMP(tf->start_time);
+}
+
+
+PG_FUNCTION_INFO_V1(temporal_float_get_end_time);
+
+Datum
+temporal_float_get_end_time(PG_FUNCTION_ARGS)
+{
+  struct temporal_float *tf = PG_GETARG_TEMPORAL_FLOAT_HEADER_P(0);
+
+  PG_RETURN_TIMESTAMP(tf->end_time);
+}
+
+
+/*
+ * \brief Time-weighted average of the linearly interpolated series.
+ *
+ * \note Each segment weighs its mean value by its duration. A series with a
+ *       single instant averages to that value.
+ *
+ */
+PG_FUNCTION_INFO_V1(temporal_float_tw_avg);
+
+Datum
+temporal_float_tw_avg(PG_FUNCTION_ARGS)
+{
+  struct temporal_float *tf = PG_GETARG_TEMPORAL_FLOAT_P(0);
+
+  const double *values = TF_VALUES(tf);
+
+  const Timestamp *times = TF_TIMES(tf);
+
+  double sum = 0.0;
+
+  if(tf->npoints == 0)
+    PG_RETURN_NULL();
+
+  if(tf->npoints == 1)
+    PG_RETURN_FLOAT8(values[0]);
+
+  for(int32 i = 1; i < tf->npoints; ++i)
+    sum += (values[i - 1] + values[i]) * 0.5 * (double) (times[i] - times[i - 1]);
+
+  PG_RETURN_FLOAT8(sum / (double) (tf->end_time - tf->start_time));
+}
+
+
+/* min and max of a linear interpolation are reached at instants: the header is enough */
+PG_FUNCTION_INFO_V1(temporal_float_tw_min);
+
+Datum
+temporal_float_tw_min(PG_FUNCTION_ARGS)
+{
+  struct temporal_float *tf = PG_GETARG_TEMPORAL_FLOAT_HEADER_P(0);
+
+  if(tf->npoints == 0)
+    PG_RETURN_NULL();
+
+  PG_RETURN_FLOAT8(tf->min);
+}
+
+
+PG_FUNCTION_INFO_V1(temporal_float_tw_max);
+
+Datum
+temporal_float_tw_max(PG_FUNCTION_ARGS)
+{
+  struct temporal_float *tf = PG_GETARG_TEMPORAL_FLOAT_HEADER_P(0);
+
+  if(tf->npoints == 0)
+    PG_RETURN_NULL();
+
+  PG_RETURN_FLOAT8(tf->max);
+}
+
+
+/*
+ * \brief Index of the last instant at or before 't', -1 if none.
+ *
+ */
+static int32 times_search(const Timestamp *times, int32 n, Timestamp t)
+{
+  int32 lo = 0;
+
+  int32 hi = n - 1;
+
+  int32 found = -1;
+
+  while(lo <= hi)
+  {
+    int32 mid = lo + (hi - lo) / 2;
+
+    if(times[mid] <= t)
+    {
+      found = mid;
+      lo = mid + 1;
+    }
+    else
+      hi = mid - 1;
+  }
+
+  return found;
+}
+
+
+/*
+ * \brief Value of the segment from instant 'i' to 'i + 1' at time 't'.
+ *
+ */
+static inline double interpolate_value(const double *values, const Timestamp *times, int32 i, Timestamp t)
+{
+  double f = (double) (t - times[i]) / (double) (times[i + 1] - times[i]);
+
+  return values[i] + (values[i + 1] - values[i]) * f;
+}
+
+
+PG_FUNCTION_INFO_V1(temporal_float_value_at);
+
+Datum
+temporal_float_value_at(PG_FUNCTION_ARGS)
+{
+  struct temporal_float *tf = PG_GETARG_TEMPORAL_FLOAT_P(0);
+
+  Timestamp t = PG_GETARG_TIMESTAMP(1);
+
+  const double *values = TF_VALUES(tf);
+
+  const Timestamp *times = TF_TIMES(tf);
+
+  int32 i;
+
+  if(tf->npoints == 0 || t < tf->start_time || t > tf->end_time)
+    PG_RETURN_NULL();
+
+  i = times_search(times, tf->npoints, t);
+
+  if(times[i] == t)
+    PG_RETURN_FLOAT8(values[i]);
+
+  PG_RETURN_FLOAT8(interpolate_value(values, times, i, t));
+}
+
+
+/*
+ * \brief The series restricted to a period, with values interpolated at
+ *        the bounds of the period that fall between two instants, as in
+ *        st_at_period of a spatiotemporal.
+ *
+ */
+PG_FUNCTION_INFO_V1(temporal_float_at_period);
+
+Datum
+temporal_float_at_period(PG_FUNCTION_ARGS)
+{
+  struct temporal_float *tf = PG_GETARG_TEMPORAL_FLOAT_P(0);
+
+  const double *values = TF_VALUES(tf);
+
+  const Timestamp *times = TF_TIMES(tf);
+
+  struct temporal_float *result;
+
+  Timestamp lower, upper;
+
+  int32 i0, i1, first;
+
+  if(!st_period_from_range(PG_GETARG_DATUM(1), &lower, &upper))
+    PG_RETURN_NULL();
+
+  i0 = times_search(times, tf->npoints, lower);
+
+  i1 = times_search(times, tf->npoints, upper);
+
+  first = (i0 >= 0 && times[i0] == lower) ? i0 : i0 + 1;
+
+  result = temporal_float_alloc(Max(i1 - first + 1, 0) + 2);
+
+  if(i0 >= 0 && times[i0] < lower && i0 + 1 < tf->npoints)
+    temporal_float_push(result, interpolate_value(values, times, i0, lower), lower);
+
+  for(int32 i = first; i <= i1; ++i)
+    temporal_float_push(result, values[i], times[i]);
+
+  if(i1 >= 0 && times[i1] < upper && i1 + 1 < tf->npoints &&
+     (result->npoints == 0 || result->end_time < upper))
+    temporal_float_push(result, interpolate_value(values, times, i1, upper), upper);
+
+  PG_RETURN_TEMPORAL_FLOAT_P(result);
+}
@@ -0,0 +1,97 @@
+/*
+  Copyright (C) 2017 National Institute For Space Research (INPE) - Brazil.
+
+  postgis-t is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License version 3 as
+  published by the Free Software Foundation.
+
+  postgis-t is distributed  "AS-IS" in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY OF ANY KIND; without even the implied warranty
+  of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with postgis-t. See LICENSE. If not, write to
+  Gilberto Ribeiro de Queiroz at <gribeiro@dpi.inpe.br>.
+
+ */
+/*!
+ *
+ * \file postgist/temporal_float.h
+ *
+ * \brief A time series of float values, with the same header conventions
+ *        and time array as struct spatiotemporal.
+ *
+ * Values are linearly interpolated between instants, so the time-weighted
+ * average of a segment is the mean of its two end values.
+ *
+ * \author Gilberto Ribeiro de Queiroz
+ * \author Fabiana Zioti
+ *
+ * \date 2017
+ *
+ * \copyright GNU Lesser Public License version 3
+ *
+ */
+
+#ifndef __POSTGIST_TEMPORAL_FLOAT_H__
+#define __POSTGIST_TEMPORAL_FLOAT_H__
+
+/* PostGIS-T extension */
+#include "spatiotemporal.h"
+
+
+/*
+ * Layout: the header is followed by the value array (capacity doubles) and
+ * then by the time array (capacity timestamps), as in struct spatiotemporal.
+ */
+struct temporal_float
+{
+  int32 vl_len_;        /* Varlena header */
+  int32 flags;          /* Reserved, always 0 */
+  Timestamp start_time;
+  Timestamp end_time;
+  int32 npoints;        /* Number of instants in use */
+  int32 capacity;       /* Number of instants the arrays have room for */
+  double min;           /* Smallest value, the range of the values */
+  double max;           /* Largest value */
+  double data[1];
+};
+
+#define TF_HEADER_SIZE  offsetof(struct temporal_float, data)
+#define TF_VALUES(tf)   ((tf)->data)
+#define TF_TIMES(tf)    ((Timestamp*) ((tf)->data + (tf)->capacity))
+#define TF_SIZE(capacity) \
+  (TF_HEADER_SIZE + (capacity) * (sizeof(double) + sizeof(Timestamp)))
+
+#define DatumGetTemporalFloat(X)      ((struct temporal_float*) PG_DETOAST_DATUM(X))
+#define PG_GETARG_TEMPORAL_FLOAT_P(n)  DatumGetTemporalFloat(PG_GETARG_DATUM(n))
+#define PG_GETARG_TEMPORAL_FLOAT_P_COPY(n)  ((struct temporal_float*) PG_GETARG_VARLENA_P_COPY(n))
+#define PG_RETURN_TEMPORAL_FLOAT_P(x)  PG_RETURN_POINTER(x)
+
+/* fetch only the header, see DatumGetSpatioTemporalHeader */
+#define DatumGetTemporalFloatHeader(X) \
+  ((struct temporal_float*) PG_DETOAST_DATUM_SLICE(X, 0, TF_HEADER_SIZE - VARHDRSZ))
+#define PG_GETARG_TEMPORAL_FLOAT_HEADER_P(n)  DatumGetTemporalFloatHeader(PG_GETARG_DATUM(n))
+
+
+struct temporal_float *temporal_float_alloc(int32 capacity);
+
+
+extern Datum temporal_float_in(PG_FUNCTION_ARGS);
+extern Datum temporal_float_out(PG_FUNCTION_ARGS);
+
+extern Datum temporal_float_append_instant(PG_FUNCTION_ARGS);
+extern Datum temporal_float_compact(PG_FUNCTION_ARGS);
+
+extern Datum temporal_float_get_start_time(PG_FUNCTION_ARGS);
+extern Datum temporal_float_get_end_time(PG_FUNCTION_ARGS);
+
+extern Datum temporal_float_tw_avg(PG_FUNCTION_ARGS);
+extern Datum temporal_float_tw_min(PG_FUNCTION_ARGS);
+extern Datum temporal_float_tw_max(PG_FUNCTION_ARGS);
+
+extern Datum temporal_float_value_at(PG_FUNCTION_ARGS);
+extern Datum temporal_float_at_period(PG_FUNCTION_ARGS);
+
+#endif  /* __POSTGIST_TEMPORAL_FLOAT_H__ */
@@ -0,0 +1,238 @@
+/*
+  Copyright (C) 2017 National Institute For Space Research (INPE) - Brazil.
+
+  postgis-t is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License version 3 as
+  published by the Free Software Foundation.
+
+  postgis-t is distributed  "AS-IS" in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY OF ANY KIND; without even the implied warranty
+  of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with postgis-t. See LICENSE. If not, write to
+  Gilberto Ribeiro de Queiroz at <gribeiro@dpi.inpe.br>.
+
+ */
+/*!
+ *
+ * \file postgist/transform.c
+ *
+ * \brief Reprojection of whole spatiotemporal values with PROJ.
+ *
+ * \author Gilberto Ribeiro de Queiroz
+ * \author Fabiana Zioti
+ *
+ * \date 2017
+ *
+ * \copyright GNU Lesser Public License version 3
+ *
+ */
+
+/* PostGIS-T extension */
+#include "spatiotemporal.h"
+#include "dims.h"
+
+/* PostgreSQL */
+#include <executor/spi.h>
+#include <utils/memutils.h>
+
+/* PROJ */
+#define ACCEPT_USE_OF_DEPRECATED_PROJ_API_H 1
+#include <proj_api.h>
+
+/* C Standard Library */
+#include <math.h>
+#include <string.h>
+
+
+/* number of projections kept open by each backend */
+#define ST_PROJ_CACHE_SIZE 8
+
+
+struct st_proj_entry
+{
+  int32 srid;
+  projPJ pj;
+  uint64 last_used;
+};
+
+
+/*
+ * Projections are looked up in spatial_ref_sys and initialized once per
+ * backend; the least recently used one is released when the cache is full.
+ */
+static struct st_proj_entry proj_cache[ST_PROJ_CACHE_SIZE];
+
+static uint64 proj_cache_clock = 0;
+
+
+static char *proj4text_lookup(int32 srid)
+{
+  char query[128];
+
+  char *result = NULL;
+
+  int rc;
+
+  if(SPI_connect() != SPI_OK_CONNECT)
+    elog(ERROR, "could not connect to SPI manager");
+
+  snprintf(query, sizeof(query), "SELECT proj4text FROM spatial_ref_sys WHERE srid = %d", srid);
+
+  rc = SPI_execute(query, true, 1);
+
+  if(rc == SPI_OK_SELECT && SPI_processed > 0)
+  {
+    char *text = SPI_getvalue(SPI_tuptable->vals[0], SPI_tuptable->tupdesc, 1);
+
+    /* copy into the caller context before SPI frees its memory */
+    if(text)
+    {
+      size_t len = strlen(text) + 1;
+
+      result = (char*) SPI_palloc(len);
+
+      memcpy(result, text, len);
+    }
+  }
+
+  SPI_finish();
+
+  if(result == NULL)
+    ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                    errmsg("SRID %d not found in spatial_ref_sys", srid)));
+
+  return result;
+}
+
+
+static projPJ proj_get(int32 srid)
+{
+  struct st_proj_entry *victim = &proj_cache[0];
+
+  char *proj4text;
+
+  projPJ pj;
+
+  if(srid <= 0)
+    ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                    errmsg("spatiotemporal with unknown SRID can not be transformed")));
+
+  for(int i = 0; i < ST_PROJ_CACHE_SIZE; ++i)
+  {
+    if(proj_cache[i].pj && proj_cache[i].srid == srid)
+    {
+      proj_cache[i].last_used = ++proj_cache_clock;
+
+      return proj_cache[i].pj;
+    }
+
+    if(proj_cache[i].last_used < victim->last_used)
+      victim = &proj_cache[i];
+  }
+
+  proj4text = proj4text_lookup(srid);
+
+  pj = pj_init_plus(proj4text);
+
+  if(pj == NULL)
+    ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                    errmsg("could not create projection for SRID %d: %s", srid, pj_strerrno(*pj_get_errno_ref())),
+                    errdetail("PROJ definition: %s", proj4text)));
+
+  pfree(proj4text);
+
+  if(victim->pj)
+    pj_free(victim->pj);
+
+  victim->srid = srid;
+  victim->pj = pj;
+  victim->last_used = ++proj_cache_clock;
+
+  return pj;
+}
+
+
+PG_FUNCTION_INFO_V1(spatiotemporal_transform);
+
+Datum
+spatiotemporal_transform(PG_FUNCTION_ARGS)
+{
+  struct spatiotemporal *st = PG_GETARG_SPATIOTEMPORAL_P(0);
+
+  int32 srid = PG_GETARG_INT32(1);
+
+  int ndims = ST_NDIMS(st);
+
+  struct spatiotemporal *result;
+
+  double *coords;
+
+  projPJ src, dst;
+
+  int rc;
+
+  if(srid == st->srid)
+    PG_RETURN_SPATIOTEMPORAL_P(st);
+
+  src = proj_get(st->srid);
+
+  dst = proj_get(srid);
+
+  result = spatiotemporal_alloc(st->npoints, st->flags);
+
+  result->start_time = st->start_time;
+  result->end_time = st->end_time;
+  result->npoints = st->npoints;
+  result->srid = srid;
+
+  coords = ST_COORDS(result);
+
+  memcpy(coords, ST_COORDS(st), st->npoints * ndims * sizeof(double));
+
+  /* times do not change */
+  memcpy(ST_TIMES(result), ST_TIMES(st), st->npoints * sizeof(Timestamp));
+
+  if(st->npoints == 0)
+    PG_RETURN_SPATIOTEMPORAL_P(result);
+
+  if(pj_is_latlong(src))
+  {
+    for(int32 i = 0; i < st->npoints; ++i)
+    {
+      coords[i * ndims] *= DEG_TO_RAD;
+      coords[i * ndims + 1] *= DEG_TO_RAD;
+    }
+  }
+
+  /*
+   * One call for the whole value: x, y and z are read from the interleaved
+   * coordinate array with a stride of ndims doubles. M is left untouched.
+   */
+  rc = pj_transform(src, dst, st->npoints, ndims,
+                    coords, coords + 1, ST_HAS_Z(st) ? coords + 2 : NULL);
+
+  if(rc != 0)
+    ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                    errmsg("could not transform spatiotemporal from SRID %d to SRID %d: %s",
+                           st->srid, srid, pj_strerrno(rc))));
+
+  for(int32 i = 0; i < st->npoints; ++i)
+  {
+    if(coords[i * ndims] == HUGE_VAL || coords[i * ndims + 1] == HUGE_VAL)
+      ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                      errmsg("could not transform instant %d of spatiotemporal to SRID %d", i + 1, srid)));
+
+    if(pj_is_latlong(dst))
+    {
+      coords[i * ndims] *= RAD_TO_DEG;
+      coords[i * ndims + 1] *= RAD_TO_DEG;
+    }
+  }
+
+  st_dims_ops_get(result->flags)->extent(coords, result->npoints, &result->extent);
+
+  PG_RETURN_SPATIOTEMPORAL_P(result);
+}
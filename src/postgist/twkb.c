@@ -0,0 +1,234 @@
+/*
+  Copyright (C) 2017 National Institute For Space Research (INPE) - Brazil.
+
+  postgis-t is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License version 3 as
+  published by the Free Software Foundation.
+
+  postgis-t is distributed  "AS-IS" in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY OF ANY KIND; without even the implied warranty
+  of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with postgis-t. See LICENSE. If not, write to
+  Gilberto Ribeiro de Queiroz at <gribeiro@dpi.inpe.br>.
+
+ */
+
+/*!
+ *
+ * \file postgist/twkb.c
+ *
+ * \brief Compact binary encoding of spatiotemporal values modeled on TWKB.
+ *
+ * \author Gilberto Ribeiro de Queiroz
+ * \author Fabiana Zioti
+ *
+ * \date 2017
+ *
+ * \copyright GNU Lesser Public License version 3
+ *
+ */
+
+/* PostGIS-T extension */
+#include "twkb.h"
+
+/* C Standard Library */
+#include <math.h>
+
+
+#define TWKB_BBOX     0x01
+#define TWKB_SRID     0x04
+#define TWKB_EXT_DIMS 0x08
+#define TWKB_EMPTY    0x10
+
+/* max bytes of a 64-bit LEB128 varint */
+#define VARINT_MAX_SIZE 10
+
+#define USECS_PER_MSEC 1000
+
+/* bound of the scaled coordinates, so that their deltas fit in an int64 */
+#define TWKB_MAX_SCALED 4611686018427387904.0
+
+
+static inline uint64 zigzag64(int64 v)
+{
+  return (((uint64) v) << 1) ^ (uint64) (v >> 63);
+}
+
+
+static inline uint8 *uvarint_write(uint8 *p, uint64 v)
+{
+  while(v >= 0x80)
+  {
+    *p++ = (uint8) (v | 0x80);
+    v >>= 7;
+  }
+
+  *p++ = (uint8) v;
+
+  return p;
+}
+
+
+static inline uint8 *svarint_write(uint8 *p, int64 v)
+{
+  return uvarint_write(p, zigzag64(v));
+}
+
+
+/*
+ * \brief Scale the coordinate 'd' to the integer TWKB stores.
+ *
+ * \note rint() of a non-finite or huge value does not fit in an int64,
+ *       so such coordinates are an error.
+ *
+ */
+static inline int64 twkb_scale(double d, double scale, int precision)
+{
+  double v;
+
+  if(!isfinite(d))
+    ereport(ERROR, (errcode(ERRCODE_NUMERIC_VALUE_OUT_OF_RANGE),
+                    errmsg("spatiotemporal with non-finite coordinates can not be written as TWKB")));
+
+  v = rint(d * scale);
+
+  if(fabs(v) >= TWKB_MAX_SCALED)
+    ereport(ERROR, (errcode(ERRCODE_NUMERIC_VALUE_OUT_OF_RANGE),
+                    errmsg("spatiotemporal coordinate %g is out of range for TWKB with precision %d", d, precision)));
+
+  return (int64) v;
+}
+
+
+/*
+ * \brief The coarsest time unit that represents all instants exactly.
+ *
+ */
+static int64 time_unit_choose(const Timestamp *times, int32 npoints)
+{
+  bool secs = true;
+
+  bool msecs = true;
+
+  for(int32 i = 0; i < npoints && msecs; ++i)
+  {
+    if(times[i] % USECS_PER_SEC != 0)
+      secs = false;
+
+    if(times[i] % USECS_PER_MSEC != 0)
+      msecs = false;
+  }
+
+  return secs ? USECS_PER_SEC : (msecs ? USECS_PER_MSEC : 1);
+}
+
+
+bytea *spatiotemporal_to_twkb(const struct spatiotemporal *st, int precision)
+{
+  int ndims = ST_NDIMS(st);
+
+  int zm_precision = Max(precision, 0);
+
+  double scale = pow(10.0, precision);
+
+  double zm_scale = pow(10.0, zm_precision);
+
+  const double *coords = ST_COORDS(st);
+
+  const Timestamp *times = ST_TIMES(st);
+
+  int64 time_unit = time_unit_choose(times, st->npoints);
+
+  int64 last[4] = { 0, 0, 0, 0 };
+
+  int64 last_t = 0;
+
+  uint8 metadata = 0;
+
+  /* header and bbox are bounded by a few dozen bytes, each instant by its varints */
+  size_t max_size = VARHDRSZ + 64 + 4 * VARINT_MAX_SIZE +
+                    (size_t) st->npoints * (ndims + 1) * VARINT_MAX_SIZE;
+
+  bytea *result = (bytea*) palloc(max_size);
+
+  uint8 *p = (uint8*) VARDATA(result);
+
+  if(precision < ST_TWKB_MIN_PRECISION || precision > ST_TWKB_MAX_PRECISION)
+    ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                    errmsg("TWKB precision must be between %d and %d",
+                           ST_TWKB_MIN_PRECISION, ST_TWKB_MAX_PRECISION)));
+
+  if(st->npoints == 0)
+    metadata |= TWKB_EMPTY;
+  else
+    metadata |= TWKB_BBOX;
+
+  if(st->srid != 0)
+    metadata |= TWKB_SRID;
+
+  if(ST_HAS_Z(st) || ST_HAS_M(st))
+    metadata |= TWKB_EXT_DIMS;
+
+  *p++ = (uint8) (ST_TWKB_TYPE | (zigzag64(precision) << 4));
+
+  *p++ = metadata;
+
+  if(metadata & TWKB_EXT_DIMS)
+  {
+    int zm = Min(zm_precision, 7);
+
+    *p++ = (uint8) ((ST_HAS_Z(st) ? 0x01 : 0) | (ST_HAS_M(st) ? 0x02 : 0) |
+                    (zm << 2) | (zm << 5));
+
+    zm_scale = pow(10.0, zm);
+  }
+
+  if(metadata & TWKB_SRID)
+    p = uvarint_write(p, (uint64) st->srid);
+
+  p = uvarint_write(p, (uint64) time_unit);
+
+  p = svarint_write(p, st->start_time);
+  p = svarint_write(p, st->end_time);
+
+  if(metadata & TWKB_BBOX)
+  {
+    int64 xmin = twkb_scale(st->extent.xmin, scale, precision);
+    int64 ymin = twkb_scale(st->extent.ymin, scale, precision);
+
+    p = svarint_write(p, xmin);
+    p = svarint_write(p, twkb_scale(st->extent.xmax, scale, precision) - xmin);
+    p = svarint_write(p, ymin);
+    p = svarint_write(p, twkb_scale(st->extent.ymax, scale, precision) - ymin);
+  }
+
+  p = uvarint_write(p, (uint64) st->npoints);
+
+  for(int32 i = 0; i < st->npoints; ++i)
+  {
+    const double *c = coords + i * ndims;
+
+    int64 t = times[i] / time_unit;
+
+    for(int d = 0; d < ndims; ++d)
+    {
+      int64 v = (d < 2) ? twkb_scale(c[d], scale, precision)
+                        : twkb_scale(c[d], zm_scale, zm_precision);
+
+      p = svarint_write(p, v - last[d]);
+
+      last[d] = v;
+    }
+
+    p = svarint_write(p, t - last_t);
+
+    last_t = t;
+  }
+
+  SET_VARSIZE(result, (char*) p - (char*) result);
+
+  return result;
+}
@@ -0,0 +1,68 @@
+/*
+  Copyright (C) 2017 National Institute For Space Research (INPE) - Brazil.
+
+  postgis-t is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License version 3 as
+  published by the Free Software Foundation.
+
+  postgis-t is distributed  "AS-IS" in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY OF ANY KIND; without even the implied warranty
+  of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with postgis-t. See LICENSE. If not, write to
+  Gilberto Ribeiro de Queiroz at <gribeiro@dpi.inpe.br>.
+
+ */
+
+/*!
+ *
+ * \file postgist/twkb.h
+ *
+ * \brief Compact binary encoding of spatiotemporal values modeled on TWKB.
+ *
+ * The encoding is:
+ *
+ *   byte     type and precision: type in the low nibble (ST_TWKB_TYPE),
+ *            zig-zag encoded xy precision in the high nibble
+ *   byte     metadata: bit 0 bbox, bit 2 srid, bit 3 extended dims, bit 4 empty
+ *   [byte]   extended dims: bit 0 Z, bit 1 M, bits 2-4 z precision,
+ *            bits 5-7 m precision
+ *   [varint] srid
+ *   varint   time unit, in microseconds (1, 1000 or 1000000)
+ *   varint   start_time and end_time, in microseconds
+ *   [varint] bbox: xmin, xmax - xmin, ymin, ymax - ymin
+ *   varint   number of instants
+ *   varint   per instant: delta of each scaled ordinate and delta of the
+ *            time, in time units, from the previous instant
+ *
+ * Signed values are zig-zag encoded, all varints are LEB128 as in TWKB.
+ *
+ * \author Gilberto Ribeiro de Queiroz
+ * \author Fabiana Zioti
+ *
+ * \date 2017
+ *
+ * \copyright GNU Lesser Public License version 3
+ *
+ */
+
+#ifndef __POSTGIST_TWKB_H__
+#define __POSTGIST_TWKB_H__
+
+/* PostGIS-T extension */
+#include "spatiotemporal.h"
+
+#define ST_TWKB_TYPE 15
+
+#define ST_TWKB_MIN_PRECISION -7
+#define ST_TWKB_MAX_PRECISION 7
+
+/*
+ * \brief Encode 'st' with 'precision' decimal digits for the coordinates.
+ *
+ */
+bytea *spatiotemporal_to_twkb(const struct spatiotemporal *st, int precision);
+
+#endif  /* __POSTGIST_TWKB_H__ */
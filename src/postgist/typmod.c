@@ -0,0 +1,280 @@
+/*
+  Copyright (C) 2017 National Institute For Space Research (INPE) - Brazil.
+
+  postgis-t is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License version 3 as
+  published by the Free Software Foundation.
+
+  postgis-t is distributed  "AS-IS" in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY OF ANY KIND; without even the implied warranty
+  of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with postgis-t. See LICENSE. If not, write to
+  Gilberto Ribeiro de Queiroz at <gribeiro@dpi.inpe.br>.
+
+ */
+
+/*!
+ *
+ * \file postgist/typmod.c
+ *
+ * \brief Type modifiers for spatiotemporal columns: SRID, dimensionality
+ *        and coordinate precision.
+ *
+ * \author Gilberto Ribeiro de Queiroz
+ * \author Fabiana Zioti
+ *
+ * \date 2017
+ *
+ * \copyright GNU Lesser Public License version 3
+ *
+ */
+
+/* PostGIS-T extension */
+#include "spatiotemporal.h"
+
+/* PostgreSQL */
+#include <catalog/pg_type.h>
+#include <utils/array.h>
+#include <utils/builtins.h>
+
+/* C Standard Library */
+#include <ctype.h>
+#include <errno.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+static const char *dims_names[4] = { "XY", "XYZ", "XYM", "XYZM" };
+
+
+static int32 typmod_parse_int(const char *s, const char *what, int32 min_value, int32 max_value)
+{
+  char *endptr;
+
+  long value;
+
+  errno = 0;
+
+  value = strtol(s, &endptr, 10);
+
+  if(errno != 0 || endptr == s || *endptr != '\0' || value < min_value || value > max_value)
+    ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                    errmsg("invalid %s for type spatiotemporal: \"%s\"", what, s)));
+
+  return (int32) value;
+}
+
+
+static int32 typmod_parse_dims(const char *s)
+{
+  if(isdigit((unsigned char) *s))
+  {
+    /* a plain number of dimensions: 3 means XYZ */
+    int32 n = typmod_parse_int(s, "dimensionality", 2, 4);
+
+    return n == 2 ? 0 : (n == 3 ? ST_FLAG_Z : (ST_FLAG_Z | ST_FLAG_M));
+  }
+
+  for(int32 flags = 0; flags < 4; ++flags)
+    if(pg_strcasecmp(s, dims_names[flags]) == 0)
+      return flags;
+
+  ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                  errmsg("invalid dimensionality for type spatiotemporal: \"%s\"", s),
+                  errhint("Use one of XY, XYZ, XYM or XYZM.")));
+
+  return 0;
+}
+
+
+PG_FUNCTION_INFO_V1(spatiotemporal_typmod_in);
+
+Datum
+spatiotemporal_typmod_in(PG_FUNCTION_ARGS)
+{
+  ArrayType *arr = (ArrayType*) DatumGetPointer(PG_GETARG_DATUM(0));
+
+  Datum *elems;
+
+  int n = 0;
+
+  int32 srid = 0;
+
+  int32 flags = 0;
+
+  bool dims_set = false;
+
+  int32 precision = -1;
+
+  if(ARR_ELEMTYPE(arr) != CSTRINGOID)
+    ereport(ERROR, (errcode(ERRCODE_ARRAY_ELEMENT_ERROR),
+                    errmsg("typmod array must be type cstring[]")));
+
+  if(ARR_NDIM(arr) != 1)
+    ereport(ERROR, (errcode(ERRCODE_ARRAY_SUBSCRIPT_ERROR),
+                    errmsg("typmod array must be one-dimensional")));
+
+  deconstruct_array(arr, CSTRINGOID, -2, false, 'c', &elems, NULL, &n);
+
+  if(n < 1 || n > 3)
+    ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                    errmsg("invalid type modifier for spatiotemporal"),
+                    errhint("Use spatiotemporal(srid [, dims [, precision]]).")));
+
+  srid = typmod_parse_int(DatumGetCString(elems[0]), "SRID", 0, SRID_MAXIMUM);
+
+  if(n > 1)
+  {
+    flags = typmod_parse_dims(DatumGetCString(elems[1]));
+    dims_set = true;
+  }
+
+  if(n > 2)
+    precision = typmod_parse_int(DatumGetCString(elems[2]), "precision", 0, ST_TYPMOD_MAX_PRECISION);
+
+  PG_RETURN_INT32(ST_TYPMOD_MAKE(srid, flags, dims_set, precision));
+}
+
+
+PG_FUNCTION_INFO_V1(spatiotemporal_typmod_out);
+
+Datum
+spatiotemporal_typmod_out(PG_FUNCTION_ARGS)
+{
+  int32 typmod = PG_GETARG_INT32(0);
+
+  StringInfoData str;
+
+  initStringInfo(&str);
+
+  if(typmod < 0)
+    PG_RETURN_CSTRING(str.data);
+
+  appendStringInfo(&str, "(%d", ST_TYPMOD_GET_SRID(typmod));
+
+  if(ST_TYPMOD_HAS_DIMS(typmod))
+    appendStringInfo(&str, ",%s", dims_names[ST_TYPMOD_GET_FLAGS(typmod)]);
+
+  if(ST_TYPMOD_GET_PRECISION(typmod) >= 0)
+    appendStringInfo(&str, ",%d", ST_TYPMOD_GET_PRECISION(typmod));
+
+  appendStringInfoChar(&str, ')');
+
+  PG_RETURN_CSTRING(str.data);
+}
+
+
+/*
+ * \brief Check the header of a value against 'typmod' and tell if the
+ *        value has to be rewritten to satisfy it.
+ *
+ */
+static bool typmod_needs_rewrite(const struct spatiotemporal *hdr, int32 typmod)
+{
+  int32 srid;
+
+  if(typmod < 0)
+    return false;
+
+  srid = ST_TYPMOD_GET_SRID(typmod);
+
+  if(ST_TYPMOD_HAS_DIMS(typmod) &&
+     ST_TYPMOD_GET_FLAGS(typmod) != (hdr->flags & (ST_FLAG_Z | ST_FLAG_M)))
+    ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                    errmsg("spatiotemporal has %s dimensions but column has %s",
+                           dims_names[hdr->flags & (ST_FLAG_Z | ST_FLAG_M)],
+                           dims_names[ST_TYPMOD_GET_FLAGS(typmod)])));
+
+  if(srid != 0 && hdr->srid != 0 && hdr->srid != srid)
+    ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                    errmsg("spatiotemporal SRID (%d) does not match column SRID (%d)", hdr->srid, srid)));
+
+  return (srid != 0 && hdr->srid == 0) || ST_TYPMOD_GET_PRECISION(typmod) >= 0;
+}
+
+
+static void coords_round(double *coords, int32 n, double scale)
+{
+  for(int32 i = 0; i < n; ++i)
+    coords[i] = rint(coords[i] * scale) / scale;
+}
+
+
+static void extent_round(struct st_extent *e, double scale)
+{
+  e->xmin = rint(e->xmin * scale) / scale;
+  e->ymin = rint(e->ymin * scale) / scale;
+  e->xmax = rint(e->xmax * scale) / scale;
+  e->ymax = rint(e->ymax * scale) / scale;
+}
+
+
+struct spatiotemporal *spatiotemporal_apply_typmod(struct spatiotemporal *st, int32 typmod)
+{
+  int32 srid;
+
+  int32 precision;
+
+  struct spatiotemporal *result;
+
+  if(!typmod_needs_rewrite(st, typmod))
+    return st;
+
+  srid = ST_TYPMOD_GET_SRID(typmod);
+
+  precision = ST_TYPMOD_GET_PRECISION(typmod);
+
+  /* never scribble on the caller's value */
+  result = (struct spatiotemporal*) palloc(VARSIZE(st));
+
+  memcpy(result, st, VARSIZE(st));
+
+  if(srid != 0)
+    result->srid = srid;
+
+  if(precision >= 0)
+  {
+    double scale = pow(10.0, precision);
+
+    int ndims = ST_NDIMS(result);
+
+    /* a chunked value keeps its layout: each chunk is rounded where it is */
+    if(ST_IS_CHUNKED(result))
+    {
+      struct st_chunk *chunks = ST_CHUNKS(result);
+
+      for(int32 k = 0; k < result->nchunks; ++k)
+      {
+        coords_round((double*) ((char*) result + chunks[k].offset), chunks[k].npoints * ndims, scale);
+
+        extent_round(&chunks[k].extent, scale);
+      }
+    }
+    else
+      coords_round(ST_COORDS(result), result->npoints * ndims, scale);
+
+    extent_round(&result->extent, scale);
+  }
+
+  return result;
+}
+
+
+PG_FUNCTION_INFO_V1(spatiotemporal_enforce_typmod);
+
+Datum
+spatiotemporal_enforce_typmod(PG_FUNCTION_ARGS)
+{
+  int32 typmod = PG_GETARG_INT32(1);
+
+  /* checked on the header: a value that satisfies the modifier is kept as is, chunked or not */
+  if(!typmod_needs_rewrite(PG_GETARG_SPATIOTEMPORAL_HEADER_P(0), typmod))
+    PG_RETURN_DATUM(PG_GETARG_DATUM(0));
+
+  PG_RETURN_SPATIOTEMPORAL_P(spatiotemporal_apply_typmod((struct spatiotemporal*) PG_DETOAST_DATUM(PG_GETARG_DATUM(0)),
+                                                         typmod));
+}
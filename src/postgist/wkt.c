@@ -33,10 +33,15 @@
 
 /*PostGIS-T extension*/
 #include "wkt.h"
+#include "dims.h"
 
 /* PostgreSQL */
 #include <libpq/pqformat.h>
 #include <utils/builtins.h>
+#include <utils/datetime.h>
+#if PG_VERSION_NUM >= 120000
+#include <common/shortest_dec.h>
+#endif
 
 
 /* C Standard Library */
@@ -45,11 +50,15 @@
 #include <float.h>
 #include <limits.h>
 #include <math.h>
+#include <stdlib.h>
 #include <string.h>
 
 /*
  * WKT delimiters for input/output
  */
+#define SRID_WKT_TOKEN "SRID="
+#define SRID_WKT_TOKEN_LEN 5
+
 #define ST_WKT_TOKEN "ST_"
 #define ST_WKT_TOKEN_LEN 3
 
@@ -67,6 +76,10 @@
 
 #define LWGEOM_SIZE_POINT 24
 
+/* worst case for one coordinate and one "YYYY-MM-DD HH:MM:SS.ffffff" time */
+#define WKT_DOUBLE_SIZE 32
+#define WKT_TIME_SIZE 27
+
 
 inline
 int coord_count(char *s)
@@ -113,13 +126,10 @@ LWGEOM *position_decode(char **cp)
 
 	*cp += index;
 
-	elog(INFO, "POSITION %s ", position);
-
 	// code from POSTGIS
 
 	if(lwgeom_parse_wkt(&lwg_parser_result, position, LW_PARSER_CHECK_ALL) == LW_FAILURE )
 	{
-			elog(INFO, "PASSER ERROR ");
 			return NULL;
 	}
 
@@ -132,7 +142,6 @@ LWGEOM *position_decode(char **cp)
 
 	if ( lwgeom_is_empty(lwgeom))
 	{
-		elog(INFO, "geometry is empty");
     	lwgeom_free(lwgeom);
     	return NULL;
   	}
@@ -167,48 +176,58 @@ Timestamp timestamp_decode(char **cp)
 
 }
 
-/*uint8_t *sequence_decode(char *str, int ncoords, char **endptr)*/
+/*
+ * \brief Decode a sequence of "POINT(x y), time;" instants into a new
+ *        spatiotemporal value.
+ *
+ * \note The dimensionality of the value is taken from the first point and
+ *       the matching coordinate kernels are used for the whole sequence.
+ *
+ */
 static inline
-uint8_t * sequence_decode(char *str, int ncoords, char **endptr, size_t *size)
+struct spatiotemporal *sequence_decode(char *str, int ncoords, char **endptr)
 {
-	uint8_t *data = NULL;
+	struct spatiotemporal *st = NULL;
 
-	uint8_t *ptr = NULL;
+	const struct st_dims_ops *ops = NULL;
 
-	size_t expected_size = 0;
+	double *coords = NULL;
 
-	size_t return_size = 0;
+	Timestamp *times = NULL;
 
-	/*lwgeom e position_time estao sendo substituidos toda hora*/
-	/*como colocar no data ?*/
+	int32 flags = 0;
 
-	/*expected_size = (2 * sizeof(Timestamp))+(2*sizeof(int32)) + (ncoords * (sizeof(Timestamp) + LWGEOM_SIZE_POINT));*/
-	expected_size = (2*sizeof(int32)) + (2 * sizeof(Timestamp)) + (ncoords * (2 * sizeof(double)));
+	for(int i = 0; i < ncoords; i++)
+	{
+		LWGEOM *lwgeom = NULL;
 
-	elog(INFO, " ---  expected_size ---  %zd", expected_size);
+		POINT4D p;
 
-	data = lwalloc(expected_size);
+		Timestamp position_time = 0;
 
-	ptr = data;
+		lwgeom = position_decode(&str);
 
-	/*pass size times*/
-	ptr += (2 * sizeof(int32) );
-	ptr += (2 * sizeof(Timestamp));
+		if(lwgeom == NULL || lwgeom->type != POINTTYPE)
+			ereport(ERROR,
+				(errcode(ERRCODE_INVALID_TEXT_REPRESENTATION),
+					errmsg("invalid input syntax for type spatiotemporal: expected a non-empty POINT")));
 
+		if(st == NULL)
+		{
+			flags = st_flags_from_lwflags(lwgeom->flags);
 
-	for(int i = 0; i < ncoords; i++)
-	{
-		LWGEOM *lwgeom = NULL;
+			st = spatiotemporal_alloc(ncoords, flags);
 
-		Timestamp position_time = 0;
+			ops = st_dims_ops_get(flags);
 
-		lwgeom = position_decode(&str);
+			coords = ST_COORDS(st);
 
-		if (lwgeom->type == POINTTYPE) {
-    		/* teste para ver se o lwgeom esta correto */
-    		elog(INFO, "****** geom_elem is POINTTYPE *****");
-    		elog(INFO, "sizeof %lu", sizeof(lwgeom));
-  	}
+			times = ST_TIMES(st);
+		}
+		else if(st_flags_from_lwflags(lwgeom->flags) != flags)
+			ereport(ERROR,
+				(errcode(ERRCODE_INVALID_TEXT_REPRESENTATION),
+					errmsg("invalid input syntax for type spatiotemporal: mixed coordinate dimensionality")));
 
 		/*skip , */
 		++str;
@@ -216,11 +235,8 @@ uint8_t * sequence_decode(char *str, int ncoords, char **endptr, size_t *size)
 		while(isspace(*str))
 				str++;
 
-		/*must have value too ?*/
-
 		position_time = timestamp_decode(&str);
 
-
 		while(isspace(*str))
 				str++;
 
@@ -231,61 +247,36 @@ uint8_t * sequence_decode(char *str, int ncoords, char **endptr, size_t *size)
 	  while(isspace(*str))
 				++str;
 
+		if(TIMESTAMP_NOT_FINITE(position_time))
+			ereport(ERROR,
+				(errcode(ERRCODE_INVALID_TEXT_REPRESENTATION),
+					errmsg("invalid input syntax for type spatiotemporal: instants must have finite times")));
 
-		/* Write in the serialized form of the gbox, if necessary. */
-		//if ( geom->bbox )
-		//	ptr += gserialized_from_gbox(geom->bbox, ptr);
+		if(i > 0 && position_time <= times[i - 1])
+			ereport(ERROR,
+				(errcode(ERRCODE_INVALID_TEXT_REPRESENTATION),
+					errmsg("invalid input syntax for type spatiotemporal: instants must be in increasing time order")));
 
-		/* Write in the serialized form of the geometry. */
-		// ptr += gserialized_from_lwgeom_point(lwgeom, ptr);
+		getPoint4d_p(lwgeom_as_lwpoint(lwgeom)->point, 0, &p);
 
-		Point *point;
-		LWPOINT *lwpoint;
+		lwgeom_free(lwgeom);
 
+		ops->encode(coords + i * ops->ndims, &p);
 
-		lwpoint = lwgeom_as_lwpoint(lwgeom);
-
-		point = (Point*)palloc(sizeof(Point));
-		point->x = lwpoint_get_x(lwpoint);
-		elog(INFO , "point->x %lf ", point->x);
-		point->y = lwpoint_get_y(lwpoint);
-		elog(INFO , "point->y %lf ", point->y);
-
-		memcpy(ptr, &point->x, sizeof(double));
-		ptr += sizeof(double);
-
-		memcpy(ptr, &point->y, sizeof(double));
-		ptr += sizeof(double);
-
-		/*s serialized Time */
-		// memcpy(ptr, &position_time, sizeof(Timestamp));
-		// ptr += sizeof(Timestamp);
-
-		//lwpoint_free(lwpoint);
-
+		times[i] = position_time;
 	}
 
-	*endptr = str;
+	if(st == NULL)
+		st = spatiotemporal_alloc(0, 0);
 
-	/* Calculate size as returned by data processing functions. */
-	return_size = ptr - data;
-
-	if ( expected_size != return_size ) /* Uh oh! */
-	{
-		elog(INFO, "Return size (%lu) not equal to expected size (%lu)!", return_size, expected_size);
-	}
-
-	if ( size ) /* Return the output size to the caller if necessary. */
-		*size = return_size;
+	st->npoints = ncoords;
 
+	if(ops != NULL)
+		ops->extent(coords, ncoords, &st->extent);
 
-	return data;
-
-	// g = gserialized_from_lwgeom(lwgeom, &ret_size);
-	// if ( ! g ) lwpgerror("Unable to serialize lwgeom.");
-
-	// SET_VARSIZE(g, ret_size);
+	*endptr = str;
 
+	return st;
 }
 
 struct spatiotemporal *spatiotemporal_decode(char *str)
@@ -300,12 +291,32 @@ struct spatiotemporal *spatiotemporal_decode(char *str)
 
 	struct spatiotemporal *st = NULL;
 
-	size_t ret_size = 0;
+	int32 srid = 0;
 
 
 	while(isspace(*cp))
 		cp++;
 
+	/* optional EWKT-like prefix: SRID=4326; */
+	if(strncasecmp(cp, SRID_WKT_TOKEN, SRID_WKT_TOKEN_LEN) == 0)
+	{
+		char *endptr;
+
+		cp += SRID_WKT_TOKEN_LEN;
+
+		srid = (int32) strtol(cp, &endptr, 10);
+
+		if(endptr == cp || *endptr != COLLECTION_DELIM || srid < 0 || srid > SRID_MAXIMUM)
+			ereport(ERROR,
+				(errcode(ERRCODE_INVALID_TEXT_REPRESENTATION),
+					errmsg("invalid input syntax for type spatiotemporal: bad SRID")));
+
+		cp = endptr + 1;
+
+		while(isspace(*cp))
+			cp++;
+	}
+
 	if(strncasecmp(cp, ST_WKT_TOKEN, ST_WKT_TOKEN_LEN) == 0)
 	{
 		cp += ST_WKT_TOKEN_LEN;
@@ -356,34 +367,22 @@ struct spatiotemporal *spatiotemporal_decode(char *str)
 			number_coords = coord_count(cp);
 
 			if(strncasecmp(cp, POINT_WKT_TOKEN, POINT_WKT_TOKEN_LEN) == 0)
-			{
-				uint8_t *data=  sequence_decode(cp, number_coords, &cp, &ret_size);
+				st = sequence_decode(cp, number_coords, &cp);
+			else
+				st = spatiotemporal_alloc(0, 0);
 
-				st = (struct spatiotemporal*)data;
-
-				if ( ! st ){
-					elog(INFO, "Unable to serialize lwgeom.");
-				}
-				else {
-
-					st->dummy = 0;
-
-					st->start_time = start_time;
-
-					st->end_time = end_time;
-
-					SET_VARSIZE(st, ret_size);
-
-					char *timestamp = palloc(2 * sizeof(Timestamp) + 1);
-
-				  	timestamp = DatumGetCString(DirectFunctionCall1(timestamp_out, PointerGetDatum(st->start_time)));
-
-				  	elog(INFO, " timestamp SERIALIZED: (%s)", timestamp);
+			/* the period in the header must be the one of the instants */
+			if(st->npoints > 0 &&
+			   (start_time != ST_TIMES(st)[0] || end_time != ST_TIMES(st)[st->npoints - 1]))
+				ereport(ERROR,
+					(errcode(ERRCODE_INVALID_TEXT_REPRESENTATION),
+						errmsg("invalid input syntax for type spatiotemporal: period does not match its instants")));
 
-				}
+			st->start_time = start_time;
 
+			st->end_time = end_time;
 
-			}
+			st->srid = srid;
 
 			if (*cp != RDELIM)
 				ereport(ERROR,
@@ -415,3 +414,188 @@ struct spatiotemporal *spatiotemporal_decode(char *str)
 
 
 }
+
+
+void
+wkt_append_double(StringInfo str, double d)
+{
+  enlargeStringInfo(str, WKT_DOUBLE_SIZE);
+
+#if PG_VERSION_NUM >= 120000
+  /* shortest digits that read back to the same double */
+  str->len += double_to_shortest_decimal_buf(d, str->data + str->len);
+#else
+  str->len += snprintf(str->data + str->len, WKT_DOUBLE_SIZE, "%.17g", d);
+#endif
+}
+
+
+static inline char *
+digits_encode(char *p, int v, int n)
+{
+  for(int i = n - 1; i >= 0; --i)
+  {
+    p[i] = '0' + v % 10;
+    v /= 10;
+  }
+
+  return p + n;
+}
+
+
+void
+wkt_append_timestamp(StringInfo str, Timestamp t, struct wkt_date_cache *cache)
+{
+  int64 day;
+
+  int64 usec;
+
+  char *p;
+
+  if(TIMESTAMP_NOT_FINITE(t))
+    goto slow;
+
+  day = t / USECS_PER_DAY;
+  usec = t % USECS_PER_DAY;
+
+  if(usec < 0)
+  {
+    usec += USECS_PER_DAY;
+    --day;
+  }
+
+  if(!cache->valid || cache->day != day)
+  {
+    int year;
+
+    int month;
+
+    int mday;
+
+    j2date((int) (day + POSTGRES_EPOCH_JDATE), &year, &month, &mday);
+
+    if(year < 1 || year > 9999)
+      goto slow;
+
+    p = digits_encode(cache->text, year, 4);
+    *p++ = '-';
+    p = digits_encode(p, month, 2);
+    *p++ = '-';
+    digits_encode(p, mday, 2);
+
+    cache->day = day;
+    cache->valid = true;
+  }
+
+  enlargeStringInfo(str, WKT_TIME_SIZE);
+
+  p = str->data + str->len;
+
+  memcpy(p, cache->text, sizeof(cache->text));
+  p += sizeof(cache->text);
+
+  *p++ = ' ';
+  p = digits_encode(p, (int) (usec / USECS_PER_HOUR), 2);
+  *p++ = ':';
+  p = digits_encode(p, (int) (usec / USECS_PER_MINUTE % MINS_PER_HOUR), 2);
+  *p++ = ':';
+  p = digits_encode(p, (int) (usec / USECS_PER_SEC % SECS_PER_MINUTE), 2);
+
+  usec %= USECS_PER_SEC;
+
+  if(usec != 0)
+  {
+    int ndigits = 6;
+
+    while(usec % 10 == 0)
+    {
+      usec /= 10;
+      --ndigits;
+    }
+
+    *p++ = '.';
+    p = digits_encode(p, (int) usec, ndigits);
+  }
+
+  *p = '\0';
+  str->len = (int) (p - str->data);
+
+  return;
+
+slow:
+  {
+    char *text = DatumGetCString(DirectFunctionCall1(timestamp_out, TimestampGetDatum(t)));
+
+    appendStringInfoString(str, text);
+
+    pfree(text);
+  }
+}
+
+
+char *spatiotemporal_encode(const struct spatiotemporal *st)
+{
+  int ndims = ST_NDIMS(st);
+
+  const double *coords = ST_COORDS(st);
+
+  const Timestamp *times = ST_TIMES(st);
+
+  const char *point_token;
+
+  struct wkt_date_cache cache;
+
+  StringInfoData str;
+
+  cache.valid = false;
+
+  switch(st->flags & (ST_FLAG_Z | ST_FLAG_M))
+  {
+    case ST_FLAG_Z: point_token = POINT_WKT_TOKEN " Z ("; break;
+    case ST_FLAG_M: point_token = POINT_WKT_TOKEN " M ("; break;
+    case ST_FLAG_Z | ST_FLAG_M: point_token = POINT_WKT_TOKEN " ZM ("; break;
+    default: point_token = POINT_WKT_TOKEN "("; break;
+  }
+
+  initStringInfo(&str);
+
+  /* one allocation for the whole text */
+  enlargeStringInfo(&str, 64 + 2 * WKT_TIME_SIZE +
+                          st->npoints * (16 + ndims * (WKT_DOUBLE_SIZE + 1) + WKT_TIME_SIZE));
+
+  if(st->srid != 0)
+    appendStringInfo(&str, SRID_WKT_TOKEN "%d%c", st->srid, COLLECTION_DELIM);
+
+  appendStringInfoString(&str, ST_WKT_TOKEN TRAJECTORY_WKT_TOKEN);
+  appendStringInfoChar(&str, LDELIM);
+
+  wkt_append_timestamp(&str, st->start_time, &cache);
+  appendStringInfoChar(&str, COLLECTION_DELIM);
+
+  wkt_append_timestamp(&str, st->end_time, &cache);
+  appendStringInfoChar(&str, COLLECTION_DELIM);
+
+  for(int32 i = 0; i < st->npoints; ++i)
+  {
+    const double *c = coords + i * ndims;
+
+    appendStringInfoString(&str, point_token);
+
+    for(int j = 0; j < ndims; ++j)
+    {
+      if(j > 0)
+        appendStringInfoChar(&str, ' ');
+
+      wkt_append_double(&str, c[j]);
+    }
+
+    appendStringInfoString(&str, "), ");
+
+    wkt_append_timestamp(&str, times[i], &cache);
+    appendStringInfoChar(&str, COLLECTION_DELIM);
+  }
+
+  appendStringInfoChar(&str, RDELIM);
+
+  return str.data;
+}
@@ -37,8 +37,53 @@
 /* PostGIS-T extension */
 #include "spatiotemporal.h"
 
+/* PostgreSQL */
+#include <lib/stringinfo.h>
+
+
+/*
+ * \brief Last date written by wkt_append_timestamp(), so times sharing a
+ *        day only format their time of day.
+ *
+ * \note Set 'valid' to false before the first use.
+ *
+ */
+struct wkt_date_cache
+{
+  bool valid;
+
+  int64 day;
+
+  char text[10];
+};
+
 struct spatiotemporal *spatiotemporal_decode(char *str);
 
+/*
+ * \brief Encode 'st' in the text form read by spatiotemporal_decode().
+ *
+ * \note Coordinates use the shortest digits that read back to the same
+ *       double, so encoding and decoding a value is lossless.
+ *
+ */
+char *spatiotemporal_encode(const struct spatiotemporal *st);
+
+/*
+ * \brief Append 'd' with the shortest digits that read back to the same
+ *        double.
+ *
+ */
+void wkt_append_double(StringInfo str, double d);
+
+/*
+ * \brief Append 't' as "YYYY-MM-DD HH:MM:SS[.ffffff]", the ISO form
+ *        accepted by timestamp_in whatever the DateStyle.
+ *
+ * \note Infinite values and years outside 1..9999 go through timestamp_out.
+ *
+ */
+void wkt_append_timestamp(StringInfo str, Timestamp t, struct wkt_date_cache *cache);
+
 
 
 #endif  /* __POSTGIST_H__ */
@@ -1,12 +1,65 @@
+import struct
+
 import numpy as np
 
+# binary send/receive format of spatiotemporal, see spatiotemporal_send()
+_HEADER = struct.Struct(">iiiiqq")
+_FLAG_Z = 0x01
+_FLAG_M = 0x02
+
+# microseconds between the Unix epoch and the PostgreSQL epoch (2000-01-01)
+_PG_EPOCH_US = 946684800000000
+
+
 class traj_py:
-    def __init__(self, x, y, t, unit = "D"):
+    def __init__(self, x, y, t, unit = "D", srid = 0):
         self.unit = unit
+        self.srid = srid
         self.x = np.array(x, dtype = "f8")
         self.y = np.array(y, dtype = "f8")
         self.t = np.array(t, dtype = "datetime64[{}]".format(unit))
-        self._t = {str(v): i for i, v in enumerate(t)}
+        self._index = None
+
+    @property
+    def _t(self):
+        # built on first lookup, so bulk loads do no per-vertex work
+        if self._index is None:
+            self._index = {str(v): i for i, v in enumerate(self.t)}
+        return self._index
+
+    @classmethod
+    def from_binary(cls, buf):
+        """Build a traj_py from the binary format of a spatiotemporal.
+
+        x and y are views on buf; only the times are converted.
+        """
+        flags, srid, n, _, start, end = _HEADER.unpack_from(buf, 0)
+        ndims = 2 + bool(flags & _FLAG_Z) + bool(flags & _FLAG_M)
+        offset = _HEADER.size
+        coords = np.frombuffer(buf, dtype = ">f8", count = n * ndims, offset = offset).reshape(n, ndims)
+        offset += 8 * n * ndims
+        times = np.frombuffer(buf, dtype = ">i8", count = n, offset = offset)
+
+        result = cls.__new__(cls)
+        result.unit = "us"
+        result.srid = srid
+        result.x = coords[:, 0]
+        result.y = coords[:, 1]
+        result.t = (times + _PG_EPOCH_US).astype("datetime64[us]")
+        result._index = None
+        return result
+
+    def to_binary(self):
+        """Encode as the binary format of a spatiotemporal (XY only)."""
+        n = len(self.x)
+        times = self.t.astype("datetime64[us]").astype("i8") - _PG_EPOCH_US
+        start, end = (int(times[0]), int(times[-1])) if n else (0, 0)
+        coords = np.empty((n, 2), dtype = ">f8")
+        coords[:, 0] = self.x
+        coords[:, 1] = self.y
+        return b"".join((_HEADER.pack(0, self.srid, n, 0, start, end),
+                         coords.tobytes(),
+                         times.astype(">i8").tobytes()))
     
     def __getitem__(self, t):
         t = np.datetime64(t, unit = self.unit)
@@ -44,10 +97,40 @@ class traj_py:
     def after(self, t):
         t = np.datetime64(t, unit = self.unit)
         mask = self.t > t
-        result = traj_py(self.x[mask], self.y[mask], self.t[mask])
+        result = traj_py(self.x[mask], self.y[mask], self.t[mask], self.unit, self.srid)
         return result
 
 
+def register_spatiotemporal(conn):
+    """Load and dump spatiotemporal as traj_py in binary on a psycopg 3 connection.
+
+    Use binary results, e.g. conn.cursor(binary = True), to get traj_py values.
+    """
+    from psycopg.adapt import Dumper, Loader
+    from psycopg.pq import Format
+    from psycopg.types import TypeInfo
+
+    info = TypeInfo.fetch(conn, "spatiotemporal")
+    if info is None:
+        raise LookupError("type spatiotemporal not found, is the postgist extension installed?")
+
+    class SpatioTemporalLoader(Loader):
+        format = Format.BINARY
+
+        def load(self, data):
+            return traj_py.from_binary(data)
+
+    class SpatioTemporalDumper(Dumper):
+        format = Format.BINARY
+        oid = info.oid
+
+        def dump(self, obj):
+            return obj.to_binary()
+
+    conn.adapters.register_loader(info.oid, SpatioTemporalLoader)
+    conn.adapters.register_dumper(traj_py, SpatioTemporalDumper)
+
+
 traj = traj_py([1,2,3], 
                [3,2,1], 
                ["2000-01-01","2000-02-01","2000-03-01"])